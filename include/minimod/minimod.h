@@ -34,7 +34,7 @@
 #endif
 #endif
 
-#define MINIMOD_CURRENT_ABI 2
+#define MINIMOD_CURRENT_ABI 4
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,11 +51,14 @@ extern "C" {
  * MINIMOD_INITFLAG_UNZIP - Mods are downloaded as ZIP files from mod.io.
  *	If your game cannot handle those directly and needs the files to be
  *	unpacked, this flag is what you are looking for.
+ * MINIMOD_INITFLAG_POLL - Callbacks are not invoked by minimod's threads,
+ *	but queued until the application calls <minimod_poll()>.
  */
 enum minimod_initflag
 {
 	MINIMOD_INITFLAG_TESTENV = 1,
 	MINIMOD_INITFLAG_UNZIP = 2,
+	MINIMOD_INITFLAG_POLL = 4,
 };
 
 /* Enum: minimod_err
@@ -255,12 +258,248 @@ struct minimod_event
  * If you wonder why *count* is not included: Every callback function with
  *  a pagination parameter also has a *size_t nsomething* parameter that
  *  contains the number of returned entries.
+ *
+ * is_last - Whether no further page follows. For the *_all()-queries
+ *	this is the end of the paging (see <Paging>), otherwise it is
+ *	whether *offset* plus *limit* reaches *total*.
  */
 struct minimod_pagination
 {
 	uint64_t offset;
 	uint64_t limit;
 	uint64_t total;
+	bool is_last;
+	char _padding[7];
+};
+
+/* Struct: minimod_cache_stats
+ *
+ * Counters of the response cache. See <minimod_set_cache()>.
+ *
+ * nhits - Responses served from the cache, because the server reported
+ *	them as not modified
+ * nmisses - Cacheable responses, which had to be downloaded
+ * nbytes_saved - Response bytes neither downloaded nor parsed due to hits
+ * nentries - Number of entries currently in the cache
+ * nbytes - Memory currently used by the cache
+ */
+struct minimod_cache_stats
+{
+	uint64_t nhits;
+	uint64_t nmisses;
+	uint64_t nbytes_saved;
+	uint64_t nentries;
+	uint64_t nbytes;
+};
+
+/* Struct: minimod_retry_policy
+ *
+ * See <minimod_set_retry_policy()>.
+ *
+ * max_retries - Retries after the first attempt. 0 disables retries.
+ * base_delay_ms - The n-th retry waits a random time between 0 and
+ *	*base_delay_ms* * 2^(n-1) (exponential backoff with full jitter)
+ * max_delay_ms - Upper bound of the above
+ */
+struct minimod_retry_policy
+{
+	uint32_t max_retries;
+	uint32_t base_delay_ms;
+	uint32_t max_delay_ms;
+	char _padding[4];
+};
+
+/* Struct: minimod_request_stats
+ *
+ * Outcome of a single GET request or download, including its retries.
+ * See <minimod_set_request_stats_callback()>.
+ *
+ * url - URL of the request, without the API key
+ * status - HTTP status of the last attempt, 0 if there was no response
+ * nretries - Number of times the request was sent again
+ * usecs - Time from sending the request the first time to the last
+ *	response, including the time waiting for retries
+ */
+struct minimod_request_stats
+{
+	char const *url;
+	uint64_t usecs;
+	uint32_t nretries;
+	int status;
+};
+
+/* Struct: minimod_install_stats
+ *
+ * Throughput of extracting a single mod. See
+ * <minimod_set_install_stats_callback()>.
+ *
+ * nfiles - Number of extracted files
+ * nbytes - Number of bytes written (uncompressed)
+ * nbytes_compressed - Number of bytes read from the ZIP file
+ * extract_usecs - Time spent on extraction in microseconds, including the
+ *	time waiting for a free worker
+ */
+struct minimod_install_stats
+{
+	uint64_t nfiles;
+	uint64_t nbytes;
+	uint64_t nbytes_compressed;
+	uint64_t extract_usecs;
+};
+
+/* Enum: minimod_install_phase
+ *
+ * MINIMOD_INSTALL_PHASE_NONE - Queued, fetching the modfile or finishing.
+ *	Never reported.
+ * MINIMOD_INSTALL_PHASE_DOWNLOADING - Downloading the ZIP file. With
+ *	MINIMOD_INITFLAG_UNZIP it may be extracted at the same time.
+ * MINIMOD_INSTALL_PHASE_EXTRACTING - Download finished, extracting.
+ */
+enum minimod_install_phase
+{
+	MINIMOD_INSTALL_PHASE_NONE = 0,
+	MINIMOD_INSTALL_PHASE_DOWNLOADING = 1,
+	MINIMOD_INSTALL_PHASE_EXTRACTING = 2,
+};
+
+/* Struct: minimod_install_progress
+ *
+ * Progress of a single installation. See
+ * <minimod_set_install_progress_callback()>.
+ *
+ * nbytes - Number of bytes downloaded so far
+ * filesize - Size of the ZIP file as reported by <minimod_modfile>
+ * bytes_per_second - Download rate since the previous report
+ * avg_bytes_per_second - Download rate since the download started
+ * nfiles_extracted - Number of files extracted so far
+ * nfiles_total - Number of files in the ZIP file, 0 while unknown.
+ *	It is unknown until the end, if the mod is extracted while
+ *	being downloaded.
+ */
+struct minimod_install_progress
+{
+	uint64_t game_id;
+	uint64_t mod_id;
+	uint64_t nbytes;
+	uint64_t filesize;
+	uint64_t bytes_per_second;
+	uint64_t avg_bytes_per_second;
+	uint64_t nfiles_extracted;
+	uint64_t nfiles_total;
+	enum minimod_install_phase phase;
+	char _padding[4];
+};
+
+/* Enum: minimod_install_error
+ *
+ * Reason an installation failed.
+ * See <minimod_set_install_error_callback()>.
+ *
+ * MINIMOD_INSTALL_ERROR_NOT_FOUND - The mod or its modfile was not found
+ * MINIMOD_INSTALL_ERROR_DOWNLOAD - The download failed or is incomplete
+ * MINIMOD_INSTALL_ERROR_CHECKSUM - The MD5 digest of the download does
+ *	not match the one of <minimod_modfile>
+ * MINIMOD_INSTALL_ERROR_EXTRACT - The ZIP file could not be extracted
+ * MINIMOD_INSTALL_ERROR_DISK - Writing to the root-path failed
+ * MINIMOD_INSTALL_ERROR_STALLED - The download stalled.
+ *	See <minimod_set_install_progress_callback()>.
+ * MINIMOD_INSTALL_ERROR_CANCELLED - <minimod_deinit()> was called before
+ *	the installation started
+ */
+enum minimod_install_error
+{
+	MINIMOD_INSTALL_ERROR_NONE = 0,
+	MINIMOD_INSTALL_ERROR_NOT_FOUND,
+	MINIMOD_INSTALL_ERROR_DOWNLOAD,
+	MINIMOD_INSTALL_ERROR_CHECKSUM,
+	MINIMOD_INSTALL_ERROR_EXTRACT,
+	MINIMOD_INSTALL_ERROR_DISK,
+	MINIMOD_INSTALL_ERROR_STALLED,
+	MINIMOD_INSTALL_ERROR_CANCELLED,
+};
+
+/* Enum: minimod_install_priority
+ *
+ * Order in which queued installations are started.
+ * Installations of the same priority start in the order they were queued.
+ *
+ * MINIMOD_INSTALL_PRIORITY_USER - Explicitly requested by the user
+ * MINIMOD_INSTALL_PRIORITY_NORMAL - Regular installations
+ * MINIMOD_INSTALL_PRIORITY_BACKGROUND - i.e. updates of installed mods
+ */
+enum minimod_install_priority
+{
+	MINIMOD_INSTALL_PRIORITY_USER = 0,
+	MINIMOD_INSTALL_PRIORITY_NORMAL = 1,
+	MINIMOD_INSTALL_PRIORITY_BACKGROUND = 2,
+};
+
+/* Type: minimod_handle
+ *
+ * Identifies a request, to cancel it, change its priority or wait for it.
+ * Returned by the minimod_get_*() functions and the installation
+ * functions. 0 is never a valid handle, it means that the request was not
+ * made.
+ *
+ * Handles are not reused, so a handle of a finished request is just not
+ * found anymore.
+ *
+ * See:
+ *	<minimod_cancel()>, <minimod_set_priority()>, <minimod_wait()>
+ */
+typedef uint64_t minimod_handle;
+
+/* Constant: MINIMOD_WAIT_FOREVER
+ *
+ * Timeout of <minimod_wait()> and friends, to wait without a time limit.
+ */
+#define MINIMOD_WAIT_FOREVER UINT32_MAX
+
+/* Enum: minimod_priority
+ *
+ * Order in which requests waiting for a connection (see
+ * <minimod_set_max_connections()>) or for the rate limit are sent.
+ * Requests of the same priority are sent in the order they were made.
+ * For installations these match the <minimod_install_priority>.
+ *
+ * MINIMOD_PRIORITY_INTERACTIVE - The user is waiting for it. This is the
+ *	default of all requests.
+ * MINIMOD_PRIORITY_PREFETCH - Likely needed soon, i.e. the next page
+ * MINIMOD_PRIORITY_BACKGROUND - Nobody is waiting for it
+ */
+enum minimod_priority
+{
+	MINIMOD_PRIORITY_INTERACTIVE = 0,
+	MINIMOD_PRIORITY_PREFETCH = 1,
+	MINIMOD_PRIORITY_BACKGROUND = 2,
+};
+
+/* Struct: minimod_install_queue_stats
+ *
+ * Progress of the install queue. See <minimod_enqueue_install()>.
+ *
+ * The counters of finished installations and bytes are reset, whenever
+ * an installation is queued while the queue is idle. So they describe
+ * the current batch of installations.
+ *
+ * nqueued - Installations waiting for a download slot
+ * ndownloading - Installations fetching meta-data or downloading
+ * nextracting - Installations extracting or waiting for an extraction slot
+ * nsucceeded - Installations finished successfully
+ * nfailed - Installations that failed. Cancelled ones are not counted.
+ * nbytes_total - Sum of file sizes of all started downloads
+ * nbytes_done - Sum of file sizes of all finished downloads
+ */
+struct minimod_install_queue_stats
+{
+	uint32_t nqueued;
+	uint32_t ndownloading;
+	uint32_t nextracting;
+	uint32_t nsucceeded;
+	uint32_t nfailed;
+	char _padding[4];
+	uint64_t nbytes_total;
+	uint64_t nbytes_done;
 };
 
 /* Topic: [More Is Less]
@@ -387,6 +626,59 @@ typedef void (*minimod_install_callback)(
   uint64_t in_game_id,
   uint64_t in_mod_id);
 
+/* Callback: minimod_install_stats_callback()
+ *
+ * See:
+ *  <minimod_set_install_stats_callback()>
+ */
+typedef void (*minimod_install_stats_callback)(
+  void *in_userdata,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  struct minimod_install_stats const *in_stats);
+
+/* Callback: minimod_request_stats_callback()
+ *
+ * *in_stats* is only valid during the callback.
+ *
+ * See:
+ *  <minimod_set_request_stats_callback()>
+ */
+typedef void (*minimod_request_stats_callback)(
+  void *in_userdata,
+  struct minimod_request_stats const *in_stats);
+
+/* Callback: minimod_install_error_callback()
+ *
+ * See:
+ *  <minimod_set_install_error_callback()>
+ */
+typedef void (*minimod_install_error_callback)(
+  void *in_userdata,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_install_error in_error);
+
+/* Callback: minimod_install_progress_callback()
+ *
+ * See:
+ *  <minimod_set_install_progress_callback()>
+ */
+typedef void (*minimod_install_progress_callback)(
+  void *in_userdata,
+  struct minimod_install_progress const *in_progress);
+
+/* Callback: minimod_install_queue_callback()
+ *
+ * Called whenever an installation changes its state.
+ *
+ * See:
+ *  <minimod_set_install_queue_callback()>
+ */
+typedef void (*minimod_install_queue_callback)(
+  void *in_userdata,
+  struct minimod_install_queue_stats const *in_stats);
+
 /* Callback: minimod_enum_installed_mods_callback()
  *
  * Called once for each currently installed mod.
@@ -402,6 +694,19 @@ typedef void (*minimod_enum_installed_mods_callback)(
   uint64_t in_mod_id,
   char const *in_path);
 
+/* Callback: minimod_enum_archive_callback()
+ *
+ * Called once for each file in an archive. *in_name* stays valid until the
+ * archive is closed.
+ *
+ * See:
+ *  <minimod_enum_archive()>
+ */
+typedef void (*minimod_enum_archive_callback)(
+  void *in_userdata,
+  char const *in_name,
+  uint64_t in_nbytes);
+
 /* Callback: minimod_get_events_callback()
  *
  * See:
@@ -492,7 +797,107 @@ minimod_init(
 MINIMOD_LIB void
 minimod_deinit(void);
 
+/* Function: minimod_poll()
+ *
+ * Invoke the callbacks queued with <MINIMOD_INITFLAG_POLL>, in the order
+ * their requests finished, on the calling thread.
+ *
+ * Responses are parsed by minimod's threads already, so a callback only
+ * costs the conversion to minimod-structs and the callback itself. This
+ * applies to queries, paged queries, authentication, ratings,
+ * subscriptions and installations (and thus sync, reconcile and
+ * dependency resolution, which are driven by those). Callbacks reporting
+ * progress or statistics are still invoked by minimod's threads.
+ *
+ * Without MINIMOD_INITFLAG_POLL callbacks are invoked right away and
+ * this does nothing. Calls from within a callback or concurrent calls
+ * return 0 right away. Callbacks still queued by <minimod_deinit()> are
+ * invoked by it.
+ *
+ * Parameters:
+ *	in_max_items - Maximum number of callbacks to invoke, 0 for all.
+ *	in_budget_us - No further callback is invoked once this many
+ *		microseconds passed, 0 for no limit. At least one callback is
+ *		invoked, if there is any.
+ *
+ * Returns:
+ *	The number of callbacks invoked.
+ */
+MINIMOD_LIB size_t
+minimod_poll(size_t in_max_items, uint64_t in_budget_us);
+
+/* Function: minimod_get_completion_fd()
+ *
+ * Get a descriptor which becomes readable once callbacks are queued for
+ * <minimod_poll()>, to wait for them in an event loop (epoll, kqueue,
+ * io_uring, ...) instead of polling periodically.
+ *
+ * It is an eventfd on Linux and the reading end of a pipe on other POSIX
+ * systems. Do not read from or close it, <minimod_poll()> resets it.
+ * It stays readable as long as <minimod_poll()> left callbacks in the
+ * queue, and may occasionally be readable without any.
+ *
+ * On Windows it is an event HANDLE to be used with
+ * WaitForMultipleObjects() and friends, instead.
+ *
+ * Returns:
+ *	The descriptor, valid until <minimod_deinit()>.
+ *	-1 without <MINIMOD_INITFLAG_POLL>.
+ */
+MINIMOD_LIB intptr_t
+minimod_get_completion_fd(void);
+
+/* Struct: minimod_ctx
+ *
+ * Opaque handle of an instance of minimod. See <minimod_ctx_create()>.
+ */
+struct minimod_ctx;
+
+/* Function: minimod_ctx_create()
+ *
+ * Create an independent instance of minimod, like <minimod_init()>, but
+ * without replacing the one used by the functions without a context.
+ *
+ * Every minimod_* function which is not about a single object (paging,
+ * archives, 'more') has a variant minimod_ctx_*, which takes the context
+ * as first argument and behaves the same otherwise. See <Contexts>.
+ *
+ * Contexts do not share any state, except for the network layer and
+ * <minimod_set_debugtesting()>. Each of them is thread-safe on its own,
+ * so an application may use a context per thread or per account, and
+ * different root paths, API keys or environments at the same time.
+ * Two contexts must not use the same root path though.
+ *
+ * Parameters:
+ *	out_ctx - Set to the new context, which needs to be passed to
+ *		<minimod_ctx_destroy()>, on success only.
+ *
+ * Returns:
+ *	MINIMOD_ERR_OK on success. See <minimod_err> for possible errors.
+ */
+MINIMOD_LIB enum minimod_err
+minimod_ctx_create(
+  char const *in_api_key,
+  char const *in_root_path,
+  unsigned int in_flags,
+  uint32_t in_abi_version,
+  struct minimod_ctx **out_ctx);
+
+/* Function: minimod_ctx_destroy()
+ *
+ * Counterpart of <minimod_ctx_create()>, like <minimod_deinit()>.
+ *
+ * Installations in progress are aborted, and callbacks of requests still
+ * in flight are invoked before this returns, so no callback of the
+ * context is invoked afterwards.
+ */
+MINIMOD_LIB void
+minimod_ctx_destroy(struct minimod_ctx *in_ctx);
+
 /* Function: minimod_is_ratelimited()
+ *
+ * While the API is rate-limited, requests are not sent but held back until
+ * the limiting expires. See <minimod_set_request_rate()>.
  *
  * Returns:
  *  A negative value when the API is not currently rate-limited.
@@ -501,6 +906,169 @@ minimod_deinit(void);
 MINIMOD_LIB int64_t
 minimod_is_ratelimited(void);
 
+/* Function: minimod_set_request_rate()
+ *
+ * Pace requests to the API to stay below its rate limit.
+ *
+ * Requests are sent right away as long as there are tokens in a bucket,
+ * which holds up to *in_burst* tokens and is refilled at
+ * *in_requests_per_minute*. Further requests are queued and sent in order,
+ * once tokens are available again. Responses which tell how many requests
+ * are left (X-RateLimit-Remaining) drain the bucket accordingly.
+ *
+ * Parameters:
+ *	in_requests_per_minute - 0 follows the limit reported by the API
+ *		(X-RateLimit-Limit), starting with 60. This is the default.
+ *	in_burst - Requests which can be sent at once. 0 uses the default of 10.
+ */
+MINIMOD_LIB void
+minimod_set_request_rate(
+  uint32_t in_requests_per_minute,
+  unsigned int in_burst);
+
+/* Function: minimod_get_scheduled_requests()
+ *
+ * Returns:
+ *	The number of requests waiting to be sent.
+ */
+MINIMOD_LIB size_t
+minimod_get_scheduled_requests(void);
+
+/* Function: minimod_set_max_connections()
+ *
+ * Limit the number of API requests in flight. Further requests wait for
+ * a response and are sent by their <minimod_priority>. Downloads of
+ * modfiles are limited by <minimod_set_install_limits()> instead.
+ *
+ * Parameters:
+ *	in_max_connections - 0 uses the default of 8.
+ */
+MINIMOD_LIB void
+minimod_set_max_connections(unsigned int in_max_connections);
+
+/* Function: minimod_cancel()
+ *
+ * Cancel a request. Its callback is not invoked anymore, once this
+ * returns true.
+ *
+ * Requests waiting to be sent are dropped, responses of requests in
+ * flight are ignored. Responses shared with other requests (see
+ * <minimod_set_batching()> and identical requests in flight) are still
+ * fetched for those.
+ *
+ * Queued installations are removed from the queue. Running ones are
+ * aborted, even while downloading or extracting, unless another
+ * installation joined them. Their callback is not invoked, neither is
+ * the error callback. A partial download is kept to be resumed by the
+ * next installation of the same modfile.
+ *
+ * Returns:
+ *	false if *in_handle* is not found, i.e. its callback was invoked
+ *	already or is being invoked.
+ */
+MINIMOD_LIB bool
+minimod_cancel(minimod_handle in_handle);
+
+/* Function: minimod_set_priority()
+ *
+ * Change the priority of a request which is not sent yet, or of a queued
+ * installation.
+ *
+ * Returns:
+ *	false if *in_handle* is not found.
+ */
+MINIMOD_LIB bool
+minimod_set_priority(
+  minimod_handle in_handle,
+  enum minimod_priority in_priority);
+
+/* Function: minimod_wait()
+ *
+ * Block the calling thread until the callback of a request returned, or
+ * the request was cancelled.
+ *
+ * Do not wait from within a callback. With <MINIMOD_INITFLAG_POLL>,
+ * callbacks are only invoked by <minimod_poll()>, so waiting on the
+ * polling thread only ends by the timeout.
+ *
+ * Parameters:
+ *	in_timeout_ms - 0 to merely check whether the request is finished,
+ *		<MINIMOD_WAIT_FOREVER> for no limit.
+ *
+ * Returns:
+ *	false if the time was up before the request finished.
+ *	Handle 0 is always finished.
+ */
+MINIMOD_LIB bool
+minimod_wait(minimod_handle in_handle, uint32_t in_timeout_ms);
+
+/* Function: minimod_wait_all()
+ *
+ * Like <minimod_wait()>, but for all of *in_handles*.
+ *
+ * Returns:
+ *	false if the time was up before all requests finished.
+ */
+MINIMOD_LIB bool
+minimod_wait_all(
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms);
+
+/* Function: minimod_wait_any()
+ *
+ * Like <minimod_wait()>, but for any of *in_handles*.
+ *
+ * Returns:
+ *	The index of the first finished request in *in_handles*, which may
+ *	have finished before already. *in_nhandles* if the time was up.
+ */
+MINIMOD_LIB size_t
+minimod_wait_any(
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms);
+
+/* Function: minimod_set_retry_policy()
+ *
+ * Configure how GET requests and downloads of modfiles are retried after
+ * transient failures: no connection, HTTP status 408, 429, 500, 502, 503
+ * and 504. Other requests are never retried.
+ *
+ * Callbacks are only invoked once a request succeeded, or failed for good.
+ * By default requests are retried twice, starting with up to 250 ms.
+ *
+ * Retries are limited by a budget shared by all requests: every retry
+ * costs a token and every request which succeeded without retrying earns
+ * a tenth of one, up to 10. So during an outage retries cease, instead of
+ * adding to the load.
+ *
+ * Downloads which are extracted while being downloaded
+ * (<MINIMOD_INITFLAG_UNZIP>) are not retried.
+ *
+ * Parameters:
+ *	in_endpoint - NULL sets the default policy. Otherwise the policy applies
+ *		to requests whose path relative to the API starts with it, i.e.
+ *		"/me" or "/games/5/mods". The longest match wins. "download" matches
+ *		downloads of modfiles.
+ *	in_policy - NULL restores the default policy or removes the one of
+ *		*in_endpoint*.
+ */
+MINIMOD_LIB void
+minimod_set_retry_policy(
+  char const *in_endpoint,
+  struct minimod_retry_policy const *in_policy);
+
+/* Function: minimod_set_request_stats_callback()
+ *
+ * Get the status, number of retries and latency of every GET request and
+ * download, once it is finished. Pass NULL to disable it.
+ */
+MINIMOD_LIB void
+minimod_set_request_stats_callback(
+  minimod_request_stats_callback in_callback,
+  void *in_userdata);
+
 /* Function: minimod_set_debugtesting()
  *
  * Enable random delays in server responses and a chance for failed
@@ -518,7 +1086,74 @@ minimod_is_ratelimited(void);
 MINIMOD_LIB void
 minimod_set_debugtesting(int error_rate, int min_delay, int max_delay);
 
-/* Topic: Queries */
+/* Function: minimod_set_cache()
+ *
+ * Enable, resize or disable the response cache. It is disabled by default.
+ *
+ * Responses of GET requests that do not require an authenticated user
+ * (games, mods, modfiles, events, dependencies) are kept in memory and
+ * mirrored to the "cache" directory in minimod's root-path.
+ * Repeated requests are sent as conditional requests
+ * (If-None-Match/If-Modified-Since). If the server answers that the data
+ * did not change, the cached response is used without downloading or
+ * parsing it again.
+ *
+ * Entries are keyed by their URL, excluding the API key.
+ *
+ * Call this after <minimod_init()> and before issuing any requests.
+ *
+ * Parameters:
+ *	in_max_bytes - Maximum memory used by the cache. 0 disables it.
+ *	in_max_entries - Maximum number of cached responses. 0 disables it.
+ *
+ * The cache directory is bounded by the same limits: a response evicted
+ * from memory is deleted from disk as well, so lowering the limits
+ * shrinks the directory accordingly.
+ *
+ * See:
+ *	<minimod_get_cache_stats()>
+ */
+MINIMOD_LIB void
+minimod_set_cache(size_t in_max_bytes, size_t in_max_entries);
+
+/* Function: minimod_set_batching()
+ *
+ * Enable or disable batching of mod lookups. It is disabled by default.
+ *
+ * With batching enabled, calls of <minimod_get_mods()> for a single mod
+ * and without a filter are not sent right away. Instead all lookups of
+ * mods of the same game within *in_window_ms* are sent as a single
+ * request (id-in=...), and its response is passed to each of their
+ * callbacks, as if they were sent on their own.
+ *
+ * Mods which are not listed publicly (i.e. hidden ones) are not part of
+ * the response of a batch, so looking them up fails.
+ *
+ * Parameters:
+ *	in_window_ms - How long the first lookup of a batch waits for others.
+ *		0 disables batching.
+ *	in_max_batch_size - A batch is sent once it holds this many lookups,
+ *		even if its window did not pass yet. 0 uses the default of 50, at
+ *		most 100 are used.
+ */
+MINIMOD_LIB void
+minimod_set_batching(uint32_t in_window_ms, unsigned int in_max_batch_size);
+
+/* Function: minimod_get_cache_stats()
+ *
+ * Get the current counters of the response cache to help tuning its
+ * limits. All counters are 0 if the cache was never enabled.
+ */
+MINIMOD_LIB void
+minimod_get_cache_stats(struct minimod_cache_stats *out_stats);
+
+/* Topic: Queries
+ *
+ *  All queries return immediately and invoke their callback once the
+ *  response arrived, or the request failed. They return a
+ *  <minimod_handle> to cancel the request (<minimod_cancel()>) or to
+ *  change its <minimod_priority>.
+ */
 
 /* Topic: [Filtering Sorting Pagination]
  *
@@ -548,7 +1183,7 @@ minimod_set_debugtesting(int error_rate, int min_delay, int max_delay);
  *	See:
  *	  https://docs.mod.io/#get-all-games
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_get_games(
   char const *in_filter,
   minimod_get_games_callback in_callback,
@@ -565,10 +1200,12 @@ minimod_get_games(
  *		in_mod_id - ID for the specific mod to retrieve data about, or 0
  *			to get all mods for the game.
  *
+ *	Lookups of a single mod may be batched, see <minimod_set_batching()>.
+ *
  *	See:
  *	  https://docs.mod.io/#get-all-mods
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_get_mods(
   char const *in_filter,
   uint64_t in_game_id,
@@ -591,7 +1228,7 @@ minimod_get_mods(
  * See:
  *  https://docs.mod.io/#get-all-modfiles
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_get_modfiles(
   char const *in_filter,
   uint64_t in_game_id,
@@ -631,7 +1268,7 @@ minimod_get_modfiles(
  * See:
  *  https://docs.mod.io/#get-all-mod-events
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_get_mod_events(
   char const *in_filter,
   uint64_t in_game_id,
@@ -651,24 +1288,79 @@ minimod_get_mod_events(
  * See:
  *  https://docs.mod.io/#get-all-mod-dependencies
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_get_dependencies(
   uint64_t in_game_id,
   uint64_t in_mod_id,
   minimod_get_dependencies_callback in_callback,
   void *in_userdata);
 
-
-/* Topic: Authentication */
-
-/* Function: minimod_is_authenticated()
+/* Struct: minimod_dependency_order
  *
- * Returns:
- *  true if an access token is locally available.
- *  But the token may be expired or invalidated by the server, so this
- *  is not a guarantee that a call will succeed. If a call fails because
+ * mod_ids - The mods which are not installed yet, each one after all of
+ *	its dependencies. Includes *mod_id* itself, unless it is installed.
+ * nresolved - Number of distinct mods in the dependency graph, including
+ *	installed ones.
+ * has_cycle - Some mods depend on each other (indirectly). Among those the
+ *	order is arbitrary.
+ */
+struct minimod_dependency_order
+{
+	uint64_t game_id;
+	uint64_t mod_id;
+	uint64_t const *mod_ids;
+	size_t nmod_ids;
+	size_t nresolved;
+	bool has_cycle;
+	char _padding[7];
+};
+
+/* Callback: minimod_resolve_dependencies_callback()
+ *
+ * *in_order* is NULL, if any of the dependencies could not be retrieved.
+ * It is only valid during the callback.
+ *
+ * See:
+ *  <minimod_resolve_dependencies()>
+ */
+typedef void (*minimod_resolve_dependencies_callback)(
+  void *in_userdata,
+  struct minimod_dependency_order const *in_order);
+
+/* Function: minimod_resolve_dependencies()
+ *
+ * Retrieve the dependencies of a mod, their dependencies and so on,
+ * and order them for installation.
+ *
+ * The graph is expanded breadth-first: the dependencies of all mods
+ * discovered so far are requested concurrently, every mod only once.
+ * So a mod with many transitive dependencies takes about as many
+ * round trips as its dependency graph is deep.
+ *
+ * Parameters:
+ *	in_max_inflight - Maximum number of concurrent requests.
+ *		0 uses a default of 4, at most 16 are used.
+ */
+MINIMOD_LIB void
+minimod_resolve_dependencies(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_resolve_dependencies_callback in_callback,
+  void *in_userdata);
+
+
+/* Topic: Authentication */
+
+/* Function: minimod_is_authenticated()
+ *
+ * Returns:
+ *  true if an access token is locally available.
+ *  But the token may be expired or invalidated by the server, so this
+ *  is not a guarantee that a call will succeed. If a call fails because
  *  the token is invalid, minimod automatically removes the token and
- *  *minimod_is_authenticated()* will return false from there on.
+ *  *minimod_is_authenticated()* will return false from there on, unless
+ *  the user was authenticated again in the meantime.
  *
  * See:
  *	<minimod_deauthenticate()>
@@ -679,6 +1371,9 @@ minimod_is_authenticated(void);
 /* Function: minimod_deauthenticate()
  *
  * Remove the current access token from the system.
+ *
+ * Requests which were started before keep using the token they were
+ * started with.
  */
 MINIMOD_LIB void
 minimod_deauthenticate(void);
@@ -734,9 +1429,10 @@ minimod_steam_auth(
  * Fetch information about the currently authenticated user.
  *
  * Returns:
- *	false if no user is currently authenticated.
+ *	0 if no user is currently authenticated, otherwise the
+ *	<minimod_handle> of the request.
  */
-MINIMOD_LIB bool
+MINIMOD_LIB minimod_handle
 minimod_get_me(minimod_get_users_callback in_callback, void *in_userdata);
 
 /* Function: minimod_get_user_events()
@@ -753,12 +1449,13 @@ minimod_get_me(minimod_get_users_callback in_callback, void *in_userdata);
  *			cutoff date, without requiring to use in_filter just for that
  *
  * Returns:
- *	false if no user is currently authenticated.
+ *	0 if no user is currently authenticated, otherwise the
+ *	<minimod_handle> of the request.
  *
  * See:
  *  https://docs.mod.io/#get-user-events
  */
-MINIMOD_LIB bool
+MINIMOD_LIB minimod_handle
 minimod_get_user_events(
   char const *in_filter,
   uint64_t in_game_id,
@@ -775,12 +1472,23 @@ minimod_get_user_events(
  * ZIP file or, if MINIMOD_INITFLAG_UNZIP was set, decompress the ZIP file
  * into a directory.
  *
+ * Extraction happens in a temporary directory first, which replaces
+ * the directory of a previously installed version only once all files
+ * were extracted successfully.
+ *
+ * Returns immediately. The mod's meta-data and its modfile are requested
+ * concurrently, the download starts as soon as the modfile is known.
+ * *in_callback* is invoked once all steps are done.
+ *
+ * Installations are queued with MINIMOD_INSTALL_PRIORITY_USER, see
+ * <minimod_enqueue_install()>.
+ *
  * Parameters:
  *	in_game_id - Cannot be 0.
  *	in_mod_id - Cannot be 0.
  *	in_modfile_id - Can be 0 to select the most current modfile for the mod.
  */
-MINIMOD_LIB void
+MINIMOD_LIB minimod_handle
 minimod_install(
   uint64_t in_game_id,
   uint64_t in_mod_id,
@@ -788,6 +1496,135 @@ minimod_install(
   minimod_install_callback in_callback,
   void *in_userdata);
 
+/* Function: minimod_enqueue_install()
+ *
+ * Queue the installation of a mod. Same as <minimod_install()>, but with
+ * an explicit priority.
+ *
+ * At most *max_downloads* installations (see <minimod_set_install_limits()>)
+ * are running at a time, further ones wait in the queue and are started
+ * by priority.
+ *
+ * If the same modfile of the mod is queued or being installed already,
+ * the installation is shared: *in_callback* is invoked once it finished,
+ * and a queued installation takes the higher of both priorities.
+ * Otherwise it waits, while an installation of the mod which finished
+ * early is still running, e.g. a stalled download.
+ *
+ * *in_callback* may be NULL, if the queue callbacks suffice.
+ *
+ * Returns:
+ *	A <minimod_handle> to cancel the installation or to change its
+ *	priority. A shared installation is only aborted once all of its
+ *	handles are cancelled.
+ */
+MINIMOD_LIB minimod_handle
+minimod_enqueue_install(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  enum minimod_install_priority in_priority,
+  minimod_install_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_set_install_limits()
+ *
+ * Limit the concurrency of installations.
+ *
+ * While all extraction slots are taken, further mods are downloaded to
+ * a ZIP file first and extracted once a slot is available, instead of
+ * being extracted while downloading.
+ *
+ * Parameters:
+ *	in_max_downloads - Maximum number of concurrent downloads. 0 uses the
+ *		default of 4.
+ *	in_max_extractions - Maximum number of concurrent extractions. 0 uses
+ *		the default of 2. Only used with MINIMOD_INITFLAG_UNZIP.
+ */
+MINIMOD_LIB void
+minimod_set_install_limits(
+  unsigned int in_max_downloads,
+  unsigned int in_max_extractions);
+
+/* Function: minimod_get_install_queue_stats()
+ */
+MINIMOD_LIB void
+minimod_get_install_queue_stats(
+  struct minimod_install_queue_stats *out_stats);
+
+/* Function: minimod_set_install_queue_callback()
+ *
+ * Set a function to be called on every change of the install queue, to
+ * report the progress of many installations at once.
+ * It is called from any of minimod's threads.
+ *
+ * Call this after <minimod_init()> and before installing any mods.
+ * Pass NULL to remove the callback.
+ */
+MINIMOD_LIB void
+minimod_set_install_queue_callback(
+  minimod_install_queue_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_set_install_stats_callback()
+ *
+ * Set a function to be called with the throughput of every successful
+ * extraction (MINIMOD_INITFLAG_UNZIP), right before the
+ * <minimod_install_callback()> of the installation.
+ *
+ * ZIP files are extracted on a pool of worker threads, so the callback
+ * can be called from any of them.
+ *
+ * Call this after <minimod_init()> and before installing any mods.
+ * Pass NULL to remove the callback.
+ */
+MINIMOD_LIB void
+minimod_set_install_stats_callback(
+  minimod_install_stats_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_set_install_error_callback()
+ *
+ * Set a function to be called with the reason of every failed
+ * installation, right before the <minimod_install_callback()> of the
+ * installation.
+ *
+ * Call this after <minimod_init()> and before installing any mods.
+ * Pass NULL to remove the callback.
+ */
+MINIMOD_LIB void
+minimod_set_install_error_callback(
+  minimod_install_error_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_set_install_progress_callback()
+ *
+ * Report the progress of all running installations periodically.
+ * The callback is invoked from a dedicated thread, once per interval for
+ * every installation which is downloading or extracting.
+ *
+ * Downloads which did not receive a single byte for *in_stall_timeout_ms*
+ * are considered stalled: their installation fails right away, i.e. its
+ * <minimod_install_callback()> is invoked with *in_success* = false.
+ * The download is aborted as soon as it receives data again, otherwise
+ * the connection is left to time out in the background. Either way its
+ * slot is only available again afterwards.
+ *
+ * Call this after <minimod_init()>.
+ * Pass NULL and 0 as *in_stall_timeout_ms* to stop reporting.
+ *
+ * Parameters:
+ *	in_interval_ms - Time between two reports. 0 uses the default of
+ *		250 ms.
+ *	in_stall_timeout_ms - 0 disables the detection of stalled downloads.
+ */
+MINIMOD_LIB void
+minimod_set_install_progress_callback(
+  minimod_install_progress_callback in_callback,
+  void *in_userdata,
+  uint32_t in_interval_ms,
+  uint32_t in_stall_timeout_ms);
+
 /* Function: minimod_uninstall()
  *
  * Attempt to uninstall (delete) the specified mod.
@@ -842,6 +1679,177 @@ minimod_get_installed_mod(
   minimod_get_mods_callback in_callback,
   void *in_userdata);
 
+/* Struct: minimod_archive
+ *
+ * Opaque handle of an installed ZIP file. See <minimod_open_archive()>.
+ */
+struct minimod_archive;
+
+/* Function: minimod_open_archive()
+ *
+ * Open a mod installed as ZIP file (without <MINIMOD_INITFLAG_UNZIP>) to
+ * read its files in place. The archive is memory-mapped and its central
+ * directory indexed once; the index is stored next to the ZIP file, so
+ * opening the archive again does not parse it either.
+ *
+ * Parameters:
+ *	in_cache_bytes - Maximum (uncompressed) bytes of deflated files kept
+ *		decompressed after they were released. With 0 they are
+ *		decompressed again on every <minimod_archive_get()>, as are
+ *		files larger than the limit.
+ *
+ * Returns:
+ *	NULL if the mod is not installed as ZIP file.
+ *
+ * See:
+ *	<minimod_close_archive()>
+ */
+MINIMOD_LIB struct minimod_archive *
+minimod_open_archive(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  size_t in_cache_bytes);
+
+/* Function: minimod_close_archive()
+ *
+ * Invalidates all data returned by <minimod_archive_get()>.
+ * On Windows the mod can not be updated or uninstalled while its archive
+ * is open.
+ */
+MINIMOD_LIB void
+minimod_close_archive(struct minimod_archive *in_archive);
+
+/* Function: minimod_archive_get()
+ *
+ * Get the contents of a file in an archive. Stored files are returned
+ * straight from the mapping, deflated files are decompressed into the
+ * cache of the archive unless they are in it already.
+ * Can be called from any thread.
+ *
+ * Parameters:
+ *	in_name - Path of the file in the archive, '/' separated.
+ *	out_bytes - Receives the size of the file.
+ *
+ * Returns:
+ *	NULL if there is no such file or it is broken. Otherwise the data needs
+ *	to be released by <minimod_archive_release()>.
+ */
+MINIMOD_LIB void const *
+minimod_archive_get(
+  struct minimod_archive *in_archive,
+  char const *in_name,
+  size_t *out_bytes);
+
+/* Function: minimod_archive_release()
+ */
+MINIMOD_LIB void
+minimod_archive_release(
+  struct minimod_archive *in_archive,
+  void const *in_data);
+
+/* Function: minimod_enum_archive()
+ *
+ * Call *in_callback* for every file (but no directory) in an archive.
+ */
+MINIMOD_LIB void
+minimod_enum_archive(
+  struct minimod_archive *in_archive,
+  minimod_enum_archive_callback in_callback,
+  void *in_userdata);
+
+
+/* Topic: Synchronization
+ *
+ * Keep the installed mods of a game in sync with the subscriptions of the
+ * authenticated user and the modfiles on mod.io, by polling for events
+ * instead of comparing everything on every launch.
+ *
+ * The newest event seen is stored per game, so a sync only fetches events
+ * which happened since: a small request for the user's events and one for
+ * events of the installed mods. Events are folded into a plan, i.e.
+ * subscribing and unsubscribing again does nothing, and the plan is run
+ * through the install queue (<MINIMOD_INSTALL_PRIORITY_BACKGROUND>).
+ *
+ * The first sync of a game only marks the point from which on events are
+ * applied, it does not compare subscriptions with installed mods. Use
+ * <minimod_reconcile()> for that.
+ */
+
+/* Enum: minimod_sync_action
+ *
+ * MINIMOD_SYNC_INSTALL - A subscribed mod was installed
+ * MINIMOD_SYNC_UPDATE - A new modfile of an installed mod was installed
+ * MINIMOD_SYNC_UNINSTALL - An unsubscribed or deleted mod was uninstalled
+ */
+enum minimod_sync_action
+{
+	MINIMOD_SYNC_INSTALL = 0,
+	MINIMOD_SYNC_UPDATE,
+	MINIMOD_SYNC_UNINSTALL,
+};
+
+/* Callback: minimod_sync_callback()
+ *
+ * Called once an action of a sync finished, from any thread.
+ *
+ * See:
+ *  <minimod_start_sync()>
+ */
+typedef void (*minimod_sync_callback)(
+  void *in_userdata,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_sync_action in_action,
+  bool in_success);
+
+/* Function: minimod_start_sync()
+ *
+ * Start syncing the installed mods of *in_game_id*. The first poll happens
+ * on the next <minimod_sync_tick()>. Starting a game which is synced
+ * already just replaces the callback.
+ *
+ * See:
+ *  <minimod_stop_sync()>
+ */
+MINIMOD_LIB void
+minimod_start_sync(
+  uint64_t in_game_id,
+  minimod_sync_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_stop_sync()
+ *
+ * Stop syncing *in_game_id*. Events of a running poll are not applied
+ * anymore, installations already queued go on.
+ */
+MINIMOD_LIB void
+minimod_stop_sync(uint64_t in_game_id);
+
+/* Function: minimod_sync_tick()
+ *
+ * Poll all synced games which are due. Call it regularly, i.e. once per
+ * frame, or after sleeping for the returned time.
+ *
+ * The interval between polls of a game adapts: it is reset to the minimum
+ * whenever there were events, and doubles up to the maximum otherwise
+ * (see <minimod_set_sync_interval()>). Once the newest events did not fit
+ * into a single response, the next poll is due immediately.
+ *
+ * Returns:
+ *	Milliseconds until the next poll is due.
+ */
+MINIMOD_LIB uint32_t
+minimod_sync_tick(void);
+
+/* Function: minimod_set_sync_interval()
+ *
+ * Parameters:
+ *	in_min_ms - Interval after events were found, 1 minute by default.
+ *	in_max_ms - Interval while nothing happens, 15 minutes by default.
+ */
+MINIMOD_LIB void
+minimod_set_sync_interval(uint32_t in_min_ms, uint32_t in_max_ms);
+
 
 /* Topic: Ratings */
 
@@ -873,12 +1881,13 @@ minimod_rate(
  * Retrieve all ratings of currently authenticated user.
  *
  * Returns:
- *	false if no user is currently authenticated.
+ *	0 if no user is currently authenticated, otherwise the
+ *	<minimod_handle> of the request.
  *
  * See:
  *  https://docs.mod.io/#get-user-ratings
  */
-MINIMOD_LIB bool
+MINIMOD_LIB minimod_handle
 minimod_get_ratings(
   char const *in_filter,
   minimod_get_ratings_callback in_callback,
@@ -892,12 +1901,13 @@ minimod_get_ratings(
  * Retrieve all subscriptions of the currently authenticated user.
  *
  * Returns:
- *	false if no user is currently authenticated.
+ *	0 if no user is currently authenticated, otherwise the
+ *	<minimod_handle> of the request.
  *
  * See:
  *  https://docs.mod.io/#get-user-subscriptions
  */
-MINIMOD_LIB bool
+MINIMOD_LIB minimod_handle
 minimod_get_subscriptions(
   char const *in_filter,
   minimod_get_mods_callback in_callback,
@@ -937,6 +1947,238 @@ minimod_unsubscribe(
   minimod_subscription_change_callback in_callback,
   void *in_userdata);
 
+/* Enum: minimod_reconcile_action
+ *
+ * MINIMOD_RECONCILE_INSTALL - Subscribed, but not installed
+ * MINIMOD_RECONCILE_UPDATE - Installed, but not the current modfile
+ * MINIMOD_RECONCILE_REMOVE - Installed, but not subscribed
+ */
+enum minimod_reconcile_action
+{
+	MINIMOD_RECONCILE_INSTALL = 0,
+	MINIMOD_RECONCILE_UPDATE,
+	MINIMOD_RECONCILE_REMOVE,
+};
+
+/* Struct: minimod_reconcile_step
+ *
+ * modfile_id - Modfile to be installed, 0 for removals
+ * filesize - Bytes to be downloaded, 0 for removals
+ */
+struct minimod_reconcile_step
+{
+	uint64_t mod_id;
+	uint64_t modfile_id;
+	uint64_t filesize;
+	enum minimod_reconcile_action action;
+	char _padding[4];
+};
+
+/* Struct: minimod_reconcile_plan
+ *
+ * steps - Installs first, then updates, then removals
+ * nbytes_download - Sum of *filesize* of all steps
+ */
+struct minimod_reconcile_plan
+{
+	uint64_t game_id;
+	struct minimod_reconcile_step const *steps;
+	size_t nsteps;
+	size_t ninstalls;
+	size_t nupdates;
+	size_t nremovals;
+	uint64_t nbytes_download;
+};
+
+/* Callback: minimod_reconcile_callback()
+ *
+ * *in_plan* is NULL, if the subscriptions could not be retrieved.
+ * It is only valid during the callback.
+ *
+ * See:
+ *  <minimod_reconcile()>
+ */
+typedef void (*minimod_reconcile_callback)(
+  void *in_userdata,
+  struct minimod_reconcile_plan const *in_plan);
+
+/* Function: minimod_reconcile()
+ *
+ * Compare the subscriptions of the authenticated user to the mods
+ * installed for *in_game_id* and plan what needs to be installed, updated
+ * or removed. The pages of subscriptions are retrieved concurrently
+ * (see <Paging>) and joined against the installed mods in a single pass.
+ *
+ * Parameters:
+ *	in_max_inflight - As with the *_all()-queries, 0 uses a default.
+ *	in_execute - Run the plan right after *in_callback* returned. Mods are
+ *		installed through the install queue with
+ *		<MINIMOD_INSTALL_PRIORITY_BACKGROUND>, so progress is reported by
+ *		<minimod_set_install_queue_callback()>.
+ *
+ * Returns:
+ *	false if no user is currently authenticated.
+ */
+MINIMOD_LIB bool
+minimod_reconcile(
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  bool in_execute,
+  minimod_reconcile_callback in_callback,
+  void *in_userdata);
+
+
+/* Topic: Paging
+ *
+ *  The *_all()-variants of the query functions retrieve every page of
+ *  a result set, instead of just the one described by *in_filter*.
+ *
+ *  The first page is requested right away. As soon as its 'result_total'
+ *  is known, the remaining pages are requested concurrently. At most
+ *  *in_max_inflight* pages (0 uses a default of 4) are in flight or
+ *  received but not delivered yet, so a slow page holds back the
+ *  following ones instead of buffering all of them.
+ *  Pages are requested with the maximum page size the API supports, so
+ *  *in_filter* must not contain '_offset' or '_limit'.
+ *
+ *  The callback is invoked once per page, strictly in page order,
+ *  even though responses may arrive in any order. The 'pagi' parameter
+ *  describes the page being delivered, 'pagi->is_last' is set for the
+ *  last one. A failing request invokes the callback once with no results
+ *  and a NULL 'pagi', which ends the paging as well.
+ *
+ *  The number of pages is fixed by the 'result_total' of the first page.
+ *  Should the total change while paging, entries may be missing or
+ *  delivered twice, but the paging still ends with 'pagi->is_last'.
+ *
+ *  The returned <minimod_paging> handle needs to be passed to
+ *  <minimod_release_paging()> once it is not needed anymore, which does
+ *  not stop the paging. Until then it can be cancelled, even after the
+ *  final callback.
+ *
+ *  (start code)
+ *  static void
+ *  on_mods(void *udata, size_t nmods, struct minimod_mod const *mods,
+ *    struct minimod_pagination const *pagi)
+ *  {
+ *    for (size_t i = 0; i < nmods; ++i)
+ *      printf("%s\n", mods[i].name);
+ *    if (!pagi || pagi->is_last)
+ *      printf("done\n");
+ *  }
+ *
+ *  minimod_release_paging(minimod_get_mods_all(NULL, game_id, 0, on_mods,
+ *    NULL));
+ *  (end)
+ */
+
+/* Struct: minimod_paging
+ *
+ * Opaque handle of a running *_all()-query. See <Paging>.
+ */
+struct minimod_paging;
+
+/* Function: minimod_get_games_all()
+ *
+ * Like <minimod_get_games()>, but retrieves all pages. See <Paging>.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_games_all(
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_games_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_get_mods_all()
+ *
+ * Like <minimod_get_mods()> for all mods of *in_game_id*, but retrieves all
+ * pages. See <Paging>.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_mods_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_get_modfiles_all()
+ *
+ * Like <minimod_get_modfiles()> for all modfiles of *in_mod_id*, but
+ * retrieves all pages. See <Paging>.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_modfiles_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_get_mod_events_all()
+ *
+ * Like <minimod_get_mod_events()>, but retrieves all pages. See <Paging>.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_mod_events_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_get_user_events_all()
+ *
+ * Like <minimod_get_user_events()>, but retrieves all pages.
+ * See <Paging>.
+ *
+ * Returns:
+ *	NULL if no user is currently authenticated.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_user_events_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_get_ratings_all()
+ *
+ * Like <minimod_get_ratings()>, but retrieves all pages. See <Paging>.
+ *
+ * Returns:
+ *	NULL if no user is currently authenticated.
+ */
+MINIMOD_LIB struct minimod_paging *
+minimod_get_ratings_all(
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_ratings_callback in_callback,
+  void *in_userdata);
+
+/* Function: minimod_cancel_paging()
+ *
+ * Stop a running *_all()-query. No further pages are requested and no
+ * further callbacks are started. A callback already running on another
+ * thread still finishes. May be called from within the callback and
+ * after the paging ended, as long as *in_paging* was not released.
+ */
+MINIMOD_LIB void
+minimod_cancel_paging(struct minimod_paging *in_paging);
+
+/* Function: minimod_release_paging()
+ *
+ * Release a handle returned by a *_all()-query. The paging goes on, if
+ * it is not cancelled. *in_paging* is invalid afterwards. NULL is fine.
+ */
+MINIMOD_LIB void
+minimod_release_paging(struct minimod_paging *in_paging);
+
 
 /* Topic: 'more' */
 
@@ -972,6 +2214,412 @@ minimod_get_more_float(void const *in_more, char const *in_name);
 MINIMOD_LIB bool
 minimod_get_more_bool(void const *in_more, char const *in_name);
 
+/* Topic: Contexts
+ *
+ * The functions below take the context returned by <minimod_ctx_create()>
+ * as first argument. Otherwise each minimod_ctx_* function behaves like
+ * its minimod_* counterpart, which uses the context of <minimod_init()>.
+ */
+
+MINIMOD_LIB size_t
+minimod_ctx_poll(
+  struct minimod_ctx *in_ctx,
+  size_t in_max_items,
+  uint64_t in_budget_us);
+
+MINIMOD_LIB intptr_t
+minimod_ctx_get_completion_fd(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB int64_t
+minimod_ctx_is_ratelimited(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB void
+minimod_ctx_set_request_rate(
+  struct minimod_ctx *in_ctx,
+  uint32_t in_requests_per_minute,
+  unsigned int in_burst);
+
+MINIMOD_LIB size_t
+minimod_ctx_get_scheduled_requests(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB void
+minimod_ctx_set_max_connections(
+  struct minimod_ctx *in_ctx,
+  unsigned int in_max_connections);
+
+MINIMOD_LIB bool
+minimod_ctx_cancel(struct minimod_ctx *in_ctx, minimod_handle in_handle);
+
+MINIMOD_LIB bool
+minimod_ctx_set_priority(
+  struct minimod_ctx *in_ctx,
+  minimod_handle in_handle,
+  enum minimod_priority in_priority);
+
+MINIMOD_LIB bool
+minimod_ctx_wait(
+  struct minimod_ctx *in_ctx,
+  minimod_handle in_handle,
+  uint32_t in_timeout_ms);
+
+MINIMOD_LIB bool
+minimod_ctx_wait_all(
+  struct minimod_ctx *in_ctx,
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms);
+
+MINIMOD_LIB size_t
+minimod_ctx_wait_any(
+  struct minimod_ctx *in_ctx,
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms);
+
+MINIMOD_LIB void
+minimod_ctx_set_retry_policy(
+  struct minimod_ctx *in_ctx,
+  char const *in_endpoint,
+  struct minimod_retry_policy const *in_policy);
+
+MINIMOD_LIB void
+minimod_ctx_set_request_stats_callback(
+  struct minimod_ctx *in_ctx,
+  minimod_request_stats_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_set_cache(
+  struct minimod_ctx *in_ctx,
+  size_t in_max_bytes,
+  size_t in_max_entries);
+
+MINIMOD_LIB void
+minimod_ctx_set_batching(
+  struct minimod_ctx *in_ctx,
+  uint32_t in_window_ms,
+  unsigned int in_max_batch_size);
+
+MINIMOD_LIB void
+minimod_ctx_get_cache_stats(
+  struct minimod_ctx *in_ctx,
+  struct minimod_cache_stats *out_stats);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_games(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  minimod_get_games_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_mods(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_modfiles(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_mod_events(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_dependencies(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_dependencies_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_resolve_dependencies(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_resolve_dependencies_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB bool
+minimod_ctx_is_authenticated(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB void
+minimod_ctx_deauthenticate(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB void
+minimod_ctx_email_request(
+  struct minimod_ctx *in_ctx,
+  char const *in_email,
+  minimod_email_request_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_email_exchange(
+  struct minimod_ctx *in_ctx,
+  char const *in_code,
+  minimod_access_token_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_steam_auth(
+  struct minimod_ctx *in_ctx,
+  void const *in_ticket,
+  size_t in_ticketbytes,
+  minimod_access_token_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_me(
+  struct minimod_ctx *in_ctx,
+  minimod_get_users_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_user_events(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_install(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  minimod_install_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_enqueue_install(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  enum minimod_install_priority in_priority,
+  minimod_install_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_set_install_limits(
+  struct minimod_ctx *in_ctx,
+  unsigned int in_max_downloads,
+  unsigned int in_max_extractions);
+
+MINIMOD_LIB void
+minimod_ctx_get_install_queue_stats(
+  struct minimod_ctx *in_ctx,
+  struct minimod_install_queue_stats *out_stats);
+
+MINIMOD_LIB void
+minimod_ctx_set_install_queue_callback(
+  struct minimod_ctx *in_ctx,
+  minimod_install_queue_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_set_install_stats_callback(
+  struct minimod_ctx *in_ctx,
+  minimod_install_stats_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_set_install_error_callback(
+  struct minimod_ctx *in_ctx,
+  minimod_install_error_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_set_install_progress_callback(
+  struct minimod_ctx *in_ctx,
+  minimod_install_progress_callback in_callback,
+  void *in_userdata,
+  uint32_t in_interval_ms,
+  uint32_t in_stall_timeout_ms);
+
+MINIMOD_LIB bool
+minimod_ctx_uninstall(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id);
+
+MINIMOD_LIB bool
+minimod_ctx_is_installed(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id);
+
+MINIMOD_LIB bool
+minimod_ctx_is_downloading(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id);
+
+MINIMOD_LIB void
+minimod_ctx_enum_installed_mods(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  minimod_enum_installed_mods_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB bool
+minimod_ctx_get_installed_mod(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_archive *
+minimod_ctx_open_archive(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  size_t in_cache_bytes);
+
+MINIMOD_LIB void
+minimod_ctx_start_sync(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  minimod_sync_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB void
+minimod_ctx_stop_sync(struct minimod_ctx *in_ctx, uint64_t in_game_id);
+
+MINIMOD_LIB uint32_t
+minimod_ctx_sync_tick(struct minimod_ctx *in_ctx);
+
+MINIMOD_LIB void
+minimod_ctx_set_sync_interval(
+  struct minimod_ctx *in_ctx,
+  uint32_t in_min_ms,
+  uint32_t in_max_ms);
+
+MINIMOD_LIB bool
+minimod_ctx_rate(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  int in_rating,
+  minimod_rate_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_ratings(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  minimod_get_ratings_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB minimod_handle
+minimod_ctx_get_subscriptions(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB bool
+minimod_ctx_subscribe(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_subscription_change_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB bool
+minimod_ctx_unsubscribe(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_subscription_change_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB bool
+minimod_ctx_reconcile(
+  struct minimod_ctx *in_ctx,
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  bool in_execute,
+  minimod_reconcile_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_games_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_games_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_mods_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_modfiles_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_mod_events_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_user_events_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata);
+
+MINIMOD_LIB struct minimod_paging *
+minimod_ctx_get_ratings_all(
+  struct minimod_ctx *in_ctx,
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_ratings_callback in_callback,
+  void *in_userdata);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,724 @@
+#include "archive.h"
+
+#include "util.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#include "miniz/miniz.h"
+#pragma GCC diagnostic pop
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
+#endif
+#pragma GCC diagnostic ignored "-Wunused-macros"
+
+#ifdef MINIMOD_LOG_ENABLE
+#define LOG(FMT, ...) printf("[archive] " FMT "\n", ##__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+#define LOGE(FMT, ...) fprintf(stderr, "[archive] " FMT "\n", ##__VA_ARGS__)
+
+#define ASSERT(in_condition)                      \
+	do                                            \
+	{                                             \
+		if (__builtin_expect(!(in_condition), 0)) \
+		{                                         \
+			LOGE(                                 \
+			  "[assertion] %s:%i: '%s'",          \
+			  __FILE__,                           \
+			  __LINE__,                           \
+			  #in_condition);                     \
+			__asm__ volatile("int $0x03");        \
+			__builtin_unreachable();              \
+		}                                         \
+	} while (__LINE__ == -1)
+
+#pragma GCC diagnostic pop
+
+// first bytes of every index file, bump when changing the format
+#define INDEX_FILE_MAGIC "minimod-zipindex 1\n"
+
+// Everything following the magic is little-endian uint64_t:
+// header, a hash table of nslots entry indices (+1, 0 marks an empty slot),
+// nentries entries and the NUL-terminated names.
+#define HEADER_FIELDS 5 // zip bytes, tail hash, nentries, nslots, name bytes
+#define ENTRY_FIELDS 7 // see struct entry
+#define FIELD_BYTES 8
+
+// bytes at the end of the archive which are hashed to tell whether the
+// index still belongs to it. Covers the end of the central directory.
+#define TAIL_BYTES 4096
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+
+// deflate expands by this factor at most, larger sizes are lies
+#define MAX_DEFLATE_RATIO 1032
+
+
+struct entry
+{
+	uint64_t hash;
+	uint64_t name_offset;
+	uint64_t name_bytes;
+	uint64_t data_offset;
+	uint64_t compressed_bytes;
+	uint64_t nbytes;
+	uint32_t method;
+	uint32_t crc32;
+};
+
+
+// The data follows the struct, so released data leads to its file.
+struct cached_file
+{
+	struct cached_file *prev;
+	struct cached_file *next;
+	uint64_t entry;
+	size_t nbytes;
+	size_t refs;
+	// larger than the cache, freed when released
+	bool is_uncached;
+	char _padding[7];
+	unsigned char data[];
+};
+
+
+struct archive
+{
+	mtx_t mtx;
+	unsigned char const *zip;
+	size_t nzip;
+	// mapped, or built in memory if it could not be written
+	unsigned char const *index;
+	size_t nindex;
+	bool is_index_mapped;
+	char _padding[7];
+	uint64_t nentries;
+	uint64_t nslots;
+	uint64_t nnames;
+	unsigned char const *slots;
+	unsigned char const *entries;
+	char const *names;
+	// decompressed files, most recently used is head
+	struct cached_file *head;
+	struct cached_file *tail;
+	// the cached file of each entry or NULL
+	struct cached_file **files;
+	size_t max_bytes;
+	size_t nbytes;
+};
+
+
+static void
+put_u64(unsigned char *out, uint64_t in_value)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		out[i] = (unsigned char)(in_value >> (i * 8));
+	}
+}
+
+
+static uint64_t
+get_u64(unsigned char const *in)
+{
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i)
+	{
+		value = (value << 8) | in[i];
+	}
+	return value;
+}
+
+
+static uint64_t
+get_le(unsigned char const *in, int in_bytes)
+{
+	uint64_t value = 0;
+	for (int i = in_bytes - 1; i >= 0; --i)
+	{
+		value = (value << 8) | in[i];
+	}
+	return value;
+}
+
+
+static uint64_t
+tail_hash(struct archive const *a)
+{
+	size_t const n = a->nzip < TAIL_BYTES ? a->nzip : TAIL_BYTES;
+	return hash_fnv1a(a->zip + a->nzip - n, n);
+}
+
+
+static size_t
+index_bytes(uint64_t in_nentries, uint64_t in_nslots, uint64_t in_nnames)
+{
+	return strlen(INDEX_FILE_MAGIC) + HEADER_FIELDS * FIELD_BYTES
+	  + in_nslots * FIELD_BYTES + in_nentries * ENTRY_FIELDS * FIELD_BYTES
+	  + in_nnames;
+}
+
+
+// points the archive at the tables of its index, if it belongs to it
+static bool
+use_index(struct archive *a, unsigned char const *in_index, size_t in_bytes)
+{
+	size_t const nmagic = strlen(INDEX_FILE_MAGIC);
+	size_t const nheader = nmagic + HEADER_FIELDS * FIELD_BYTES;
+	if (in_bytes < nheader || 0 != memcmp(in_index, INDEX_FILE_MAGIC, nmagic))
+	{
+		return false;
+	}
+
+	unsigned char const *header = in_index + nmagic;
+	uint64_t const nzip = get_u64(header + 0 * FIELD_BYTES);
+	uint64_t const hash = get_u64(header + 1 * FIELD_BYTES);
+	uint64_t const nentries = get_u64(header + 2 * FIELD_BYTES);
+	uint64_t const nslots = get_u64(header + 3 * FIELD_BYTES);
+	uint64_t const nnames = get_u64(header + 4 * FIELD_BYTES);
+
+	// bound the counts before multiplying them
+	bool const is_valid = nzip == a->nzip && hash == tail_hash(a)
+	  && nentries <= in_bytes && nnames <= in_bytes && nslots <= in_bytes
+	  && nslots > nentries && (nslots & (nslots - 1)) == 0
+	  && index_bytes(nentries, nslots, nnames) == in_bytes;
+	if (!is_valid)
+	{
+		return false;
+	}
+
+	a->index = in_index;
+	a->nindex = in_bytes;
+	a->nentries = nentries;
+	a->nslots = nslots;
+	a->nnames = nnames;
+	a->slots = header + HEADER_FIELDS * FIELD_BYTES;
+	a->entries = a->slots + nslots * FIELD_BYTES;
+	a->names =
+	  (char const *)(a->entries + nentries * ENTRY_FIELDS * FIELD_BYTES);
+	return true;
+}
+
+
+// offset of the data of an entry, which follows its local header
+static bool
+get_data_offset(
+  struct archive const *a,
+  uint64_t in_local_header_offset,
+  uint64_t *out_offset)
+{
+	uint64_t const ofs = in_local_header_offset;
+	if (ofs > a->nzip || a->nzip - ofs < ZIP_LOCAL_HEADER_SIZE)
+	{
+		return false;
+	}
+	unsigned char const *header = a->zip + ofs;
+	if (get_le(header, 4) != ZIP_LOCAL_HEADER_SIG)
+	{
+		return false;
+	}
+	// the local extra field may differ from the central one
+	*out_offset = ofs + ZIP_LOCAL_HEADER_SIZE + get_le(header + 26, 2)
+	  + get_le(header + 28, 2);
+	return *out_offset <= a->nzip;
+}
+
+
+// parses the central directory, returns the index in a malloc()ed buffer
+static unsigned char *
+build_index(struct archive const *a, size_t *out_bytes)
+{
+	mz_zip_archive zip;
+	memset(&zip, 0, sizeof zip);
+	if (!mz_zip_reader_init_mem(&zip, a->zip, a->nzip, 0))
+	{
+		LOGE("zip error: %i", zip.m_last_error);
+		return NULL;
+	}
+
+	mz_uint const nfiles = mz_zip_reader_get_num_files(&zip);
+	struct entry *entries = malloc((nfiles + 1) * sizeof *entries);
+	char **names = malloc((nfiles + 1) * sizeof *names);
+	uint64_t nentries = 0;
+	uint64_t nnames = 0;
+
+	mz_zip_archive_file_stat stat;
+	for (mz_uint i = 0; i < nfiles; ++i)
+	{
+		struct entry *e = &entries[nentries];
+		bool const is_file = mz_zip_reader_file_stat(&zip, i, &stat)
+		  && !stat.m_is_directory && stat.m_is_supported
+		  && get_data_offset(a, stat.m_local_header_ofs, &e->data_offset)
+		  && stat.m_comp_size <= a->nzip - e->data_offset;
+		if (!is_file)
+		{
+			continue;
+		}
+
+		size_t const name_bytes = strlen(stat.m_filename);
+		e->hash = hash_fnv1a(stat.m_filename, name_bytes);
+		e->name_offset = nnames;
+		e->name_bytes = name_bytes;
+		e->compressed_bytes = stat.m_comp_size;
+		e->nbytes = stat.m_uncomp_size;
+		e->method = stat.m_method;
+		e->crc32 = stat.m_crc32;
+		names[nentries] = strdup(stat.m_filename);
+		nnames += name_bytes + 1 /*NUL*/;
+		nentries += 1;
+	}
+	mz_zip_reader_end(&zip);
+
+	// keep the load factor at or below 1/2
+	uint64_t nslots = 8;
+	while (nslots < nentries * 2)
+	{
+		nslots *= 2;
+	}
+
+	size_t const nindex = index_bytes(nentries, nslots, nnames);
+	unsigned char *index = calloc(1, nindex);
+	size_t const nmagic = strlen(INDEX_FILE_MAGIC);
+	memcpy(index, INDEX_FILE_MAGIC, nmagic);
+
+	unsigned char *header = index + nmagic;
+	put_u64(header + 0 * FIELD_BYTES, a->nzip);
+	put_u64(header + 1 * FIELD_BYTES, tail_hash(a));
+	put_u64(header + 2 * FIELD_BYTES, nentries);
+	put_u64(header + 3 * FIELD_BYTES, nslots);
+	put_u64(header + 4 * FIELD_BYTES, nnames);
+
+	unsigned char *slots = header + HEADER_FIELDS * FIELD_BYTES;
+	unsigned char *ptr = slots + nslots * FIELD_BYTES;
+	char *name_ptr = (char *)(ptr + nentries * ENTRY_FIELDS * FIELD_BYTES);
+	for (uint64_t i = 0; i < nentries; ++i)
+	{
+		struct entry const *e = &entries[i];
+		put_u64(ptr + 0 * FIELD_BYTES, e->hash);
+		put_u64(ptr + 1 * FIELD_BYTES, e->name_offset);
+		put_u64(ptr + 2 * FIELD_BYTES, e->name_bytes);
+		put_u64(ptr + 3 * FIELD_BYTES, e->data_offset);
+		put_u64(ptr + 4 * FIELD_BYTES, e->compressed_bytes);
+		put_u64(ptr + 5 * FIELD_BYTES, e->nbytes);
+		put_u64(ptr + 6 * FIELD_BYTES, e->method | (uint64_t)e->crc32 << 32);
+		ptr += ENTRY_FIELDS * FIELD_BYTES;
+
+		memcpy(name_ptr + e->name_offset, names[i], e->name_bytes + 1);
+		free(names[i]);
+
+		// a name stored twice keeps the first entry
+		uint64_t slot = e->hash & (nslots - 1);
+		while (get_u64(slots + slot * FIELD_BYTES) != 0)
+		{
+			slot = (slot + 1) & (nslots - 1);
+		}
+		put_u64(slots + slot * FIELD_BYTES, i + 1);
+	}
+
+	free(names);
+	free(entries);
+
+	*out_bytes = nindex;
+	return index;
+}
+
+
+static void
+save_index(
+  char const *in_path,
+  unsigned char const *in_index,
+  size_t in_bytes)
+{
+	// archives may be opened concurrently, do not interleave the writes
+	char *tmppath;
+	asprintf(&tmppath, "%s.%p", in_path, (void const *)in_index);
+
+	FILE *f = fsu_fopen(tmppath, "wb");
+	bool is_saved = false;
+	if (f)
+	{
+		is_saved = fwrite(in_index, 1, in_bytes, f) == in_bytes;
+		is_saved = (0 == fclose(f)) && is_saved;
+		is_saved = is_saved && fsu_mvfile(tmppath, in_path, true);
+		if (!is_saved)
+		{
+			fsu_rmfile(tmppath);
+		}
+	}
+	if (!is_saved)
+	{
+		LOGE("failed to write %s", in_path);
+	}
+	free(tmppath);
+}
+
+
+static bool
+get_entry(struct archive const *a, uint64_t in_index, struct entry *out_entry)
+{
+	unsigned char const *ptr =
+	  a->entries + in_index * ENTRY_FIELDS * FIELD_BYTES;
+	out_entry->hash = get_u64(ptr + 0 * FIELD_BYTES);
+	out_entry->name_offset = get_u64(ptr + 1 * FIELD_BYTES);
+	out_entry->name_bytes = get_u64(ptr + 2 * FIELD_BYTES);
+	out_entry->data_offset = get_u64(ptr + 3 * FIELD_BYTES);
+	out_entry->compressed_bytes = get_u64(ptr + 4 * FIELD_BYTES);
+	out_entry->nbytes = get_u64(ptr + 5 * FIELD_BYTES);
+	uint64_t const method_crc = get_u64(ptr + 6 * FIELD_BYTES);
+	out_entry->method = (uint32_t)method_crc;
+	out_entry->crc32 = (uint32_t)(method_crc >> 32);
+
+	// do not trust the index blindly, it is read from disk
+	return out_entry->name_offset < a->nnames
+	  && out_entry->name_bytes < a->nnames - out_entry->name_offset
+	  && a->names[out_entry->name_offset + out_entry->name_bytes] == '\0'
+	  && out_entry->data_offset <= a->nzip
+	  && out_entry->compressed_bytes <= a->nzip - out_entry->data_offset;
+}
+
+
+static bool
+find_entry(
+  struct archive const *a,
+  char const *in_name,
+  uint64_t *out_index,
+  struct entry *out_entry)
+{
+	size_t const name_bytes = strlen(in_name);
+	uint64_t const hash = hash_fnv1a(in_name, name_bytes);
+	uint64_t const mask = a->nslots - 1;
+
+	uint64_t slot = hash & mask;
+	for (uint64_t i = 0; i < a->nslots; ++i, slot = (slot + 1) & mask)
+	{
+		uint64_t const index = get_u64(a->slots + slot * FIELD_BYTES);
+		if (index == 0 || index > a->nentries)
+		{
+			return false;
+		}
+		if (!get_entry(a, index - 1, out_entry))
+		{
+			return false;
+		}
+		char const *name = a->names + out_entry->name_offset;
+		if (
+		  out_entry->hash == hash && out_entry->name_bytes == name_bytes
+		  && 0 == memcmp(name, in_name, name_bytes))
+		{
+			*out_index = index - 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+static void
+link_file(struct archive *a, struct cached_file *f)
+{
+	f->prev = NULL;
+	f->next = a->head;
+	if (a->head)
+	{
+		a->head->prev = f;
+	}
+	a->head = f;
+	if (!a->tail)
+	{
+		a->tail = f;
+	}
+	a->nbytes += f->nbytes;
+}
+
+
+static void
+unlink_file(struct archive *a, struct cached_file *f)
+{
+	if (f->prev)
+	{
+		f->prev->next = f->next;
+	}
+	else
+	{
+		a->head = f->next;
+	}
+	if (f->next)
+	{
+		f->next->prev = f->prev;
+	}
+	else
+	{
+		a->tail = f->prev;
+	}
+	f->prev = NULL;
+	f->next = NULL;
+	a->nbytes -= f->nbytes;
+}
+
+
+// needs to be called with a->mtx locked, files in use are never evicted
+static void
+evict(struct archive *a)
+{
+	struct cached_file *f = a->tail;
+	while (f && a->nbytes > a->max_bytes)
+	{
+		struct cached_file *prev = f->prev;
+		if (f->refs == 0)
+		{
+			unlink_file(a, f);
+			a->files[f->entry] = NULL;
+			free(f);
+		}
+		f = prev;
+	}
+}
+
+
+// The size is read from the archive, so it is checked before it is
+// allocated: It needs to be possible for the compressed size.
+static struct cached_file *
+inflate_entry(
+  struct archive const *a,
+  uint64_t in_index,
+  struct entry const *in_entry)
+{
+	char const *name = a->names + in_entry->name_offset;
+	bool const is_plausible =
+	  in_entry->nbytes / MAX_DEFLATE_RATIO <= in_entry->compressed_bytes
+	  && in_entry->nbytes < SIZE_MAX - sizeof(struct cached_file);
+	if (!is_plausible)
+	{
+		LOGE("refusing to inflate %s to %" PRIu64 " bytes",
+		  name,
+		  in_entry->nbytes);
+		return NULL;
+	}
+
+	size_t const nbytes = (size_t)in_entry->nbytes;
+	struct cached_file *f = malloc(sizeof *f + nbytes);
+	if (!f)
+	{
+		LOGE("out of memory inflating %s", name);
+		return NULL;
+	}
+	size_t const ninflated = tinfl_decompress_mem_to_mem(
+	  f->data,
+	  nbytes,
+	  a->zip + in_entry->data_offset,
+	  (size_t)in_entry->compressed_bytes,
+	  0);
+	uint32_t const crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, f->data, nbytes);
+	if (ninflated != nbytes || crc != in_entry->crc32)
+	{
+		LOGE("failed to inflate %s", name);
+		free(f);
+		return NULL;
+	}
+	*f = (struct cached_file){
+		.entry = in_index,
+		.nbytes = nbytes,
+	};
+	return f;
+}
+
+
+struct archive *
+archive_open(
+  char const *in_zip_path,
+  char const *in_index_path,
+  size_t in_cache_bytes)
+{
+	size_t nzip = 0;
+	void const *zip = fsu_mmap(in_zip_path, &nzip);
+	if (!zip)
+	{
+		LOGE("failed to map %s", in_zip_path);
+		return NULL;
+	}
+
+	struct archive *a = calloc(1, sizeof *a);
+	a->zip = zip;
+	a->nzip = nzip;
+	a->max_bytes = in_cache_bytes;
+	mtx_init(&a->mtx, mtx_plain);
+
+	size_t nindex = 0;
+	void const *index = fsu_mmap(in_index_path, &nindex);
+	if (index && use_index(a, index, nindex))
+	{
+		a->is_index_mapped = true;
+		a->files = calloc(a->nentries + 1, sizeof *a->files);
+		return a;
+	}
+	if (index)
+	{
+		fsu_munmap(index, nindex);
+	}
+
+	LOG("indexing %s", in_zip_path);
+	unsigned char *built = build_index(a, &nindex);
+	if (!built)
+	{
+		archive_close(a);
+		return NULL;
+	}
+	save_index(in_index_path, built, nindex);
+	bool const is_used = use_index(a, built, nindex);
+	ASSERT(is_used);
+	(void)is_used;
+	a->files = calloc(a->nentries + 1, sizeof *a->files);
+	return a;
+}
+
+
+void
+archive_close(struct archive *in_archive)
+{
+	struct archive *a = in_archive;
+	struct cached_file *f = a->head;
+	while (f)
+	{
+		struct cached_file *next = f->next;
+		free(f);
+		f = next;
+	}
+	free(a->files);
+
+	if (a->is_index_mapped)
+	{
+		fsu_munmap(a->index, a->nindex);
+	}
+	else
+	{
+		free((void *)(uintptr_t)a->index);
+	}
+	fsu_munmap(a->zip, a->nzip);
+	mtx_destroy(&a->mtx);
+	free(a);
+}
+
+
+void const *
+archive_get(struct archive *a, char const *in_name, size_t *out_bytes)
+{
+	uint64_t index;
+	struct entry e;
+	if (!find_entry(a, in_name, &index, &e))
+	{
+		return NULL;
+	}
+
+	// stored files need no copy at all
+	if (e.method == 0)
+	{
+		if (e.compressed_bytes != e.nbytes)
+		{
+			return NULL;
+		}
+		*out_bytes = (size_t)e.nbytes;
+		return a->zip + e.data_offset;
+	}
+	if (e.method != MZ_DEFLATED)
+	{
+		return NULL;
+	}
+
+	mtx_lock(&a->mtx);
+	struct cached_file *f = a->files[index];
+	if (f)
+	{
+		// mark as most recently used
+		unlink_file(a, f);
+		link_file(a, f);
+		f->refs += 1;
+	}
+	mtx_unlock(&a->mtx);
+
+	if (!f)
+	{
+		struct cached_file *inflated = inflate_entry(a, index, &e);
+		if (!inflated)
+		{
+			return NULL;
+		}
+
+		// files larger than the whole cache are not kept at all
+		if (inflated->nbytes > a->max_bytes)
+		{
+			inflated->is_uncached = true;
+			*out_bytes = inflated->nbytes;
+			return inflated->data;
+		}
+
+		mtx_lock(&a->mtx);
+		// some other thread may have been quicker
+		f = a->files[index];
+		if (f)
+		{
+			free(inflated);
+		}
+		else
+		{
+			f = inflated;
+			a->files[index] = f;
+			link_file(a, f);
+		}
+		f->refs += 1;
+		evict(a);
+		mtx_unlock(&a->mtx);
+	}
+
+	*out_bytes = f->nbytes;
+	return f->data;
+}
+
+
+void
+archive_release(struct archive *a, void const *in_data)
+{
+	unsigned char const *data = in_data;
+	if (!data || (data >= a->zip && data <= a->zip + a->nzip))
+	{
+		return;
+	}
+
+	struct cached_file *f = (struct cached_file *)(uintptr_t)(
+	  data - offsetof(struct cached_file, data));
+	if (f->is_uncached)
+	{
+		free(f);
+		return;
+	}
+
+	mtx_lock(&a->mtx);
+	ASSERT(f->refs > 0 && a->files[f->entry] == f);
+	f->refs -= 1;
+	evict(a);
+	mtx_unlock(&a->mtx);
+}
+
+
+void
+archive_enum(
+  struct archive *a,
+  archive_enum_callback in_callback,
+  void *in_userdata)
+{
+	for (uint64_t i = 0; i < a->nentries; ++i)
+	{
+		struct entry e;
+		if (get_entry(a, i, &e))
+		{
+			in_callback(in_userdata, a->names + e.name_offset, e.nbytes);
+		}
+	}
+}
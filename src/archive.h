@@ -0,0 +1,108 @@
+// vi: filetype=c
+#pragma once
+#ifndef MINIMOD_ARCHIVE_H_INCLUDED
+#define MINIMOD_ARCHIVE_H_INCLUDED
+
+/* Title: archive
+ *
+ * Topic: Introduction
+ *
+ * Read-only access to the files of a ZIP archive without extracting it.
+ *
+ * The archive is memory-mapped. Its central directory is turned into a
+ * hash table once, which is stored next to the archive and memory-mapped
+ * as well when the archive is opened again, so opening and looking up a
+ * file never parses the central directory.
+ *
+ * Stored files are returned as pointers into the mapping. Deflated files
+ * are decompressed into a cache, which is bounded by the number of
+ * (uncompressed) bytes of files which are not in use.
+ * All functions are thread-safe.
+ */
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Section: API */
+
+struct archive;
+
+/* Callback: archive_enum_callback()
+ *
+ * *in_name* stays valid until the archive is closed.
+ */
+typedef void (*archive_enum_callback)(
+  void *in_userdata,
+  char const *in_name,
+  uint64_t in_nbytes);
+
+/* Function: archive_open()
+ *
+ * Parameters:
+ *	in_index_path - Where the index of the archive is stored. It is
+ *		(re)built if it is missing or does not match the archive.
+ *	in_cache_bytes - Limit of the decompression cache. With 0 deflated
+ *		files are freed as soon as they are released, as are files
+ *		larger than the limit.
+ *
+ * Returns:
+ *	NULL if the archive could not be mapped or is no ZIP archive.
+ */
+struct archive *
+archive_open(
+  char const *in_zip_path,
+  char const *in_index_path,
+  size_t in_cache_bytes);
+
+/* Function: archive_close()
+ *
+ * Invalidates all pointers returned by <archive_get()>.
+ */
+void
+archive_close(struct archive *in_archive);
+
+/* Function: archive_get()
+ *
+ * Get the contents of file *in_name* ('/' separated, as stored in the
+ * archive).
+ *
+ * Returns:
+ *	NULL if there is no such file or it could not be decompressed.
+ *	Otherwise the data needs to be passed to <archive_release()>.
+ */
+void const *
+archive_get(
+  struct archive *in_archive,
+  char const *in_name,
+  size_t *out_bytes);
+
+/* Function: archive_release()
+ *
+ * Release data returned by <archive_get()>.
+ */
+void
+archive_release(struct archive *in_archive, void const *in_data);
+
+/* Function: archive_enum()
+ *
+ * Call *in_callback* for every file in the archive, in no particular order.
+ * Directories are not enumerated.
+ */
+void
+archive_enum(
+  struct archive *in_archive,
+  archive_enum_callback in_callback,
+  void *in_userdata);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,597 @@
+#include "cache.h"
+
+#include "util.h"
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#include "qajson4c/src/qajson4c/qajson4c.h"
+#pragma GCC diagnostic pop
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
+#endif
+#pragma GCC diagnostic ignored "-Wunused-macros"
+
+#ifdef MINIMOD_LOG_ENABLE
+#define LOG(FMT, ...) printf("[cache] " FMT "\n", ##__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+#define LOGE(FMT, ...) fprintf(stderr, "[cache] " FMT "\n", ##__VA_ARGS__)
+
+#pragma GCC diagnostic pop
+
+// first line of every cache file, bump when changing the format
+#define CACHE_FILE_MAGIC "minimod-cache 1\n"
+// of the index, always a power of 2
+#define MIN_CAPACITY 64
+
+
+struct cache
+{
+	mtx_t mtx;
+	char *dir;
+	// most recently used entry is head
+	struct cache_entry *head;
+	struct cache_entry *tail;
+	// the entries of the list by their hash, open addressing, NULL marks
+	// an empty slot
+	struct cache_entry **slots;
+	size_t capacity;
+	size_t max_bytes;
+	size_t max_entries;
+	size_t nbytes;
+	size_t nentries;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t bytes_saved;
+};
+
+
+static size_t
+entry_bytes(struct cache_entry const *e)
+{
+	return e->nbody + e->ndom;
+}
+
+
+static char *
+entry_path(struct cache const *c, uint64_t in_hash)
+{
+	char *path;
+	asprintf(&path, "%s%016" PRIx64, c->dir, in_hash);
+	return path;
+}
+
+
+static void
+free_entry(struct cache_entry *e)
+{
+	free(e->key);
+	free(e->etag);
+	free(e->last_modified);
+	free(e->body);
+	free(e->dom);
+	free(e);
+}
+
+
+// returns the slot of the entry or the empty slot it would go into
+static size_t
+find_slot(struct cache const *c, uint64_t in_hash, char const *in_key)
+{
+	size_t i = (size_t)in_hash & (c->capacity - 1);
+	while (c->slots[i])
+	{
+		struct cache_entry const *e = c->slots[i];
+		if (e->hash == in_hash && 0 == strcmp(e->key, in_key))
+		{
+			break;
+		}
+		i = (i + 1) & (c->capacity - 1);
+	}
+	return i;
+}
+
+
+static void
+grow(struct cache *c)
+{
+	struct cache_entry **old = c->slots;
+	size_t const ncapacity = c->capacity;
+
+	c->capacity = ncapacity ? ncapacity * 2 : MIN_CAPACITY;
+	c->slots = calloc(c->capacity, sizeof *c->slots);
+	for (size_t i = 0; i < ncapacity; ++i)
+	{
+		if (old[i])
+		{
+			c->slots[find_slot(c, old[i]->hash, old[i]->key)] = old[i];
+		}
+	}
+	free(old);
+}
+
+
+// Keys are unique, see cache_store().
+static void
+insert_slot(struct cache *c, struct cache_entry *e)
+{
+	// keep the load factor below 1/2, so probe sequences stay short
+	if ((c->nentries + 1) * 2 > c->capacity)
+	{
+		grow(c);
+	}
+	c->slots[find_slot(c, e->hash, e->key)] = e;
+}
+
+
+static void
+erase_slot(struct cache *c, struct cache_entry const *in_entry)
+{
+	size_t const mask = c->capacity - 1;
+	size_t i = (size_t)in_entry->hash & mask;
+	while (c->slots[i] != in_entry)
+	{
+		i = (i + 1) & mask;
+	}
+
+	// shift following entries back instead of leaving tombstones
+	size_t j = i;
+	for (;;)
+	{
+		j = (j + 1) & mask;
+		struct cache_entry *e = c->slots[j];
+		if (!e)
+		{
+			break;
+		}
+		size_t const home = (size_t)e->hash & mask;
+		// move e into the hole, unless its home slot lies cyclically in (i, j]
+		bool const is_reachable =
+		  (i < j) ? (i < home && home <= j) : (i < home || home <= j);
+		if (!is_reachable)
+		{
+			c->slots[i] = e;
+			i = j;
+		}
+	}
+	c->slots[i] = NULL;
+}
+
+
+static void
+push_entry(struct cache *c, struct cache_entry *e)
+{
+	e->prev = NULL;
+	e->next = c->head;
+	if (c->head)
+	{
+		c->head->prev = e;
+	}
+	c->head = e;
+	if (!c->tail)
+	{
+		c->tail = e;
+	}
+}
+
+
+static void
+pop_entry(struct cache *c, struct cache_entry *e)
+{
+	if (e->prev)
+	{
+		e->prev->next = e->next;
+	}
+	else
+	{
+		c->head = e->next;
+	}
+	if (e->next)
+	{
+		e->next->prev = e->prev;
+	}
+	else
+	{
+		c->tail = e->prev;
+	}
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+
+static void
+link_entry(struct cache *c, struct cache_entry *e)
+{
+	insert_slot(c, e);
+	push_entry(c, e);
+	e->is_linked = true;
+	c->nbytes += entry_bytes(e);
+	c->nentries += 1;
+}
+
+
+static void
+unlink_entry(struct cache *c, struct cache_entry *e)
+{
+	erase_slot(c, e);
+	pop_entry(c, e);
+	e->is_linked = false;
+	c->nbytes -= entry_bytes(e);
+	c->nentries -= 1;
+}
+
+
+static struct cache_entry *
+find_entry(struct cache *c, uint64_t in_hash, char const *in_key)
+{
+	return c->capacity > 0 ? c->slots[find_slot(c, in_hash, in_key)] : NULL;
+}
+
+
+// The disk mirror holds the same entries as memory, so evicted entries
+// are removed from disk as well.
+// needs to be called with c->mtx locked
+static void
+evict(struct cache *c)
+{
+	while (c->tail && (c->nentries > c->max_entries || c->nbytes > c->max_bytes))
+	{
+		struct cache_entry *victim = c->tail;
+		LOG("evicting %s", victim->key);
+		unlink_entry(c, victim);
+
+		char *path = entry_path(c, victim->hash);
+		fsu_rmfile(path);
+		free(path);
+
+		if (victim->refs == 0)
+		{
+			free_entry(victim);
+		}
+	}
+}
+
+
+static char *
+dup_or_null(char const *in_str)
+{
+	return (in_str && *in_str) ? strdup(in_str) : NULL;
+}
+
+
+// reads the next '\n' terminated line out of *io_ptr and NUL-terminates it
+static char *
+next_line(char **io_ptr, char const *in_end)
+{
+	char *line = *io_ptr;
+	char *nl = memchr(line, '\n', (size_t)(in_end - line));
+	if (!nl)
+	{
+		return NULL;
+	}
+	*nl = '\0';
+	*io_ptr = nl + 1;
+	return line;
+}
+
+
+static struct cache_entry *
+load_entry(struct cache const *c, uint64_t in_hash, char const *in_key)
+{
+	char *path = entry_path(c, in_hash);
+	int64_t fsize = fsu_fsize(path);
+	FILE *f = fsize > 0 ? fsu_fopen(path, "rb") : NULL;
+	free(path);
+	if (!f)
+	{
+		return NULL;
+	}
+
+	char *filebuffer = malloc((size_t)fsize);
+	size_t nread = fread(filebuffer, 1, (size_t)fsize, f);
+	fclose(f);
+
+	struct cache_entry *e = NULL;
+	char *ptr = filebuffer;
+	char const *end = filebuffer + nread;
+	size_t const nmagic = strlen(CACHE_FILE_MAGIC);
+	if (nread > nmagic && 0 == memcmp(ptr, CACHE_FILE_MAGIC, nmagic))
+	{
+		ptr += nmagic;
+		char *key = next_line(&ptr, end);
+		char *etag = key ? next_line(&ptr, end) : NULL;
+		char *last_modified = etag ? next_line(&ptr, end) : NULL;
+		char *nbody = last_modified ? next_line(&ptr, end) : NULL;
+		size_t const body_bytes = nbody ? strtoull(nbody, NULL, 10) : 0;
+		// different key with the same hash or truncated file
+		if (
+		  nbody && 0 == strcmp(key, in_key)
+		  && body_bytes == (size_t)(end - ptr))
+		{
+			e = calloc(1, sizeof *e);
+			e->hash = in_hash;
+			e->key = strdup(key);
+			e->etag = dup_or_null(etag);
+			e->last_modified = dup_or_null(last_modified);
+			e->nbody = body_bytes;
+			e->body = malloc(body_bytes);
+			memcpy(e->body, ptr, body_bytes);
+		}
+	}
+
+	free(filebuffer);
+	return e;
+}
+
+
+static void
+save_entry(struct cache const *c, struct cache_entry const *e)
+{
+	char *path = entry_path(c, e->hash);
+	// write to a temporary file first, so concurrent stores of the same key
+	// do not interleave and readers never see a partially written file.
+	char *tmppath;
+	asprintf(&tmppath, "%s.%p", path, (void const *)e);
+
+	FILE *f = fsu_fopen(tmppath, "wb");
+	if (f)
+	{
+		fprintf(
+		  f,
+		  CACHE_FILE_MAGIC "%s\n%s\n%s\n%zu\n",
+		  e->key,
+		  e->etag ? e->etag : "",
+		  e->last_modified ? e->last_modified : "",
+		  e->nbody);
+		fwrite(e->body, 1, e->nbody, f);
+		fclose(f);
+		if (!fsu_mvfile(tmppath, path, true))
+		{
+			LOGE("failed to write %s", path);
+			fsu_rmfile(tmppath);
+		}
+	}
+
+	free(tmppath);
+	free(path);
+}
+
+
+struct cache *
+cache_create(char const *in_dir, size_t in_max_bytes, size_t in_max_entries)
+{
+	struct cache *c = calloc(1, sizeof *c);
+	c->dir = strdup(in_dir);
+	c->max_bytes = in_max_bytes;
+	c->max_entries = in_max_entries;
+	mtx_init(&c->mtx, mtx_plain);
+	fsu_mkdir(c->dir);
+	return c;
+}
+
+
+void
+cache_destroy(struct cache *c)
+{
+	struct cache_entry *e = c->head;
+	while (e)
+	{
+		struct cache_entry *next = e->next;
+		free_entry(e);
+		e = next;
+	}
+	free(c->slots);
+	mtx_destroy(&c->mtx);
+	free(c->dir);
+	free(c);
+}
+
+
+void
+cache_set_limits(struct cache *c, size_t in_max_bytes, size_t in_max_entries)
+{
+	mtx_lock(&c->mtx);
+	c->max_bytes = in_max_bytes;
+	c->max_entries = in_max_entries;
+	evict(c);
+	mtx_unlock(&c->mtx);
+}
+
+
+char *
+cache_key_from_url(char const *in_url)
+{
+	char *key = strdup(in_url);
+	char *param = strstr(key, "api_key=");
+	// only strip it, if it is an actual parameter
+	while (param && param != key && param[-1] != '?' && param[-1] != '&')
+	{
+		param = strstr(param + 1, "api_key=");
+	}
+	if (param)
+	{
+		char *next = strchr(param, '&');
+		if (next)
+		{
+			memmove(param, next + 1, strlen(next + 1) + 1 /*NUL*/);
+		}
+		else
+		{
+			*param = '\0';
+		}
+	}
+	return key;
+}
+
+
+struct cache_entry *
+cache_lookup(struct cache *c, char const *in_key)
+{
+	uint64_t const hash = hash_fnv1a(in_key, strlen(in_key));
+
+	mtx_lock(&c->mtx);
+	struct cache_entry *e = find_entry(c, hash, in_key);
+	if (e)
+	{
+		// mark as most recently used
+		pop_entry(c, e);
+		push_entry(c, e);
+		e->refs += 1;
+	}
+	bool const is_enabled = c->max_entries > 0 && c->max_bytes > 0;
+	mtx_unlock(&c->mtx);
+
+	if (e || !is_enabled)
+	{
+		return e;
+	}
+
+	// not in memory, so try the disk
+	struct cache_entry *loaded = load_entry(c, hash, in_key);
+	if (!loaded)
+	{
+		return NULL;
+	}
+
+	mtx_lock(&c->mtx);
+	// some other thread may have been quicker
+	e = find_entry(c, hash, in_key);
+	if (e)
+	{
+		free_entry(loaded);
+	}
+	else
+	{
+		LOG("loaded %s from disk", in_key);
+		e = loaded;
+		link_entry(c, e);
+	}
+	e->refs += 1;
+	evict(c);
+	mtx_unlock(&c->mtx);
+
+	return e;
+}
+
+
+struct cache_entry *
+cache_store(
+  struct cache *c,
+  char const *in_key,
+  char const *in_etag,
+  char const *in_last_modified,
+  void const *in_body,
+  size_t in_nbody)
+{
+	mtx_lock(&c->mtx);
+	c->misses += 1;
+	bool const fits = in_nbody <= c->max_bytes && c->max_entries > 0;
+	mtx_unlock(&c->mtx);
+
+	// without validators the entry could never be revalidated
+	bool const has_validator =
+	  (in_etag && *in_etag) || (in_last_modified && *in_last_modified);
+	if (!fits || !has_validator)
+	{
+		return NULL;
+	}
+
+	struct cache_entry *e = calloc(1, sizeof *e);
+	e->key = strdup(in_key);
+	e->hash = hash_fnv1a(in_key, strlen(in_key));
+	e->etag = dup_or_null(in_etag);
+	e->last_modified = dup_or_null(in_last_modified);
+	e->nbody = in_nbody;
+	e->body = malloc(in_nbody);
+	memcpy(e->body, in_body, in_nbody);
+	e->refs = 1;
+
+	save_entry(c, e);
+
+	mtx_lock(&c->mtx);
+	struct cache_entry *old = find_entry(c, e->hash, e->key);
+	if (old)
+	{
+		unlink_entry(c, old);
+		if (old->refs == 0)
+		{
+			free_entry(old);
+		}
+	}
+	link_entry(c, e);
+	evict(c);
+	mtx_unlock(&c->mtx);
+
+	return e;
+}
+
+
+void
+cache_hit(struct cache *c, struct cache_entry *e)
+{
+	mtx_lock(&c->mtx);
+	c->hits += 1;
+	c->bytes_saved += e->nbody;
+	mtx_unlock(&c->mtx);
+}
+
+
+void const *
+cache_document(struct cache *c, struct cache_entry *e)
+{
+	mtx_lock(&c->mtx);
+	if (!e->document)
+	{
+		QAJ4C_Value const *document = NULL;
+		e->ndom = QAJ4C_calculate_max_buffer_size_n(e->body, e->nbody);
+		e->dom = malloc(e->ndom);
+		QAJ4C_parse_opt(e->body, e->nbody, 0, e->dom, e->ndom, &document);
+		e->document = document;
+		if (e->is_linked)
+		{
+			c->nbytes += e->ndom;
+			// e itself is pinned and survives, even if it is evicted
+			evict(c);
+		}
+	}
+	void const *document = e->document;
+	mtx_unlock(&c->mtx);
+	return document;
+}
+
+
+void
+cache_release(struct cache *c, struct cache_entry *e)
+{
+	mtx_lock(&c->mtx);
+	e->refs -= 1;
+	bool const is_dead = e->refs == 0 && !e->is_linked;
+	mtx_unlock(&c->mtx);
+
+	if (is_dead)
+	{
+		free_entry(e);
+	}
+}
+
+
+void
+cache_get_stats(struct cache *c, struct cache_stats *out_stats)
+{
+	mtx_lock(&c->mtx);
+	out_stats->hits = c->hits;
+	out_stats->misses = c->misses;
+	out_stats->bytes_saved = c->bytes_saved;
+	out_stats->nentries = c->nentries;
+	out_stats->nbytes = c->nbytes;
+	mtx_unlock(&c->mtx);
+}
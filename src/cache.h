@@ -0,0 +1,179 @@
+// vi: filetype=c
+#pragma once
+#ifndef MINIMOD_CACHE_H_INCLUDED
+#define MINIMOD_CACHE_H_INCLUDED
+
+/* Title: cache
+ *
+ * Topic: Introduction
+ *
+ * Bounded response cache used by minimod to revalidate GET requests
+ * with conditional requests (ETag/Last-Modified).
+ *
+ * Entries are kept in memory (including their parsed JSON document)
+ * and mirrored to disk, so they survive restarts of the application.
+ * The disk mirror is bounded by the limits of memory: an entry evicted
+ * from memory is deleted from disk as well, including when the limits
+ * are lowered. After a restart entries are loaded from disk on demand.
+ * All functions are thread-safe.
+ */
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Section: API */
+
+struct cache;
+
+/* Struct: cache_entry
+ *
+ * A single cached response.
+ * Entries returned by <cache_lookup()> or <cache_store()> are pinned and
+ * stay valid until they are passed to <cache_release()>.
+ *
+ * etag - Value of the response's ETag header or NULL
+ * last_modified - Value of the response's Last-Modified header or NULL
+ */
+struct cache_entry
+{
+	struct cache_entry *prev;
+	struct cache_entry *next;
+	char *key;
+	char *etag;
+	char *last_modified;
+	void *body;
+	void *dom;
+	void const *document;
+	uint64_t hash;
+	size_t nbody;
+	size_t ndom;
+	int refs;
+	bool is_linked;
+	char _padding[3];
+};
+
+/* Struct: cache_stats
+ *
+ * hits - Number of responses served from the cache after revalidation
+ * misses - Number of cacheable responses that had to be downloaded
+ * bytes_saved - Sum of response bytes that were not downloaded due to hits
+ * nentries - Number of entries currently held in memory
+ * nbytes - Number of bytes currently held in memory
+ */
+struct cache_stats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t bytes_saved;
+	uint64_t nentries;
+	uint64_t nbytes;
+};
+
+/* Function: cache_create()
+ *
+ * Parameters:
+ *	in_dir - Directory to mirror entries to. Needs to end with '/'.
+ *	in_max_bytes - Upper limit of bytes held in memory, including parsed
+ *		documents. Bounds the disk mirror as well.
+ *	in_max_entries - Upper limit of entries held in memory and on disk
+ */
+struct cache *
+cache_create(char const *in_dir, size_t in_max_bytes, size_t in_max_entries);
+
+/* Function: cache_destroy()
+ *
+ * Free all memory. The on-disk entries are kept.
+ */
+void
+cache_destroy(struct cache *in_cache);
+
+/* Function: cache_set_limits()
+ *
+ * Change the limits of the cache, evicting entries as required.
+ * Evicted entries are deleted from disk as well.
+ */
+void
+cache_set_limits(
+  struct cache *in_cache,
+  size_t in_max_bytes,
+  size_t in_max_entries);
+
+/* Function: cache_key_from_url()
+ *
+ * Create the key for *in_url*, which is the URL without the 'api_key'
+ * query parameter.
+ *
+ * Returns:
+ *	Newly allocated string, to be free()d by the caller.
+ */
+char *
+cache_key_from_url(char const *in_url);
+
+/* Function: cache_lookup()
+ *
+ * Look up *in_key* in memory first and on disk second.
+ *
+ * Returns:
+ *	Pinned entry or NULL.
+ */
+struct cache_entry *
+cache_lookup(struct cache *in_cache, char const *in_key);
+
+/* Function: cache_store()
+ *
+ * Store a response, replacing an existing entry with the same key.
+ * Responses without any validators or exceeding the limits of the cache
+ * are not stored. Also counts as a miss.
+ *
+ * Returns:
+ *	Pinned entry or NULL if the response was not stored.
+ */
+struct cache_entry *
+cache_store(
+  struct cache *in_cache,
+  char const *in_key,
+  char const *in_etag,
+  char const *in_last_modified,
+  void const *in_body,
+  size_t in_nbody);
+
+/* Function: cache_hit()
+ *
+ * Record that *in_entry* was revalidated successfully (HTTP status 304).
+ */
+void
+cache_hit(struct cache *in_cache, struct cache_entry *in_entry);
+
+/* Function: cache_document()
+ *
+ * Get the parsed JSON document (QAJ4C_Value) of *in_entry*.
+ * The document is parsed only once and then kept with the entry.
+ * Its memory counts towards the limits, so this may evict other entries.
+ */
+void const *
+cache_document(struct cache *in_cache, struct cache_entry *in_entry);
+
+/* Function: cache_release()
+ *
+ * Unpin an entry returned by <cache_lookup()> or <cache_store()>.
+ */
+void
+cache_release(struct cache *in_cache, struct cache_entry *in_entry);
+
+/* Function: cache_get_stats()
+ */
+void
+cache_get_stats(struct cache *in_cache, struct cache_stats *out_stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
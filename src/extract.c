@@ -0,0 +1,1510 @@
+#include "extract.h"
+
+#include "util.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#include "miniz/miniz.h"
+#pragma GCC diagnostic pop
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UNUSED(X) __pragma(warning(suppress : 4100)) X
+#else
+#define UNUSED(X) __attribute__((unused)) X
+#endif
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
+#endif
+#pragma GCC diagnostic ignored "-Wunused-macros"
+
+#ifdef MINIMOD_LOG_ENABLE
+#define LOG(FMT, ...) printf("[extract] " FMT "\n", ##__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+#define LOGE(FMT, ...) fprintf(stderr, "[extract] " FMT "\n", ##__VA_ARGS__)
+
+#pragma GCC diagnostic pop
+
+// CONFIG
+// ------
+#define MAX_WORKERS 8
+// entries of an archive are handed to the workers in items of up to
+// ITEM_FILES files or ITEM_BYTES (uncompressed) bytes
+#define ITEM_FILES 64
+#define ITEM_BYTES (8 * 1024 * 1024)
+// every worker writes through a stdio buffer of this size
+#define WRITE_BUFFER_SIZE (1024 * 1024)
+#define WRITE_BUFFER_ALIGN 4096
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+
+
+struct extract_job
+{
+	mz_zip_archive zip;
+	FILE *file;
+	char *zip_path;
+	char *dir;
+	char *tmp_dir;
+	extract_callback callback;
+	void *userdata;
+	// read concurrently by the submitter, points to own_progress if it
+	// is not interested.
+	struct extract_progress *progress;
+	struct extract_progress own_progress;
+	// nfiles, nbytes and nbytes_compressed are updated atomically
+	struct extract_stats stats;
+	uint64_t start;
+	// number of items not done yet, the last one finishes the job
+	size_t nremaining;
+	bool is_failed;
+	char _padding[7];
+};
+
+
+struct extract_item
+{
+	struct extract_item *next;
+	struct extract_job *job;
+	mz_uint first;
+	// 0 means the job still needs to be prepared
+	mz_uint count;
+};
+
+
+struct extractor
+{
+	mtx_t mtx;
+	cnd_t cnd;
+	struct extract_item *head;
+	struct extract_item *tail;
+	thrd_t *workers;
+	unsigned int nworkers;
+	// number of running stream threads
+	unsigned int nstreams;
+	bool is_quitting;
+	char _padding[7];
+};
+
+
+struct worker
+{
+	struct extractor *extractor;
+	void *buffer_alloc;
+	char *buffer;
+	// too big for the stack of some threads
+	mz_zip_archive_file_stat stat;
+};
+
+
+static void
+push_items(struct extractor *ex, struct extract_item *in_first)
+{
+	struct extract_item *last = in_first;
+	while (last->next)
+	{
+		last = last->next;
+	}
+
+	mtx_lock(&ex->mtx);
+	if (ex->tail)
+	{
+		ex->tail->next = in_first;
+	}
+	else
+	{
+		ex->head = in_first;
+	}
+	ex->tail = last;
+	cnd_broadcast(&ex->cnd);
+	mtx_unlock(&ex->mtx);
+}
+
+
+// Returns a buffer of WRITE_BUFFER_SIZE bytes aligned to WRITE_BUFFER_ALIGN.
+// *out_alloc needs to be free()d.
+static char *
+alloc_write_buffer(void **out_alloc)
+{
+	*out_alloc = malloc(WRITE_BUFFER_SIZE + WRITE_BUFFER_ALIGN);
+	uintptr_t const misalignment = (uintptr_t)*out_alloc % WRITE_BUFFER_ALIGN;
+	return (char *)*out_alloc
+	  + (misalignment ? WRITE_BUFFER_ALIGN - misalignment : 0);
+}
+
+
+static size_t
+read_zip(void *in_file, mz_uint64 in_offset, void *out_buffer, size_t in_bytes)
+{
+	return fsu_pread(in_file, out_buffer, in_bytes, in_offset);
+}
+
+
+static size_t
+write_file(
+  void *in_file,
+  mz_uint64 UNUSED(in_offset),
+  void const *in_buffer,
+  size_t in_bytes)
+{
+	return fwrite(in_buffer, 1, in_bytes, in_file);
+}
+
+
+// Reject absolute paths and paths escaping the destination directory.
+static bool
+is_safe_name(char const *in_name)
+{
+	if (in_name[0] == '/' || in_name[0] == '\\' || strchr(in_name, ':'))
+	{
+		return false;
+	}
+
+	char const *component = in_name;
+	for (char const *ptr = in_name;; ++ptr)
+	{
+		if (*ptr == '/' || *ptr == '\\' || *ptr == '\0')
+		{
+			if (ptr - component == 2 && 0 == strncmp(component, "..", 2))
+			{
+				return false;
+			}
+			if (*ptr == '\0')
+			{
+				return true;
+			}
+			component = ptr + 1;
+		}
+	}
+}
+
+
+static int
+compare_strings(void const *in_a, void const *in_b)
+{
+	return strcmp(*(char *const *)in_a, *(char *const *)in_b);
+}
+
+
+static bool
+move_into_place(char const *in_dir, char const *in_tmp_dir)
+{
+	// move the previous version away first, as directories cannot be
+	// replaced by rename().
+	char *old = NULL;
+	if (fsu_ptype(in_dir) == FSU_PATHTYPE_DIR)
+	{
+		asprintf(&old, "%s.old", in_dir);
+		if (fsu_ptype(old) == FSU_PATHTYPE_DIR)
+		{
+			fsu_rmdir_recursive(old);
+		}
+		if (!fsu_mvfile(in_dir, old, false))
+		{
+			LOGE("failed to move %s away", in_dir);
+			free(old);
+			return false;
+		}
+	}
+
+	bool const ok = fsu_mvfile(in_tmp_dir, in_dir, false);
+	if (!ok)
+	{
+		LOGE("failed to move %s into place", in_dir);
+		if (old)
+		{
+			fsu_mvfile(old, in_dir, false);
+		}
+	}
+	else if (old)
+	{
+		fsu_rmdir_recursive(old);
+	}
+
+	free(old);
+	return ok;
+}
+
+
+static bool
+is_cancelled(struct extract_progress *in_progress)
+{
+	return __atomic_load_n(&in_progress->is_cancelled, __ATOMIC_ACQUIRE);
+}
+
+
+static void
+finish_job(struct extract_job *job)
+{
+	bool ok = !__atomic_load_n(&job->is_failed, __ATOMIC_ACQUIRE);
+	bool const is_job_cancelled = is_cancelled(job->progress);
+	ok = ok && !is_job_cancelled;
+
+	if (job->zip.m_zip_mode != MZ_ZIP_MODE_INVALID)
+	{
+		mz_zip_reader_end(&job->zip);
+	}
+	if (job->file)
+	{
+		fclose(job->file);
+	}
+
+	if (ok)
+	{
+		ok = move_into_place(job->dir, job->tmp_dir);
+	}
+	if (!ok && fsu_ptype(job->tmp_dir) == FSU_PATHTYPE_DIR)
+	{
+		fsu_rmdir_recursive(job->tmp_dir);
+	}
+
+	job->stats.usecs = sys_microseconds() - job->start;
+	LOG(
+	  "%s: %" PRIu64 " files, %" PRIu64 " bytes in %" PRIu64 " ms (%.1f MiB/s)",
+	  job->dir,
+	  job->stats.nfiles,
+	  job->stats.nbytes,
+	  job->stats.usecs / 1000,
+	  (double)job->stats.nbytes / 1048576.0
+	    / ((double)(job->stats.usecs + 1) / 1000000.0));
+
+	enum extract_result result = ok ? EXTRACT_OK : EXTRACT_ERR_FAILED;
+	if (is_job_cancelled)
+	{
+		result = EXTRACT_ERR_CANCELLED;
+	}
+	job->callback(job->userdata, result, &job->stats);
+
+	free(job->zip_path);
+	free(job->dir);
+	free(job->tmp_dir);
+	free(job);
+}
+
+
+static void
+finish_items(struct extract_job *job, size_t in_count)
+{
+	if (0 == __atomic_sub_fetch(&job->nremaining, in_count, __ATOMIC_ACQ_REL))
+	{
+		finish_job(job);
+	}
+}
+
+
+// Creates every directory required by the archive once, instead of
+// once per file.
+static bool
+make_dirs(struct extract_job *job, char **in_dirs, size_t in_ndirs)
+{
+	char *path;
+	asprintf(&path, "%s/", job->tmp_dir);
+	bool ok = fsu_mkdir(path);
+	free(path);
+
+	qsort(in_dirs, in_ndirs, sizeof *in_dirs, compare_strings);
+	for (size_t i = 0; ok && i < in_ndirs; ++i)
+	{
+		// skip it, if the next one is the same or a subdirectory, as
+		// fsu_mkdir() creates all parents anyway.
+		if (
+		  i + 1 < in_ndirs
+		  && 0 == strncmp(in_dirs[i], in_dirs[i + 1], strlen(in_dirs[i])))
+		{
+			continue;
+		}
+		asprintf(&path, "%s/%s", job->tmp_dir, in_dirs[i]);
+		ok = fsu_mkdir(path);
+		if (!ok)
+		{
+			LOGE("failed to create %s", path);
+		}
+		free(path);
+	}
+	return ok;
+}
+
+
+static void
+prepare_job(struct worker *w, struct extract_job *job)
+{
+	int64_t const size = fsu_fsize(job->zip_path);
+	job->file = size > 0 ? fsu_fopen(job->zip_path, "rb") : NULL;
+	if (!job->file)
+	{
+		LOGE("failed to open %s", job->zip_path);
+		job->is_failed = true;
+		finish_job(job);
+		return;
+	}
+
+	job->zip.m_pRead = read_zip;
+	job->zip.m_pIO_opaque = job->file;
+	if (!mz_zip_reader_init(&job->zip, (mz_uint64)size, 0))
+	{
+		LOGE("zip error: %i", job->zip.m_last_error);
+		job->is_failed = true;
+		finish_job(job);
+		return;
+	}
+
+	// leftovers of an interrupted extraction
+	if (fsu_ptype(job->tmp_dir) == FSU_PATHTYPE_DIR)
+	{
+		fsu_rmdir_recursive(job->tmp_dir);
+	}
+
+	mz_uint const nfiles = mz_zip_reader_get_num_files(&job->zip);
+	LOG("#files in %s: %u", job->zip_path, nfiles);
+	char **dirs = malloc(nfiles * sizeof *dirs);
+	size_t ndirs = 0;
+	struct extract_item *items = NULL;
+	struct extract_item **tail = &items;
+	struct extract_item *item = NULL;
+	size_t nitems = 0;
+	uint64_t item_bytes = 0;
+	uint64_t nfiles_total = 0;
+	bool ok = true;
+
+	for (mz_uint i = 0; ok && i < nfiles; ++i)
+	{
+		mz_zip_archive_file_stat *stat = &w->stat;
+		ok = mz_zip_reader_file_stat(&job->zip, i, stat)
+		  && is_safe_name(stat->m_filename)
+		  && (stat->m_is_directory || stat->m_is_supported);
+		if (!ok)
+		{
+			LOGE("unsupported entry #%u '%s'", i, stat->m_filename);
+			break;
+		}
+
+		char const *slash = strrchr(stat->m_filename, '/');
+		if (slash)
+		{
+			size_t const len = (size_t)(slash - stat->m_filename) + 1;
+			char *dir = malloc(len + 1);
+			memcpy(dir, stat->m_filename, len);
+			dir[len] = '\0';
+			dirs[ndirs++] = dir;
+		}
+
+		// start a new item, if the current one is big enough
+		if (
+		  !item || item->count >= ITEM_FILES || item_bytes >= ITEM_BYTES)
+		{
+			item = calloc(1, sizeof *item);
+			item->job = job;
+			item->first = i;
+			*tail = item;
+			tail = &item->next;
+			nitems += 1;
+			item_bytes = 0;
+		}
+		item->count += 1;
+		item_bytes += stat->m_uncomp_size;
+		nfiles_total += stat->m_is_directory ? 0 : 1;
+	}
+	__atomic_store_n(
+	  &job->progress->nfiles_total,
+	  nfiles_total,
+	  __ATOMIC_RELAXED);
+
+	ok = ok && make_dirs(job, dirs, ndirs);
+	for (size_t i = 0; i < ndirs; ++i)
+	{
+		free(dirs[i]);
+	}
+	free(dirs);
+
+	if (!ok || nitems == 0)
+	{
+		while (items)
+		{
+			struct extract_item *next = items->next;
+			free(items);
+			items = next;
+		}
+		job->is_failed = !ok;
+		finish_job(job);
+		return;
+	}
+
+	job->nremaining = nitems;
+	push_items(w->extractor, items);
+}
+
+
+static bool
+copy_stored(
+  struct extract_job *job,
+  mz_zip_archive_file_stat const *stat,
+  FILE *out_file)
+{
+	unsigned char header[ZIP_LOCAL_HEADER_SIZE];
+	if (
+	  sizeof header
+	  != fsu_pread(job->file, header, sizeof header, stat->m_local_header_ofs))
+	{
+		return false;
+	}
+
+	uint32_t const sig = (uint32_t)header[0] | (uint32_t)header[1] << 8
+	  | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 24;
+	uint64_t const offset = stat->m_local_header_ofs + ZIP_LOCAL_HEADER_SIZE
+	  + (header[26] | header[27] << 8) + (header[28] | header[29] << 8);
+	if (
+	  sig != ZIP_LOCAL_HEADER_SIG
+	  || offset + stat->m_comp_size > job->zip.m_archive_size)
+	{
+		return false;
+	}
+
+	// the data is copied verbatim without passing through userspace,
+	// so only its size is verified, but not its CRC.
+	return fsu_copy_range(job->file, offset, stat->m_comp_size, out_file);
+}
+
+
+static bool
+extract_entry(struct worker *w, struct extract_job *job, mz_uint in_index)
+{
+	mz_zip_archive_file_stat *stat = &w->stat;
+	if (!mz_zip_reader_file_stat(&job->zip, in_index, stat))
+	{
+		return false;
+	}
+	if (stat->m_is_directory)
+	{
+		return true;
+	}
+
+	char *path;
+	asprintf(&path, "%s/%s", job->tmp_dir, stat->m_filename);
+	LOG("  + extracting %s", path);
+
+	// directories exist already
+	FILE *f = fsu_fopen_nomkdir(path, "wb");
+	if (!f)
+	{
+		LOGE("failed to create %s", path);
+		free(path);
+		return false;
+	}
+	setvbuf(f, w->buffer, _IOFBF, WRITE_BUFFER_SIZE);
+
+	bool ok;
+	if (stat->m_method == 0 && stat->m_comp_size == stat->m_uncomp_size)
+	{
+		ok = copy_stored(job, stat, f);
+	}
+	else
+	{
+		ok = mz_zip_reader_extract_to_callback(
+		  &job->zip,
+		  in_index,
+		  write_file,
+		  f,
+		  0);
+	}
+	ok = (0 == fclose(f)) && ok;
+
+	if (ok)
+	{
+		__atomic_add_fetch(&job->progress->nfiles, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&job->stats.nfiles, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(
+		  &job->stats.nbytes,
+		  stat->m_uncomp_size,
+		  __ATOMIC_RELAXED);
+		__atomic_add_fetch(
+		  &job->stats.nbytes_compressed,
+		  stat->m_comp_size,
+		  __ATOMIC_RELAXED);
+	}
+	else
+	{
+		LOGE("failed to extract %s", path);
+	}
+
+	free(path);
+	return ok;
+}
+
+
+static void
+extract_entries(struct worker *w, struct extract_item *item)
+{
+	struct extract_job *job = item->job;
+	for (mz_uint i = item->first; i < item->first + item->count; ++i)
+	{
+		// no need to continue, if any other entry failed already
+		if (
+		  __atomic_load_n(&job->is_failed, __ATOMIC_RELAXED)
+		  || is_cancelled(job->progress))
+		{
+			break;
+		}
+		if (!extract_entry(w, job, i))
+		{
+			__atomic_store_n(&job->is_failed, true, __ATOMIC_RELEASE);
+		}
+	}
+	finish_items(job, 1);
+}
+
+
+static int
+worker_main(void *in_extractor)
+{
+	struct worker *w = calloc(1, sizeof *w);
+	w->extractor = in_extractor;
+	w->buffer = alloc_write_buffer(&w->buffer_alloc);
+
+	struct extractor *ex = w->extractor;
+	for (;;)
+	{
+		mtx_lock(&ex->mtx);
+		while (!ex->head && !ex->is_quitting)
+		{
+			cnd_wait(&ex->cnd, &ex->mtx);
+		}
+		// finish all queued work before quitting
+		struct extract_item *item = ex->head;
+		if (item)
+		{
+			ex->head = item->next;
+			if (!ex->head)
+			{
+				ex->tail = NULL;
+			}
+		}
+		mtx_unlock(&ex->mtx);
+
+		if (!item)
+		{
+			break;
+		}
+
+		if (item->count == 0)
+		{
+			prepare_job(w, item->job);
+		}
+		else
+		{
+			extract_entries(w, item);
+		}
+		free(item);
+	}
+
+	free(w->buffer_alloc);
+	free(w);
+	return 0;
+}
+
+
+struct extractor *
+extractor_create(unsigned int in_nworkers)
+{
+	struct extractor *ex = calloc(1, sizeof *ex);
+	mtx_init(&ex->mtx, mtx_plain);
+	cnd_init(&ex->cnd);
+
+	unsigned int n = in_nworkers;
+	if (n == 0)
+	{
+		n = sys_ncpus();
+		n = n < MAX_WORKERS ? n : MAX_WORKERS;
+	}
+
+	ex->workers = calloc(n, sizeof *ex->workers);
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		if (thrd_success != thrd_create(&ex->workers[i], worker_main, ex))
+		{
+			LOGE("failed to create worker thread");
+			break;
+		}
+		ex->nworkers += 1;
+	}
+	return ex;
+}
+
+
+void
+extractor_destroy(struct extractor *ex)
+{
+	// stream threads are detached, so wait for them to be done.
+	// first, as their callbacks may still submit archives.
+	mtx_lock(&ex->mtx);
+	while (ex->nstreams > 0)
+	{
+		cnd_wait(&ex->cnd, &ex->mtx);
+	}
+	ex->is_quitting = true;
+	cnd_broadcast(&ex->cnd);
+	mtx_unlock(&ex->mtx);
+
+	for (unsigned int i = 0; i < ex->nworkers; ++i)
+	{
+		thrd_join(ex->workers[i], NULL);
+	}
+
+	free(ex->workers);
+	cnd_destroy(&ex->cnd);
+	mtx_destroy(&ex->mtx);
+	free(ex);
+}
+
+
+void
+extractor_submit(
+  struct extractor *ex,
+  char const *in_zip_path,
+  char const *in_dir,
+  struct extract_progress *io_progress,
+  extract_callback in_callback,
+  void *in_userdata)
+{
+	struct extract_job *job = calloc(1, sizeof *job);
+	job->zip_path = strdup(in_zip_path);
+	job->dir = strdup(in_dir);
+	asprintf(&job->tmp_dir, "%s.tmp", in_dir);
+	job->callback = in_callback;
+	job->userdata = in_userdata;
+	job->progress = io_progress ? io_progress : &job->own_progress;
+	job->start = sys_microseconds();
+
+	// reading the central directory is left to the workers as well
+	struct extract_item *item = calloc(1, sizeof *item);
+	item->job = job;
+	push_items(ex, item);
+}
+
+
+// STREAMING
+// ---------
+// Extracts an archive front to back while it is being downloaded, using the
+// local headers in front of every entry. The central directory at the end
+// is only used to verify what was extracted.
+#define STREAM_READ_SIZE (256 * 1024)
+
+#define ZIP_CENTRAL_HEADER_SIG 0x02014b50
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_DESCRIPTOR_SIG 0x08074b50
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP64_LOCATOR_SIG 0x07064b50
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_FLAG_DESCRIPTOR 0x0008
+
+
+struct stream_entry
+{
+	char *name;
+	uint64_t offset;
+	uint64_t csize;
+	uint64_t usize;
+	uint32_t crc;
+	char _padding[4];
+};
+
+
+// a directory created by a stream, including the trailing '/'
+struct stream_dir
+{
+	char *name;
+	uint64_t hash;
+};
+
+
+struct extract_stream
+{
+	struct extractor *extractor;
+	FILE *pipe;
+	char *dir;
+	char *tmp_dir;
+	extract_callback callback;
+	void *userdata;
+	// as with extract_job
+	struct extract_progress *progress;
+	struct extract_progress own_progress;
+	struct extract_stats stats;
+	uint64_t start;
+	// of everything read from the pipe
+	struct md5 md5;
+	char *expected_md5;
+
+	// input buffer, [in_begin; in_end) is not consumed yet
+	unsigned char *in;
+	size_t in_size;
+	size_t in_begin;
+	size_t in_end;
+	// archive offset of in[in_begin]
+	uint64_t offset;
+	bool is_eof;
+	char _padding[7];
+
+	// entries seen so far, to verify the central directory
+	struct stream_entry *entries;
+	size_t nentries;
+	size_t capentries;
+
+	// created directories, open addressing, empty slots have no name
+	struct stream_dir *dirs;
+	size_t ndirs;
+	size_t capdirs;
+
+	tinfl_decompressor inflator;
+	unsigned char *dict;
+	void *write_buffer_alloc;
+	char *write_buffer;
+};
+
+
+static uint16_t
+rd16(unsigned char const *in_ptr)
+{
+	return (uint16_t)(in_ptr[0] | in_ptr[1] << 8);
+}
+
+
+static uint32_t
+rd32(unsigned char const *in_ptr)
+{
+	return (uint32_t)rd16(in_ptr) | (uint32_t)rd16(in_ptr + 2) << 16;
+}
+
+
+static uint64_t
+rd64(unsigned char const *in_ptr)
+{
+	return (uint64_t)rd32(in_ptr) | (uint64_t)rd32(in_ptr + 4) << 32;
+}
+
+
+// Reads at least one more byte from the pipe. Returns false on EOF.
+static bool
+read_more(struct extract_stream *s)
+{
+	if (s->is_eof)
+	{
+		return false;
+	}
+
+	// make room at the end
+	if (s->in_begin > 0)
+	{
+		memmove(s->in, s->in + s->in_begin, s->in_end - s->in_begin);
+		s->in_end -= s->in_begin;
+		s->in_begin = 0;
+	}
+	if (s->in_size - s->in_end < STREAM_READ_SIZE / 2)
+	{
+		s->in_size *= 2;
+		s->in = realloc(s->in, s->in_size);
+	}
+
+	size_t const n = fread(s->in + s->in_end, 1, s->in_size - s->in_end, s->pipe);
+	md5_update(&s->md5, s->in + s->in_end, n);
+	s->in_end += n;
+	__atomic_add_fetch(&s->progress->nbytes_read, n, __ATOMIC_RELAXED);
+	s->is_eof = (n == 0);
+	return n > 0;
+}
+
+
+// Makes sure at least in_bytes are buffered. Returns false on EOF.
+static bool
+fill(struct extract_stream *s, size_t in_bytes)
+{
+	while (s->in_end - s->in_begin < in_bytes)
+	{
+		if (!read_more(s))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static unsigned char const *
+cur(struct extract_stream const *s)
+{
+	return s->in + s->in_begin;
+}
+
+
+static size_t
+avail(struct extract_stream const *s)
+{
+	return s->in_end - s->in_begin;
+}
+
+
+static void
+consume(struct extract_stream *s, size_t in_bytes)
+{
+	s->in_begin += in_bytes;
+	s->offset += in_bytes;
+}
+
+
+// Parses the ZIP64 extended information extra field. Only the fields whose
+// regular counterparts are 0xFFFFFFFF are present, in this order.
+// Returns true if the field exists.
+static bool
+parse_zip64_extra(
+  unsigned char const *in_extra,
+  size_t in_nextra,
+  uint64_t *io_usize,
+  uint64_t *io_csize,
+  uint64_t *io_offset)
+{
+	unsigned char const *end = in_extra + in_nextra;
+	while (in_extra + 4 <= end)
+	{
+		uint16_t const id = rd16(in_extra);
+		uint16_t const size = rd16(in_extra + 2);
+		unsigned char const *field = in_extra + 4;
+		unsigned char const *field_end = field + size;
+		if (field_end > end)
+		{
+			return false;
+		}
+		if (id == ZIP64_EXTRA_ID)
+		{
+			uint64_t *values[] = { io_usize, io_csize, io_offset };
+			for (size_t i = 0; i < 3; ++i)
+			{
+				if (values[i] && *values[i] == 0xFFFFFFFF && field + 8 <= field_end)
+				{
+					*values[i] = rd64(field);
+					field += 8;
+				}
+			}
+			return true;
+		}
+		in_extra = field_end;
+	}
+	return false;
+}
+
+
+// Creates the directory of in_name (up to the last '/'), unless it was
+// created already.
+static bool
+stream_mkdir(struct extract_stream *s, char const *in_name)
+{
+	char const *slash = strrchr(in_name, '/');
+	if (!slash)
+	{
+		return true;
+	}
+	size_t const len = (size_t)(slash - in_name) + 1;
+	uint64_t const hash = hash_fnv1a(in_name, len);
+
+	// open addressing, kept at most half full
+	size_t i = hash & (s->capdirs - 1);
+	while (s->dirs[i].name)
+	{
+		char const *name = s->dirs[i].name;
+		if (
+		  s->dirs[i].hash == hash && 0 == strncmp(name, in_name, len)
+		  && '\0' == name[len])
+		{
+			return true;
+		}
+		i = (i + 1) & (s->capdirs - 1);
+	}
+
+	char *path;
+	asprintf(&path, "%s/%.*s", s->tmp_dir, (int)len, in_name);
+	if (!fsu_mkdir(path))
+	{
+		// not recorded, so a later entry does not assume it exists
+		LOGE("failed to create %s", path);
+		free(path);
+		return false;
+	}
+	free(path);
+
+	asprintf(&s->dirs[i].name, "%.*s", (int)len, in_name);
+	s->dirs[i].hash = hash;
+	s->ndirs += 1;
+	if (s->ndirs * 2 > s->capdirs)
+	{
+		struct stream_dir *old = s->dirs;
+		size_t const oldcap = s->capdirs;
+		s->capdirs *= 2;
+		s->dirs = calloc(s->capdirs, sizeof *s->dirs);
+		for (size_t k = 0; k < oldcap; ++k)
+		{
+			if (old[k].name)
+			{
+				size_t j = old[k].hash & (s->capdirs - 1);
+				while (s->dirs[j].name)
+				{
+					j = (j + 1) & (s->capdirs - 1);
+				}
+				s->dirs[j] = old[k];
+			}
+		}
+		free(old);
+	}
+	return true;
+}
+
+
+static bool
+write_out(
+  FILE *out_file,
+  uint32_t *io_crc,
+  unsigned char const *in_data,
+  size_t in_bytes)
+{
+	*io_crc = (uint32_t)mz_crc32(*io_crc, in_data, in_bytes);
+	return !out_file || in_bytes == fwrite(in_data, 1, in_bytes, out_file);
+}
+
+
+static bool
+inflate_entry(
+  struct extract_stream *s,
+  FILE *out_file,
+  uint32_t *io_crc,
+  uint64_t *out_csize,
+  uint64_t *out_usize)
+{
+	tinfl_init(&s->inflator);
+	size_t dict_ofs = 0;
+	for (;;)
+	{
+		if (avail(s) == 0 && !read_more(s))
+		{
+			return false;
+		}
+
+		size_t in_bytes = avail(s);
+		size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+		tinfl_status const status = tinfl_decompress(
+		  &s->inflator,
+		  cur(s),
+		  &in_bytes,
+		  s->dict,
+		  s->dict + dict_ofs,
+		  &out_bytes,
+		  TINFL_FLAG_HAS_MORE_INPUT);
+		consume(s, in_bytes);
+		*out_csize += in_bytes;
+
+		if (!write_out(out_file, io_crc, s->dict + dict_ofs, out_bytes))
+		{
+			return false;
+		}
+		*out_usize += out_bytes;
+		dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+		if (status == TINFL_STATUS_DONE)
+		{
+			return true;
+		}
+		if (status < TINFL_STATUS_DONE)
+		{
+			return false;
+		}
+		if (status == TINFL_STATUS_NEEDS_MORE_INPUT && !read_more(s))
+		{
+			return false;
+		}
+	}
+}
+
+
+static bool
+copy_entry(
+  struct extract_stream *s,
+  FILE *out_file,
+  uint32_t *io_crc,
+  uint64_t in_bytes)
+{
+	while (in_bytes > 0)
+	{
+		if (avail(s) == 0 && !read_more(s))
+		{
+			return false;
+		}
+		size_t const n = avail(s) < in_bytes ? avail(s) : (size_t)in_bytes;
+		if (!write_out(out_file, io_crc, cur(s), n))
+		{
+			return false;
+		}
+		consume(s, n);
+		in_bytes -= n;
+	}
+	return true;
+}
+
+
+// A stored entry with a data descriptor has no size up front, so its end
+// is found by looking for a descriptor matching the data before it.
+static bool
+copy_entry_until_descriptor(
+  struct extract_stream *s,
+  FILE *out_file,
+  uint32_t *io_crc,
+  uint64_t *out_size)
+{
+	// signature, crc, compressed and uncompressed size
+	size_t const ndescriptor = 16;
+	for (;;)
+	{
+		if (avail(s) < ndescriptor && !read_more(s))
+		{
+			return false;
+		}
+
+		unsigned char const *begin = cur(s);
+		unsigned char const *end = begin + avail(s);
+		unsigned char const *ptr = begin;
+		for (; ptr + 4 <= end; ++ptr)
+		{
+			if (rd32(ptr) != ZIP_DESCRIPTOR_SIG)
+			{
+				continue;
+			}
+			if (ptr + ndescriptor > end)
+			{
+				break;
+			}
+			size_t const n = (size_t)(ptr - begin);
+			uint32_t const crc = (uint32_t)mz_crc32(*io_crc, begin, n);
+			if (rd32(ptr + 4) == crc && rd32(ptr + 8) == *out_size + n)
+			{
+				bool const ok = write_out(out_file, io_crc, begin, n);
+				consume(s, n);
+				*out_size += n;
+				return ok;
+			}
+		}
+
+		// keep what might be the beginning of a descriptor
+		size_t const n = (size_t)(ptr - begin);
+		if (n == 0)
+		{
+			if (!read_more(s))
+			{
+				return false;
+			}
+			continue;
+		}
+		if (!write_out(out_file, io_crc, begin, n))
+		{
+			return false;
+		}
+		consume(s, n);
+		*out_size += n;
+	}
+}
+
+
+static bool
+stream_local_entry(struct extract_stream *s)
+{
+	if (!fill(s, ZIP_LOCAL_HEADER_SIZE))
+	{
+		return false;
+	}
+	unsigned char const *h = cur(s);
+	uint16_t const flags = rd16(h + 6);
+	uint16_t const method = rd16(h + 8);
+	uint32_t const crc = rd32(h + 14);
+	uint64_t csize = rd32(h + 18);
+	uint64_t usize = rd32(h + 22);
+	size_t const nname = rd16(h + 26);
+	size_t const nextra = rd16(h + 28);
+	if (!fill(s, ZIP_LOCAL_HEADER_SIZE + nname + nextra))
+	{
+		return false;
+	}
+	h = cur(s);
+
+	struct stream_entry e = { .offset = s->offset };
+	e.name = malloc(nname + 1);
+	memcpy(e.name, h + ZIP_LOCAL_HEADER_SIZE, nname);
+	e.name[nname] = '\0';
+	// determines the size of the data descriptor as well
+	bool const is_zip64 = parse_zip64_extra(
+	  h + ZIP_LOCAL_HEADER_SIZE + nname,
+	  nextra,
+	  &usize,
+	  &csize,
+	  NULL);
+	consume(s, ZIP_LOCAL_HEADER_SIZE + nname + nextra);
+
+	if (s->nentries == s->capentries)
+	{
+		s->capentries = s->capentries ? s->capentries * 2 : 64;
+		s->entries = realloc(s->entries, s->capentries * sizeof *s->entries);
+	}
+	s->entries[s->nentries++] = e;
+
+	bool const has_descriptor = flags & ZIP_FLAG_DESCRIPTOR;
+	if (
+	  !is_safe_name(e.name) || (flags & ZIP_FLAG_ENCRYPTED)
+	  || (method != 0 && method != MZ_DEFLATED))
+	{
+		LOGE("unsupported entry '%s'", e.name);
+		return false;
+	}
+
+	bool const is_dir = nname > 0 && e.name[nname - 1] == '/';
+	if (!stream_mkdir(s, e.name))
+	{
+		return false;
+	}
+
+	FILE *f = NULL;
+	if (!is_dir)
+	{
+		char *path;
+		asprintf(&path, "%s/%s", s->tmp_dir, e.name);
+		LOG("  + extracting %s", path);
+		f = fsu_fopen_nomkdir(path, "wb");
+		if (!f)
+		{
+			LOGE("failed to create %s", path);
+			free(path);
+			return false;
+		}
+		free(path);
+		setvbuf(f, s->write_buffer, _IOFBF, WRITE_BUFFER_SIZE);
+	}
+
+	uint32_t actual_crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, NULL, 0);
+	uint64_t actual_csize = 0;
+	uint64_t actual_usize = 0;
+	bool ok;
+	if (method == MZ_DEFLATED)
+	{
+		ok = inflate_entry(s, f, &actual_crc, &actual_csize, &actual_usize);
+	}
+	else if (has_descriptor && csize == 0)
+	{
+		ok = copy_entry_until_descriptor(s, f, &actual_crc, &actual_usize);
+		actual_csize = actual_usize;
+	}
+	else
+	{
+		ok = copy_entry(s, f, &actual_crc, csize);
+		actual_csize = actual_usize = csize;
+	}
+	if (f)
+	{
+		ok = (0 == fclose(f)) && ok;
+	}
+
+	// the sizes in the local header are 0 if there is a data descriptor
+	if (ok && has_descriptor)
+	{
+		ok = fill(s, 4);
+		if (ok && rd32(cur(s)) == ZIP_DESCRIPTOR_SIG)
+		{
+			consume(s, 4);
+		}
+		size_t const nsizes = is_zip64 ? 8 : 4;
+		ok = ok && fill(s, 4 + 2 * nsizes);
+		if (ok)
+		{
+			e.crc = rd32(cur(s));
+			e.csize = is_zip64 ? rd64(cur(s) + 4) : rd32(cur(s) + 4);
+			e.usize = is_zip64 ? rd64(cur(s) + 12) : rd32(cur(s) + 8);
+			consume(s, 4 + 2 * nsizes);
+		}
+	}
+	else
+	{
+		e.crc = crc;
+		e.csize = csize;
+		e.usize = usize;
+	}
+	s->entries[s->nentries - 1] = e;
+
+	if (
+	  ok
+	  && (e.crc != actual_crc || e.csize != actual_csize || e.usize != actual_usize))
+	{
+		LOGE("corrupt entry '%s'", e.name);
+		ok = false;
+	}
+
+	if (ok && !is_dir)
+	{
+		__atomic_add_fetch(&s->progress->nfiles, 1, __ATOMIC_RELAXED);
+		s->stats.nfiles += 1;
+		s->stats.nbytes += actual_usize;
+		s->stats.nbytes_compressed += actual_csize;
+	}
+	return ok;
+}
+
+
+// Compares the central directory against the entries extracted.
+static bool
+stream_central_directory(struct extract_stream *s)
+{
+	__atomic_store_n(
+	  &s->progress->nfiles_total,
+	  s->stats.nfiles,
+	  __ATOMIC_RELAXED);
+
+	size_t nseen = 0;
+	while (fill(s, 4) && rd32(cur(s)) == ZIP_CENTRAL_HEADER_SIG)
+	{
+		if (!fill(s, ZIP_CENTRAL_HEADER_SIZE))
+		{
+			return false;
+		}
+		unsigned char const *h = cur(s);
+		size_t const nname = rd16(h + 28);
+		size_t const nextra = rd16(h + 30);
+		size_t const ncomment = rd16(h + 32);
+		size_t const nheader = ZIP_CENTRAL_HEADER_SIZE + nname + nextra + ncomment;
+		if (!fill(s, nheader))
+		{
+			return false;
+		}
+		h = cur(s);
+
+		uint32_t const crc = rd32(h + 16);
+		uint64_t csize = rd32(h + 20);
+		uint64_t usize = rd32(h + 24);
+		uint64_t offset = rd32(h + 42);
+		parse_zip64_extra(
+		  h + ZIP_CENTRAL_HEADER_SIZE + nname,
+		  nextra,
+		  &usize,
+		  &csize,
+		  &offset);
+
+		struct stream_entry const *e =
+		  nseen < s->nentries ? &s->entries[nseen] : NULL;
+		if (
+		  !e || strlen(e->name) != nname
+		  || 0 != memcmp(e->name, h + ZIP_CENTRAL_HEADER_SIZE, nname)
+		  || e->crc != crc || e->csize != csize || e->usize != usize
+		  || e->offset != offset)
+		{
+			LOGE("central directory does not match entry #%zu", nseen);
+			return false;
+		}
+		consume(s, nheader);
+		nseen += 1;
+	}
+
+	if (nseen != s->nentries)
+	{
+		LOGE("central directory misses entries");
+		return false;
+	}
+
+	if (fill(s, 4) && rd32(cur(s)) == ZIP64_EOCD_SIG)
+	{
+		if (!fill(s, 12))
+		{
+			return false;
+		}
+		uint64_t const size = rd64(cur(s) + 4);
+		if (size > STREAM_READ_SIZE || !fill(s, 12 + (size_t)size))
+		{
+			return false;
+		}
+		consume(s, 12 + (size_t)size);
+	}
+	if (fill(s, 4) && rd32(cur(s)) == ZIP64_LOCATOR_SIG)
+	{
+		if (!fill(s, ZIP64_LOCATOR_SIZE))
+		{
+			return false;
+		}
+		consume(s, ZIP64_LOCATOR_SIZE);
+	}
+
+	if (!fill(s, ZIP_EOCD_SIZE) || rd32(cur(s)) != ZIP_EOCD_SIG)
+	{
+		LOGE("end of central directory missing");
+		return false;
+	}
+	uint16_t const ntotal = rd16(cur(s) + 10);
+	return ntotal == 0xFFFF || ntotal == (s->nentries & 0xFFFF);
+}
+
+
+static bool
+stream_archive(struct extract_stream *s)
+{
+	if (fsu_ptype(s->tmp_dir) == FSU_PATHTYPE_DIR)
+	{
+		fsu_rmdir_recursive(s->tmp_dir);
+	}
+	char *path;
+	asprintf(&path, "%s/", s->tmp_dir);
+	bool const ok = fsu_mkdir(path);
+	free(path);
+	if (!ok)
+	{
+		return false;
+	}
+
+	while (fill(s, 4) && rd32(cur(s)) == ZIP_LOCAL_HEADER_SIG)
+	{
+		if (is_cancelled(s->progress) || !stream_local_entry(s))
+		{
+			return false;
+		}
+	}
+	return stream_central_directory(s);
+}
+
+
+static int
+stream_main(void *in_stream)
+{
+	struct extract_stream *s = in_stream;
+
+	bool ok = stream_archive(s);
+	if (!ok)
+	{
+		LOGE("failed to extract %s", s->dir);
+	}
+
+	// the writer must not be blocked by a full pipe
+	while (read_more(s))
+	{
+		s->in_begin = s->in_end;
+	}
+	fclose(s->pipe);
+
+	enum extract_result result = ok ? EXTRACT_OK : EXTRACT_ERR_FAILED;
+	char md5[33];
+	md5_final(&s->md5, md5);
+	if (s->expected_md5 && 0 != strcmp(md5, s->expected_md5))
+	{
+		LOGE("md5 mismatch of %s: %s", s->dir, md5);
+		result = EXTRACT_ERR_CHECKSUM;
+	}
+	// a cancelled download is truncated, which is not the archive's fault
+	if (is_cancelled(s->progress))
+	{
+		result = EXTRACT_ERR_CANCELLED;
+	}
+
+	if (result == EXTRACT_OK && !move_into_place(s->dir, s->tmp_dir))
+	{
+		result = EXTRACT_ERR_FAILED;
+	}
+	if (result != EXTRACT_OK && fsu_ptype(s->tmp_dir) == FSU_PATHTYPE_DIR)
+	{
+		fsu_rmdir_recursive(s->tmp_dir);
+	}
+
+	s->stats.usecs = sys_microseconds() - s->start;
+	LOG(
+	  "%s: %" PRIu64 " files, %" PRIu64 " bytes in %" PRIu64 " ms (streamed)",
+	  s->dir,
+	  s->stats.nfiles,
+	  s->stats.nbytes,
+	  s->stats.usecs / 1000);
+
+	s->callback(s->userdata, result, &s->stats);
+
+	struct extractor *ex = s->extractor;
+	for (size_t i = 0; i < s->nentries; ++i)
+	{
+		free(s->entries[i].name);
+	}
+	free(s->entries);
+	for (size_t i = 0; i < s->capdirs; ++i)
+	{
+		free(s->dirs[i].name);
+	}
+	free(s->dirs);
+	free(s->dict);
+	free(s->write_buffer_alloc);
+	free(s->in);
+	free(s->dir);
+	free(s->tmp_dir);
+	free(s->expected_md5);
+	free(s);
+
+	mtx_lock(&ex->mtx);
+	ex->nstreams -= 1;
+	cnd_broadcast(&ex->cnd);
+	mtx_unlock(&ex->mtx);
+	return 0;
+}
+
+
+bool
+extractor_submit_stream(
+  struct extractor *ex,
+  FILE *in_pipe,
+  char const *in_dir,
+  char const *in_md5,
+  struct extract_progress *io_progress,
+  extract_callback in_callback,
+  void *in_userdata)
+{
+	struct extract_stream *s = calloc(1, sizeof *s);
+	s->extractor = ex;
+	s->pipe = in_pipe;
+	s->dir = strdup(in_dir);
+	asprintf(&s->tmp_dir, "%s.tmp", in_dir);
+	s->callback = in_callback;
+	s->userdata = in_userdata;
+	s->progress = io_progress ? io_progress : &s->own_progress;
+	s->expected_md5 = in_md5 ? strdup(in_md5) : NULL;
+	md5_init(&s->md5);
+	s->start = sys_microseconds();
+	s->in_size = STREAM_READ_SIZE;
+	s->in = malloc(s->in_size);
+	s->capdirs = 64;
+	s->dirs = calloc(s->capdirs, sizeof *s->dirs);
+	s->dict = malloc(TINFL_LZ_DICT_SIZE);
+	s->write_buffer = alloc_write_buffer(&s->write_buffer_alloc);
+
+	mtx_lock(&ex->mtx);
+	ex->nstreams += 1;
+	mtx_unlock(&ex->mtx);
+
+	thrd_t thread;
+	if (thrd_success != thrd_create(&thread, stream_main, s))
+	{
+		LOGE("failed to create stream thread");
+		mtx_lock(&ex->mtx);
+		ex->nstreams -= 1;
+		mtx_unlock(&ex->mtx);
+		free(s->write_buffer_alloc);
+		free(s->dict);
+		free(s->dirs);
+		free(s->in);
+		free(s->dir);
+		free(s->tmp_dir);
+		free(s->expected_md5);
+		free(s);
+		return false;
+	}
+	thrd_detach(thread);
+	return true;
+}
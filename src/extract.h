@@ -0,0 +1,167 @@
+// vi: filetype=c
+#pragma once
+#ifndef MINIMOD_EXTRACT_H_INCLUDED
+#define MINIMOD_EXTRACT_H_INCLUDED
+
+/* Title: extract
+ *
+ * Topic: Introduction
+ *
+ * Extraction engine used by minimod to unpack downloaded ZIP archives.
+ *
+ * Archives on disk are extracted by a pool of worker threads, which share
+ * the entries of an archive among each other. Archives still being
+ * downloaded are extracted front to back as they arrive.
+ *
+ * Everything is extracted into a temporary directory first, which is then
+ * moved into place once all entries were written successfully. So the
+ * destination is either untouched or complete, never half-extracted.
+ */
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stdint.h>
+#include <stdio.h> // FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Section: API */
+
+struct extractor;
+
+/* Struct: extract_stats
+ *
+ * nfiles - Number of files extracted
+ * nbytes - Number of (uncompressed) bytes written
+ * nbytes_compressed - Number of compressed bytes read
+ * usecs - Microseconds from submitting the archive until it was in place
+ */
+struct extract_stats
+{
+	uint64_t nfiles;
+	uint64_t nbytes;
+	uint64_t nbytes_compressed;
+	uint64_t usecs;
+};
+
+/* Struct: extract_progress
+ *
+ * Progress of a single archive, updated atomically by the extractor while
+ * extracting it. It is owned by the submitter and needs to stay valid until
+ * the <extract_callback()> is invoked.
+ *
+ * nbytes_read - Number of bytes read from the pipe (streams only)
+ * nfiles - Number of files extracted so far
+ * nfiles_total - Number of files in the archive, 0 while unknown.
+ *	Streams only know it once their central directory is reached.
+ * is_cancelled - Set (atomically) by the submitter to stop the
+ *	extraction, which then fails with EXTRACT_ERR_CANCELLED.
+ */
+struct extract_progress
+{
+	uint64_t nbytes_read;
+	uint64_t nfiles;
+	uint64_t nfiles_total;
+	bool is_cancelled;
+	char _padding[7];
+};
+
+/* Enum: extract_result
+ *
+ * EXTRACT_OK - Everything was extracted and moved into place
+ * EXTRACT_ERR_FAILED - The archive is broken or writing a file failed
+ * EXTRACT_ERR_CHECKSUM - The MD5 digest of a stream does not match
+ * EXTRACT_ERR_CANCELLED - <extract_progress>.is_cancelled was set
+ */
+enum extract_result
+{
+	EXTRACT_OK = 0,
+	EXTRACT_ERR_FAILED,
+	EXTRACT_ERR_CHECKSUM,
+	EXTRACT_ERR_CANCELLED,
+};
+
+/* Callback: extract_callback()
+ *
+ * Called from one of the worker threads once an archive is extracted,
+ * or failed to.
+ */
+typedef void (*extract_callback)(
+  void *userdata,
+  enum extract_result result,
+  struct extract_stats const *stats);
+
+/* Function: extractor_create()
+ *
+ * Parameters:
+ *	in_nworkers - Number of worker threads, 0 uses one per CPU (up to 8).
+ */
+struct extractor *
+extractor_create(unsigned int in_nworkers);
+
+/* Function: extractor_destroy()
+ *
+ * Finish all submitted archives, then stop the workers and free all memory.
+ */
+void
+extractor_destroy(struct extractor *in_extractor);
+
+/* Function: extractor_submit()
+ *
+ * Queue *in_zip_path* for extraction into directory *in_dir*.
+ * Returns immediately.
+ *
+ * Parameters:
+ *	in_dir - Destination directory, without trailing '/'.
+ *		Any existing directory is replaced, once extraction succeeded.
+ *		*in_dir* ".tmp" is used as temporary directory.
+ *	io_progress - Zero-initialized <extract_progress> or NULL.
+ */
+void
+extractor_submit(
+  struct extractor *in_extractor,
+  char const *in_zip_path,
+  char const *in_dir,
+  struct extract_progress *io_progress,
+  extract_callback in_callback,
+  void *in_userdata);
+
+/* Function: extractor_submit_stream()
+ *
+ * Extract a ZIP archive while it is being written into *in_pipe*, i.e.
+ * while it is being downloaded. Entries are extracted in the order they
+ * arrive, as described by their local headers. Once the writer closes its
+ * end of the pipe, the central directory is verified against the
+ * extracted entries.
+ *
+ * Every stream is extracted by its own thread, which drains *in_pipe* to
+ * the end in any case, so the writer is never blocked indefinitely.
+ * *in_pipe* is closed by the extractor.
+ *
+ * Parameters:
+ *	in_dir - As with <extractor_submit()>.
+ *	in_md5 - Expected MD5 digest (hex) of the whole stream or NULL.
+ *		On mismatch nothing is moved into place.
+ *	io_progress - As with <extractor_submit()>.
+ *
+ * Returns:
+ *	false if the stream could not be started. *in_pipe* is not closed then.
+ */
+bool
+extractor_submit_stream(
+  struct extractor *in_extractor,
+  FILE *in_pipe,
+  char const *in_dir,
+  char const *in_md5,
+  struct extract_progress *io_progress,
+  extract_callback in_callback,
+  void *in_userdata);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -1,14 +1,13 @@
 #include "minimod/minimod.h"
 #undef minimod_init
 
+#include "archive.h"
+#include "cache.h"
+#include "extract.h"
+#include "modindex.h"
 #include "netw/netw.h"
 #include "util.h"
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpadded"
-#include "miniz/miniz.h"
-#pragma GCC diagnostic pop
-
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma GCC diagnostic ignored "-Wdocumentation"
@@ -17,7 +16,6 @@
 #pragma GCC diagnostic pop
 
 #include <ctype.h>
-#include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -67,6 +65,32 @@
 // CONFIG
 // ------
 #define DEFAULT_ROOT "_minimod"
+#define DEFAULT_MAX_DOWNLOADS 4
+#define DEFAULT_MAX_EXTRACTIONS 2
+#define DEFAULT_PROGRESS_INTERVAL_MS 250
+// granularity of the progress thread, bounds the delay of stopping it
+#define PROGRESS_TICK_MS 50
+// larger archives are downloaded to a file, which can be resumed, instead
+// of being streamed into the extractor
+#define RESUMABLE_MIN_BYTES (64 * 1024 * 1024)
+// first line of the sidecar of partial downloads, bump when changing it
+#define PART_FILE_MAGIC "minimod-part 1\n"
+#define DEFAULT_SYNC_MIN_INTERVAL_MS (60 * 1000)
+#define DEFAULT_SYNC_MAX_INTERVAL_MS (15 * 60 * 1000)
+#define DEFAULT_BATCH_SIZE 50
+// pacing of API requests until the server tells its actual limit
+#define DEFAULT_REQUESTS_PER_MINUTE 60
+#define DEFAULT_REQUEST_BURST 10
+#define DEFAULT_MAX_RETRIES 2
+#define DEFAULT_RETRY_BASE_DELAY_MS 250
+#define DEFAULT_RETRY_MAX_DELAY_MS 8000
+// each retry costs a token, each request which needed no retry earns
+// a fraction of one, so retries stay a fraction of all requests.
+#define RETRY_BUDGET_MAX 10.0
+#define RETRY_BUDGET_RATIO 0.1
+#define DEFAULT_MAX_CONNECTIONS 8
+// of the registry of handles, see register_control()
+#define NCONTROL_BUCKETS 64
 
 
 struct callback
@@ -90,51 +114,283 @@ struct callback
 };
 
 
-enum task_flag
+// The OAuth2 token of the user. It is replaced by the network thread
+// (token exchange, HTTP 401) while requests are built on any thread, so
+// it is immutable and reference-counted. See pin_auth().
+struct auth
+{
+	char *token;
+	// "Bearer <token>"
+	char *bearer;
+	// the allocation, which is aligned to AUTH_ALIGN
+	void *block;
+	// atomic
+	unsigned int refs;
+	char _padding[4];
+};
+
+
+// Snapshots are aligned to this, so the low bits of a pointer to one count
+// the readers which are pinning it. See pin_auth().
+#define AUTH_ALIGN 256
+#define AUTH_PINS_MASK ((uintptr_t)(AUTH_ALIGN - 1))
+
+
+// Requests handed out to the client are identified by a handle, which
+// can be used to cancel them or change their priority. See minimod_cancel().
+struct request_control
+{
+	// in its bucket of the registry
+	struct request_control *next;
+	// 0 if it was never registered
+	minimod_handle handle;
+	// atomic
+	enum minimod_priority priority;
+	// atomic
+	bool is_cancelled;
+	bool is_registered;
+	char _padding[2];
+};
+
+
+struct task;
+typedef void (*task_deliver_fn)(
+  struct task *task,
+  QAJ4C_Value const *document);
+
+
+// Idempotent requests keep a copy of themselves, to be sent again after
+// transient failures. See next_retry_delay().
+struct retry_state
 {
-	TASK_FLAG_AUTH_TOKEN = 1,
+	char *url;
+	// NULL-terminated, NULL if there are none
+	char **headers;
+	uint64_t start;
+	struct minimod_retry_policy policy;
+	uint32_t nretries;
+	char _padding[4];
 };
 
 
 struct task
 {
+	struct minimod_ctx *ctx;
 	struct callback callback;
+	// converts the response document into minimod-structs and calls
+	// the callback. document is NULL if the request failed.
+	task_deliver_fn deliver;
+	char *cache_key;
+	struct cache_entry *cache_entry;
 	uint64_t meta64;
 	int32_t meta32;
-	uint32_t flags;
+	// a page of minimod_paging, which knows whether it is the last one
+	bool is_paged;
+	bool is_last_page;
+	char _padding[2];
+	// pinned, if the request is authenticated by the user's token
+	struct auth *auth;
+	// identical requests in flight are only sent once, see submit_get()
+	char *flight_key;
+	struct task *next_flight;
+	struct task *next_waiter;
+	struct retry_state retry;
+	struct request_control control;
+	// of the request of a flight, which is wanted as long as one of its
+	// tasks is. See update_flights().
+	struct request_control flight_control;
+};
+
+
+// an installation of a mod, which is already being installed
+struct install_waiter
+{
+	minimod_install_callback callback;
+	void *userdata;
+	struct install_waiter *next;
+	struct request_control control;
 };
 
 
 struct install_request
 {
+	struct minimod_ctx *ctx;
 	minimod_install_callback callback;
 	void *userdata;
 	uint64_t game_id;
 	uint64_t mod_id;
+	// the requested modfile, the actual one once it is known
+	uint64_t modfile_id;
+	uint64_t filesize;
+	// bytes of a previous, partial download which are kept
+	uint64_t resume_offset;
+	char *md5;
+	// of the whole file and of the response only, which differ when
+	// resuming a download
+	struct md5 file_md5;
+	struct md5 response_md5;
 	char *zip_path;
+	// file the archive is downloaded to, before it is moved to zip_path
+	char *part_path;
 	FILE *file;
 	struct install_request *next;
-	int waiting;
-	char _padding[4];
+	// install queue or queue of extractions waiting for a slot
+	struct install_request *queue_next;
+	// installations joining this one, guarded by install_requests_mtx
+	struct install_waiter *waiters;
+	struct request_control control;
+	// of the modfile, kept to download it again after a failure
+	struct retry_state download_retry;
+	// meta-data of the mod, written once the installation succeeded
+	char *json;
+	size_t njson;
+	uint64_t date_updated;
+	struct extract_stats extract_stats;
+	struct extract_progress extract_progress;
+	// used by the progress thread only, guarded by install_requests_mtx
+	uint64_t download_start;
+	uint64_t last_report;
+	uint64_t last_nbytes;
+	uint64_t last_change;
+	// number of concurrent steps still running, see minimod_install()
+	int npending;
+	enum minimod_install_priority priority;
+	// atomic, progress is only reported while downloading or extracting
+	enum minimod_install_phase phase;
+	// atomic, the first error of any concurrent step
+	enum minimod_install_error error;
+	bool is_streaming;
+	// the download is hashed while it is written
+	bool is_hashing;
+	// atomic, the callback of stalled installations is invoked early
+	bool is_callback_invoked;
+	// guarded by install_requests_mtx
+	bool has_download_slot;
+	bool has_extraction_slot;
+	// no specific modfile was requested
+	bool is_latest;
+	// left the install queue, guarded by install_requests_mtx
+	bool is_started;
+	char _padding[1];
 };
 
 
-struct mmi
+struct minimod_ctx
 {
 	char *api_key;
 	char *root_path;
 	char *cache_tokenpath;
-	char *token;
-	char *token_bearer;
+	// atomic, the current struct auth and the number of readers which are
+	// pinning it, see pin_auth(). NULL while the user is not authenticated.
+	uintptr_t auth;
 	struct install_request *install_requests;
 	mtx_t install_requests_mtx;
+	// installed mods, so they do not need to be looked up on disk
+	struct modindex *installed;
+	// install queue, guarded by install_requests_mtx
+	struct install_request *install_queue;
+	struct install_request *extract_queue;
+	struct minimod_install_queue_stats install_queue_stats;
+	minimod_install_queue_callback install_queue_callback;
+	void *install_queue_userdata;
+	unsigned int max_downloads;
+	unsigned int max_extractions;
+	unsigned int nextraction_slots;
+	bool is_install_queue_closed;
+	char _padding_queue[3];
+	// progress reporting, guarded by install_requests_mtx
+	minimod_install_progress_callback install_progress_callback;
+	void *install_progress_userdata;
+	uint32_t progress_interval_ms;
+	uint32_t stall_timeout_ms;
+	thrd_t progress_thread;
+	bool has_progress_thread;
+	// atomic
+	bool is_progress_quitting;
+	char _padding_progress[6];
+	struct cache *cache;
+	struct extractor *extractor;
+	minimod_install_stats_callback install_stats_callback;
+	void *install_stats_userdata;
+	minimod_install_error_callback install_error_callback;
+	void *install_error_userdata;
+	// synced games, see minimod_start_sync()
+	mtx_t sync_mtx;
+	struct sync_game *sync_games;
+	uint32_t sync_min_interval_ms;
+	uint32_t sync_max_interval_ms;
+	// batched mod lookups, see minimod_set_batching()
+	mtx_t batch_mtx;
+	// signalled when a batch is opened or the thread quits
+	cnd_t batch_cnd;
+	struct mod_batch *batches;
+	uint32_t batch_window_ms;
+	uint32_t max_batch_size;
+	thrd_t batch_thread;
+	bool has_batch_thread;
+	// atomic
+	bool is_batch_quitting;
+	char _padding_batch[6];
+	// GET requests in flight, see submit_get()
+	mtx_t flights_mtx;
+	struct task *flights;
+	// request scheduler, see submit_request()
+	mtx_t sched_mtx;
+	// signalled whenever the scheduler thread may have more to do sooner
+	cnd_t sched_cnd;
+	struct scheduled_request *sched_queue;
+	double request_tokens;
+	uint64_t request_tokens_refilled;
+	uint32_t requests_per_minute;
+	uint32_t request_burst;
+	unsigned int max_connections;
+	unsigned int nconnections;
+	thrd_t sched_thread;
+	bool has_sched_thread;
+	// requests per minute were set by the client, not by the server
+	bool is_request_rate_fixed;
+	bool is_sched_closed;
+	// atomic
+	bool is_sched_quitting;
+	char _padding_sched[4];
+	// retries, guarded by sched_mtx as well
+	struct delayed_call *delayed_calls;
+	struct retry_override *retry_overrides;
+	struct minimod_retry_policy retry_policy;
+	double retry_budget;
+	minimod_request_stats_callback request_stats_callback;
+	void *request_stats_userdata;
+	// atomic, state of random_u64()
+	uint64_t random_state;
+	// registry of handles, see register_control()
+	mtx_t controls_mtx;
+	struct request_control *controls[NCONTROL_BUCKETS];
+	minimod_handle last_handle;
+	// handles of requests which are not finished, ascending. Guarded by
+	// controls_mtx as well, see finish_handle().
+	minimod_handle *busy_handles;
+	size_t nbusy_handles;
+	size_t max_busy_handles;
+	cnd_t handles_cnd;
+	// guarded by sched_mtx
 	time_t rate_limited_until;
 	int env;
+	// atomic, requests and downloads handed to netw, see send_netw_request()
+	unsigned int ninflight;
+	// callbacks waiting for minimod_poll(), see post_completion()
+	struct completion *completions;
+	struct completion *poll_queue;
+	// readable while there are completions, see minimod_get_completion_fd()
+	struct sys_event completion_event;
 	bool unzip;
 	bool is_apikey_invalid;
-	char _padding[2];
+	bool is_polled;
+	// atomic
+	bool is_polling;
+	char _padding_poll[4];
 };
-static struct mmi l_mmi;
+// the context of the functions without one, see minimod_init()
+static struct minimod_ctx *l_ctx;
 
 
 static char const *endpoints[2] = {
@@ -143,46 +399,431 @@ static char const *endpoints[2] = {
 };
 
 
+// COMPLETIONS
+// -----------
+// With MINIMOD_INITFLAG_POLL callbacks are not invoked by the thread which
+// finished a request, but queued for minimod_poll(). Responses are parsed
+// before they are queued, so only the conversion to minimod-structs and
+// the callback itself run on the polling thread.
+//
+// Any thread pushes onto a lock-free stack. The polling thread takes the
+// whole stack at once and reverses it into poll_queue, which only it
+// touches.
+//
+// completion_event is set by whoever pushes onto the empty stack, and
+// reset right before the stack is taken. So it is never reset while
+// anything is left on the stack, but may be set while nothing is.
+struct completion
+{
+	struct completion *next;
+	void (*fn)(void *in_userdata);
+	void *userdata;
+};
+
+
+// Calls in_fn right away, unless the context is polled.
+static void
+post_completion(
+  struct minimod_ctx *ctx,
+  void (*in_fn)(void *),
+  void *in_userdata)
+{
+	if (!ctx->is_polled)
+	{
+		in_fn(in_userdata);
+		return;
+	}
+
+	struct completion *c = malloc(sizeof *c);
+	c->fn = in_fn;
+	c->userdata = in_userdata;
+	c->next = __atomic_load_n(&ctx->completions, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(
+	  &ctx->completions,
+	  &c->next,
+	  c,
+	  true,
+	  __ATOMIC_RELEASE,
+	  __ATOMIC_RELAXED))
+	{
+	}
+	if (!c->next)
+	{
+		sys_event_set(&ctx->completion_event);
+	}
+}
+
+
+// Needs to be called by the polling thread.
+static struct completion *
+take_completion(struct minimod_ctx *ctx)
+{
+	if (!ctx->poll_queue)
+	{
+		sys_event_reset(&ctx->completion_event);
+		struct completion *c =
+		  __atomic_exchange_n(&ctx->completions, NULL, __ATOMIC_ACQUIRE);
+		// newest first, so reversing it restores the order of posting
+		while (c)
+		{
+			struct completion *next = c->next;
+			c->next = ctx->poll_queue;
+			ctx->poll_queue = c;
+			c = next;
+		}
+	}
+
+	struct completion *c = ctx->poll_queue;
+	if (c)
+	{
+		ctx->poll_queue = c->next;
+	}
+	return c;
+}
+
+
+// HANDLES
+// -------
+// The registry only maps handles to the request_control of requests.
+// Cancelling and changing the priority merely set its fields, which are
+// checked by the request itself, so no other lock is taken while
+// controls_mtx is locked.
+//
+// A handle is busy from its registration until its callback returned (or
+// it was cancelled), which is what minimod_wait() waits for. This outlasts
+// the registration, and even the request itself, when the callback is
+// queued for minimod_poll().
+static minimod_handle
+register_control(struct minimod_ctx *ctx, struct request_control *c)
+{
+	mtx_lock(&ctx->controls_mtx);
+	c->handle = ++ctx->last_handle;
+	c->is_registered = true;
+	struct request_control **bucket =
+	  &ctx->controls[c->handle % NCONTROL_BUCKETS];
+	c->next = *bucket;
+	*bucket = c;
+	// handles are ascending, so appending keeps them sorted
+	if (ctx->nbusy_handles == ctx->max_busy_handles)
+	{
+		ctx->max_busy_handles =
+		  ctx->max_busy_handles > 0 ? ctx->max_busy_handles * 2 : 64;
+		ctx->busy_handles = realloc(
+		  ctx->busy_handles,
+		  ctx->max_busy_handles * sizeof *ctx->busy_handles);
+	}
+	ctx->busy_handles[ctx->nbusy_handles++] = c->handle;
+	minimod_handle const handle = c->handle;
+	mtx_unlock(&ctx->controls_mtx);
+	return handle;
+}
+
+
+// Needs to be called with controls_mtx locked.
+//
+// Returns:
+//	The index of *in_handle* in busy_handles, nbusy_handles if it is not
+//	busy.
+static size_t
+find_busy_handle(struct minimod_ctx *ctx, minimod_handle in_handle)
+{
+	size_t lo = 0;
+	size_t hi = ctx->nbusy_handles;
+	while (lo < hi)
+	{
+		size_t const mid = lo + (hi - lo) / 2;
+		if (ctx->busy_handles[mid] < in_handle)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo < ctx->nbusy_handles && ctx->busy_handles[lo] == in_handle
+	  ? lo
+	  : ctx->nbusy_handles;
+}
+
+
+// Needs to be called with controls_mtx locked.
+static void
+remove_busy_handle(struct minimod_ctx *ctx, minimod_handle in_handle)
+{
+	size_t const i = find_busy_handle(ctx, in_handle);
+	if (i < ctx->nbusy_handles)
+	{
+		ctx->nbusy_handles -= 1;
+		memmove(
+		  &ctx->busy_handles[i],
+		  &ctx->busy_handles[i + 1],
+		  (ctx->nbusy_handles - i) * sizeof *ctx->busy_handles);
+		cnd_broadcast(&ctx->handles_cnd);
+	}
+}
+
+
+// To be called once the callback of a request returned, or it is clear
+// that it is not going to be invoked. Finishing a handle twice, or handle
+// 0, is fine.
+static void
+finish_handle(struct minimod_ctx *ctx, minimod_handle in_handle)
+{
+	if (in_handle == 0)
+	{
+		return;
+	}
+	mtx_lock(&ctx->controls_mtx);
+	remove_busy_handle(ctx, in_handle);
+	mtx_unlock(&ctx->controls_mtx);
+}
+
+
+// Once unregistered, a request cannot be cancelled anymore, so its
+// callback is invoked, if this returns false.
+//
+// Returns:
+//	Whether the request was cancelled.
+static bool
+unregister_control(struct minimod_ctx *ctx, struct request_control *c)
+{
+	mtx_lock(&ctx->controls_mtx);
+	if (c->is_registered)
+	{
+		struct request_control **it =
+		  &ctx->controls[c->handle % NCONTROL_BUCKETS];
+		while (*it != c)
+		{
+			it = &(*it)->next;
+		}
+		*it = c->next;
+		c->next = NULL;
+		c->is_registered = false;
+	}
+	bool const is_cancelled = c->is_cancelled;
+	mtx_unlock(&ctx->controls_mtx);
+	return is_cancelled;
+}
+
+
+// Needs to be called with controls_mtx locked.
+static struct request_control *
+find_control(struct minimod_ctx *ctx, minimod_handle in_handle)
+{
+	struct request_control *c = ctx->controls[in_handle % NCONTROL_BUCKETS];
+	while (c && c->handle != in_handle)
+	{
+		c = c->next;
+	}
+	return c;
+}
+
+
+static bool
+is_control_cancelled(struct request_control const *c)
+{
+	return __atomic_load_n(&c->is_cancelled, __ATOMIC_ACQUIRE);
+}
+
+
+static enum minimod_priority
+get_control_priority(struct request_control const *c)
+{
+	return __atomic_load_n(&c->priority, __ATOMIC_ACQUIRE);
+}
+
+
+static void
+free_retry(struct retry_state *r);
+static void
+release_auth(struct auth *auth);
+
+
 static struct task *
-alloc_task(void)
+alloc_task(struct minimod_ctx *ctx)
 {
-	return calloc(1, sizeof(struct task));
+	struct task *task = calloc(1, sizeof(struct task));
+	task->ctx = ctx;
+	return task;
 }
 
 
 static void
 free_task(struct task *task)
 {
+	struct minimod_ctx *ctx = task->ctx;
+	if (task->cache_entry)
+	{
+		cache_release(ctx->cache, task->cache_entry);
+	}
+	unregister_control(ctx, &task->control);
+	finish_handle(ctx, task->control.handle);
+	free(task->cache_key);
+	free(task->flight_key);
+	free_retry(&task->retry);
+	release_auth(task->auth);
 	free(task);
 }
 
 
+// outcome of an installation, see post_completion()
+struct install_result
+{
+	struct minimod_ctx *ctx;
+	minimod_install_callback callback;
+	void *userdata;
+	// of the installation, finished once its callback returned
+	minimod_handle handle;
+	struct install_waiter *waiters;
+	uint64_t game_id;
+	uint64_t mod_id;
+	enum minimod_install_error error;
+	char _padding[4];
+};
+
+
+static struct install_result *
+alloc_install_result(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_install_error in_error)
+{
+	struct install_result *r = calloc(1, sizeof *r);
+	r->ctx = ctx;
+	r->game_id = in_game_id;
+	r->mod_id = in_mod_id;
+	r->error = in_error;
+	return r;
+}
+
+
+static void
+run_install_callback(void *in_result)
+{
+	struct install_result *r = in_result;
+	struct minimod_ctx *ctx = r->ctx;
+	if (r->error && ctx->install_error_callback)
+	{
+		ctx->install_error_callback(
+		  ctx->install_error_userdata,
+		  r->game_id,
+		  r->mod_id,
+		  r->error);
+	}
+	if (r->callback)
+	{
+		r->callback(r->userdata, !r->error, r->game_id, r->mod_id);
+	}
+	finish_handle(ctx, r->handle);
+	free(r);
+}
+
+
+// Installations may be reported before they are finished, so this takes
+// no install_request.
+static void
+invoke_install_callback(
+  struct minimod_ctx *ctx,
+  minimod_handle in_handle,
+  minimod_install_callback in_callback,
+  void *in_userdata,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_install_error in_error)
+{
+	struct install_result *r =
+	  alloc_install_result(ctx, in_game_id, in_mod_id, in_error);
+	r->handle = in_handle;
+	r->callback = in_callback;
+	r->userdata = in_userdata;
+	post_completion(ctx, run_install_callback, r);
+}
+
+
+// Waiters are unregistered only now, so they can still be cancelled while
+// their completion is queued.
+static void
+run_install_waiters(void *in_result)
+{
+	struct install_result *r = in_result;
+	while (r->waiters)
+	{
+		struct install_waiter *w = r->waiters;
+		r->waiters = w->next;
+		bool const is_cancelled = unregister_control(r->ctx, &w->control);
+		if (w->callback && !is_cancelled)
+		{
+			w->callback(w->userdata, !r->error, r->game_id, r->mod_id);
+		}
+		finish_handle(r->ctx, w->control.handle);
+		free(w);
+	}
+	free(r);
+}
+
+
+// The error is reported once, by the installation they joined.
+static void
+invoke_install_waiters(
+  struct minimod_ctx *ctx,
+  struct install_waiter *in_waiters,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_install_error in_error)
+{
+	if (!in_waiters)
+	{
+		return;
+	}
+	struct install_result *r =
+	  alloc_install_result(ctx, in_game_id, in_mod_id, in_error);
+	r->waiters = in_waiters;
+	post_completion(ctx, run_install_waiters, r);
+}
+
+
 static struct install_request *
-alloc_install_request(void)
+alloc_install_request(struct minimod_ctx *ctx)
 {
 	struct install_request *r = calloc(1, sizeof(struct install_request));
-	mtx_lock(&l_mmi.install_requests_mtx);
-	r->next = l_mmi.install_requests;
-	l_mmi.install_requests = r;
-	mtx_unlock(&l_mmi.install_requests_mtx);
+	r->ctx = ctx;
+	mtx_lock(&ctx->install_requests_mtx);
+	r->next = ctx->install_requests;
+	ctx->install_requests = r;
+	mtx_unlock(&ctx->install_requests_mtx);
 	return r;
 }
 
 
+// defined below, as it starts installations which release their slots
+static void
+pump_install_queue(struct minimod_ctx *ctx);
+
+
 static void
 free_install_request(struct install_request *req)
 {
-	mtx_lock(&l_mmi.install_requests_mtx);
+	struct minimod_ctx *ctx = req->ctx;
+	unregister_control(ctx, &req->control);
+	mtx_lock(&ctx->install_requests_mtx);
+	// other installations of the mod may be waiting for this one
+	bool const is_started = req->is_started;
 	// check if head is req
-	if (l_mmi.install_requests == req)
+	if (ctx->install_requests == req)
 	{
-		l_mmi.install_requests = l_mmi.install_requests->next;
+		ctx->install_requests = ctx->install_requests->next;
+		free_retry(&req->download_retry);
 		free(req->zip_path);
+		free(req->part_path);
+		free(req->md5);
+		free(req->json);
 		free(req);
 	}
 	else
 	{
-		struct install_request *r = l_mmi.install_requests;
+		struct install_request *r = ctx->install_requests;
 		while (r->next)
 		{
 			if (r->next == req)
@@ -190,45 +831,196 @@ free_install_request(struct install_request *req)
 				// remove from list
 				r->next = r->next->next;
 				// free it
+				free_retry(&req->download_retry);
 				free(req->zip_path);
+				free(req->part_path);
+				free(req->md5);
+				free(req->json);
 				free(req);
 				break;
 			}
 			r = r->next;
 		}
 	}
-	mtx_unlock(&l_mmi.install_requests_mtx);
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	if (is_started)
+	{
+		pump_install_queue(ctx);
+	}
 }
 
 
 static char *
-get_tokenpath(void)
+get_tokenpath(struct minimod_ctx *ctx)
+{
+	ASSERT(ctx->root_path);
+
+	if (!ctx->cache_tokenpath)
+	{
+		asprintf(&ctx->cache_tokenpath, "%s/token", ctx->root_path);
+	}
+
+	return ctx->cache_tokenpath;
+}
+
+
+static struct auth *
+create_auth(char const *in_token, size_t in_bytes)
+{
+	void *block = calloc(1, sizeof(struct auth) + AUTH_ALIGN);
+	struct auth *auth = (struct auth *)(
+	  ((uintptr_t)block + AUTH_PINS_MASK) & ~AUTH_PINS_MASK);
+	auth->block = block;
+	auth->token = malloc(in_bytes + 1);
+	memcpy(auth->token, in_token, in_bytes);
+	auth->token[in_bytes] = '\0';
+	asprintf(&auth->bearer, "Bearer %s", auth->token);
+	auth->refs = 1;
+	return auth;
+}
+
+
+static void
+release_auth(struct auth *auth)
+{
+	if (auth && 0 == __atomic_sub_fetch(&auth->refs, 1, __ATOMIC_ACQ_REL))
+	{
+		free(auth->token);
+		free(auth->bearer);
+		free(auth->block);
+	}
+}
+
+
+// Readers never lock and writers never wait (a split reference count).
+// A reader counts itself in the low bits of ctx->auth while it takes a
+// reference of its own. A writer swapping out the snapshot credits the
+// readers counted so far to the snapshot instead, so those which can not
+// uncount themselves anymore release that credit.
+//
+// Returns:
+//	The current snapshot, which needs to be passed to release_auth(),
+//	or NULL if the user is not authenticated.
+static struct auth *
+pin_auth(struct minimod_ctx *ctx)
 {
-	ASSERT(l_mmi.root_path);
+	uintptr_t pinned = __atomic_load_n(&ctx->auth, __ATOMIC_ACQUIRE);
+	for (;;)
+	{
+		if ((pinned & ~AUTH_PINS_MASK) == 0)
+		{
+			return NULL;
+		}
+		// all pins are taken, which only lasts a few instructions
+		if ((pinned & AUTH_PINS_MASK) == AUTH_PINS_MASK)
+		{
+			pinned = __atomic_load_n(&ctx->auth, __ATOMIC_ACQUIRE);
+			continue;
+		}
+		if (__atomic_compare_exchange_n(
+		      &ctx->auth,
+		      &pinned,
+		      pinned + 1,
+		      true,
+		      __ATOMIC_ACQ_REL,
+		      __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+	}
 
-	if (!l_mmi.cache_tokenpath)
+	struct auth *auth = (struct auth *)(pinned & ~AUTH_PINS_MASK);
+	__atomic_add_fetch(&auth->refs, 1, __ATOMIC_RELAXED);
+
+	uintptr_t current = pinned + 1;
+	for (;;)
+	{
+		if ((current & ~AUTH_PINS_MASK) != (uintptr_t)auth)
+		{
+			// swapped out, the writer credited the pin to the snapshot
+			release_auth(auth);
+			break;
+		}
+		if (__atomic_compare_exchange_n(
+		      &ctx->auth,
+		      &current,
+		      current - 1,
+		      true,
+		      __ATOMIC_ACQ_REL,
+		      __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+	}
+	return auth;
+}
+
+
+// Drops the reference of the context to a snapshot swapped out of it,
+// after crediting the readers still pinning it. It is freed once the last
+// request built with it is done.
+static void
+retire_auth(uintptr_t in_pinned)
+{
+	struct auth *auth = (struct auth *)(in_pinned & ~AUTH_PINS_MASK);
+	if (auth)
 	{
-		asprintf(&l_mmi.cache_tokenpath, "%s/token", l_mmi.root_path);
+		__atomic_add_fetch(
+		  &auth->refs,
+		  (unsigned int)(in_pinned & AUTH_PINS_MASK),
+		  __ATOMIC_ACQ_REL);
+		release_auth(auth);
 	}
+}
+
 
-	return l_mmi.cache_tokenpath;
+static void
+swap_auth(struct minimod_ctx *ctx, struct auth *in_auth)
+{
+	retire_auth(
+	  __atomic_exchange_n(&ctx->auth, (uintptr_t)in_auth, __ATOMIC_ACQ_REL));
+}
+
+
+// Only the token a request was sent with is invalidated by its response,
+// not one which replaced it in the meantime.
+static void
+deauthenticate(struct minimod_ctx *ctx, struct auth *in_auth)
+{
+	uintptr_t pinned = __atomic_load_n(&ctx->auth, __ATOMIC_ACQUIRE);
+	// only pins change, as long as the snapshot is the same
+	while ((pinned & ~AUTH_PINS_MASK) == (uintptr_t)in_auth)
+	{
+		if (__atomic_compare_exchange_n(
+		      &ctx->auth,
+		      &pinned,
+		      0,
+		      true,
+		      __ATOMIC_ACQ_REL,
+		      __ATOMIC_ACQUIRE))
+		{
+			fsu_rmfile(get_tokenpath(ctx));
+			retire_auth(pinned);
+			break;
+		}
+	}
 }
 
 
 static bool
-read_token(void)
+read_token(struct minimod_ctx *ctx)
 {
-	int64_t fsize = fsu_fsize(get_tokenpath());
+	int64_t fsize = fsu_fsize(get_tokenpath(ctx));
 	if (fsize > 0)
 	{
-		// read file into l_mmi.token (does null-terminate it)
-		FILE *f = fsu_fopen(get_tokenpath(), "rb");
+		FILE *f = fsu_fopen(get_tokenpath(ctx), "rb");
 		ASSERT(f);
-		l_mmi.token = malloc((size_t)(fsize + 1));
-		fread(l_mmi.token, (size_t)fsize, 1, f);
-		l_mmi.token[fsize] = '\0';
+		char *token = malloc((size_t)fsize);
+		fread(token, (size_t)fsize, 1, f);
 		fclose(f);
-		asprintf(&l_mmi.token_bearer, "Bearer %s", l_mmi.token);
+		swap_auth(ctx, create_auth(token, (size_t)fsize));
+		free(token);
 		return true;
 	}
 	return false;
@@ -418,1044 +1210,7681 @@ populate_rating(struct minimod_rating *rating, QAJ4C_Value const *node)
 
 
 static void
-populate_pagination(struct minimod_pagination *pagi, QAJ4C_Value const *node)
+populate_pagination(
+  struct minimod_pagination *pagi,
+  struct task const *in_task,
+  QAJ4C_Value const *node)
 {
+	*pagi = (struct minimod_pagination){ 0 };
 	pagi->offset = QAJ4C_get_uint64(QAJ4C_object_get(node, "result_offset"));
 	pagi->limit = QAJ4C_get_uint64(QAJ4C_object_get(node, "result_limit"));
 	pagi->total = QAJ4C_get_uint64(QAJ4C_object_get(node, "result_total"));
+	pagi->is_last = in_task && in_task->is_paged
+	  ? in_task->is_last_page
+	  : pagi->offset + pagi->limit >= pagi->total;
 }
 
 
+// NETW
+// ----
+// netw is process-wide, but shared by all contexts. So it is initialized
+// by the first context and deinitialized by the last one, and each
+// context counts its requests in flight to wait for them, before it is
+// destroyed.
+//
+// There is no context to hold a mutex for the users of netw, thus they
+// are guarded by a spin lock.
+static bool l_netw_lock;
+static unsigned int l_netw_users;
+
+
+struct netw_call
+{
+	struct minimod_ctx *ctx;
+	union
+	{
+		netw_request_callback request;
+		netw_download_callback download;
+	} callback;
+	void *userdata;
+};
+
+
 static void
-handle_generic_errors(
-  int error,
-  struct netw_header const *header,
-  bool is_token_auth)
+lock_netw(void)
 {
-	if (error == 429) // too many requests
+	while (__atomic_test_and_set(&l_netw_lock, __ATOMIC_ACQUIRE))
 	{
-		char const *retry_after = netw_get_header(header, "Retry-After");
-		long retry_after_l = strtol(retry_after, NULL, 10);
-		LOG("Retry-After: %li seconds", retry_after_l);
-		l_mmi.rate_limited_until = sys_seconds() + retry_after_l;
-	}
-	if (error == 401)
-	{
-		if (is_token_auth)
-		{
-			LOG("Received HTTP Status 401 -> OAUTH2 Token Invalid");
-			minimod_deauthenticate();
-		}
-		else
-		{
-			LOG("Received HTTP Status 401 -> API Key Invalid");
-			l_mmi.is_apikey_invalid = true;
-		}
+		sys_sleep(1);
 	}
 }
 
 
-static void
-handle_get_games(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+static bool
+acquire_netw(void)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	lock_netw();
+	bool const ok = l_netw_users > 0 || netw_init();
+	if (ok)
 	{
-		task->callback.fptr.get_games(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
+		l_netw_users += 1;
 	}
+	__atomic_clear(&l_netw_lock, __ATOMIC_RELEASE);
+	return ok;
+}
 
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_Value const *document = NULL;
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
 
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	if (data)
+static void
+release_netw(void)
+{
+	lock_netw();
+	ASSERT(l_netw_users > 0);
+	l_netw_users -= 1;
+	if (l_netw_users == 0)
 	{
-		ASSERT(QAJ4C_is_array(data));
-
-		size_t ngames = QAJ4C_array_size(data);
-		struct minimod_game *games = calloc(sizeof *games, ngames);
-
-		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
-		{
-			populate_game(&games[i], QAJ4C_array_get(data, i));
-		}
+		netw_deinit();
+	}
+	__atomic_clear(&l_netw_lock, __ATOMIC_RELEASE);
+}
 
-		struct minimod_pagination pagi;
-		populate_pagination(&pagi, document);
 
-		task->callback.fptr
-		  .get_games(task->callback.userdata, ngames, games, &pagi);
+static struct netw_call *
+begin_netw_call(struct minimod_ctx *ctx, void *in_userdata)
+{
+	struct netw_call *call = malloc(sizeof *call);
+	call->ctx = ctx;
+	call->userdata = in_userdata;
+	__atomic_add_fetch(&ctx->ninflight, 1, __ATOMIC_ACQ_REL);
+	return call;
+}
 
-		free(games);
-	}
 
-	free_task(task);
-	free(buffer);
+// The context may be destroyed as soon as this returns.
+static void
+end_netw_call(struct netw_call *call)
+{
+	struct minimod_ctx *ctx = call->ctx;
+	free(call);
+	__atomic_sub_fetch(&ctx->ninflight, 1, __ATOMIC_ACQ_REL);
 }
 
 
 static void
-handle_get_mods(
-  void *in_udata,
+on_netw_request(
+  void *in_call,
   void const *in_data,
   size_t in_len,
   int error,
   struct netw_header const *header)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
-	{
-		task->callback.fptr.get_mods(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
-	}
-
-	// parse data
-	QAJ4C_Value const *document = NULL;
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
+	struct netw_call *call = in_call;
+	call->callback.request(call->userdata, in_data, in_len, error, header);
+	end_netw_call(call);
+}
 
-	// single item or array of items?
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	if (data)
-	{
-		ASSERT(QAJ4C_is_array(data));
 
-		size_t nmods = QAJ4C_array_size(data);
-		struct minimod_mod *mods = calloc(sizeof *mods, nmods);
+static void
+on_netw_download(
+  void *in_call,
+  FILE *in_file,
+  int error,
+  struct netw_header const *header)
+{
+	struct netw_call *call = in_call;
+	call->callback.download(call->userdata, in_file, error, header);
+	end_netw_call(call);
+}
 
-		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
-		{
-			populate_mod(&mods[i], QAJ4C_array_get(data, i));
-		}
 
-		struct minimod_pagination pagi;
-		populate_pagination(&pagi, document);
+// Same as netw_request(), but counted as in flight for ctx.
+static bool
+send_netw_request(
+  struct minimod_ctx *ctx,
+  enum netw_verb in_verb,
+  char const *in_uri,
+  char const *const in_headers[],
+  void const *in_body,
+  size_t in_nbody,
+  netw_request_callback in_callback,
+  void *in_userdata)
+{
+	struct netw_call *call = begin_netw_call(ctx, in_userdata);
+	call->callback.request = in_callback;
+	bool const ok = netw_request(
+	  in_verb,
+	  in_uri,
+	  in_headers,
+	  in_body,
+	  in_nbody,
+	  on_netw_request,
+	  call);
+	if (!ok)
+	{
+		end_netw_call(call);
+	}
+	return ok;
+}
 
-		task->callback.fptr
-		  .get_mods(task->callback.userdata, nmods, mods, &pagi);
 
-		free(mods);
-	}
-	else
+// Same as netw_download_to(), but counted as in flight for ctx.
+static bool
+send_netw_download(
+  struct minimod_ctx *ctx,
+  char const *in_uri,
+  char const *const in_headers[],
+  FILE *in_file,
+  netw_download_callback in_callback,
+  void *in_userdata)
+{
+	struct netw_call *call = begin_netw_call(ctx, in_userdata);
+	call->callback.download = in_callback;
+	bool const ok = netw_download_to(
+	  NETW_VERB_GET,
+	  in_uri,
+	  in_headers,
+	  NULL,
+	  0,
+	  in_file,
+	  on_netw_download,
+	  call);
+	if (!ok)
 	{
-		struct minimod_mod mod = { 0 };
-		populate_mod(&mod, document);
-		task->callback.fptr.get_mods(task->callback.userdata, 1, &mod, NULL);
+		end_netw_call(call);
 	}
-	free_task(task);
-	free(buffer);
+	return ok;
 }
 
 
+// Waits for the responses to all requests of ctx in flight.
 static void
-handle_get_users(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+drain_netw_calls(struct minimod_ctx *ctx)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	while (__atomic_load_n(&ctx->ninflight, __ATOMIC_ACQUIRE) > 0)
 	{
-		task->callback.fptr.get_mods(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
+		sys_sleep(10);
 	}
+}
 
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_Value const *document = NULL;
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
 
-	// check for 'data' to see if it is a 'single' or 'multi' data object
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	if (data)
-	{
-		ASSERT(QAJ4C_is_array(data));
+// SCHEDULER
+// ---------
+// All API requests go through submit_request(). They are paced by a token
+// bucket, which is adapted to the X-RateLimit-* headers of the responses,
+// and held back while the API is rate limiting, instead of failing.
+// At most max_connections are in flight, the others wait by priority.
+struct scheduled_request
+{
+	struct minimod_ctx *ctx;
+	struct scheduled_request *next;
+	char *path;
+	// NULL-terminated
+	char **headers;
+	void *body;
+	size_t nbody;
+	netw_request_callback callback;
+	void *userdata;
+	// NULL for requests without a handle
+	struct request_control const *control;
+	enum netw_verb verb;
+	// dropped from the queue, instead of being sent
+	bool is_dropped;
+	char _padding[3];
+};
 
-		size_t nusers = QAJ4C_array_size(data);
-		struct minimod_user *users = calloc(sizeof *users, nusers);
 
-		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
-		{
-			populate_user(&users[i], QAJ4C_array_get(data, i));
-		}
+struct delayed_call
+{
+	struct delayed_call *next;
+	uint64_t due;
+	void (*fn)(void *in_userdata);
+	void *userdata;
+};
 
-		struct minimod_pagination pagi;
-		populate_pagination(&pagi, document);
 
-		task->callback.fptr
-		  .get_users(task->callback.userdata, nusers, users, &pagi);
+struct retry_override
+{
+	struct retry_override *next;
+	char *endpoint;
+	struct minimod_retry_policy policy;
+};
 
-		free(users);
+
+static char **
+copy_headers(char const *const *in_headers)
+{
+	size_t nheaders = 0;
+	while (in_headers && in_headers[nheaders])
+	{
+		++nheaders;
 	}
-	// single user
-	else
+	char **headers = calloc(nheaders + 1, sizeof *headers);
+	for (size_t i = 0; i < nheaders; ++i)
 	{
-		struct minimod_user user;
-		populate_user(&user, document);
-		task->callback.fptr.get_users(task->callback.userdata, 1, &user, NULL);
+		headers[i] = strdup(in_headers[i]);
 	}
-	free_task(task);
-	free(buffer);
+	return headers;
 }
 
 
 static void
-handle_get_modfiles(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+free_headers(char **in_headers)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	for (char **h = in_headers; h && *h; ++h)
 	{
-		task->callback.fptr
-		  .get_modfiles(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
+		free(*h);
 	}
+	free(in_headers);
+}
 
-	// parse data
-	QAJ4C_Value const *document = NULL;
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
 
-	// single item or array of items?
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	if (data)
+// Needs to be called with sched_mtx locked.
+static bool
+take_request_token(struct minimod_ctx *ctx)
+{
+	uint64_t const now = sys_microseconds();
+	double const refill = (double)(now - ctx->request_tokens_refilled)
+	  * ctx->requests_per_minute / (60 * 1000000.0);
+	ctx->request_tokens_refilled = now;
+	ctx->request_tokens += refill;
+	if (ctx->request_tokens > ctx->request_burst)
 	{
-		ASSERT(QAJ4C_is_array(data));
+		ctx->request_tokens = ctx->request_burst;
+	}
 
-		size_t nmodfiles = QAJ4C_array_size(data);
-		struct minimod_modfile *modfiles = calloc(sizeof *modfiles, nmodfiles);
+	if (sys_seconds() < ctx->rate_limited_until || ctx->request_tokens < 1)
+	{
+		return false;
+	}
+	ctx->request_tokens -= 1;
+	return true;
+}
 
-		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
-		{
-			populate_modfile(&modfiles[i], QAJ4C_array_get(data, i));
-		}
 
-		struct minimod_pagination pagi;
-		populate_pagination(&pagi, document);
+static void
+free_scheduled_request(struct scheduled_request *r)
+{
+	free_headers(r->headers);
+	free(r->path);
+	free(r->body);
+	free(r);
+}
 
-		task->callback.fptr
-		  .get_modfiles(task->callback.userdata, nmodfiles, modfiles, &pagi);
 
-		free(modfiles);
-	}
-	else
+// Removes and returns the calls due at *in_now*, in no particular order.
+static struct delayed_call *
+take_delayed_calls(struct minimod_ctx *ctx, uint64_t in_now)
+{
+	struct delayed_call *due = NULL;
+	mtx_lock(&ctx->sched_mtx);
+	struct delayed_call **it = &ctx->delayed_calls;
+	while (*it)
 	{
-		struct minimod_modfile modfile;
-		populate_modfile(&modfile, document);
-		task->callback.fptr
-		  .get_modfiles(task->callback.userdata, 1, &modfile, NULL);
+		struct delayed_call *c = *it;
+		if (c->due <= in_now)
+		{
+			*it = c->next;
+			c->next = due;
+			due = c;
+		}
+		else
+		{
+			it = &c->next;
+		}
 	}
-	free_task(task);
-	free(buffer);
+	mtx_unlock(&ctx->sched_mtx);
+	return due;
 }
 
 
 static void
-handle_get_events(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+run_delayed_calls(struct delayed_call *in_calls)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	while (in_calls)
 	{
-		task->callback.fptr.get_events(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
+		struct delayed_call *next = in_calls->next;
+		in_calls->fn(in_calls->userdata);
+		free(in_calls);
+		in_calls = next;
 	}
+}
 
-	// parse data
-	QAJ4C_Value const *document = NULL;
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
 
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	ASSERT(QAJ4C_is_array(data));
+static void
+start_sched_thread(struct minimod_ctx *ctx);
 
-	size_t nevents = QAJ4C_array_size(data);
-	struct minimod_event *events = calloc(sizeof *events, nevents);
 
-	for (size_t i = 0; i < nevents; ++i)
+// Calls *in_fn* on the scheduler thread after *in_delay_ms*.
+static void
+call_later(
+  struct minimod_ctx *ctx,
+  uint32_t in_delay_ms,
+  void (*in_fn)(void *),
+  void *in_userdata)
+{
+	mtx_lock(&ctx->sched_mtx);
+	bool const is_closed = ctx->is_sched_closed;
+	if (!is_closed)
 	{
-		populate_event(&events[i], QAJ4C_array_get(data, i));
+		struct delayed_call *c = malloc(sizeof *c);
+		c->due = sys_microseconds() + in_delay_ms * 1000ull;
+		c->fn = in_fn;
+		c->userdata = in_userdata;
+		c->next = ctx->delayed_calls;
+		ctx->delayed_calls = c;
+		start_sched_thread(ctx);
+		cnd_signal(&ctx->sched_cnd);
 	}
+	mtx_unlock(&ctx->sched_mtx);
 
-	struct minimod_pagination pagi;
-	populate_pagination(&pagi, document);
-
-	task->callback.fptr
-	  .get_events(task->callback.userdata, nevents, events, &pagi);
+	// there is no one left to wait
+	if (is_closed)
+	{
+		in_fn(in_userdata);
+	}
+}
 
-	free(events);
 
-	free_task(task);
-	free(buffer);
+static void
+fail_scheduled_request(void *in_request)
+{
+	struct scheduled_request *r = in_request;
+	r->callback(r->userdata, NULL, 0, 0, NULL);
+	free_scheduled_request(r);
 }
 
 
 static void
-handle_get_dependencies(
-  void *in_udata,
+pump_scheduler(struct minimod_ctx *ctx);
+
+
+static void
+on_scheduled_response(
+  void *in_request,
   void const *in_data,
   size_t in_len,
   int error,
   struct netw_header const *header)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
-	{
-		task->callback.fptr
-		  .get_dependencies(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
-	}
-
-	// parse data
-	QAJ4C_Value const *document = NULL;
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
+	struct scheduled_request *r = in_request;
+	struct minimod_ctx *ctx = r->ctx;
+	mtx_lock(&ctx->sched_mtx);
+	ctx->nconnections -= 1;
+	cnd_signal(&ctx->sched_cnd);
+	mtx_unlock(&ctx->sched_mtx);
+
+	r->callback(r->userdata, in_data, in_len, error, header);
+	free_scheduled_request(r);
+	pump_scheduler(ctx);
+}
 
-	// single item or array of items?
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	ASSERT(QAJ4C_is_array(data));
 
-	size_t ndeps = QAJ4C_array_size(data);
-	uint64_t *deps = calloc(sizeof *deps, ndeps);
-
-	for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
-	{
-		deps[i] = QAJ4C_get_uint64(QAJ4C_array_get(data, i));
-	}
-
-	struct minimod_pagination pagi;
-	populate_pagination(&pagi, document);
-
-	task->callback.fptr
-	  .get_dependencies(task->callback.userdata, ndeps, deps, &pagi);
-
-	free(deps);
-
-	free_task(task);
-	free(buffer);
+static bool
+is_request_dropped(struct scheduled_request const *r)
+{
+	return r->control && is_control_cancelled(r->control);
 }
 
 
-static void
-handle_email_request(
-  void *in_udata,
-  void const *UNUSED(in_data),
-  size_t UNUSED(in_len),
-  int error,
-  struct netw_header const *header)
+static enum minimod_priority
+get_request_priority(struct scheduled_request const *r)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	task->callback.fptr.email_request(task->callback.userdata, error == 200);
-	free_task(task);
+	return r->control ? get_control_priority(r->control)
+	                  : MINIMOD_PRIORITY_INTERACTIVE;
 }
 
 
+// Sends the most urgent requests, as long as there are connections and
+// tokens left. Cancelled requests are dropped.
+//
+// Callbacks are never invoked from here, but by the scheduler thread,
+// since this is called by submit_request() on the thread of the caller,
+// which may hold locks of its own.
 static void
-handle_token_exchange(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+pump_scheduler(struct minimod_ctx *ctx)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	struct scheduled_request *due = NULL;
+	struct scheduled_request **due_tail = &due;
+	mtx_lock(&ctx->sched_mtx);
+	for (;;)
 	{
-		task->callback.fptr.access_token(task->callback.userdata, NULL, 0);
-		free_task(task);
-		return;
+		// first come first served within a priority
+		struct scheduled_request **best = NULL;
+		struct scheduled_request **it = &ctx->sched_queue;
+		for (; *it; it = &(*it)->next)
+		{
+			if (is_request_dropped(*it))
+			{
+				best = it;
+				break;
+			}
+			if (
+			  !best
+			  || get_request_priority(*it) < get_request_priority(*best))
+			{
+				best = it;
+			}
+		}
+		if (!best)
+		{
+			break;
+		}
+
+		struct scheduled_request *r = *best;
+		r->is_dropped = is_request_dropped(r);
+		if (
+		  !r->is_dropped
+		  && (ctx->nconnections >= ctx->max_connections
+		    || !take_request_token(ctx)))
+		{
+			break;
+		}
+		*best = r->next;
+		r->next = NULL;
+		*due_tail = r;
+		due_tail = &r->next;
+		if (!r->is_dropped)
+		{
+			ctx->nconnections += 1;
+		}
 	}
+	mtx_unlock(&ctx->sched_mtx);
 
-	// parse data
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_Value const *document = NULL;
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
+	while (due)
+	{
+		struct scheduled_request *r = due;
+		due = r->next;
+		if (r->is_dropped)
+		{
+			LOG("request dropped: %s", r->path);
+			call_later(ctx, 0, fail_scheduled_request, r);
+		}
+		else if (!send_netw_request(
+		           ctx,
+		           r->verb,
+		           r->path,
+		           (char const *const *)r->headers,
+		           r->body,
+		           r->nbody,
+		           on_scheduled_response,
+		           r))
+		{
+			mtx_lock(&ctx->sched_mtx);
+			ctx->nconnections -= 1;
+			cnd_signal(&ctx->sched_cnd);
+			mtx_unlock(&ctx->sched_mtx);
+			// the caller was told the request is sent, so it gets a response
+			call_later(ctx, 0, fail_scheduled_request, r);
+		}
+	}
+}
 
-	QAJ4C_Value const *token = QAJ4C_object_get(document, "access_token");
-	ASSERT(QAJ4C_is_string(token));
 
-	char const *tok = QAJ4C_get_string(token);
-	size_t tok_bytes = QAJ4C_get_string_length(token);
+// Microseconds until the next delayed call is due or the next queued
+// request gets a token, UINT64_MAX if there is nothing to wait for but
+// a signal, e.g. of a connection which is free again.
+// Needs to be called with sched_mtx locked.
+static uint64_t
+get_sched_timeout(struct minimod_ctx *ctx, uint64_t in_now)
+{
+	uint64_t timeout = UINT64_MAX;
+	for (struct delayed_call *c = ctx->delayed_calls; c; c = c->next)
+	{
+		uint64_t const t = c->due > in_now ? c->due - in_now : 0;
+		timeout = t < timeout ? t : timeout;
+	}
 
-	FILE *f = fsu_fopen(get_tokenpath(), "wb");
-	fwrite(tok, tok_bytes, 1, f);
-	fclose(f);
+	if (ctx->sched_queue && ctx->nconnections < ctx->max_connections)
+	{
+		time_t const now_s = sys_seconds();
+		double const tokens = ctx->request_tokens
+		  + (double)(in_now - ctx->request_tokens_refilled)
+		    * ctx->requests_per_minute / (60 * 1000000.0);
+		uint64_t t = 0;
+		if (now_s < ctx->rate_limited_until)
+		{
+			t = (uint64_t)(ctx->rate_limited_until - now_s) * 1000000;
+		}
+		else if (tokens < 1)
+		{
+			t = (uint64_t)((1 - tokens) * 60 * 1000000.0
+			      / ctx->requests_per_minute)
+			  + 1;
+		}
+		timeout = t < timeout ? t : timeout;
+	}
+	return timeout;
+}
 
-	read_token();
 
-	task->callback.fptr.access_token(task->callback.userdata, tok, tok_bytes);
+// Sleeps until there is something to do, instead of polling.
+static int
+sched_main(void *in_arg)
+{
+	struct minimod_ctx *ctx = in_arg;
+	mtx_lock(&ctx->sched_mtx);
+	while (!__atomic_load_n(&ctx->is_sched_quitting, __ATOMIC_ACQUIRE))
+	{
+		uint64_t const timeout =
+		  get_sched_timeout(ctx, sys_microseconds());
+		if (timeout == UINT64_MAX)
+		{
+			cnd_wait(&ctx->sched_cnd, &ctx->sched_mtx);
+		}
+		else if (timeout > 0)
+		{
+			// rounded up, to not wake up just before it is due
+			uint64_t const ms = (timeout + 999) / 1000;
+			sys_cnd_timedwait(
+			  &ctx->sched_cnd,
+			  &ctx->sched_mtx,
+			  ms < UINT32_MAX ? (uint32_t)ms : UINT32_MAX);
+		}
+		mtx_unlock(&ctx->sched_mtx);
 
-	free_task(task);
+		struct delayed_call *calls =
+		  take_delayed_calls(ctx, sys_microseconds());
+		run_delayed_calls(calls);
+		pump_scheduler(ctx);
+		mtx_lock(&ctx->sched_mtx);
+	}
+	mtx_unlock(&ctx->sched_mtx);
+	return 0;
 }
 
 
+// Started on demand, but kept running until minimod_deinit().
+// Needs to be called with sched_mtx locked.
 static void
-handle_rate(
-  void *in_udata,
-  void const *UNUSED(in_data),
-  size_t UNUSED(in_len),
-  int error,
-  struct netw_header const *header)
+start_sched_thread(struct minimod_ctx *ctx)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
+	if (!ctx->has_sched_thread)
+	{
+		ctx->has_sched_thread =
+		  (thrd_success == thrd_create(&ctx->sched_thread, sched_main, ctx));
+	}
+}
 
-	if (error == 201)
+
+// Same as netw_request(). The request is queued and sent as soon as there
+// is a connection and a token for it, by the priority of *in_control*,
+// which may be NULL. Cancelled requests get a failed response.
+static bool
+submit_request(
+  struct minimod_ctx *ctx,
+  enum netw_verb in_verb,
+  char const *in_path,
+  char const *const *in_headers,
+  void const *in_body,
+  size_t in_nbody,
+  struct request_control const *in_control,
+  netw_request_callback in_callback,
+  void *in_userdata)
+{
+	mtx_lock(&ctx->sched_mtx);
+	bool const is_closed = ctx->is_sched_closed;
+	if (!is_closed)
 	{
-		LOG("Rating applied successful");
-		task->callback.fptr.rate(task->callback.userdata, true);
+		struct scheduled_request *r = calloc(1, sizeof *r);
+		r->ctx = ctx;
+		r->verb = in_verb;
+		r->path = strdup(in_path);
+		r->headers = copy_headers(in_headers);
+		if (in_nbody > 0)
+		{
+			r->body = malloc(in_nbody);
+			memcpy(r->body, in_body, in_nbody);
+			r->nbody = in_nbody;
+		}
+		r->control = in_control;
+		r->callback = in_callback;
+		r->userdata = in_userdata;
+
+		struct scheduled_request **tail = &ctx->sched_queue;
+		while (*tail)
+		{
+			tail = &(*tail)->next;
+		}
+		*tail = r;
+
+		// to send requests once tokens are available again
+		start_sched_thread(ctx);
+		cnd_signal(&ctx->sched_cnd);
 	}
-	else
+	mtx_unlock(&ctx->sched_mtx);
+
+	if (is_closed)
 	{
-		LOGE("Raiting not applied: %i", error);
-		task->callback.fptr.rate(task->callback.userdata, false);
+		return send_netw_request(
+		  ctx,
+		  in_verb,
+		  in_path,
+		  in_headers,
+		  in_body,
+		  in_nbody,
+		  in_callback,
+		  in_userdata);
 	}
-	free_task(task);
+	pump_scheduler(ctx);
+	return true;
 }
 
 
+// Requests submitted afterwards are sent right away.
 static void
-handle_get_ratings(
-  void *in_udata,
-  void const *in_data,
-  size_t in_len,
-  int error,
-  struct netw_header const *header)
+stop_scheduler(struct minimod_ctx *ctx)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-	if (error != 200)
+	if (ctx->has_sched_thread)
 	{
-		task->callback.fptr
-		  .get_ratings(task->callback.userdata, 0, NULL, NULL);
-		free_task(task);
-		return;
+		mtx_lock(&ctx->sched_mtx);
+		__atomic_store_n(&ctx->is_sched_quitting, true, __ATOMIC_RELEASE);
+		cnd_signal(&ctx->sched_cnd);
+		mtx_unlock(&ctx->sched_mtx);
+		thrd_join(ctx->sched_thread, NULL);
 	}
 
-	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
-	void *buffer = malloc(nbuffer);
-	QAJ4C_Value const *document = NULL;
-	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
-	ASSERT(QAJ4C_is_object(document));
-
-	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
-	ASSERT(QAJ4C_is_array(data));
-
-	size_t nratings = QAJ4C_array_size(data);
-	struct minimod_rating *ratings = calloc(sizeof *ratings, nratings);
+	mtx_lock(&ctx->sched_mtx);
+	ctx->is_sched_closed = true;
+	struct scheduled_request *r = ctx->sched_queue;
+	ctx->sched_queue = NULL;
+	mtx_unlock(&ctx->sched_mtx);
 
-	for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+	while (r)
 	{
-		populate_rating(&ratings[i], QAJ4C_array_get(data, i));
+		struct scheduled_request *next = r->next;
+		fail_scheduled_request(r);
+		r = next;
 	}
 
-	struct minimod_pagination pagi;
-	populate_pagination(&pagi, document);
-
-	task->callback.fptr
-	  .get_ratings(task->callback.userdata, nratings, ratings, &pagi);
+	// pending retries are sent right away
+	run_delayed_calls(take_delayed_calls(ctx, UINT64_MAX));
+}
 
-	free(ratings);
 
-	free(buffer);
-	free_task(task);
+// splitmix64, good enough for jitter
+static uint64_t
+random_u64(struct minimod_ctx *ctx)
+{
+	uint64_t z = __atomic_add_fetch(
+	  &ctx->random_state,
+	  0x9E3779B97F4A7C15ull,
+	  __ATOMIC_RELAXED);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
 }
 
 
+// API requests are matched by their path relative to the API, downloads of
+// modfiles are the "download" endpoint.
 static void
-handle_subscription_change(
-  void *in_udata,
-  void const *UNUSED(in_data),
-  size_t UNUSED(in_bytes),
-  int error,
-  struct netw_header const *header)
+retry_begin(
+  struct minimod_ctx *ctx,
+  struct retry_state *r,
+  char const *in_url,
+  char const *const *in_headers)
 {
-	struct task *task = in_udata;
-	handle_generic_errors(error, header, task->flags & TASK_FLAG_AUTH_TOKEN);
-
-	if (task->meta32 > 0)
-	{
-		if (error == 201)
-		{
-			task->callback.fptr.subscription_change(
-			  task->callback.userdata,
-			  task->meta64,
-			  1);
-		}
-		else
-		{
-			LOGE(
-			  "failed to subscribe %i [modid: %" PRIu64 "]",
-			  error,
-			  task->meta64);
-			task->callback.fptr.subscription_change(
-			  task->callback.userdata,
-			  task->meta64,
-			  0);
-		}
-	}
-	else
+	char const *base = endpoints[ctx->env];
+	size_t const nbase = strlen(base);
+	char const *endpoint =
+	  0 == strncmp(in_url, base, nbase) ? in_url + nbase : "download";
+
+	r->url = strdup(in_url);
+	r->headers = in_headers ? copy_headers(in_headers) : NULL;
+	r->start = sys_microseconds();
+	r->nretries = 0;
+
+	mtx_lock(&ctx->sched_mtx);
+	r->policy = ctx->retry_policy;
+	size_t nmatched = 0;
+	for (struct retry_override *o = ctx->retry_overrides; o; o = o->next)
 	{
-		if (error == 204)
-		{
-			task->callback.fptr.subscription_change(
-			  task->callback.userdata,
-			  task->meta64,
-			  -1);
-		}
-		else
+		size_t const n = strlen(o->endpoint);
+		if (n > nmatched && 0 == strncmp(endpoint, o->endpoint, n))
 		{
-			LOGE(
-			  "failed to unsubscribe %i [modid: %" PRIu64 "]",
-			  error,
-			  task->meta64);
-			task->callback.fptr.subscription_change(
-			  task->callback.userdata,
-			  task->meta64,
-			  0);
+			r->policy = o->policy;
+			nmatched = n;
 		}
 	}
+	mtx_unlock(&ctx->sched_mtx);
+}
 
-	free_task(task);
+
+static bool
+is_transient_status(int in_status)
+{
+	// 0 is a failed connection
+	return in_status == 0 || in_status == 408 || in_status == 429
+	  || in_status == 500 || in_status == 502 || in_status == 503
+	  || in_status == 504;
 }
 
 
-enum minimod_err
-minimod_init(
-  char const *in_api_key,
-  char const *in_root_path,
-  unsigned int in_flags,
-  uint32_t in_abi_version)
+// Returns:
+//	0 if the request should not be retried, otherwise the delay in
+//	milliseconds: exponential backoff with full jitter.
+static uint32_t
+next_retry_delay(struct minimod_ctx *ctx, struct retry_state *r, int in_status)
 {
-	// check version compatibility
-	if (in_abi_version != MINIMOD_CURRENT_ABI)
+	if (
+	  !r->url || !is_transient_status(in_status)
+	  || r->nretries >= r->policy.max_retries)
 	{
-		return MINIMOD_ERR_ABI;
+		return 0;
 	}
 
-	// check if API key is given
-	if (!in_api_key)
+	mtx_lock(&ctx->sched_mtx);
+	bool const has_budget = ctx->retry_budget >= 1;
+	if (has_budget)
 	{
-		return MINIMOD_ERR_KEY;
+		ctx->retry_budget -= 1;
 	}
-	else
+	mtx_unlock(&ctx->sched_mtx);
+	if (!has_budget)
 	{
-		if (strlen(in_api_key) != 32)
-		{
-			return MINIMOD_ERR_KEY;
-		}
-		for (size_t i = 0; i < 32; ++i)
-		{
-			if (!isalnum(in_api_key[i]))
-			{
-				return MINIMOD_ERR_KEY;
-			}
-		}
+		LOG("retry budget exhausted: %s", r->url);
+		return 0;
+	}
+
+	uint64_t cap = r->policy.base_delay_ms;
+	for (uint32_t i = 0; i < r->nretries && cap < r->policy.max_delay_ms; ++i)
+	{
+		cap *= 2;
 	}
+	cap = cap < r->policy.max_delay_ms ? cap : r->policy.max_delay_ms;
+	r->nretries += 1;
+	uint32_t const delay = (uint32_t)(random_u64(ctx) % (cap + 1));
+	LOG("retry %u of %s (%i) in %u ms", r->nretries, r->url, in_status, delay);
+	// 0 means no retry
+	return delay > 0 ? delay : 1;
+}
 
-	l_mmi.env = (in_flags & MINIMOD_INITFLAG_TESTENV);
 
-	// TODO validate path
-	l_mmi.root_path = strdup(in_root_path ? in_root_path : DEFAULT_ROOT);
-	// make sure the path does not end with '/'
-	size_t len = strlen(l_mmi.root_path);
-	ASSERT(len > 0);
-	if (l_mmi.root_path[len - 1] == '/')
+// Reports the final outcome of a request, after all of its retries.
+static void
+report_retry(struct minimod_ctx *ctx, struct retry_state *r, int in_status)
+{
+	if (!r->url)
 	{
-		l_mmi.root_path[len - 1] = '\0';
+		return;
 	}
 
-	// attempt to initialize netw
-	if (!netw_init())
+	mtx_lock(&ctx->sched_mtx);
+	if (r->nretries == 0 && in_status >= 200 && in_status < 400)
 	{
-		return MINIMOD_ERR_NET;
+		ctx->retry_budget += RETRY_BUDGET_RATIO;
+		if (ctx->retry_budget > RETRY_BUDGET_MAX)
+		{
+			ctx->retry_budget = RETRY_BUDGET_MAX;
+		}
 	}
+	minimod_request_stats_callback callback = ctx->request_stats_callback;
+	void *userdata = ctx->request_stats_userdata;
+	mtx_unlock(&ctx->sched_mtx);
 
-	l_mmi.api_key = in_api_key ? strdup(in_api_key) : NULL;
+	if (callback)
+	{
+		// the API key is not part of the reported URL
+		char *url = cache_key_from_url(r->url);
+		struct minimod_request_stats const stats = {
+			.url = url,
+			.status = in_status,
+			.nretries = r->nretries,
+			.usecs = sys_microseconds() - r->start,
+		};
+		callback(userdata, &stats);
+		free(url);
+	}
+}
 
-	l_mmi.unzip = (in_flags & MINIMOD_INITFLAG_UNZIP);
 
-	mtx_init(&l_mmi.install_requests_mtx, mtx_plain);
+static void
+free_retry(struct retry_state *r)
+{
+	free(r->url);
+	free_headers(r->headers);
+	r->url = NULL;
+	r->headers = NULL;
+}
 
-	read_token();
 
-	return MINIMOD_ERR_OK;
+static void
+free_retry_overrides(struct minimod_ctx *ctx)
+{
+	while (ctx->retry_overrides)
+	{
+		struct retry_override *next = ctx->retry_overrides->next;
+		free(ctx->retry_overrides->endpoint);
+		free(ctx->retry_overrides);
+		ctx->retry_overrides = next;
+	}
 }
 
 
 void
-minimod_deinit(void)
+minimod_ctx_set_retry_policy(
+  struct minimod_ctx *ctx,
+  char const *in_endpoint,
+  struct minimod_retry_policy const *in_policy)
 {
-	netw_deinit();
-
-	free(l_mmi.root_path);
-	free(l_mmi.cache_tokenpath);
-	free(l_mmi.api_key);
-	free(l_mmi.token);
-	free(l_mmi.token_bearer);
+	struct minimod_retry_policy policy = {
+		.max_retries = DEFAULT_MAX_RETRIES,
+		.base_delay_ms = DEFAULT_RETRY_BASE_DELAY_MS,
+		.max_delay_ms = DEFAULT_RETRY_MAX_DELAY_MS,
+	};
+	if (in_policy)
+	{
+		policy = *in_policy;
+		policy.base_delay_ms = policy.base_delay_ms > 0
+		  ? policy.base_delay_ms
+		  : DEFAULT_RETRY_BASE_DELAY_MS;
+		policy.max_delay_ms = policy.max_delay_ms >= policy.base_delay_ms
+		  ? policy.max_delay_ms
+		  : policy.base_delay_ms;
+	}
 
-	mtx_destroy(&l_mmi.install_requests_mtx);
+	mtx_lock(&ctx->sched_mtx);
+	if (!in_endpoint)
+	{
+		ctx->retry_policy = policy;
+		mtx_unlock(&ctx->sched_mtx);
+		return;
+	}
 
-	l_mmi = (struct mmi){ 0 };
+	struct retry_override **it = &ctx->retry_overrides;
+	while (*it && 0 != strcmp((*it)->endpoint, in_endpoint))
+	{
+		it = &(*it)->next;
+	}
+	if (!in_policy && *it)
+	{
+		struct retry_override *o = *it;
+		*it = o->next;
+		free(o->endpoint);
+		free(o);
+	}
+	else if (in_policy)
+	{
+		if (!*it)
+		{
+			*it = calloc(1, sizeof **it);
+			(*it)->endpoint = strdup(in_endpoint);
+		}
+		(*it)->policy = policy;
+	}
+	mtx_unlock(&ctx->sched_mtx);
 }
 
 
-int64_t
-minimod_is_ratelimited(void)
+void
+minimod_ctx_set_request_stats_callback(
+  struct minimod_ctx *ctx,
+  minimod_request_stats_callback in_callback,
+  void *in_userdata)
 {
-	return l_mmi.rate_limited_until - sys_seconds();
+	mtx_lock(&ctx->sched_mtx);
+	ctx->request_stats_callback = in_callback;
+	ctx->request_stats_userdata = in_userdata;
+	mtx_unlock(&ctx->sched_mtx);
 }
 
 
-void
-minimod_set_debugtesting(int error_rate, int min_delay, int max_delay)
+// mod.io reports its limit per minute and how many requests are left,
+// which is authoritative over the local estimate.
+static void
+adapt_request_rate(struct minimod_ctx *ctx, struct netw_header const *header)
 {
-	netw_set_error_rate(error_rate);
-	netw_set_delay(min_delay, max_delay);
-}
-
+	char const *limit = netw_get_header(header, "X-RateLimit-Limit");
+	char const *remaining = netw_get_header(header, "X-RateLimit-Remaining");
+	char const *retry_after =
+	  netw_get_header(header, "X-RateLimit-RetryAfter");
+	if (!limit && !remaining)
+	{
+		return;
+	}
+
+	mtx_lock(&ctx->sched_mtx);
+	long const limit_l = limit ? strtol(limit, NULL, 10) : 0;
+	if (limit_l > 0 && !ctx->is_request_rate_fixed)
+	{
+		ctx->requests_per_minute = (uint32_t)limit_l;
+	}
+	if (remaining)
+	{
+		long const remaining_l = strtol(remaining, NULL, 10);
+		if (remaining_l >= 0 && ctx->request_tokens > remaining_l)
+		{
+			ctx->request_tokens = remaining_l;
+		}
+		if (remaining_l == 0 && retry_after)
+		{
+			long const retry_after_l = strtol(retry_after, NULL, 10);
+			LOG("X-RateLimit-RetryAfter: %li seconds", retry_after_l);
+			ctx->rate_limited_until = sys_seconds() + retry_after_l;
+		}
+	}
+	cnd_signal(&ctx->sched_cnd);
+	mtx_unlock(&ctx->sched_mtx);
+}
+
 
 void
-minimod_get_games(
+minimod_ctx_set_request_rate(
+  struct minimod_ctx *ctx,
+  uint32_t in_requests_per_minute,
+  unsigned int in_burst)
+{
+	mtx_lock(&ctx->sched_mtx);
+	ctx->is_request_rate_fixed = in_requests_per_minute > 0;
+	if (in_requests_per_minute > 0)
+	{
+		ctx->requests_per_minute = in_requests_per_minute;
+	}
+	ctx->request_burst = in_burst > 0 ? in_burst : DEFAULT_REQUEST_BURST;
+	cnd_signal(&ctx->sched_cnd);
+	mtx_unlock(&ctx->sched_mtx);
+}
+
+
+void
+minimod_ctx_set_max_connections(
+  struct minimod_ctx *ctx,
+  unsigned int in_max_connections)
+{
+	mtx_lock(&ctx->sched_mtx);
+	ctx->max_connections =
+	  in_max_connections > 0 ? in_max_connections : DEFAULT_MAX_CONNECTIONS;
+	cnd_signal(&ctx->sched_cnd);
+	mtx_unlock(&ctx->sched_mtx);
+	pump_scheduler(ctx);
+}
+
+
+size_t
+minimod_ctx_get_scheduled_requests(struct minimod_ctx *ctx)
+{
+	size_t n = 0;
+	mtx_lock(&ctx->sched_mtx);
+	for (struct scheduled_request *r = ctx->sched_queue; r; r = r->next)
+	{
+		n += 1;
+	}
+	mtx_unlock(&ctx->sched_mtx);
+	return n;
+}
+
+
+static void
+handle_generic_errors(
+  struct minimod_ctx *ctx,
+  int error,
+  struct netw_header const *header,
+  struct auth *in_auth)
+{
+	if (header)
+	{
+		adapt_request_rate(ctx, header);
+	}
+	if (error == 429) // too many requests
+	{
+		char const *retry_after = netw_get_header(header, "Retry-After");
+		long retry_after_l = retry_after ? strtol(retry_after, NULL, 10) : 60;
+		LOG("Retry-After: %li seconds", retry_after_l);
+		mtx_lock(&ctx->sched_mtx);
+		ctx->rate_limited_until = sys_seconds() + retry_after_l;
+		cnd_signal(&ctx->sched_cnd);
+		mtx_unlock(&ctx->sched_mtx);
+	}
+	if (error == 401)
+	{
+		if (in_auth)
+		{
+			LOG("Received HTTP Status 401 -> OAUTH2 Token Invalid");
+			deauthenticate(ctx, in_auth);
+		}
+		else
+		{
+			LOG("Received HTTP Status 401 -> API Key Invalid");
+			ctx->is_apikey_invalid = true;
+		}
+	}
+}
+
+
+static void
+deliver_games(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr.get_games(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	if (data)
+	{
+		ASSERT(QAJ4C_is_array(data));
+
+		size_t ngames = QAJ4C_array_size(data);
+		struct minimod_game *games =
+		  arena_calloc(arena_thread(), ngames, sizeof *games);
+
+		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+		{
+			populate_game(&games[i], QAJ4C_array_get(data, i));
+		}
+
+		struct minimod_pagination pagi;
+		populate_pagination(&pagi, task, document);
+
+		task->callback.fptr
+		  .get_games(task->callback.userdata, ngames, games, &pagi);
+	}
+}
+
+
+static void
+deliver_mods(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr.get_mods(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	// single item or array of items?
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	if (data)
+	{
+		ASSERT(QAJ4C_is_array(data));
+
+		size_t nmods = QAJ4C_array_size(data);
+		struct minimod_mod *mods =
+		  arena_calloc(arena_thread(), nmods, sizeof *mods);
+
+		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+		{
+			populate_mod(&mods[i], QAJ4C_array_get(data, i));
+		}
+
+		struct minimod_pagination pagi;
+		populate_pagination(&pagi, task, document);
+
+		task->callback.fptr
+		  .get_mods(task->callback.userdata, nmods, mods, &pagi);
+	}
+	else
+	{
+		struct minimod_mod mod = { 0 };
+		populate_mod(&mod, document);
+		task->callback.fptr.get_mods(task->callback.userdata, 1, &mod, NULL);
+	}
+}
+
+
+static void
+deliver_users(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr.get_users(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	// check for 'data' to see if it is a 'single' or 'multi' data object
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	if (data)
+	{
+		ASSERT(QAJ4C_is_array(data));
+
+		size_t nusers = QAJ4C_array_size(data);
+		struct minimod_user *users =
+		  arena_calloc(arena_thread(), nusers, sizeof *users);
+
+		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+		{
+			populate_user(&users[i], QAJ4C_array_get(data, i));
+		}
+
+		struct minimod_pagination pagi;
+		populate_pagination(&pagi, task, document);
+
+		task->callback.fptr
+		  .get_users(task->callback.userdata, nusers, users, &pagi);
+	}
+	// single user
+	else
+	{
+		struct minimod_user user;
+		populate_user(&user, document);
+		task->callback.fptr.get_users(task->callback.userdata, 1, &user, NULL);
+	}
+}
+
+
+static void
+deliver_modfiles(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr
+		  .get_modfiles(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	// single item or array of items?
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	if (data)
+	{
+		ASSERT(QAJ4C_is_array(data));
+
+		size_t nmodfiles = QAJ4C_array_size(data);
+		struct minimod_modfile *modfiles =
+		  arena_calloc(arena_thread(), nmodfiles, sizeof *modfiles);
+
+		for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+		{
+			populate_modfile(&modfiles[i], QAJ4C_array_get(data, i));
+		}
+
+		struct minimod_pagination pagi;
+		populate_pagination(&pagi, task, document);
+
+		task->callback.fptr
+		  .get_modfiles(task->callback.userdata, nmodfiles, modfiles, &pagi);
+	}
+	else
+	{
+		struct minimod_modfile modfile;
+		populate_modfile(&modfile, document);
+		task->callback.fptr
+		  .get_modfiles(task->callback.userdata, 1, &modfile, NULL);
+	}
+}
+
+
+static void
+deliver_events(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr.get_events(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	ASSERT(QAJ4C_is_array(data));
+
+	size_t nevents = QAJ4C_array_size(data);
+	struct minimod_event *events =
+	  arena_calloc(arena_thread(), nevents, sizeof *events);
+
+	for (size_t i = 0; i < nevents; ++i)
+	{
+		populate_event(&events[i], QAJ4C_array_get(data, i));
+	}
+
+	struct minimod_pagination pagi;
+	populate_pagination(&pagi, task, document);
+
+	task->callback.fptr
+	  .get_events(task->callback.userdata, nevents, events, &pagi);
+}
+
+
+static void
+deliver_dependencies(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr
+		  .get_dependencies(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	ASSERT(QAJ4C_is_array(data));
+
+	size_t ndeps = QAJ4C_array_size(data);
+	uint64_t *deps =
+	  arena_calloc(arena_thread(), ndeps, sizeof *deps);
+
+	for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+	{
+		deps[i] = QAJ4C_get_uint64(QAJ4C_array_get(data, i));
+	}
+
+	struct minimod_pagination pagi;
+	populate_pagination(&pagi, task, document);
+
+	task->callback.fptr
+	  .get_dependencies(task->callback.userdata, ndeps, deps, &pagi);
+}
+
+
+static void
+deliver_ratings(struct task *task, QAJ4C_Value const *document)
+{
+	if (!document)
+	{
+		task->callback.fptr
+		  .get_ratings(task->callback.userdata, 0, NULL, NULL);
+		return;
+	}
+
+	QAJ4C_Value const *data = QAJ4C_object_get(document, "data");
+	ASSERT(QAJ4C_is_array(data));
+
+	size_t nratings = QAJ4C_array_size(data);
+	struct minimod_rating *ratings =
+	  arena_calloc(arena_thread(), nratings, sizeof *ratings);
+
+	for (size_t i = 0; i < QAJ4C_array_size(data); ++i)
+	{
+		populate_rating(&ratings[i], QAJ4C_array_get(data, i));
+	}
+
+	struct minimod_pagination pagi;
+	populate_pagination(&pagi, task, document);
+
+	task->callback.fptr
+	  .get_ratings(task->callback.userdata, nratings, ratings, &pagi);
+}
+
+
+static QAJ4C_Value const *
+parse_document(struct arena *in_arena, void const *in_data, size_t in_len)
+{
+	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
+	void *buffer = arena_alloc(in_arena, nbuffer);
+	QAJ4C_Value const *document = NULL;
+	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
+	ASSERT(QAJ4C_is_object(document));
+	return document;
+}
+
+
+// Same as parse_document(), but the document outlives the thread's arena
+// in *out_buffer*, which needs to be freed.
+static QAJ4C_Value const *
+parse_document_heap(void const *in_data, size_t in_len, void **out_buffer)
+{
+	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
+	*out_buffer = malloc(nbuffer);
+	QAJ4C_Value const *document = NULL;
+	QAJ4C_parse_opt(in_data, in_len, 0, *out_buffer, nbuffer, &document);
+	ASSERT(QAJ4C_is_object(document));
+	return document;
+}
+
+
+// Removes *task* from the requests in flight and returns the tasks which
+// are waiting for the same response.
+static struct task *
+land_flight(struct task *task)
+{
+	struct minimod_ctx *ctx = task->ctx;
+	mtx_lock(&ctx->flights_mtx);
+	struct task **it = &ctx->flights;
+	while (*it && *it != task)
+	{
+		it = &(*it)->next_flight;
+	}
+	if (*it)
+	{
+		*it = task->next_flight;
+	}
+	struct task *waiters = task->next_waiter;
+	task->next_waiter = NULL;
+	mtx_unlock(&ctx->flights_mtx);
+	return waiters;
+}
+
+
+// The document is parsed once, but converted by each task on its own.
+// Cancelled tasks are skipped.
+static void
+deliver_flight(
+  struct task *task,
+  struct task *waiters,
+  QAJ4C_Value const *document)
+{
+	struct minimod_ctx *ctx = task->ctx;
+	if (!unregister_control(ctx, &task->control))
+	{
+		task->deliver(task, document);
+	}
+	for (struct task *t = waiters; t; t = t->next_waiter)
+	{
+		if (!unregister_control(ctx, &t->control))
+		{
+			t->deliver(t, document);
+		}
+	}
+}
+
+
+// A response to a flight, parsed but not delivered yet.
+struct delivery
+{
+	struct task *task;
+	struct task *waiters;
+	QAJ4C_Value const *document;
+	// pinned, if the document is the one of a stored cache entry
+	struct cache_entry *stored;
+	// holds the document, unless it is in the arena or the cache
+	void *buffer;
+};
+
+
+static void
+finish_delivery(struct delivery const *d)
+{
+	struct minimod_ctx *ctx = d->task->ctx;
+	struct arena *arena = arena_thread();
+	struct arena_mark const mark = arena_mark(arena);
+	deliver_flight(d->task, d->waiters, d->document);
+	arena_release(arena, mark);
+
+	if (d->stored)
+	{
+		cache_release(ctx->cache, d->stored);
+	}
+	free(d->buffer);
+	free_task(d->task);
+	struct task *waiters = d->waiters;
+	while (waiters)
+	{
+		struct task *next = waiters->next_waiter;
+		free_task(waiters);
+		waiters = next;
+	}
+}
+
+
+static void
+run_delivery(void *in_delivery)
+{
+	finish_delivery(in_delivery);
+	free(in_delivery);
+}
+
+
+// The request of a flight is dropped once all of its tasks are cancelled,
+// and otherwise has the priority of the most urgent one.
+static void
+update_flights(struct minimod_ctx *ctx)
+{
+	mtx_lock(&ctx->flights_mtx);
+	for (struct task *f = ctx->flights; f; f = f->next_flight)
+	{
+		bool is_cancelled = true;
+		enum minimod_priority priority = MINIMOD_PRIORITY_BACKGROUND;
+		for (struct task *t = f; t; t = t->next_waiter)
+		{
+			if (!is_control_cancelled(&t->control))
+			{
+				is_cancelled = false;
+				enum minimod_priority const p =
+				  get_control_priority(&t->control);
+				priority = p < priority ? p : priority;
+			}
+		}
+		__atomic_store_n(
+		  &f->flight_control.priority,
+		  priority,
+		  __ATOMIC_RELEASE);
+		__atomic_store_n(
+		  &f->flight_control.is_cancelled,
+		  is_cancelled,
+		  __ATOMIC_RELEASE);
+	}
+	mtx_unlock(&ctx->flights_mtx);
+}
+
+
+static void
+handle_get(
+  void *in_udata,
+  void const *in_data,
+  size_t in_len,
+  int error,
+  struct netw_header const *header);
+
+
+static void
+resend_get(void *in_userdata)
+{
+	struct task *task = in_userdata;
+	struct minimod_ctx *ctx = task->ctx;
+	if (!submit_request(ctx,
+	      NETW_VERB_GET,
+	      task->retry.url,
+	      (char const *const *)task->retry.headers,
+	      NULL,
+	      0,
+	      &task->flight_control,
+	      handle_get,
+	      task))
+	{
+		handle_get(task, NULL, 0, 0, NULL);
+	}
+}
+
+
+// Common response handler of all GET requests returning JSON data.
+// Takes care of errors, retries, parsing and the response cache; the
+// actual conversion into minimod-structs happens in task->deliver().
+static void
+handle_get(
+  void *in_udata,
+  void const *in_data,
+  size_t in_len,
+  int error,
+  struct netw_header const *header)
+{
+	struct task *task = in_udata;
+	struct minimod_ctx *ctx = task->ctx;
+	handle_generic_errors(
+	  ctx,
+	  error,
+	  header,
+	  task->auth);
+
+	// tasks waiting for the same response keep waiting, unless all of
+	// them are cancelled
+	uint32_t const retry_delay = is_control_cancelled(&task->flight_control)
+	  ? 0
+	  : next_retry_delay(ctx, &task->retry, error);
+	if (retry_delay > 0)
+	{
+		call_later(ctx, retry_delay, resend_get, task);
+		return;
+	}
+	report_retry(ctx, &task->retry, error);
+
+	// everything allocated while parsing and delivering the response
+	// is released at once, after the callback returned.
+	struct arena *arena = arena_thread();
+	struct arena_mark const mark = arena_mark(arena);
+
+	struct delivery d = { .task = task, .waiters = land_flight(task) };
+	if (error == 304 && task->cache_entry)
+	{
+		// not modified: neither download nor parse anything
+		LOG("cache hit: %s", task->cache_key);
+		cache_hit(ctx->cache, task->cache_entry);
+		d.document = cache_document(ctx->cache, task->cache_entry);
+	}
+	else if (error != 200)
+	{
+		d.document = NULL;
+	}
+	else if (
+	  task->cache_key
+	  && (d.stored = cache_store(
+	        ctx->cache,
+	        task->cache_key,
+	        netw_get_header(header, "ETag"),
+	        netw_get_header(header, "Last-Modified"),
+	        in_data,
+	        in_len)))
+	{
+		d.document = cache_document(ctx->cache, d.stored);
+	}
+	else if (ctx->is_polled)
+	{
+		d.document = parse_document_heap(in_data, in_len, &d.buffer);
+	}
+	else
+	{
+		d.document = parse_document(arena, in_data, in_len);
+	}
+
+	if (ctx->is_polled)
+	{
+		struct delivery *posted = malloc(sizeof *posted);
+		*posted = d;
+		post_completion(ctx, run_delivery, posted);
+	}
+	else
+	{
+		finish_delivery(&d);
+	}
+	arena_release(arena, mark);
+}
+
+
+// Send a GET request, which is handled by handle_get() and task->deliver().
+// If there is a cached response for it, the request is made conditional.
+// If the same URL is already requested (by the same user), no request is
+// sent, but *task* waits for the response of the one in flight.
+// The request is sent by the priority of task->control.
+//
+// Returns:
+//	The handle of *task*, 0 if the request failed, in which case *task* is
+//	freed without delivering anything.
+static minimod_handle
+submit_get(
+  char const *in_path,
+  char const *const *in_headers,
+  task_deliver_fn in_deliver,
+  struct task *task)
+{
+	struct minimod_ctx *ctx = task->ctx;
+	task->deliver = in_deliver;
+	minimod_handle const handle = register_control(ctx, &task->control);
+	enum minimod_priority const priority = task->control.priority;
+	task->flight_control.priority = priority;
+
+	asprintf(
+	  &task->flight_key,
+	  "%s %s",
+	  task->auth ? task->auth->bearer : "",
+	  in_path);
+	mtx_lock(&ctx->flights_mtx);
+	struct task *flight = ctx->flights;
+	// a flight whose tasks are all cancelled may be dropped any moment
+	while (
+	  flight
+	  && (strcmp(flight->flight_key, task->flight_key) != 0
+	    || is_control_cancelled(&flight->flight_control)))
+	{
+		flight = flight->next_flight;
+	}
+	if (flight)
+	{
+		LOG("joining request in flight: %s", in_path);
+		task->next_waiter = flight->next_waiter;
+		flight->next_waiter = task;
+		if (priority < get_control_priority(&flight->flight_control))
+		{
+			__atomic_store_n(
+			  &flight->flight_control.priority,
+			  priority,
+			  __ATOMIC_RELEASE);
+		}
+	}
+	else
+	{
+		task->next_flight = ctx->flights;
+		ctx->flights = task;
+	}
+	mtx_unlock(&ctx->flights_mtx);
+	if (flight)
+	{
+		return handle;
+	}
+
+	// room for the caller's headers plus the conditional ones
+	char const *headers[16];
+	size_t nheaders = 0;
+	while (in_headers && in_headers[nheaders])
+	{
+		ASSERT(nheaders + 5 < sizeof headers / sizeof *headers);
+		headers[nheaders] = in_headers[nheaders];
+		++nheaders;
+	}
+
+	// responses to token-authenticated requests are specific to the user
+	// and therefore not cached.
+	if (ctx->cache && !task->auth)
+	{
+		task->cache_key = cache_key_from_url(in_path);
+		task->cache_entry = cache_lookup(ctx->cache, task->cache_key);
+		if (task->cache_entry && task->cache_entry->etag)
+		{
+			headers[nheaders++] = "If-None-Match";
+			headers[nheaders++] = task->cache_entry->etag;
+		}
+		if (task->cache_entry && task->cache_entry->last_modified)
+		{
+			headers[nheaders++] = "If-Modified-Since";
+			headers[nheaders++] = task->cache_entry->last_modified;
+		}
+	}
+	headers[nheaders] = NULL;
+
+	retry_begin(ctx, &task->retry, in_path, headers);
+	if (!submit_request(ctx,
+	      NETW_VERB_GET,
+	      in_path,
+	      headers,
+	      NULL,
+	      0,
+	      &task->flight_control,
+	      handle_get,
+	      task))
+	{
+		// tasks which joined in the meantime expect a callback
+		struct task *waiters = land_flight(task);
+		while (waiters)
+		{
+			struct task *next = waiters->next_waiter;
+			if (!unregister_control(ctx, &waiters->control))
+			{
+				waiters->deliver(waiters, NULL);
+			}
+			free_task(waiters);
+			waiters = next;
+		}
+		free_task(task);
+		return 0;
+	}
+	return handle;
+}
+
+
+static void
+finish_email_request(void *in_task)
+{
+	struct task *task = in_task;
+	task->callback.fptr.email_request(task->callback.userdata, task->meta32);
+	free_task(task);
+}
+
+
+static void
+handle_email_request(
+  void *in_udata,
+  void const *UNUSED(in_data),
+  size_t UNUSED(in_len),
+  int error,
+  struct netw_header const *header)
+{
+	struct task *task = in_udata;
+	struct minimod_ctx *ctx = task->ctx;
+	handle_generic_errors(
+	  ctx,
+	  error,
+	  header,
+	  task->auth);
+	task->meta32 = (error == 200);
+	post_completion(ctx, finish_email_request, task);
+}
+
+
+static void
+finish_token_exchange(void *in_task)
+{
+	struct task *task = in_task;
+	char const *token = task->auth ? task->auth->token : NULL;
+	task->callback.fptr.access_token(
+	  task->callback.userdata,
+	  token,
+	  token ? strlen(token) : 0);
+	free_task(task);
+}
+
+
+static void
+handle_token_exchange(
+  void *in_udata,
+  void const *in_data,
+  size_t in_len,
+  int error,
+  struct netw_header const *header)
+{
+	struct task *task = in_udata;
+	struct minimod_ctx *ctx = task->ctx;
+	handle_generic_errors(
+	  ctx,
+	  error,
+	  header,
+	  task->auth);
+	if (error != 200)
+	{
+		post_completion(ctx, finish_token_exchange, task);
+		return;
+	}
+
+	// parse data
+	struct arena *arena = arena_thread();
+	struct arena_mark const mark = arena_mark(arena);
+	size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(in_data, in_len);
+	void *buffer = arena_alloc(arena, nbuffer);
+	QAJ4C_Value const *document = NULL;
+	QAJ4C_parse_opt(in_data, in_len, 0, buffer, nbuffer, &document);
+	ASSERT(QAJ4C_is_object(document));
+
+	QAJ4C_Value const *token = QAJ4C_object_get(document, "access_token");
+	ASSERT(QAJ4C_is_string(token));
+
+	char const *tok = QAJ4C_get_string(token);
+	size_t tok_bytes = QAJ4C_get_string_length(token);
+
+	FILE *f = fsu_fopen(get_tokenpath(ctx), "wb");
+	fwrite(tok, tok_bytes, 1, f);
+	fclose(f);
+
+	// the task keeps a reference, to report the token
+	task->auth = create_auth(tok, tok_bytes);
+	__atomic_add_fetch(&task->auth->refs, 1, __ATOMIC_RELAXED);
+	swap_auth(ctx, task->auth);
+
+	arena_release(arena, mark);
+	post_completion(ctx, finish_token_exchange, task);
+}
+
+
+static void
+finish_rate(void *in_task)
+{
+	struct task *task = in_task;
+	task->callback.fptr.rate(task->callback.userdata, task->meta32);
+	free_task(task);
+}
+
+
+static void
+handle_rate(
+  void *in_udata,
+  void const *UNUSED(in_data),
+  size_t UNUSED(in_len),
+  int error,
+  struct netw_header const *header)
+{
+	struct task *task = in_udata;
+	struct minimod_ctx *ctx = task->ctx;
+	handle_generic_errors(
+	  ctx,
+	  error,
+	  header,
+	  task->auth);
+
+	if (error == 201)
+	{
+		LOG("Rating applied successful");
+	}
+	else
+	{
+		LOGE("Raiting not applied: %i", error);
+	}
+	task->meta32 = (error == 201);
+	post_completion(ctx, finish_rate, task);
+}
+
+
+static void
+finish_subscription_change(void *in_task)
+{
+	struct task *task = in_task;
+	task->callback.fptr.subscription_change(
+	  task->callback.userdata,
+	  task->meta64,
+	  task->meta32);
+	free_task(task);
+}
+
+
+static void
+handle_subscription_change(
+  void *in_udata,
+  void const *UNUSED(in_data),
+  size_t UNUSED(in_bytes),
+  int error,
+  struct netw_header const *header)
+{
+	struct task *task = in_udata;
+	struct minimod_ctx *ctx = task->ctx;
+	handle_generic_errors(
+	  ctx,
+	  error,
+	  header,
+	  task->auth);
+
+	// meta32 turns from the requested change into the one applied
+	if (task->meta32 > 0)
+	{
+		if (error != 201)
+		{
+			LOGE(
+			  "failed to subscribe %i [modid: %" PRIu64 "]",
+			  error,
+			  task->meta64);
+			task->meta32 = 0;
+		}
+	}
+	else
+	{
+		if (error != 204)
+		{
+			LOGE(
+			  "failed to unsubscribe %i [modid: %" PRIu64 "]",
+			  error,
+			  task->meta64);
+			task->meta32 = 0;
+		}
+	}
+
+	post_completion(ctx, finish_subscription_change, task);
+}
+
+
+// defined below, as it scans the installed mods like the enumeration did
+static void
+open_installed_index(struct minimod_ctx *ctx);
+
+
+// defined below with the rest of the sync engine
+static void
+free_sync_games(struct minimod_ctx *ctx);
+static minimod_handle
+enqueue_batched_lookup(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_priority in_priority,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata);
+static void
+stop_batching(struct minimod_ctx *ctx);
+
+
+enum minimod_err
+minimod_ctx_create(
+  char const *in_api_key,
+  char const *in_root_path,
+  unsigned int in_flags,
+  uint32_t in_abi_version,
+  struct minimod_ctx **out_ctx)
+{
+	// check version compatibility
+	if (in_abi_version != MINIMOD_CURRENT_ABI)
+	{
+		return MINIMOD_ERR_ABI;
+	}
+
+	// check if API key is given
+	if (!in_api_key)
+	{
+		return MINIMOD_ERR_KEY;
+	}
+	else
+	{
+		if (strlen(in_api_key) != 32)
+		{
+			return MINIMOD_ERR_KEY;
+		}
+		for (size_t i = 0; i < 32; ++i)
+		{
+			if (!isalnum(in_api_key[i]))
+			{
+				return MINIMOD_ERR_KEY;
+			}
+		}
+	}
+
+	// attempt to initialize netw
+	if (!acquire_netw())
+	{
+		return MINIMOD_ERR_NET;
+	}
+
+	struct minimod_ctx *ctx = calloc(1, sizeof *ctx);
+	ctx->is_polled = (in_flags & MINIMOD_INITFLAG_POLL);
+	// out of descriptors, netw is not going to do any better
+	if (ctx->is_polled && !sys_event_init(&ctx->completion_event))
+	{
+		free(ctx);
+		release_netw();
+		return MINIMOD_ERR_NET;
+	}
+	ctx->env = (in_flags & MINIMOD_INITFLAG_TESTENV);
+
+	// TODO validate path
+	ctx->root_path = strdup(in_root_path ? in_root_path : DEFAULT_ROOT);
+	// make sure the path does not end with '/'
+	size_t len = strlen(ctx->root_path);
+	ASSERT(len > 0);
+	if (ctx->root_path[len - 1] == '/')
+	{
+		ctx->root_path[len - 1] = '\0';
+	}
+
+	ctx->api_key = in_api_key ? strdup(in_api_key) : NULL;
+
+	ctx->unzip = (in_flags & MINIMOD_INITFLAG_UNZIP);
+	if (ctx->unzip)
+	{
+		ctx->extractor = extractor_create(0);
+	}
+
+	mtx_init(&ctx->install_requests_mtx, mtx_plain);
+	mtx_init(&ctx->controls_mtx, mtx_plain);
+	cnd_init(&ctx->handles_cnd);
+	ctx->max_downloads = DEFAULT_MAX_DOWNLOADS;
+	ctx->max_extractions = DEFAULT_MAX_EXTRACTIONS;
+
+	open_installed_index(ctx);
+
+	mtx_init(&ctx->sync_mtx, mtx_plain);
+	mtx_init(&ctx->batch_mtx, mtx_plain);
+	cnd_init(&ctx->batch_cnd);
+	mtx_init(&ctx->flights_mtx, mtx_plain);
+	mtx_init(&ctx->sched_mtx, mtx_plain);
+	cnd_init(&ctx->sched_cnd);
+	ctx->requests_per_minute = DEFAULT_REQUESTS_PER_MINUTE;
+	ctx->request_burst = DEFAULT_REQUEST_BURST;
+	ctx->request_tokens = DEFAULT_REQUEST_BURST;
+	ctx->request_tokens_refilled = sys_microseconds();
+	ctx->max_connections = DEFAULT_MAX_CONNECTIONS;
+	ctx->retry_policy = (struct minimod_retry_policy){
+		.max_retries = DEFAULT_MAX_RETRIES,
+		.base_delay_ms = DEFAULT_RETRY_BASE_DELAY_MS,
+		.max_delay_ms = DEFAULT_RETRY_MAX_DELAY_MS,
+	};
+	ctx->retry_budget = RETRY_BUDGET_MAX;
+	ctx->random_state = sys_microseconds();
+	ctx->max_batch_size = DEFAULT_BATCH_SIZE;
+	ctx->sync_min_interval_ms = DEFAULT_SYNC_MIN_INTERVAL_MS;
+	ctx->sync_max_interval_ms = DEFAULT_SYNC_MAX_INTERVAL_MS;
+
+	read_token(ctx);
+
+	*out_ctx = ctx;
+	return MINIMOD_ERR_OK;
+}
+
+
+// Runs the callbacks queued for minimod_poll(), and those of the requests
+// they start, until there is nothing left.
+static void
+finish_completions(struct minimod_ctx *ctx)
+{
+	do
+	{
+		drain_netw_calls(ctx);
+	} while (minimod_ctx_poll(ctx, 0, 0) > 0);
+}
+
+
+void
+minimod_ctx_destroy(struct minimod_ctx *ctx)
+{
+	if (ctx->has_progress_thread)
+	{
+		__atomic_store_n(&ctx->is_progress_quitting, true, __ATOMIC_RELEASE);
+		thrd_join(ctx->progress_thread, NULL);
+	}
+
+	// installations which did not start yet, are not going to
+	mtx_lock(&ctx->install_requests_mtx);
+	ctx->is_install_queue_closed = true;
+	struct install_request *queued = ctx->install_queue;
+	ctx->install_queue = NULL;
+	mtx_unlock(&ctx->install_requests_mtx);
+	while (queued)
+	{
+		struct install_request *next = queued->queue_next;
+		bool const is_cancelled = unregister_control(ctx, &queued->control);
+		invoke_install_callback(ctx,
+		  queued->control.handle,
+		  is_cancelled ? NULL : queued->callback,
+		  queued->userdata,
+		  queued->game_id,
+		  queued->mod_id,
+		  MINIMOD_INSTALL_ERROR_CANCELLED);
+		invoke_install_waiters(ctx,
+		  queued->waiters,
+		  queued->game_id,
+		  queued->mod_id,
+		  MINIMOD_INSTALL_ERROR_CANCELLED);
+		queued->waiters = NULL;
+		free_install_request(queued);
+		queued = next;
+	}
+
+	// lookups which are still waiting for their batch, are failed
+	stop_batching(ctx);
+	// and so are requests waiting for their turn
+	stop_scheduler(ctx);
+
+	// downloads in progress are aborted, instead of waiting for them
+	mtx_lock(&ctx->install_requests_mtx);
+	for (struct install_request *r = ctx->install_requests; r; r = r->next)
+	{
+		__atomic_store_n(
+		  &r->extract_progress.is_cancelled,
+		  true,
+		  __ATOMIC_RELEASE);
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	// netw outlives this context, as long as there are other ones
+	drain_netw_calls(ctx);
+
+	// finishes pending extractions, which need root_path
+	if (ctx->extractor)
+	{
+		extractor_destroy(ctx->extractor);
+	}
+
+	// callbacks still waiting for minimod_poll() are invoked now
+	finish_completions(ctx);
+	if (ctx->is_polled)
+	{
+		sys_event_destroy(&ctx->completion_event);
+	}
+	release_netw();
+	free_retry_overrides(ctx);
+	mtx_destroy(&ctx->sched_mtx);
+	cnd_destroy(&ctx->sched_cnd);
+
+	// no poll is running anymore, without netw
+	free_sync_games(ctx);
+	mtx_destroy(&ctx->sync_mtx);
+	mtx_destroy(&ctx->flights_mtx);
+
+	free(ctx->root_path);
+	free(ctx->cache_tokenpath);
+	free(ctx->api_key);
+	retire_auth(ctx->auth);
+
+	if (ctx->cache)
+	{
+		cache_destroy(ctx->cache);
+	}
+
+	modindex_destroy(ctx->installed);
+
+	mtx_destroy(&ctx->install_requests_mtx);
+	mtx_destroy(&ctx->controls_mtx);
+	cnd_destroy(&ctx->handles_cnd);
+	free(ctx->busy_handles);
+
+	free(ctx);
+}
+
+
+enum minimod_err
+minimod_init(
+  char const *in_api_key,
+  char const *in_root_path,
+  unsigned int in_flags,
+  uint32_t in_abi_version)
+{
+	return minimod_ctx_create(
+	  in_api_key,
+	  in_root_path,
+	  in_flags,
+	  in_abi_version,
+	  &l_ctx);
+}
+
+
+void
+minimod_deinit(void)
+{
+	minimod_ctx_destroy(l_ctx);
+	l_ctx = NULL;
+}
+
+
+size_t
+minimod_ctx_poll(
+  struct minimod_ctx *ctx,
+  size_t in_max_items,
+  uint64_t in_budget_us)
+{
+	// neither concurrently nor from within a callback
+	if (__atomic_exchange_n(&ctx->is_polling, true, __ATOMIC_ACQUIRE))
+	{
+		return 0;
+	}
+
+	uint64_t const start = sys_microseconds();
+	size_t n = 0;
+	struct completion *c;
+	while ((in_max_items == 0 || n < in_max_items)
+	  && (c = take_completion(ctx)))
+	{
+		c->fn(c->userdata);
+		free(c);
+		n += 1;
+		if (in_budget_us > 0 && sys_microseconds() - start >= in_budget_us)
+		{
+			break;
+		}
+	}
+	// what is left for the next poll keeps the descriptor readable
+	if (ctx->poll_queue)
+	{
+		sys_event_set(&ctx->completion_event);
+	}
+
+	__atomic_store_n(&ctx->is_polling, false, __ATOMIC_RELEASE);
+	return n;
+}
+
+
+intptr_t
+minimod_ctx_get_completion_fd(struct minimod_ctx *ctx)
+{
+	return ctx->is_polled ? sys_event_handle(&ctx->completion_event) : -1;
+}
+
+
+int64_t
+minimod_ctx_is_ratelimited(struct minimod_ctx *ctx)
+{
+	mtx_lock(&ctx->sched_mtx);
+	time_t const until = ctx->rate_limited_until;
+	mtx_unlock(&ctx->sched_mtx);
+	return until - sys_seconds();
+}
+
+
+void
+minimod_set_debugtesting(int error_rate, int min_delay, int max_delay)
+{
+	netw_set_error_rate(error_rate);
+	netw_set_delay(min_delay, max_delay);
+}
+
+
+void
+minimod_ctx_set_cache(
+  struct minimod_ctx *ctx,
+  size_t in_max_bytes,
+  size_t in_max_entries)
+{
+	if (ctx->cache)
+	{
+		cache_set_limits(ctx->cache, in_max_bytes, in_max_entries);
+	}
+	else if (in_max_bytes > 0 && in_max_entries > 0)
+	{
+		char *path;
+		asprintf(&path, "%s/cache/", ctx->root_path);
+		ctx->cache = cache_create(path, in_max_bytes, in_max_entries);
+		free(path);
+	}
+}
+
+
+void
+minimod_ctx_get_cache_stats(
+  struct minimod_ctx *ctx,
+  struct minimod_cache_stats *out_stats)
+{
+	ASSERT(out_stats);
+	*out_stats = (struct minimod_cache_stats){ 0 };
+	if (ctx->cache)
+	{
+		struct cache_stats stats;
+		cache_get_stats(ctx->cache, &stats);
+		out_stats->nhits = stats.hits;
+		out_stats->nmisses = stats.misses;
+		out_stats->nbytes_saved = stats.bytes_saved;
+		out_stats->nentries = stats.nentries;
+		out_stats->nbytes = stats.nbytes;
+	}
+}
+
+
+static char *
+path_games(struct minimod_ctx *ctx, char const *in_filter)
+{
+	char *path;
+	asprintf(
+	  &path,
+	  "%s/games?api_key=%s&%s",
+	  endpoints[ctx->env],
+	  ctx->api_key,
+	  in_filter ? in_filter : "");
+	return path;
+}
+
+
+minimod_handle
+minimod_ctx_get_games(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  minimod_get_games_callback in_callback,
+  void *in_udata)
+{
+	char *path = path_games(ctx, in_filter);
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_games = in_callback;
+	task->callback.userdata = in_udata;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_games, task);
+
+	free(path);
+	return handle;
+}
+
+
+static char *
+path_mods(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	char *path;
+	if (in_mod_id)
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "?api_key=%s&%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  in_mod_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "");
+	}
+	else
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods?api_key=%s&%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "");
+	}
+	return path;
+}
+
+
+static minimod_handle
+get_mods(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_priority in_priority,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	if (in_mod_id && (!in_filter || !*in_filter))
+	{
+		minimod_handle const handle = enqueue_batched_lookup(ctx,
+		  in_game_id,
+		  in_mod_id,
+		  in_priority,
+		  in_callback,
+		  in_userdata);
+		if (handle)
+		{
+			return handle;
+		}
+	}
+
+	char *path = path_mods(ctx, in_filter, in_game_id, in_mod_id);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_mods = in_callback;
+	task->callback.userdata = in_userdata;
+	task->control.priority = in_priority;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_mods, task);
+
+	free(path);
+	return handle;
+}
+
+
+minimod_handle
+minimod_ctx_get_mods(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	return get_mods(ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  MINIMOD_PRIORITY_INTERACTIVE,
+	  in_callback,
+	  in_userdata);
+}
+
+
+void
+minimod_ctx_email_request(
+  struct minimod_ctx *ctx,
+  char const *in_email,
+  minimod_email_request_callback in_callback,
+  void *in_udata)
+{
+	char *path;
+	asprintf(&path, "%s/oauth/emailrequest", endpoints[ctx->env]);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Content-Type", "application/x-www-form-urlencoded",
+		NULL
+		// clang-format on
+	};
+
+	char *payload;
+	char *email = netw_percent_encode(in_email, strlen(in_email), NULL);
+	int nbytes =
+	  asprintf(&payload, "api_key=%s&email=%s", ctx->api_key, email);
+	free(email);
+	LOG("payload: %s (%i)", payload, nbytes);
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.email_request = in_callback;
+	task->callback.userdata = in_udata;
+	if (!submit_request(ctx,
+	      NETW_VERB_POST,
+	      path,
+	      headers,
+	      payload,
+	      (size_t)nbytes,
+	      NULL,
+	      handle_email_request,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(payload);
+	free(path);
+}
+
+
+void
+minimod_ctx_email_exchange(
+  struct minimod_ctx *ctx,
+  char const *in_code,
+  minimod_access_token_callback in_callback,
+  void *in_udata)
+{
+	char *path;
+	asprintf(&path, "%s/oauth/emailexchange", endpoints[ctx->env]);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Content-Type", "application/x-www-form-urlencoded",
+		NULL
+		// clang-format on
+	};
+
+	char *payload;
+	int nbytes = asprintf(
+	  &payload,
+	  "api_key=%s&security_code=%s",
+	  ctx->api_key,
+	  in_code);
+	LOG("payload: %s (%i)", payload, nbytes);
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.access_token = in_callback;
+	task->callback.userdata = in_udata;
+	if (!submit_request(ctx,
+	      NETW_VERB_POST,
+	      path,
+	      headers,
+	      payload,
+	      (size_t)nbytes,
+	      NULL,
+	      handle_token_exchange,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(payload);
+	free(path);
+}
+
+
+void
+minimod_ctx_steam_auth(
+  struct minimod_ctx *ctx,
+  void const *in_ticket,
+  size_t in_ticketbytes,
+  minimod_access_token_callback in_callback,
+  void *in_udata)
+{
+	char *path;
+	asprintf(&path, "%s/external/steamauth", endpoints[ctx->env]);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Content-Type", "application/x-www-form-urlencoded",
+		NULL
+		// clang-format on
+	};
+
+	char b64[256];
+	size_t b64_len = enc_base64(in_ticket, in_ticketbytes, b64, sizeof b64);
+	ASSERT(b64_len <= sizeof b64);
+	char *ticket = netw_percent_encode(b64, b64_len, NULL);
+	char *payload;
+	int nbytes =
+	  asprintf(&payload, "api_key=%s&appdata=%s", ctx->api_key, ticket);
+	LOG("payload: %s (%i)", payload, nbytes);
+	free(ticket);
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.access_token = in_callback;
+	task->callback.userdata = in_udata;
+	if (!submit_request(ctx,
+	      NETW_VERB_POST,
+	      path,
+	      headers,
+	      payload,
+	      (size_t)nbytes,
+	      NULL,
+	      handle_token_exchange,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(payload);
+	free(path);
+}
+
+
+minimod_handle
+minimod_ctx_get_me(
+  struct minimod_ctx *ctx,
+  minimod_get_users_callback in_callback,
+  void *in_udata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return 0;
+	}
+
+	char *path;
+	asprintf(&path, "%s/me", endpoints[ctx->env]);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.fptr.get_users = in_callback;
+	task->callback.userdata = in_udata;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_users, task);
+
+	free(path);
+
+	return handle;
+}
+
+
+static char *
+path_user_events(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff)
+{
+	char *game_filter = NULL;
+	if (in_game_id)
+	{
+		asprintf(&game_filter, "&game_id=%" PRIu64, in_game_id);
+	}
+	char *cutoff_filter = NULL;
+	if (in_date_cutoff)
+	{
+		asprintf(&cutoff_filter, "&date_added-gt=%" PRIu64, in_date_cutoff);
+	}
+	char *path;
+	asprintf(
+	  &path,
+	  "%s/me/events?%s%s%s",
+	  endpoints[ctx->env],
+	  in_filter ? in_filter : "",
+	  game_filter ? game_filter : "",
+	  cutoff_filter ? cutoff_filter : "");
+	free(game_filter);
+	free(cutoff_filter);
+	return path;
+}
+
+
+minimod_handle
+minimod_ctx_get_user_events(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return 0;
+	}
+
+	char *path = path_user_events(ctx, in_filter, in_game_id, in_date_cutoff);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		NULL
+		// clang-format on
+	};
+	LOG("request: %s", path);
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.fptr.get_events = in_callback;
+	task->callback.userdata = in_userdata;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_events, task);
+
+	free(path);
+
+	return handle;
+}
+
+
+static minimod_handle
+get_dependencies(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_dependencies_callback in_callback,
+  void *in_userdata)
+{
+
+	char *path;
+	asprintf(
+	  &path,
+	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/dependencies?api_key=%s",
+	  endpoints[ctx->env],
+	  in_game_id,
+	  in_mod_id,
+	  ctx->api_key);
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_dependencies = in_callback;
+	task->callback.userdata = in_userdata;
+	minimod_handle const handle =
+	  submit_get(path, NULL, deliver_dependencies, task);
+
+	free(path);
+	return handle;
+}
+
+
+minimod_handle
+minimod_ctx_get_dependencies(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_dependencies_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	return get_dependencies(
+	  ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
+}
+
+
+bool
+minimod_ctx_is_authenticated(struct minimod_ctx *ctx)
+{
+	uintptr_t const pinned = __atomic_load_n(&ctx->auth, __ATOMIC_ACQUIRE);
+	return (pinned & ~AUTH_PINS_MASK) != 0;
+}
+
+
+void
+minimod_ctx_deauthenticate(struct minimod_ctx *ctx)
+{
+	fsu_rmfile(get_tokenpath(ctx));
+	swap_auth(ctx, NULL);
+}
+
+
+static char *
+path_modfiles(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id)
+{
+	char *path;
+	if (in_modfile_id)
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/files/%" PRIu64
+		  "?api_key=%s&%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  in_mod_id,
+		  in_modfile_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "");
+	}
+	else
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/files?api_key=%s&%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  in_mod_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "");
+	}
+	return path;
+}
+
+
+static minimod_handle
+get_modfiles(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  enum minimod_priority in_priority,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata)
+{
+	char *path =
+	  path_modfiles(ctx, in_filter, in_game_id, in_mod_id, in_modfile_id);
+	LOG("request: %s", path);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_modfiles = in_callback;
+	task->callback.userdata = in_userdata;
+	task->control.priority = in_priority;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_modfiles, task);
+
+	free(path);
+	return handle;
+}
+
+
+minimod_handle
+minimod_ctx_get_modfiles(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	return get_modfiles(ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_modfile_id,
+	  MINIMOD_PRIORITY_INTERACTIVE,
+	  in_callback,
+	  in_userdata);
+}
+
+
+static char *
+path_mod_events(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff)
+{
+	char *cutoff = NULL;
+	if (in_date_cutoff)
+	{
+		asprintf(&cutoff, "&date_added-gt=%" PRIu64, in_date_cutoff);
+	}
+	char *path;
+	if (in_mod_id)
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/events/"
+		  "?api_key=%s&%s%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  in_mod_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "",
+		  cutoff ? cutoff : "");
+	}
+	else
+	{
+		asprintf(
+		  &path,
+		  "%s/games/%" PRIu64 "/mods/events?api_key=%s&%s%s",
+		  endpoints[ctx->env],
+		  in_game_id,
+		  ctx->api_key,
+		  in_filter ? in_filter : "",
+		  cutoff ? cutoff : "");
+	}
+	free(cutoff);
+	return path;
+}
+
+
+minimod_handle
+minimod_ctx_get_mod_events(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	char *path =
+	  path_mod_events(ctx, in_filter, in_game_id, in_mod_id, in_date_cutoff);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		NULL
+		// clang-format on
+	};
+	LOG("request: %s", path);
+
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_events = in_callback;
+	task->callback.userdata = in_userdata;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_events, task);
+
+	free(path);
+	return handle;
+}
+
+
+static char *
+get_mod_dir(struct minimod_ctx *ctx, uint64_t in_game_id, uint64_t in_mod_id)
+{
+	char *dir;
+	asprintf(
+	  &dir,
+	  "%s/mods/%" PRIu64 "/%" PRIu64,
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	return dir;
+}
+
+
+// Installations are aborted once they are cancelled by all who wait for
+// them, see update_installs().
+static bool
+is_install_aborted(struct install_request *req)
+{
+	return __atomic_load_n(
+	  &req->extract_progress.is_cancelled,
+	  __ATOMIC_ACQUIRE);
+}
+
+
+static void
+report_install_queue(struct minimod_ctx *ctx)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	struct minimod_install_queue_stats stats = ctx->install_queue_stats;
+	minimod_install_queue_callback callback = ctx->install_queue_callback;
+	void *userdata = ctx->install_queue_userdata;
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	if (callback)
+	{
+		callback(userdata, &stats);
+	}
+}
+
+
+// Once the download of an installation is over, the next queued
+// installation may start.
+static void
+release_download_slot(struct install_request *req, bool in_is_downloaded)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	mtx_lock(&ctx->install_requests_mtx);
+	if (req->has_download_slot)
+	{
+		req->has_download_slot = false;
+		ctx->install_queue_stats.ndownloading -= 1;
+		if (in_is_downloaded)
+		{
+			ctx->install_queue_stats.nbytes_done += req->filesize;
+		}
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	pump_install_queue(ctx);
+}
+
+
+// Only installations holding an extraction slot may stream their archive
+// into the extractor.
+static bool
+try_acquire_extraction_slot(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	mtx_lock(&ctx->install_requests_mtx);
+	if (ctx->nextraction_slots < ctx->max_extractions)
+	{
+		ctx->nextraction_slots += 1;
+		ctx->install_queue_stats.nextracting += 1;
+		req->has_extraction_slot = true;
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+	return req->has_extraction_slot;
+}
+
+
+static void
+on_install_extracted(
+  void *in_udata,
+  enum extract_result in_result,
+  struct extract_stats const *in_stats);
+
+
+static void
+submit_extraction(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	char *dir = get_mod_dir(ctx, req->game_id, req->mod_id);
+	extractor_submit(
+	  ctx->extractor,
+	  req->zip_path,
+	  dir,
+	  &req->extract_progress,
+	  on_install_extracted,
+	  req);
+	free(dir);
+}
+
+
+// Extract a downloaded archive, as soon as there is a slot for it.
+static void
+queue_extraction(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	mtx_lock(&ctx->install_requests_mtx);
+	ctx->install_queue_stats.nextracting += 1;
+	if (ctx->nextraction_slots < ctx->max_extractions)
+	{
+		ctx->nextraction_slots += 1;
+		req->has_extraction_slot = true;
+	}
+	else
+	{
+		// sorted by priority like the install queue, so a mod the user
+		// waits for is not extracted after a batch of background updates
+		struct install_request **it = &ctx->extract_queue;
+		while (*it && (*it)->priority <= req->priority)
+		{
+			it = &(*it)->queue_next;
+		}
+		req->queue_next = *it;
+		*it = req;
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	if (req->has_extraction_slot)
+	{
+		submit_extraction(req);
+	}
+	report_install_queue(ctx);
+}
+
+
+// Pass the slot on to the most urgent waiting extraction, if any.
+static void
+release_extraction_slot(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	mtx_lock(&ctx->install_requests_mtx);
+	struct install_request *next = NULL;
+	if (req->has_extraction_slot)
+	{
+		req->has_extraction_slot = false;
+		ctx->install_queue_stats.nextracting -= 1;
+		next = ctx->extract_queue;
+		if (next && ctx->nextraction_slots <= ctx->max_extractions)
+		{
+			ctx->extract_queue = next->queue_next;
+			next->has_extraction_slot = true;
+		}
+		else
+		{
+			next = NULL;
+			ctx->nextraction_slots -= 1;
+		}
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	if (next)
+	{
+		submit_extraction(next);
+	}
+}
+
+
+static void
+write_part_meta(struct install_request *req, uint64_t in_offset)
+{
+	char *meta_path;
+	asprintf(&meta_path, "%s.meta", req->part_path);
+	FILE *f = fsu_fopen(meta_path, "wb");
+	if (f)
+	{
+		fprintf(
+		  f,
+		  PART_FILE_MAGIC "%" PRIu64 "\n%s\n%" PRIu64 "\n",
+		  req->modfile_id,
+		  req->md5 ? req->md5 : "-",
+		  in_offset);
+		fclose(f);
+	}
+	free(meta_path);
+}
+
+
+static void
+remove_part(struct install_request *req)
+{
+	char *meta_path;
+	asprintf(&meta_path, "%s.meta", req->part_path);
+	fsu_rmfile(meta_path);
+	fsu_rmfile(req->part_path);
+	free(meta_path);
+}
+
+
+// Get the number of bytes of a previous download of the same modfile.
+// Partial downloads of anything else are removed.
+static uint64_t
+get_resume_offset(struct install_request *req)
+{
+	char *meta_path;
+	asprintf(&meta_path, "%s.meta", req->part_path);
+	FILE *f = fsu_fopen(meta_path, "rb");
+	free(meta_path);
+	if (!f)
+	{
+		fsu_rmfile(req->part_path);
+		return 0;
+	}
+
+	char meta[256];
+	size_t const nmeta = fread(meta, 1, sizeof meta - 1, f);
+	fclose(f);
+	meta[nmeta] = '\0';
+
+	uint64_t modfile_id = 0;
+	char md5[33] = { 0 };
+	uint64_t offset = 0;
+	int const nparsed = sscanf(
+	  meta,
+	  PART_FILE_MAGIC "%" SCNu64 "%32s%" SCNu64,
+	  &modfile_id,
+	  md5,
+	  &offset);
+
+	// stdio writes everything in order, so whatever is in the file
+	// after the recorded offset is valid as well.
+	int64_t const fsize = fsu_fsize(req->part_path);
+	if (
+	  nparsed != 3 || modfile_id != req->modfile_id
+	  || 0 != strcmp(md5, req->md5 ? req->md5 : "-") || fsize <= 0
+	  || (uint64_t)fsize < offset)
+	{
+		remove_part(req);
+		return 0;
+	}
+	return (uint64_t)fsize;
+}
+
+
+// The server ignored the Range header and sent the whole file, which was
+// appended to the partial download.
+static bool
+drop_part_prefix(struct install_request *req)
+{
+	int64_t const fsize = fsu_fsize(req->part_path);
+	char *tmp_path;
+	asprintf(&tmp_path, "%s.tmp", req->part_path);
+	FILE *src = fsu_fopen(req->part_path, "rb");
+	FILE *dst = fsu_fopen(tmp_path, "wb");
+	bool ok = src && dst && fsize >= (int64_t)req->resume_offset
+	  && fsu_copy_range(
+	    src,
+	    req->resume_offset,
+	    (uint64_t)fsize - req->resume_offset,
+	    dst);
+	if (src)
+	{
+		fclose(src);
+	}
+	ok = dst && (0 == fclose(dst)) && ok;
+	ok = ok && fsu_mvfile(tmp_path, req->part_path, true);
+	if (!ok)
+	{
+		fsu_rmfile(tmp_path);
+	}
+	free(tmp_path);
+	return ok;
+}
+
+
+static void
+hash_file(char const *in_path, struct md5 *io_md5)
+{
+	FILE *f = fsu_fopen(in_path, "rb");
+	if (f)
+	{
+		char buffer[64 * 1024];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof buffer, f)) > 0)
+		{
+			md5_update(io_md5, buffer, n);
+		}
+		fclose(f);
+	}
+}
+
+
+// Failing the write aborts the download.
+static bool
+on_install_write(void *in_userdata, void const *in_data, size_t in_bytes)
+{
+	struct install_request *req = in_userdata;
+	if (req->is_hashing)
+	{
+		md5_update(&req->file_md5, in_data, in_bytes);
+		if (req->resume_offset > 0)
+		{
+			md5_update(&req->response_md5, in_data, in_bytes);
+		}
+	}
+	return !is_install_aborted(req);
+}
+
+
+static char *
+get_zip_md5_path(struct install_request *req)
+{
+	char *path;
+	asprintf(&path, "%s.md5", req->zip_path);
+	return path;
+}
+
+
+// Is the ZIP file on disk the modfile to be installed?
+static bool
+is_zip_current(struct install_request *req)
+{
+	if (!req->md5 || fsu_fsize(req->zip_path) != (int64_t)req->filesize)
+	{
+		return false;
+	}
+
+	char *md5_path = get_zip_md5_path(req);
+	FILE *f = fsu_fopen(md5_path, "rb");
+	free(md5_path);
+	char md5[33] = { 0 };
+	bool const has_md5 = f && 32 == fread(md5, 1, 32, f);
+	if (f)
+	{
+		fclose(f);
+	}
+	return has_md5 && 0 == strcmp(md5, req->md5);
+}
+
+
+// Move a complete download to zip_path, or keep an incomplete one to be
+// resumed by the next installation of the same modfile.
+static enum minimod_install_error
+finish_part(
+  struct install_request *req,
+  int in_status,
+  enum minimod_install_error in_error)
+{
+	enum minimod_install_error error = in_error;
+	bool const is_range_ignored = (in_status == 200 && req->resume_offset > 0);
+	if (in_status >= 300)
+	{
+		// whatever was appended is not part of the file
+		fsu_truncate(req->part_path, req->resume_offset);
+	}
+	else if (is_range_ignored)
+	{
+		LOG("range ignored, dropping %" PRIu64 " bytes", req->resume_offset);
+		if (!drop_part_prefix(req))
+		{
+			fsu_truncate(req->part_path, 0);
+			error = MINIMOD_INSTALL_ERROR_DISK;
+		}
+	}
+
+	int64_t const fsize = fsu_fsize(req->part_path);
+	if (!error && req->filesize > 0 && fsize != (int64_t)req->filesize)
+	{
+		LOGE(
+		  "downloaded %" PRId64 " bytes instead of %" PRIu64,
+		  fsize,
+		  req->filesize);
+		error = MINIMOD_INSTALL_ERROR_DOWNLOAD;
+	}
+
+	char md5[33] = { 0 };
+	if (!error && req->md5)
+	{
+		if (!req->is_hashing)
+		{
+			// no streams to hash the download while it is written
+			md5_init(&req->file_md5);
+			hash_file(req->part_path, &req->file_md5);
+		}
+		md5_final(
+		  is_range_ignored && req->is_hashing ? &req->response_md5
+		                                      : &req->file_md5,
+		  md5);
+		if (0 != strcmp(md5, req->md5))
+		{
+			LOGE("md5 mismatch: %s instead of %s", md5, req->md5);
+			error = MINIMOD_INSTALL_ERROR_CHECKSUM;
+		}
+	}
+
+	if (!error && !fsu_mvfile(req->part_path, req->zip_path, true))
+	{
+		error = MINIMOD_INSTALL_ERROR_DISK;
+	}
+
+	if (
+	  !error || error == MINIMOD_INSTALL_ERROR_CHECKSUM || fsize <= 0
+	  || (req->filesize > 0 && (uint64_t)fsize >= req->filesize))
+	{
+		remove_part(req);
+	}
+	else
+	{
+		LOG("keeping %" PRId64 " bytes of %s", fsize, req->part_path);
+		write_part_meta(req, (uint64_t)fsize);
+	}
+
+	// remember the digest, so an identical ZIP file is not downloaded again
+	if (!error && req->md5)
+	{
+		char *md5_path = get_zip_md5_path(req);
+		FILE *f = fsu_fopen(md5_path, "wb");
+		if (f)
+		{
+			fputs(md5, f);
+			fclose(f);
+		}
+		free(md5_path);
+	}
+	return error;
+}
+
+
+static bool
+write_install_json(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	char *jpath;
+	asprintf(
+	  &jpath,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
+	  ctx->root_path,
+	  req->game_id,
+	  req->mod_id);
+	FILE *jout = fsu_fopen(jpath, "wb");
+	bool ok = jout && req->njson == fwrite(req->json, 1, req->njson, jout);
+	ok = jout && (0 == fclose(jout)) && ok;
+	if (!ok)
+	{
+		LOGE("failed to write %s", jpath);
+	}
+	free(jpath);
+	return ok;
+}
+
+
+static void
+finish_install(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	enum minimod_install_error error =
+	  __atomic_load_n(&req->error, __ATOMIC_ACQUIRE);
+	// the json file marks the mod as installed
+	if (!error)
+	{
+		modindex_begin(ctx->installed);
+		if (write_install_json(req))
+		{
+			uint64_t const nbytes =
+			  ctx->unzip ? req->extract_stats.nbytes : req->filesize;
+			struct modindex_entry const entry = {
+				.game_id = req->game_id,
+				.mod_id = req->mod_id,
+				.modfile_id = req->modfile_id,
+				.date_updated = req->date_updated,
+				.nbytes = nbytes,
+				.is_zip = !ctx->unzip,
+			};
+			modindex_put(ctx->installed, &entry);
+		}
+		else
+		{
+			error = MINIMOD_INSTALL_ERROR_DISK;
+		}
+		modindex_end(ctx->installed);
+	}
+	bool const success = !error;
+
+	if (success && ctx->unzip && ctx->install_stats_callback)
+	{
+		struct minimod_install_stats stats = {
+			.nfiles = req->extract_stats.nfiles,
+			.nbytes = req->extract_stats.nbytes,
+			.nbytes_compressed = req->extract_stats.nbytes_compressed,
+			.extract_usecs = req->extract_stats.usecs,
+		};
+		ctx->install_stats_callback(
+		  ctx->install_stats_userdata,
+		  req->game_id,
+		  req->mod_id,
+		  &stats);
+	}
+
+	// nobody is waiting for an aborted installation
+	bool const is_aborted = is_install_aborted(req);
+	mtx_lock(&ctx->install_requests_mtx);
+	if (success)
+	{
+		ctx->install_queue_stats.nsucceeded += 1;
+	}
+	else if (!is_aborted)
+	{
+		ctx->install_queue_stats.nfailed += 1;
+	}
+	// stalled installations were reported already. Either way no further
+	// installation can join this one from now on.
+	bool const is_reported =
+	  __atomic_exchange_n(&req->is_callback_invoked, true, __ATOMIC_ACQ_REL);
+	struct install_waiter *waiters = req->waiters;
+	req->waiters = NULL;
+	mtx_unlock(&ctx->install_requests_mtx);
+	report_install_queue(ctx);
+
+	// the error is still reported, if only the callback was cancelled
+	bool const is_cancelled = unregister_control(ctx, &req->control);
+	if (!is_reported && !is_aborted)
+	{
+		invoke_install_callback(ctx,
+		  req->control.handle,
+		  is_cancelled ? NULL : req->callback,
+		  req->userdata,
+		  req->game_id,
+		  req->mod_id,
+		  error);
+	}
+	else if (!is_reported)
+	{
+		finish_handle(ctx, req->control.handle);
+	}
+	invoke_install_waiters(ctx, waiters, req->game_id, req->mod_id, error);
+	free_install_request(req);
+}
+
+
+static void
+set_install_error(
+  struct install_request *req,
+  enum minimod_install_error in_error)
+{
+	// the first error is the cause of all others
+	enum minimod_install_error none = MINIMOD_INSTALL_ERROR_NONE;
+	__atomic_compare_exchange_n(
+	  &req->error,
+	  &none,
+	  in_error,
+	  false,
+	  __ATOMIC_ACQ_REL,
+	  __ATOMIC_ACQUIRE);
+}
+
+
+// Called at the end of every concurrent step of an installation.
+// The last one finishes the installation.
+static void
+finish_install_step(
+  struct install_request *req,
+  enum minimod_install_error in_error)
+{
+	if (in_error)
+	{
+		set_install_error(req, in_error);
+	}
+	if (0 == __atomic_sub_fetch(&req->npending, 1, __ATOMIC_ACQ_REL))
+	{
+		finish_install(req);
+	}
+}
+
+
+static void
+on_install_extracted(
+  void *in_udata,
+  enum extract_result in_result,
+  struct extract_stats const *in_stats)
+{
+	struct install_request *req = in_udata;
+
+	enum minimod_install_error error = MINIMOD_INSTALL_ERROR_NONE;
+	if (in_result == EXTRACT_ERR_CHECKSUM)
+	{
+		error = MINIMOD_INSTALL_ERROR_CHECKSUM;
+	}
+	else if (in_result == EXTRACT_ERR_CANCELLED)
+	{
+		error = MINIMOD_INSTALL_ERROR_CANCELLED;
+	}
+	else if (in_result != EXTRACT_OK)
+	{
+		LOGE("mod NOT extracted");
+		error = MINIMOD_INSTALL_ERROR_EXTRACT;
+	}
+	req->extract_stats = *in_stats;
+	__atomic_store_n(&req->phase, MINIMOD_INSTALL_PHASE_NONE, __ATOMIC_RELEASE);
+
+	if (!req->is_streaming)
+	{
+		char *md5_path = get_zip_md5_path(req);
+		fsu_rmfile(md5_path);
+		free(md5_path);
+		fsu_rmfile(req->zip_path);
+	}
+	release_extraction_slot(req);
+	finish_install_step(req, error);
+}
+
+
+static void
+send_download(struct install_request *req, FILE *fout);
+static void
+download_to_part(void *in_userdata);
+
+
+static void
+on_install_download(
+  void *in_udata,
+  FILE *in_file,
+  int error,
+  struct netw_header const *UNUSED(in_header))
+{
+	struct install_request *req = in_udata;
+	struct minimod_ctx *ctx = req->ctx;
+	// Downloads are not authenticated, thusly there is no need to handle
+	// rate-limiting or authorization errors.
+	bool const is_downloaded =
+	  (error == 200 || (error == 206 && req->resume_offset > 0));
+	if (!is_downloaded)
+	{
+		LOGE("mod NOT downloaded %i", error);
+	}
+	else
+	{
+		LOG("mod downloaded");
+	}
+
+	// for streamed installations this signals the end of the archive to
+	// the extractor.
+	bool const is_closed = (0 == fclose(in_file));
+	enum minimod_install_error install_error = MINIMOD_INSTALL_ERROR_NONE;
+	if (is_install_aborted(req))
+	{
+		// failing its writes is the only way to abort a download
+		install_error = MINIMOD_INSTALL_ERROR_CANCELLED;
+	}
+	else if (!is_downloaded)
+	{
+		install_error = MINIMOD_INSTALL_ERROR_DOWNLOAD;
+	}
+	else if (!is_closed)
+	{
+		install_error = MINIMOD_INSTALL_ERROR_DISK;
+	}
+	if (!req->is_streaming)
+	{
+		install_error = finish_part(req, error, install_error);
+	}
+
+	// what was streamed into the extractor cannot be sent again, but a
+	// .part file is resumed by the retry
+	uint32_t const retry_delay =
+	  (install_error == MINIMOD_INSTALL_ERROR_DOWNLOAD && !req->is_streaming)
+	  ? next_retry_delay(ctx, &req->download_retry, error)
+	  : 0;
+	if (retry_delay > 0)
+	{
+		__atomic_store_n(
+		  &req->phase,
+		  MINIMOD_INSTALL_PHASE_NONE,
+		  __ATOMIC_RELEASE);
+		call_later(ctx, retry_delay, download_to_part, req);
+		return;
+	}
+	report_retry(ctx, &req->download_retry, error);
+
+	bool const is_written = !install_error;
+	__atomic_store_n(
+	  &req->phase,
+	  (ctx->unzip && is_written) ? MINIMOD_INSTALL_PHASE_EXTRACTING
+	                              : MINIMOD_INSTALL_PHASE_NONE,
+	  __ATOMIC_RELEASE);
+	release_download_slot(req, is_written);
+
+	// extract zip?
+	if (ctx->unzip && is_written && !req->is_streaming)
+	{
+		// do not block the network thread with extracting it
+		queue_extraction(req);
+		return;
+	}
+
+	finish_install_step(req, install_error);
+}
+
+
+static bool
+json_print_callback(void *ptr, const char *buffer, size_t size)
+{
+	struct install_request *req = ptr;
+	req->json = realloc(req->json, req->njson + size);
+	memcpy(req->json + req->njson, buffer, size);
+	req->njson += size;
+	return true;
+}
+
+
+static void
+on_install_get_mod(
+  void *in_userdata,
+  size_t in_nmods,
+  struct minimod_mod const *in_mods,
+  struct minimod_pagination const *UNUSED(pagi))
+{
+	ASSERT(in_nmods <= 1);
+	struct install_request *req = in_userdata;
+
+	if (is_install_aborted(req))
+	{
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_CANCELLED);
+		return;
+	}
+	if (in_nmods > 0)
+	{
+		// keep it until the mod is installed
+		req->date_updated = in_mods[0].date_updated;
+		QAJ4C_print_buffer_callback(
+		  in_mods[0].more,
+		  json_print_callback,
+		  req);
+	}
+	else
+	{
+		LOGE("mod NOT found");
+	}
+
+	finish_install_step(
+	  req,
+	  in_nmods > 0 ? MINIMOD_INSTALL_ERROR_NONE
+	               : MINIMOD_INSTALL_ERROR_NOT_FOUND);
+}
+
+
+static void
+on_install_get_modfile(
+  void *in_userdata,
+  size_t nmodfiles,
+  struct minimod_modfile const *modfiles,
+  struct minimod_pagination const *UNUSED(pagi))
+{
+	ASSERT(nmodfiles <= 1);
+	struct install_request *req = in_userdata;
+	struct minimod_ctx *ctx = req->ctx;
+
+	if (is_install_aborted(req))
+	{
+		release_download_slot(req, false);
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_CANCELLED);
+		return;
+	}
+	if (nmodfiles == 0)
+	{
+		LOGE("modfile NOT found");
+		release_download_slot(req, false);
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_NOT_FOUND);
+		return;
+	}
+
+	mtx_lock(&ctx->install_requests_mtx);
+	req->filesize = modfiles[0].filesize;
+	ctx->install_queue_stats.nbytes_total += req->filesize;
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	req->modfile_id = modfiles[0].id;
+	bool const has_md5 = modfiles[0].md5 && *modfiles[0].md5;
+	req->md5 = has_md5 ? strdup(modfiles[0].md5) : NULL;
+	asprintf(
+	  &req->zip_path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip",
+	  ctx->root_path,
+	  req->game_id,
+	  req->mod_id);
+	asprintf(&req->part_path, "%s.part", req->zip_path);
+
+	if (is_zip_current(req))
+	{
+		LOG("%s is up to date", req->zip_path);
+		release_download_slot(req, true);
+		if (ctx->unzip)
+		{
+			__atomic_store_n(
+			  &req->phase,
+			  MINIMOD_INSTALL_PHASE_EXTRACTING,
+			  __ATOMIC_RELEASE);
+			queue_extraction(req);
+			return;
+		}
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_NONE);
+		return;
+	}
+
+	FILE *fout = NULL;
+	// Large archives and those partially downloaded before are downloaded
+	// to disk, so they can be resumed. So are those without a free
+	// extraction slot, which wait there for their extraction.
+	if (
+	  ctx->unzip && req->filesize < RESUMABLE_MIN_BYTES
+	  && fsu_ptype(req->part_path) == FSU_PATHTYPE_NONE
+	  && try_acquire_extraction_slot(req))
+	{
+		// extract the archive while it is downloading, instead of
+		// writing it to disk and reading it back afterwards.
+		FILE *pipe_read = NULL;
+		if (sys_pipe(&pipe_read, &fout))
+		{
+			// the extraction is one more concurrent step
+			__atomic_add_fetch(&req->npending, 1, __ATOMIC_ACQ_REL);
+			char *dir = get_mod_dir(ctx, req->game_id, req->mod_id);
+			req->is_streaming = extractor_submit_stream(
+			  ctx->extractor,
+			  pipe_read,
+			  dir,
+			  req->md5,
+			  &req->extract_progress,
+			  on_install_extracted,
+			  req);
+			free(dir);
+			if (!req->is_streaming)
+			{
+				__atomic_sub_fetch(&req->npending, 1, __ATOMIC_ACQ_REL);
+				fclose(pipe_read);
+				fclose(fout);
+				fout = NULL;
+			}
+		}
+		if (!req->is_streaming)
+		{
+			release_extraction_slot(req);
+		}
+	}
+
+	retry_begin(ctx, &req->download_retry, modfiles[0].url, NULL);
+	if (fout)
+	{
+		// only to abort the download, see on_install_write()
+		req->is_hashing = false;
+		FILE *tee = fsu_tee(fout, on_install_write, req);
+		send_download(req, tee ? tee : fout);
+	}
+	else
+	{
+		download_to_part(req);
+	}
+}
+
+
+static void
+send_download(struct install_request *req, FILE *fout)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	char range[32];
+	char const *const range_headers[] = {
+		// clang-format off
+		"Range", range,
+		NULL
+		// clang-format on
+	};
+	if (req->resume_offset > 0)
+	{
+		LOG("resuming download at %" PRIu64, req->resume_offset);
+		snprintf(range, sizeof range, "bytes=%" PRIu64 "-", req->resume_offset);
+	}
+
+	req->file = fout;
+	mtx_lock(&ctx->install_requests_mtx);
+	req->download_start = sys_microseconds();
+	// starts sampling anew, after a retry. Bytes kept from a previous
+	// download were not received now.
+	req->last_report = 0;
+	req->last_nbytes = req->resume_offset;
+	mtx_unlock(&ctx->install_requests_mtx);
+	__atomic_store_n(
+	  &req->phase,
+	  MINIMOD_INSTALL_PHASE_DOWNLOADING,
+	  __ATOMIC_RELEASE);
+
+	if (req->filesize > 0 && req->resume_offset >= req->filesize)
+	{
+		// nothing left to download
+		on_install_download(req, fout, 206, NULL);
+	}
+	else if (!send_netw_download(
+	           ctx,
+	           req->download_retry.url,
+	           req->resume_offset > 0 ? range_headers : NULL,
+	           fout,
+	           on_install_download,
+	           req))
+	{
+		on_install_download(req, fout, 0, NULL);
+	}
+}
+
+
+// Downloads the modfile to the .part file, continuing a previous download.
+// Also used to retry failed downloads.
+static void
+download_to_part(void *in_userdata)
+{
+	struct install_request *req = in_userdata;
+	if (is_install_aborted(req))
+	{
+		release_download_slot(req, false);
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_CANCELLED);
+		return;
+	}
+	req->resume_offset = get_resume_offset(req);
+	FILE *fout =
+	  fsu_fopen(req->part_path, req->resume_offset > 0 ? "ab" : "wb");
+	if (!fout)
+	{
+		LOGE("failed to create %s", req->part_path);
+		release_download_slot(req, false);
+		finish_install_step(req, MINIMOD_INSTALL_ERROR_DISK);
+		return;
+	}
+	write_part_meta(req, req->resume_offset);
+
+	// verify the download while it is written, not afterwards
+	if (req->md5)
+	{
+		md5_init(&req->file_md5);
+		md5_init(&req->response_md5);
+		if (req->resume_offset > 0)
+		{
+			hash_file(req->part_path, &req->file_md5);
+		}
+	}
+	// also without a digest, to be able to abort the download
+	FILE *tee = fsu_tee(fout, on_install_write, req);
+	req->is_hashing = (tee != NULL && req->md5 != NULL);
+	send_download(req, tee ? tee : fout);
+}
+
+
+static void
+start_install(struct install_request *req)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	// Fetching the meta-data and the modfile->download->extraction chain
+	// run concurrently. Whichever step finishes last invokes the callback.
+	req->npending = 2;
+
+	// the priorities of installations map to those of requests
+	enum minimod_priority const priority =
+	  (enum minimod_priority)req->priority;
+	LOG("install: get_mods + get_modfiles");
+	get_mods(ctx,
+	  NULL,
+	  req->game_id,
+	  req->mod_id,
+	  priority,
+	  on_install_get_mod,
+	  req);
+	get_modfiles(ctx,
+	  "_sort=-date_added&_limit=1",
+	  req->game_id,
+	  req->mod_id,
+	  req->modfile_id,
+	  priority,
+	  on_install_get_modfile,
+	  req);
+}
+
+
+// An installation which invoked its callback already or is aborted may
+// still write to the files of its mod until it is freed, e.g. a stalled
+// download. Another installation of the mod needs to wait for that.
+// Needs to be called with install_requests_mtx locked.
+static bool
+is_mod_busy(struct minimod_ctx *ctx, struct install_request const *in_req)
+{
+	for (struct install_request *r = ctx->install_requests; r; r = r->next)
+	{
+		if (
+		  r != in_req && r->is_started && r->game_id == in_req->game_id
+		  && r->mod_id == in_req->mod_id)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Start queued installations, as long as there are download slots left.
+// Installations of a mod which is busy stay queued, see
+// free_install_request().
+static void
+pump_install_queue(struct minimod_ctx *ctx)
+{
+	for (;;)
+	{
+		mtx_lock(&ctx->install_requests_mtx);
+		struct install_request **it = &ctx->install_queue;
+		if (
+		  ctx->is_install_queue_closed
+		  || ctx->install_queue_stats.ndownloading >= ctx->max_downloads)
+		{
+			it = NULL;
+		}
+		while (it && *it && is_mod_busy(ctx, *it))
+		{
+			it = &(*it)->queue_next;
+		}
+		struct install_request *req = it ? *it : NULL;
+		if (req)
+		{
+			*it = req->queue_next;
+			req->queue_next = NULL;
+			req->is_started = true;
+			req->has_download_slot = true;
+			ctx->install_queue_stats.nqueued -= 1;
+			ctx->install_queue_stats.ndownloading += 1;
+		}
+		mtx_unlock(&ctx->install_requests_mtx);
+
+		if (!req)
+		{
+			break;
+		}
+		start_install(req);
+	}
+
+	report_install_queue(ctx);
+}
+
+
+minimod_handle
+minimod_ctx_install(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  minimod_install_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_enqueue_install(
+	  ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_modfile_id,
+	  MINIMOD_INSTALL_PRIORITY_USER,
+	  in_callback,
+	  in_userdata);
+}
+
+
+// Moves an installation within *in_queue* to its (new) priority.
+//
+// Returns:
+//	false if it is not in the queue.
+static bool
+requeue(
+  struct install_request **in_queue,
+  struct install_request *req,
+  enum minimod_install_priority in_priority)
+{
+	struct install_request **it = in_queue;
+	while (*it && *it != req)
+	{
+		it = &(*it)->queue_next;
+	}
+	if (!*it)
+	{
+		return false;
+	}
+	*it = req->queue_next;
+	req->priority = in_priority;
+	it = in_queue;
+	while (*it && (*it)->priority <= in_priority)
+	{
+		it = &(*it)->queue_next;
+	}
+	req->queue_next = *it;
+	*it = req;
+	return true;
+}
+
+
+// Moves a queued installation, or one waiting for its extraction, to its
+// (new) priority.
+// Needs to be called with install_requests_mtx locked.
+static void
+requeue_install(
+  struct install_request *req,
+  enum minimod_install_priority in_priority)
+{
+	struct minimod_ctx *ctx = req->ctx;
+	// in neither queue means it is running already
+	if (!requeue(&ctx->install_queue, req, in_priority))
+	{
+		requeue(&ctx->extract_queue, req, in_priority);
+	}
+}
+
+
+// Attaches the callback to an installation of the same modfile, which
+// is queued or running, so a mod is never downloaded twice at once.
+// A queued installation is moved up, if the new one has a higher priority.
+//
+// Returns:
+//	The handle of the joining installation, 0 if there was none to join.
+static minimod_handle
+join_install(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  enum minimod_install_priority in_priority,
+  minimod_install_callback in_callback,
+  void *in_userdata)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	struct install_request *r = ctx->install_requests;
+	for (; r; r = r->next)
+	{
+		bool const is_same_modfile = in_modfile_id == 0
+		  ? r->is_latest
+		  : r->modfile_id == in_modfile_id;
+		if (
+		  r->game_id == in_game_id && r->mod_id == in_mod_id && is_same_modfile
+		  && !__atomic_load_n(&r->is_callback_invoked, __ATOMIC_ACQUIRE)
+		  && !is_install_aborted(r))
+		{
+			break;
+		}
+	}
+	if (!r)
+	{
+		mtx_unlock(&ctx->install_requests_mtx);
+		return 0;
+	}
+
+	LOG("joining installation of %" PRIu64, in_mod_id);
+	struct install_waiter *waiter = calloc(1, sizeof *waiter);
+	waiter->callback = in_callback;
+	waiter->userdata = in_userdata;
+	waiter->control.priority = (enum minimod_priority)in_priority;
+	waiter->next = r->waiters;
+	r->waiters = waiter;
+	minimod_handle const handle = register_control(ctx, &waiter->control);
+
+	if (in_priority < r->priority)
+	{
+		requeue_install(r, in_priority);
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+	return handle;
+}
+
+
+minimod_handle
+minimod_ctx_enqueue_install(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  enum minimod_install_priority in_priority,
+  minimod_install_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+
+	minimod_handle const joined = join_install(ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_modfile_id,
+	  in_priority,
+	  in_callback,
+	  in_userdata);
+	if (joined)
+	{
+		return joined;
+	}
+
+	struct install_request *req = alloc_install_request(ctx);
+	req->callback = in_callback;
+	req->userdata = in_userdata;
+	req->mod_id = in_mod_id;
+	req->game_id = in_game_id;
+	req->modfile_id = in_modfile_id;
+	req->is_latest = in_modfile_id == 0;
+	req->priority = in_priority;
+	req->control.priority = (enum minimod_priority)in_priority;
+	minimod_handle const handle = register_control(ctx, &req->control);
+
+	mtx_lock(&ctx->install_requests_mtx);
+	struct minimod_install_queue_stats *stats = &ctx->install_queue_stats;
+	if (0 == stats->nqueued + stats->ndownloading + stats->nextracting)
+	{
+		// a new batch
+		memset(stats, 0, sizeof *stats);
+	}
+	stats->nqueued += 1;
+
+	// sorted by priority, first come first served within a priority
+	struct install_request **it = &ctx->install_queue;
+	while (*it && (*it)->priority <= in_priority)
+	{
+		it = &(*it)->queue_next;
+	}
+	req->queue_next = *it;
+	*it = req;
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	pump_install_queue(ctx);
+	return handle;
+}
+
+
+// An installation is as urgent as the most urgent of the parties waiting
+// for it, and aborted once all of them are cancelled.
+// Needs to be called with install_requests_mtx locked.
+static bool
+update_install(struct install_request *req)
+{
+	bool is_cancelled = is_control_cancelled(&req->control);
+	enum minimod_priority priority = is_cancelled
+	  ? MINIMOD_PRIORITY_BACKGROUND
+	  : get_control_priority(&req->control);
+	for (struct install_waiter *w = req->waiters; w; w = w->next)
+	{
+		if (!is_control_cancelled(&w->control))
+		{
+			is_cancelled = false;
+			enum minimod_priority const p = get_control_priority(&w->control);
+			priority = p < priority ? p : priority;
+		}
+	}
+
+	if (is_cancelled)
+	{
+		__atomic_store_n(
+		  &req->extract_progress.is_cancelled,
+		  true,
+		  __ATOMIC_RELEASE);
+	}
+	else if (priority != (enum minimod_priority)req->priority)
+	{
+		requeue_install(req, (enum minimod_install_priority)priority);
+	}
+	return is_cancelled;
+}
+
+
+// Queued installations which are aborted are removed from the queue,
+// running ones stop at their next step.
+static void
+update_installs(struct minimod_ctx *ctx)
+{
+	struct install_request *aborted = NULL;
+	mtx_lock(&ctx->install_requests_mtx);
+	for (struct install_request *r = ctx->install_requests; r; r = r->next)
+	{
+		if (
+		  __atomic_load_n(&r->is_callback_invoked, __ATOMIC_ACQUIRE)
+		  || is_install_aborted(r) || !update_install(r))
+		{
+			continue;
+		}
+
+		struct install_request **it = &ctx->install_queue;
+		while (*it && *it != r)
+		{
+			it = &(*it)->queue_next;
+		}
+		if (*it)
+		{
+			LOG("queued installation of %" PRIu64 " cancelled", r->mod_id);
+			*it = r->queue_next;
+			r->queue_next = aborted;
+			aborted = r;
+			ctx->install_queue_stats.nqueued -= 1;
+		}
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	if (aborted)
+	{
+		report_install_queue(ctx);
+	}
+	while (aborted)
+	{
+		struct install_request *next = aborted->queue_next;
+		invoke_install_waiters(ctx,
+		  aborted->waiters,
+		  aborted->game_id,
+		  aborted->mod_id,
+		  MINIMOD_INSTALL_ERROR_CANCELLED);
+		aborted->waiters = NULL;
+		free_install_request(aborted);
+		aborted = next;
+	}
+}
+
+
+bool
+minimod_ctx_cancel(struct minimod_ctx *ctx, minimod_handle in_handle)
+{
+	mtx_lock(&ctx->controls_mtx);
+	struct request_control *c = find_control(ctx, in_handle);
+	if (c)
+	{
+		__atomic_store_n(&c->is_cancelled, true, __ATOMIC_RELEASE);
+		// nothing left to wait for
+		remove_busy_handle(ctx, in_handle);
+	}
+	mtx_unlock(&ctx->controls_mtx);
+
+	if (c)
+	{
+		LOG("request %" PRIu64 " cancelled", in_handle);
+		update_flights(ctx);
+		update_installs(ctx);
+		// queued requests fail right away, not once they would be sent
+		pump_scheduler(ctx);
+	}
+	return c != NULL;
+}
+
+
+bool
+minimod_ctx_set_priority(
+  struct minimod_ctx *ctx,
+  minimod_handle in_handle,
+  enum minimod_priority in_priority)
+{
+	mtx_lock(&ctx->controls_mtx);
+	struct request_control *c = find_control(ctx, in_handle);
+	if (c)
+	{
+		__atomic_store_n(&c->priority, in_priority, __ATOMIC_RELEASE);
+	}
+	mtx_unlock(&ctx->controls_mtx);
+
+	if (c)
+	{
+		update_flights(ctx);
+		update_installs(ctx);
+	}
+	return c != NULL;
+}
+
+
+// Waits until at least *in_min_finished* of the handles are finished.
+//
+// Returns:
+//	The number of finished handles, and the index of the first one in
+//	*out_first* (*in_nhandles* if there is none).
+static size_t
+wait_handles(
+  struct minimod_ctx *ctx,
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  size_t in_min_finished,
+  uint32_t in_timeout_ms,
+  size_t *out_first)
+{
+	uint64_t const start = sys_microseconds();
+	uint64_t const timeout_us = in_timeout_ms * 1000ull;
+	size_t nfinished;
+	mtx_lock(&ctx->controls_mtx);
+	for (;;)
+	{
+		nfinished = 0;
+		*out_first = in_nhandles;
+		for (size_t i = 0; i < in_nhandles; ++i)
+		{
+			if (find_busy_handle(ctx, in_handles[i]) == ctx->nbusy_handles)
+			{
+				*out_first = nfinished == 0 ? i : *out_first;
+				nfinished += 1;
+			}
+		}
+		if (nfinished >= in_min_finished)
+		{
+			break;
+		}
+
+		if (in_timeout_ms == MINIMOD_WAIT_FOREVER)
+		{
+			cnd_wait(&ctx->handles_cnd, &ctx->controls_mtx);
+			continue;
+		}
+		uint64_t const waited = sys_microseconds() - start;
+		if (waited >= timeout_us)
+		{
+			break;
+		}
+		// rounded up, to not wake up just before the time is up
+		sys_cnd_timedwait(
+		  &ctx->handles_cnd,
+		  &ctx->controls_mtx,
+		  (uint32_t)((timeout_us - waited + 999) / 1000));
+	}
+	mtx_unlock(&ctx->controls_mtx);
+	return nfinished;
+}
+
+
+bool
+minimod_ctx_wait(
+  struct minimod_ctx *ctx,
+  minimod_handle in_handle,
+  uint32_t in_timeout_ms)
+{
+	size_t first;
+	return wait_handles(ctx, &in_handle, 1, 1, in_timeout_ms, &first) == 1;
+}
+
+
+bool
+minimod_ctx_wait_all(
+  struct minimod_ctx *ctx,
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms)
+{
+	size_t first;
+	size_t const nfinished = wait_handles(ctx,
+	  in_handles,
+	  in_nhandles,
+	  in_nhandles,
+	  in_timeout_ms,
+	  &first);
+	return nfinished == in_nhandles;
+}
+
+
+size_t
+minimod_ctx_wait_any(
+  struct minimod_ctx *ctx,
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms)
+{
+	size_t first;
+	wait_handles(ctx, in_handles, in_nhandles, 1, in_timeout_ms, &first);
+	return first;
+}
+
+
+void
+minimod_ctx_set_install_limits(
+  struct minimod_ctx *ctx,
+  unsigned int in_max_downloads,
+  unsigned int in_max_extractions)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	ctx->max_downloads =
+	  in_max_downloads > 0 ? in_max_downloads : DEFAULT_MAX_DOWNLOADS;
+	ctx->max_extractions =
+	  in_max_extractions > 0 ? in_max_extractions : DEFAULT_MAX_EXTRACTIONS;
+	// hand out the additional extraction slots, if any
+	struct install_request *extract = NULL;
+	while (
+	  ctx->extract_queue && ctx->nextraction_slots < ctx->max_extractions)
+	{
+		struct install_request *req = ctx->extract_queue;
+		ctx->extract_queue = req->queue_next;
+		ctx->nextraction_slots += 1;
+		req->has_extraction_slot = true;
+		req->queue_next = extract;
+		extract = req;
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+
+	while (extract)
+	{
+		struct install_request *next = extract->queue_next;
+		submit_extraction(extract);
+		extract = next;
+	}
+	pump_install_queue(ctx);
+}
+
+
+void
+minimod_ctx_get_install_queue_stats(
+  struct minimod_ctx *ctx,
+  struct minimod_install_queue_stats *out_stats)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	*out_stats = ctx->install_queue_stats;
+	mtx_unlock(&ctx->install_requests_mtx);
+}
+
+
+void
+minimod_ctx_set_install_queue_callback(
+  struct minimod_ctx *ctx,
+  minimod_install_queue_callback in_callback,
+  void *in_userdata)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	ctx->install_queue_callback = in_callback;
+	ctx->install_queue_userdata = in_userdata;
+	mtx_unlock(&ctx->install_requests_mtx);
+}
+
+
+void
+minimod_ctx_set_install_stats_callback(
+  struct minimod_ctx *ctx,
+  minimod_install_stats_callback in_callback,
+  void *in_userdata)
+{
+	ctx->install_stats_callback = in_callback;
+	ctx->install_stats_userdata = in_userdata;
+}
+
+
+void
+minimod_ctx_set_install_error_callback(
+  struct minimod_ctx *ctx,
+  minimod_install_error_callback in_callback,
+  void *in_userdata)
+{
+	ctx->install_error_callback = in_callback;
+	ctx->install_error_userdata = in_userdata;
+}
+
+
+struct stalled_install
+{
+	minimod_handle handle;
+	minimod_install_callback callback;
+	void *userdata;
+	struct install_waiter *waiters;
+	uint64_t game_id;
+	uint64_t mod_id;
+};
+
+
+static uint64_t
+bytes_per_second(uint64_t in_nbytes, uint64_t in_usecs)
+{
+	return in_usecs > 0 ? in_nbytes * 1000000 / in_usecs : 0;
+}
+
+
+// Samples all installations which are downloading or extracting.
+// Needs to be called with install_requests_mtx locked.
+static size_t
+sample_progress(
+  struct minimod_ctx *ctx,
+  uint64_t in_now,
+  struct minimod_install_progress *out_progress,
+  struct stalled_install *out_stalled,
+  size_t *out_nstalled)
+{
+	size_t nprogress = 0;
+	*out_nstalled = 0;
+	for (struct install_request *r = ctx->install_requests; r; r = r->next)
+	{
+		enum minimod_install_phase const phase =
+		  __atomic_load_n(&r->phase, __ATOMIC_ACQUIRE);
+		if (
+		  phase == MINIMOD_INSTALL_PHASE_NONE
+		  || __atomic_load_n(&r->is_callback_invoked, __ATOMIC_ACQUIRE)
+		  || is_install_aborted(r))
+		{
+			continue;
+		}
+
+		if (r->last_report == 0)
+		{
+			r->last_report = r->download_start;
+			r->last_change = r->download_start;
+		}
+
+		uint64_t nbytes = r->filesize;
+		if (phase == MINIMOD_INSTALL_PHASE_DOWNLOADING)
+		{
+			if (r->is_streaming)
+			{
+				nbytes = __atomic_load_n(
+				  &r->extract_progress.nbytes_read,
+				  __ATOMIC_RELAXED);
+			}
+			else
+			{
+				int64_t const fsize = fsu_fsize(r->part_path);
+				nbytes = fsize > 0 ? (uint64_t)fsize : 0;
+			}
+
+			if (nbytes != r->last_nbytes)
+			{
+				r->last_change = in_now;
+			}
+			else if (
+			  ctx->stall_timeout_ms > 0
+			  && in_now - r->last_change >= ctx->stall_timeout_ms * 1000ull
+			  && !__atomic_exchange_n(
+			    &r->is_callback_invoked,
+			    true,
+			    __ATOMIC_ACQ_REL))
+			{
+				LOGE("download of mod %" PRIu64 " stalled", r->mod_id);
+				set_install_error(r, MINIMOD_INSTALL_ERROR_STALLED);
+				// aborts the download with its next write, which frees the
+				// slot. It is counted here, as aborted ones are not.
+				__atomic_store_n(
+				  &r->extract_progress.is_cancelled,
+				  true,
+				  __ATOMIC_RELEASE);
+				ctx->install_queue_stats.nfailed += 1;
+				bool const is_cancelled = unregister_control(ctx, &r->control);
+				out_stalled[(*out_nstalled)++] = (struct stalled_install){
+					.handle = r->control.handle,
+					.callback = is_cancelled ? NULL : r->callback,
+					.userdata = r->userdata,
+					.waiters = r->waiters,
+					.game_id = r->game_id,
+					.mod_id = r->mod_id,
+				};
+				r->waiters = NULL;
+				continue;
+			}
+		}
+
+		out_progress[nprogress++] = (struct minimod_install_progress){
+			.game_id = r->game_id,
+			.mod_id = r->mod_id,
+			.nbytes = nbytes,
+			.filesize = r->filesize,
+			.bytes_per_second = bytes_per_second(
+			  nbytes - r->last_nbytes,
+			  in_now - r->last_report),
+			.avg_bytes_per_second = bytes_per_second(
+			  nbytes > r->resume_offset ? nbytes - r->resume_offset : 0,
+			  in_now - r->download_start),
+			.nfiles_extracted =
+			  __atomic_load_n(&r->extract_progress.nfiles, __ATOMIC_RELAXED),
+			.nfiles_total = __atomic_load_n(
+			  &r->extract_progress.nfiles_total,
+			  __ATOMIC_RELAXED),
+			.phase = phase,
+		};
+		r->last_nbytes = nbytes;
+		r->last_report = in_now;
+	}
+	return nprogress;
+}
+
+
+static int
+progress_main(void *in_arg)
+{
+	struct minimod_ctx *ctx = in_arg;
+	uint64_t next_report = 0;
+	while (!__atomic_load_n(&ctx->is_progress_quitting, __ATOMIC_ACQUIRE))
+	{
+		sys_sleep(PROGRESS_TICK_MS);
+		uint64_t const now = sys_microseconds();
+		if (now < next_report)
+		{
+			continue;
+		}
+
+		mtx_lock(&ctx->install_requests_mtx);
+		next_report = now + ctx->progress_interval_ms * 1000ull;
+		minimod_install_progress_callback callback =
+		  ctx->install_progress_callback;
+		void *userdata = ctx->install_progress_userdata;
+		size_t nrequests = 0;
+		for (struct install_request *r = ctx->install_requests; r; r = r->next)
+		{
+			nrequests += 1;
+		}
+		// +1 to not depend on malloc(0)
+		struct minimod_install_progress *progress =
+		  malloc(nrequests * sizeof *progress + 1);
+		struct stalled_install *stalled =
+		  malloc(nrequests * sizeof *stalled + 1);
+		size_t nstalled;
+		size_t const nprogress =
+		  sample_progress(ctx, now, progress, stalled, &nstalled);
+		mtx_unlock(&ctx->install_requests_mtx);
+
+		for (size_t i = 0; callback && i < nprogress; ++i)
+		{
+			callback(userdata, &progress[i]);
+		}
+		// stalled installations count as failed already
+		if (nstalled > 0)
+		{
+			report_install_queue(ctx);
+		}
+		for (size_t i = 0; i < nstalled; ++i)
+		{
+			invoke_install_callback(ctx,
+			  stalled[i].handle,
+			  stalled[i].callback,
+			  stalled[i].userdata,
+			  stalled[i].game_id,
+			  stalled[i].mod_id,
+			  MINIMOD_INSTALL_ERROR_STALLED);
+			invoke_install_waiters(ctx,
+			  stalled[i].waiters,
+			  stalled[i].game_id,
+			  stalled[i].mod_id,
+			  MINIMOD_INSTALL_ERROR_STALLED);
+		}
+		free(progress);
+		free(stalled);
+	}
+	return 0;
+}
+
+
+void
+minimod_ctx_set_install_progress_callback(
+  struct minimod_ctx *ctx,
+  minimod_install_progress_callback in_callback,
+  void *in_userdata,
+  uint32_t in_interval_ms,
+  uint32_t in_stall_timeout_ms)
+{
+	mtx_lock(&ctx->install_requests_mtx);
+	ctx->install_progress_callback = in_callback;
+	ctx->install_progress_userdata = in_userdata;
+	ctx->progress_interval_ms =
+	  in_interval_ms > 0 ? in_interval_ms : DEFAULT_PROGRESS_INTERVAL_MS;
+	ctx->stall_timeout_ms = in_stall_timeout_ms;
+	// started on demand, but kept running until minimod_deinit()
+	bool const needs_thread = (in_callback || in_stall_timeout_ms > 0)
+	  && !ctx->has_progress_thread;
+	if (needs_thread)
+	{
+		ctx->has_progress_thread =
+		  (thrd_success
+		   == thrd_create(&ctx->progress_thread, progress_main, ctx));
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+}
+
+
+bool
+minimod_ctx_uninstall(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	if (!modindex_get(ctx->installed, in_game_id, in_mod_id, NULL))
+	{
+		return false;
+	}
+
+	modindex_begin(ctx->installed);
+	modindex_remove(ctx->installed, in_game_id, in_mod_id);
+
+	char *path;
+	asprintf(
+	  &path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	fsu_rmfile(path);
+	free(path);
+
+	// check if the mod was stored as zip
+	asprintf(
+	  &path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip",
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	if (fsu_ptype(path) == FSU_PATHTYPE_FILE)
+	{
+		fsu_rmfile(path);
+	}
+	free(path);
+
+	// and its index, see minimod_open_archive()
+	asprintf(
+	  &path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip.idx",
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	if (fsu_ptype(path) == FSU_PATHTYPE_FILE)
+	{
+		fsu_rmfile(path);
+	}
+	free(path);
+
+	// finally and probably redundantly check for dir
+	asprintf(
+	  &path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64,
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	if (fsu_ptype(path) == FSU_PATHTYPE_DIR)
+	{
+		fsu_rmdir_recursive(path);
+	}
+	free(path);
+
+	modindex_end(ctx->installed);
+
+	return true;
+}
+
+
+struct enum_data
+{
+	minimod_enum_installed_mods_callback callback;
+	void *userdata;
+	uint64_t game_id;
+};
+
+
+static bool
+is_str_numeric(char const *str, size_t len)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (!isdigit(str[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool
+str_ends_with_json(char const *str, size_t len)
+{
+	return (len > 5) && (strcmp(str + len - 5, ".json") == 0);
+}
+
+
+static void
+game_enumerator(
+  char const *root,
+  char const *name,
+  bool is_dir,
+  void *in_userdata)
+{
+	struct enum_data *edata = in_userdata;
+
+	if (is_dir)
+	{
+		return;
+	}
+
+	size_t l = strlen(name);
+	if (str_ends_with_json(name, l) && is_str_numeric(name, l - 5))
+	{
+		LOG("found mod: %s %s", root, name);
+		uint64_t mod_id = strtoul(name, NULL, 10);
+		LOG("mod_id: %" PRIu64, mod_id);
+		char *path = NULL;
+		asprintf(&path, "%s%" PRIu64 ".zip", root, mod_id);
+		if (fsu_ptype(path) == FSU_PATHTYPE_FILE)
+		{
+			edata->callback(edata->userdata, edata->game_id, mod_id, path);
+		}
+		else
+		{
+			free(path);
+			asprintf(&path, "%s%" PRIu64 "/", root, mod_id);
+			edata->callback(edata->userdata, edata->game_id, mod_id, path);
+		}
+		free(path);
+	}
+}
+
+
+static void
+root_enumerator(
+  char const *root,
+  char const *name,
+  bool is_dir,
+  void *in_userdata)
+{
+	struct enum_data *edata = in_userdata;
+
+	if (is_dir)
+	{
+		LOG("found dir: %s - %s", root, name);
+		size_t l = strlen(name);
+		bool is_game_id = is_str_numeric(name, l);
+		if (is_game_id)
+		{
+			edata->game_id = strtoull(name, NULL, 10);
+			char *path;
+			asprintf(&path, "%s%s/", root, name);
+			fsu_enum_dir(path, game_enumerator, edata);
+			free(path);
+		}
+	}
+}
+
+
+static bool
+read_installed_mod(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	char *path;
+	asprintf(
+	  &path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+
+	int64_t fsize_raw = fsu_fsize(path);
+	FILE *jfile = fsu_fopen(path, "rb");
+
+	free(path);
+
+	if (!jfile)
+	{
+		return false;
+	}
+
+	// load file data into memory
+	if (fsize_raw > 0)
+	{
+		size_t fsize = (size_t)fsize_raw;
+		struct arena *arena = arena_thread();
+		struct arena_mark const mark = arena_mark(arena);
+		char *filebuffer = arena_alloc(arena, fsize);
+		fread(filebuffer, fsize, 1, jfile);
+
+		// load data into QAJ4C
+		size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(filebuffer, fsize);
+		void *buffer = arena_alloc(arena, nbuffer);
+		QAJ4C_Value const *document = NULL;
+		QAJ4C_parse_opt(filebuffer, fsize, 0, buffer, nbuffer, &document);
+		ASSERT(QAJ4C_is_object(document));
+
+		// call callback with data
+		struct minimod_mod mod = { 0 };
+		populate_mod(&mod, document);
+		in_callback(in_userdata, 1, &mod, NULL);
+
+		arena_release(arena, mark);
+	}
+	else
+	{
+		in_callback(in_userdata, 0, NULL, NULL);
+	}
+	fclose(jfile);
+
+
+	return true;
+}
+
+
+
+static void
+on_index_read_mod(
+  void *in_userdata,
+  size_t in_nmods,
+  struct minimod_mod const *in_mods,
+  struct minimod_pagination const *UNUSED(pagi))
+{
+	struct modindex_entry *entry = in_userdata;
+	if (in_nmods > 0)
+	{
+		entry->modfile_id = in_mods[0].modfile_id;
+		entry->date_updated = in_mods[0].date_updated;
+	}
+}
+
+
+static void
+on_index_found_mod(
+  void *in_userdata,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  char const *in_path)
+{
+	struct minimod_ctx *ctx = in_userdata;
+
+	size_t const len = strlen(in_path);
+	bool const is_zip = len > 4 && 0 == strcmp(in_path + len - 4, ".zip");
+	int64_t const fsize = is_zip ? fsu_fsize(in_path) : -1;
+	struct modindex_entry entry = {
+		.game_id = in_game_id,
+		.mod_id = in_mod_id,
+		.nbytes = fsize > 0 ? (uint64_t)fsize : 0,
+		.is_zip = is_zip,
+	};
+	read_installed_mod(ctx, in_game_id, in_mod_id, on_index_read_mod, &entry);
+	modindex_put(ctx->installed, &entry);
+}
+
+
+static void
+open_installed_index(struct minimod_ctx *ctx)
+{
+	char *path;
+	asprintf(&path, "%s/mods/index", ctx->root_path);
+	ctx->installed = modindex_load(path);
+	if (!ctx->installed)
+	{
+		// missing or stale, so look at what is actually installed
+		LOG("rebuilding %s", path);
+		ctx->installed = modindex_create(path);
+		modindex_begin(ctx->installed);
+
+		struct enum_data edata = {
+			.callback = on_index_found_mod,
+			.userdata = ctx,
+		};
+		char *root;
+		asprintf(&root, "%s/mods/", ctx->root_path);
+		fsu_enum_dir(root, root_enumerator, &edata);
+		free(root);
+
+		modindex_end(ctx->installed);
+	}
+	free(path);
+}
+
+
+struct enum_installed_data
+{
+	struct minimod_ctx *ctx;
+	minimod_enum_installed_mods_callback callback;
+	void *userdata;
+};
+
+
+static void
+on_enum_installed(void *in_userdata, struct modindex_entry const *in_entry)
+{
+	struct enum_installed_data const *edata = in_userdata;
+	struct minimod_ctx *ctx = edata->ctx;
+
+	char *path;
+	asprintf(
+	  &path,
+	  in_entry->is_zip ? "%s/mods/%" PRIu64 "/%" PRIu64 ".zip"
+	                   : "%s/mods/%" PRIu64 "/%" PRIu64 "/",
+	  ctx->root_path,
+	  in_entry->game_id,
+	  in_entry->mod_id);
+	edata->callback(
+	  edata->userdata,
+	  in_entry->game_id,
+	  in_entry->mod_id,
+	  path);
+	free(path);
+}
+
+
+void
+minimod_ctx_enum_installed_mods(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  minimod_enum_installed_mods_callback in_callback,
+  void *in_userdata)
+{
+	struct enum_installed_data edata = {
+		.ctx = ctx,
+		.callback = in_callback,
+		.userdata = in_userdata,
+	};
+	modindex_enum(ctx->installed, in_game_id, on_enum_installed, &edata);
+}
+
+
+/* Should get_installed_mod() use a callback for unified interfaces?
+ * But it is not asynchronous. Should asynchronicity be emulated?
+ * Or use a different interface that just returns a minimod_mod struct?
+ * If so, who owns the memory? Who frees the data of the mod?
+ * What happens with the underlying QAJ4C object?
+ * Inconvenient to handle; that's for sure.
+ *
+ * So a callback makes much more sense, also for consistency.
+ * But if it is not asynchronous (to save minimod from spawning
+ * threads itself) maybe 'get_installed_mod' is the wrong name.
+ * It also has strong ties with minimod_enum_installed_mods().
+ * So it should not be called 'get' or 'enum'; but what else?
+ *
+ * Combining those two would be nice, however loading the data during
+ * enumeration are lots of allocations and memory, even if they
+ * may not be required; and I'd prefer on the side of no-superflous
+ * allocs and cycles.
+ */
+bool
+minimod_ctx_get_installed_mod(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	if (!modindex_get(ctx->installed, in_game_id, in_mod_id, NULL))
+	{
+		return false;
+	}
+	return read_installed_mod(
+	  ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
+}
+
+
+bool
+minimod_ctx_is_installed(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	return modindex_get(ctx->installed, in_game_id, in_mod_id, NULL);
+}
+
+
+struct minimod_archive
+{
+	struct archive *archive;
+};
+
+
+struct minimod_archive *
+minimod_ctx_open_archive(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  size_t in_cache_bytes)
+{
+	struct modindex_entry entry;
+	if (
+	  !modindex_get(ctx->installed, in_game_id, in_mod_id, &entry)
+	  || !entry.is_zip)
+	{
+		return NULL;
+	}
+
+	char *zip_path;
+	asprintf(
+	  &zip_path,
+	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip",
+	  ctx->root_path,
+	  in_game_id,
+	  in_mod_id);
+	char *index_path;
+	asprintf(&index_path, "%s.idx", zip_path);
+
+	struct archive *archive =
+	  archive_open(zip_path, index_path, in_cache_bytes);
+	free(index_path);
+	free(zip_path);
+	if (!archive)
+	{
+		return NULL;
+	}
+
+	struct minimod_archive *a = calloc(1, sizeof *a);
+	a->archive = archive;
+	return a;
+}
+
+
+void
+minimod_close_archive(struct minimod_archive *in_archive)
+{
+	if (in_archive)
+	{
+		archive_close(in_archive->archive);
+		free(in_archive);
+	}
+}
+
+
+void const *
+minimod_archive_get(
+  struct minimod_archive *in_archive,
+  char const *in_name,
+  size_t *out_bytes)
+{
+	return archive_get(in_archive->archive, in_name, out_bytes);
+}
+
+
+void
+minimod_archive_release(
+  struct minimod_archive *in_archive,
+  void const *in_data)
+{
+	archive_release(in_archive->archive, in_data);
+}
+
+
+void
+minimod_enum_archive(
+  struct minimod_archive *in_archive,
+  minimod_enum_archive_callback in_callback,
+  void *in_userdata)
+{
+	archive_enum(in_archive->archive, in_callback, in_userdata);
+}
+
+
+bool
+minimod_ctx_is_downloading(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	bool is_downloading = false;
+	mtx_lock(&ctx->install_requests_mtx);
+	struct install_request *r = ctx->install_requests;
+	while (r)
+	{
+		if (r->game_id == in_game_id && r->mod_id == in_mod_id)
+		{
+			is_downloading = true;
+			break;
+		}
+		r = r->next;
+	}
+	mtx_unlock(&ctx->install_requests_mtx);
+	return is_downloading;
+}
+
+
+bool
+minimod_ctx_rate(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  int in_rating,
+  minimod_rate_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return false;
+	}
+
+	char *path = NULL;
+	asprintf(
+	  &path,
+	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/ratings",
+	  endpoints[ctx->env],
+	  in_game_id,
+	  in_mod_id);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Content-Type", "application/x-www-form-urlencoded",
+		"Authorization", auth->bearer,
+		NULL
+		// clang-format on
+	};
+
+	char const *data = in_rating > 0 ? "rating=1"
+	  : in_rating < 0                ? "rating=-1"
+	                                 : "rating=0";
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.userdata = in_userdata;
+	task->callback.fptr.rate = in_callback;
+	if (!submit_request(ctx,
+	      NETW_VERB_POST,
+	      path,
+	      headers,
+	      data,
+	      strlen(data),
+	      NULL,
+	      handle_rate,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(path);
+	return true;
+}
+
+
+static char *
+path_ratings(struct minimod_ctx *ctx, char const *in_filter)
+{
+	char *path = NULL;
+	asprintf(
+	  &path,
+	  "%s/me/ratings?%s",
+	  endpoints[ctx->env],
+	  in_filter ? in_filter : "");
+	return path;
+}
+
+
+minimod_handle
+minimod_ctx_get_ratings(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  minimod_get_ratings_callback in_callback,
+  void *in_udata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return 0;
+	}
+
+	char *path = path_ratings(ctx, in_filter);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.userdata = in_udata;
+	task->callback.fptr.get_ratings = in_callback;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_ratings, task);
+
+	free(path);
+	return handle;
+}
+
+
+static char *
+path_subscriptions(struct minimod_ctx *ctx, char const *in_filter)
+{
+	char *path = NULL;
+	asprintf(
+	  &path,
+	  "%s/me/subscribed?%s",
+	  endpoints[ctx->env],
+	  in_filter ? in_filter : "");
+	return path;
+}
+
+
+minimod_handle
+minimod_ctx_get_subscriptions(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  minimod_get_mods_callback in_callback,
+  void *in_udata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return 0;
+	}
+
+	char *path = path_subscriptions(ctx, in_filter);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.userdata = in_udata;
+	task->callback.fptr.get_mods = in_callback;
+	minimod_handle const handle =
+	  submit_get(path, headers, deliver_mods, task);
+
+	free(path);
+	return handle;
+}
+
+
+bool
+minimod_ctx_subscribe(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_subscription_change_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return false;
+	}
+
+	char *path = NULL;
+	asprintf(
+	  &path,
+	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/subscribe",
+	  endpoints[ctx->env],
+	  in_game_id,
+	  in_mod_id);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		"Content-Type", "application/x-www-form-urlencoded",
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.userdata = in_userdata;
+	task->callback.fptr.subscription_change = in_callback;
+	task->meta64 = in_mod_id;
+	task->meta32 = 1;
+
+	if (!submit_request(ctx,
+	      NETW_VERB_POST,
+	      path,
+	      headers,
+	      NULL,
+	      0,
+	      NULL,
+	      handle_subscription_change,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(path);
+
+	return true;
+}
+
+
+bool
+minimod_ctx_unsubscribe(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_subscription_change_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return false;
+	}
+
+	char *path = NULL;
+	asprintf(
+	  &path,
+	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/subscribe",
+	  endpoints[ctx->env],
+	  in_game_id,
+	  in_mod_id);
+
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		"Authorization", auth->bearer,
+		"Content-Type", "application/x-www-form-urlencoded",
+		NULL
+		// clang-format on
+	};
+
+	struct task *task = alloc_task(ctx);
+	task->auth = auth;
+	task->callback.userdata = in_userdata;
+	task->callback.fptr.subscription_change = in_callback;
+	task->meta64 = in_mod_id;
+	task->meta32 = -1;
+
+	if (!submit_request(ctx,
+	      NETW_VERB_DELETE,
+	      path,
+	      headers,
+	      NULL,
+	      0,
+	      NULL,
+	      handle_subscription_change,
+	      task))
+	{
+		free_task(task);
+	}
+
+	free(path);
+
+	return true;
+}
+
+
+// PAGING
+// ------
+// maximum _limit supported by the API
+#define PAGING_LIMIT 100
+#define PAGING_DEFAULT_INFLIGHT 4
+
+
+struct paging_page
+{
+	void *data;
+	size_t len;
+	int error;
+	bool is_received;
+	char _padding[3];
+};
+
+
+struct paging_request
+{
+	struct minimod_paging *paging;
+	size_t index;
+	struct retry_state retry;
+};
+
+
+// Referenced by the caller and by the paging itself, as long as pages are
+// requested or delivered. So the caller can cancel it any time, until it
+// released the handle.
+struct minimod_paging
+{
+	struct minimod_ctx *ctx;
+	mtx_t mtx;
+	struct callback callback;
+	task_deliver_fn deliver;
+	// includes the query already, so paging parameters are appended
+	char *path;
+	// pinned, if the pages are requested on behalf of the user
+	struct auth *auth;
+	// number of pages is unknown until the first one was delivered
+	struct paging_page *pages;
+	size_t npages;
+	size_t nrequested;
+	size_t ndelivered;
+	size_t ninflight;
+	// pages waiting for minimod_poll()
+	size_t nposted;
+	unsigned int max_inflight;
+	// atomic
+	unsigned int refs;
+	bool is_delivering;
+	bool is_cancelled;
+	bool is_done;
+	// the paging released its reference
+	bool is_finished;
+	char _padding[4];
+};
+
+
+static void
+free_paging(struct minimod_paging *p)
+{
+	for (size_t i = 0; i < p->npages; ++i)
+	{
+		free(p->pages[i].data);
+	}
+	free(p->pages);
+	free(p->path);
+	release_auth(p->auth);
+	mtx_destroy(&p->mtx);
+	free(p);
+}
+
+
+static void
+release_paging(struct minimod_paging *p)
+{
+	if (p && 0 == __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL))
+	{
+		free_paging(p);
+	}
+}
+
+
+// Called with p->mtx locked, returns with it unlocked. Releases the
+// reference of the paging, once nothing is in flight or queued anymore.
+static void
+unlock_paging(struct minimod_paging *p)
+{
+	bool const is_finished = !p->is_finished
+	  && (p->is_done || p->is_cancelled) && p->ninflight == 0
+	  && p->nposted == 0 && !p->is_delivering;
+	p->is_finished = p->is_finished || is_finished;
+	mtx_unlock(&p->mtx);
+
+	if (is_finished)
+	{
+		release_paging(p);
+	}
+}
+
+
+static void
+handle_page(
+  void *in_udata,
+  void const *in_data,
+  size_t in_len,
+  int error,
+  struct netw_header const *header);
+
+
+static void
+resend_page(void *in_userdata)
+{
+	struct paging_request *req = in_userdata;
+	struct minimod_ctx *ctx = req->paging->ctx;
+	if (!submit_request(ctx,
+	      NETW_VERB_GET,
+	      req->retry.url,
+	      (char const *const *)req->retry.headers,
+	      NULL,
+	      0,
+	      NULL,
+	      handle_page,
+	      req))
+	{
+		handle_page(req, NULL, 0, 0, NULL);
+	}
+}
+
+
+// Request pages [in_first; in_last). Called without p->mtx locked.
+static void
+request_pages(struct minimod_paging *p, size_t in_first, size_t in_last)
+{
+	struct minimod_ctx *ctx = p->ctx;
+	char const *const headers[] = {
+		// clang-format off
+		"Accept", "application/json",
+		p->auth ? "Authorization" : NULL, p->auth ? p->auth->bearer : NULL,
+		NULL
+		// clang-format on
+	};
+
+	for (size_t i = in_first; i < in_last; ++i)
+	{
+		char *path;
+		asprintf(
+		  &path,
+		  "%s&_offset=%zu&_limit=%i",
+		  p->path,
+		  i * PAGING_LIMIT,
+		  PAGING_LIMIT);
+		LOG("request page %zu: %s", i, path);
+
+		struct paging_request *req = calloc(1, sizeof *req);
+		req->paging = p;
+		req->index = i;
+		retry_begin(ctx, &req->retry, path, headers);
+		if (!submit_request(ctx,
+		      NETW_VERB_GET,
+		      path,
+		      headers,
+		      NULL,
+		      0,
+		      NULL,
+		      handle_page,
+		      req))
+		{
+			// treat it as a failed response to deliver the error in order
+			handle_page(req, NULL, 0, 0, NULL);
+		}
+		free(path);
+	}
+}
+
+
+// A page parsed already, delivered by minimod_poll(). See pump_pages().
+struct page_delivery
+{
+	struct minimod_paging *paging;
+	QAJ4C_Value const *document;
+	void *buffer;
+	bool is_last;
+	char _padding[7];
+};
+
+
+static void
+run_page_delivery(void *in_delivery)
+{
+	struct page_delivery *d = in_delivery;
+	struct minimod_paging *p = d->paging;
+	mtx_lock(&p->mtx);
+	bool const is_cancelled = p->is_cancelled;
+	mtx_unlock(&p->mtx);
+
+	if (!is_cancelled)
+	{
+		struct arena *arena = arena_thread();
+		struct arena_mark const mark = arena_mark(arena);
+		struct task task = {
+			.callback = p->callback,
+			.deliver = p->deliver,
+			.is_paged = true,
+			.is_last_page = d->is_last,
+		};
+		task.deliver(&task, d->document);
+		arena_release(arena, mark);
+	}
+	free(d->buffer);
+	free(d);
+
+	mtx_lock(&p->mtx);
+	p->nposted -= 1;
+	unlock_paging(p);
+}
+
+
+// Deliver all pages received in order and request more, if there is room.
+// With MINIMOD_INITFLAG_POLL pages are only parsed here and delivered by
+// minimod_poll(), in the same order.
+// Called with p->mtx locked, returns with it unlocked.
+static void
+pump_pages(struct minimod_paging *p)
+{
+	if (p->is_delivering)
+	{
+		mtx_unlock(&p->mtx);
+		return;
+	}
+	p->is_delivering = true;
+
+	while (!p->is_cancelled && !p->is_done)
+	{
+		// request more pages, keeping at most max_inflight pages in flight
+		// or received but not delivered yet, so a slow page does not make
+		// all later ones pile up
+		size_t const first = p->nrequested;
+		while (
+		  p->nrequested < p->npages
+		  && p->nrequested - p->ndelivered < p->max_inflight)
+		{
+			p->nrequested += 1;
+			p->ninflight += 1;
+		}
+		size_t const last = p->nrequested;
+		if (last > first)
+		{
+			mtx_unlock(&p->mtx);
+			request_pages(p, first, last);
+			mtx_lock(&p->mtx);
+			continue;
+		}
+
+		struct paging_page *page = &p->pages[p->ndelivered];
+		if (!page->is_received)
+		{
+			break;
+		}
+		bool const is_polled = p->ctx->is_polled;
+		if (is_polled)
+		{
+			p->nposted += 1;
+		}
+		mtx_unlock(&p->mtx);
+
+		struct arena *arena = arena_thread();
+		struct arena_mark const mark = arena_mark(arena);
+		void *buffer = NULL;
+		QAJ4C_Value const *document = NULL;
+		if (page->error == 200)
+		{
+			document = is_polled
+			  ? parse_document_heap(page->data, page->len, &buffer)
+			  : parse_document(arena, page->data, page->len);
+		}
+		// a page without a list is delivered with a NULL pagination, so it
+		// has to end the paging like a failure
+		if (document && !QAJ4C_object_get(document, "data"))
+		{
+			document = NULL;
+		}
+
+		// the first page tells how many pages there are
+		size_t npages = 0;
+		if (document && p->ndelivered == 0)
+		{
+			struct minimod_pagination pagi;
+			populate_pagination(&pagi, NULL, document);
+			npages = (size_t)((pagi.total + PAGING_LIMIT - 1) / PAGING_LIMIT);
+			npages = npages > 0 ? npages : 1;
+		}
+		// the number of pages is fixed by the first one, even if the total
+		// changes while paging. Only the delivering thread changes them.
+		size_t const ntotal = npages > 0 ? npages : p->npages;
+		bool const is_last = p->ndelivered + 1 == ntotal;
+
+		if (is_polled)
+		{
+			struct page_delivery *d = calloc(1, sizeof *d);
+			d->paging = p;
+			d->document = document;
+			d->buffer = buffer;
+			d->is_last = is_last;
+			post_completion(p->ctx, run_page_delivery, d);
+		}
+		else
+		{
+			struct task task = {
+				.callback = p->callback,
+				.deliver = p->deliver,
+				.is_paged = true,
+				.is_last_page = is_last,
+			};
+			task.deliver(&task, document);
+		}
+		arena_release(arena, mark);
+
+		mtx_lock(&p->mtx);
+		free(page->data);
+		page->data = NULL;
+		p->ndelivered += 1;
+		if (npages > 1)
+		{
+			p->pages = realloc(p->pages, npages * sizeof *p->pages);
+			memset(p->pages + 1, 0, (npages - 1) * sizeof *p->pages);
+			p->npages = npages;
+		}
+		if (!document || p->ndelivered == p->npages)
+		{
+			p->is_done = true;
+		}
+	}
+
+	p->is_delivering = false;
+	unlock_paging(p);
+}
+
+
+static void
+handle_page(
+  void *in_udata,
+  void const *in_data,
+  size_t in_len,
+  int error,
+  struct netw_header const *header)
+{
+	struct paging_request *req = in_udata;
+	struct minimod_paging *p = req->paging;
+	struct minimod_ctx *ctx = p->ctx;
+	size_t const index = req->index;
+
+	if (header)
+	{
+		handle_generic_errors(ctx, error, header, p->auth);
+	}
+
+	mtx_lock(&p->mtx);
+	bool const is_wanted = !p->is_cancelled && !p->is_done;
+	mtx_unlock(&p->mtx);
+	// the page stays in flight while waiting for its retry
+	uint32_t const retry_delay =
+	  is_wanted ? next_retry_delay(ctx, &req->retry, error) : 0;
+	if (retry_delay > 0)
+	{
+		call_later(ctx, retry_delay, resend_page, req);
+		return;
+	}
+	report_retry(ctx, &req->retry, error);
+	free_retry(&req->retry);
+	free(req);
+
+	mtx_lock(&p->mtx);
+	p->ninflight -= 1;
+	if (!p->is_cancelled && !p->is_done)
+	{
+		struct paging_page *page = &p->pages[index];
+		page->error = error;
+		if (error == 200)
+		{
+			page->data = malloc(in_len);
+			memcpy(page->data, in_data, in_len);
+			page->len = in_len;
+		}
+		page->is_received = true;
+	}
+	pump_pages(p);
+}
+
+
+static struct minimod_paging *
+start_paging(
+  struct minimod_ctx *ctx,
+  char *in_path,
+  struct auth *in_auth,
+  unsigned int in_max_inflight,
+  task_deliver_fn in_deliver,
+  struct callback in_callback)
+{
+	struct minimod_paging *p = calloc(1, sizeof *p);
+	mtx_init(&p->mtx, mtx_plain);
+	p->ctx = ctx;
+	p->callback = in_callback;
+	p->deliver = in_deliver;
+	p->path = in_path;
+	p->auth = in_auth;
+	p->max_inflight =
+	  in_max_inflight > 0 ? in_max_inflight : PAGING_DEFAULT_INFLIGHT;
+	// only the first page is requested until the total is known
+	p->npages = 1;
+	p->pages = calloc(1, sizeof *p->pages);
+	// of the caller and of the paging
+	p->refs = 2;
+
+	mtx_lock(&p->mtx);
+	pump_pages(p);
+	return p;
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_games_all(
+  struct minimod_ctx *ctx,
   char const *in_filter,
+  unsigned int in_max_inflight,
   minimod_get_games_callback in_callback,
-  void *in_udata)
+  void *in_userdata)
+{
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_games = in_callback;
+	return start_paging(ctx,
+	  path_games(ctx, in_filter),
+	  NULL,
+	  in_max_inflight,
+	  deliver_games,
+	  callback);
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_mods_all(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_mods = in_callback;
+	return start_paging(ctx,
+	  path_mods(ctx, in_filter, in_game_id, 0),
+	  NULL,
+	  in_max_inflight,
+	  deliver_mods,
+	  callback);
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_modfiles_all(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_modfiles = in_callback;
+	return start_paging(ctx,
+	  path_modfiles(ctx, in_filter, in_game_id, in_mod_id, 0),
+	  NULL,
+	  in_max_inflight,
+	  deliver_modfiles,
+	  callback);
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_mod_events_all(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_events = in_callback;
+	return start_paging(ctx,
+	  path_mod_events(ctx, in_filter, in_game_id, in_mod_id, in_date_cutoff),
+	  NULL,
+	  in_max_inflight,
+	  deliver_events,
+	  callback);
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_user_events_all(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return NULL;
+	}
+
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_events = in_callback;
+	return start_paging(ctx,
+	  path_user_events(ctx, in_filter, in_game_id, in_date_cutoff),
+	  auth,
+	  in_max_inflight,
+	  deliver_events,
+	  callback);
+}
+
+
+struct minimod_paging *
+minimod_ctx_get_ratings_all(
+  struct minimod_ctx *ctx,
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_ratings_callback in_callback,
+  void *in_userdata)
+{
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
+	{
+		return NULL;
+	}
+
+	struct callback callback = { .userdata = in_userdata };
+	callback.fptr.get_ratings = in_callback;
+	return start_paging(ctx,
+	  path_ratings(ctx, in_filter),
+	  auth,
+	  in_max_inflight,
+	  deliver_ratings,
+	  callback);
+}
+
+
+void
+minimod_cancel_paging(struct minimod_paging *in_paging)
+{
+	struct minimod_paging *p = in_paging;
+	mtx_lock(&p->mtx);
+	p->is_cancelled = true;
+	unlock_paging(p);
+}
+
+
+void
+minimod_release_paging(struct minimod_paging *in_paging)
+{
+	release_paging(in_paging);
+}
+
+
+// SYNC
+// ----
+// events per response, a full page means there are more
+#define SYNC_PAGE_SIZE 100
+// mod events are limited to the installed mods, as long as they fit the URL
+#define SYNC_MAX_FILTERED_MODS 100
+// first line of the files in <root>/sync/, bump when changing the format
+#define SYNC_FILE_MAGIC "minimod-sync 1\n"
+
+
+struct sync_event
+{
+	uint64_t id;
+	uint64_t date_added;
+	uint64_t mod_id;
+	enum minimod_eventtype type;
+	char _padding[4];
+};
+
+
+// what the events of a poll mean for a single mod
+struct sync_step
+{
+	uint64_t mod_id;
+	bool is_wanted;
+	// is_wanted is only valid, if there was a (un)subscribe or delete event
+	bool is_wanted_known;
+	bool is_changed;
+	char _padding[5];
+};
+
+
+struct sync_game
+{
+	struct minimod_ctx *ctx;
+	struct sync_game *next;
+	minimod_sync_callback callback;
+	void *userdata;
+	uint64_t game_id;
+	// newest event applied, 0 until the first one
+	uint64_t user_event_id;
+	uint64_t mod_event_id;
+	// older events are ignored, while there is no event id yet
+	uint64_t date_baseline;
+	// sys_microseconds()
+	uint64_t next_poll;
+	uint32_t interval_ms;
+	// requests of the running poll
+	int npending;
+	// events of the running poll
+	struct sync_event *events;
+	size_t nevents;
+	bool is_polling;
+	bool is_failed;
+	bool has_more;
+	bool is_stopped;
+	char _padding[4];
+};
+
+
+struct sync_install
+{
+	minimod_sync_callback callback;
+	void *userdata;
+	enum minimod_sync_action action;
+	char _padding[4];
+};
+
+
+static char *
+get_sync_path(struct minimod_ctx *ctx, uint64_t in_game_id)
+{
+	char *path;
+	asprintf(&path, "%s/sync/%" PRIu64, ctx->root_path, in_game_id);
+	return path;
+}
+
+
+static void
+read_sync_state(struct sync_game *g)
+{
+	struct minimod_ctx *ctx = g->ctx;
+	char *path = get_sync_path(ctx, g->game_id);
+	FILE *f = fsu_fopen(path, "rb");
+	free(path);
+
+	char magic[sizeof SYNC_FILE_MAGIC] = { 0 };
+	bool is_valid = f && fgets(magic, sizeof magic, f)
+	  && 0 == strcmp(magic, SYNC_FILE_MAGIC)
+	  && 3
+	    == fscanf(
+	      f,
+	      "%" SCNu64 " %" SCNu64 " %" SCNu64,
+	      &g->user_event_id,
+	      &g->mod_event_id,
+	      &g->date_baseline);
+	if (f)
+	{
+		fclose(f);
+	}
+
+	if (!is_valid)
+	{
+		// apply what happens from now on
+		g->user_event_id = 0;
+		g->mod_event_id = 0;
+		g->date_baseline = (uint64_t)time(NULL);
+	}
+}
+
+
+static void
+write_sync_state(struct sync_game const *g)
+{
+	struct minimod_ctx *ctx = g->ctx;
+	char *path = get_sync_path(ctx, g->game_id);
+	char *tmppath;
+	asprintf(&tmppath, "%s.tmp", path);
+
+	FILE *f = fsu_fopen(tmppath, "wb");
+	bool ok = f
+	  && 0 < fprintf(
+	    f,
+	    SYNC_FILE_MAGIC "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+	    g->user_event_id,
+	    g->mod_event_id,
+	    g->date_baseline);
+	ok = f && (0 == fclose(f)) && ok;
+	if (!ok || !fsu_mvfile(tmppath, path, true))
+	{
+		LOGE("failed to write %s", path);
+		fsu_rmfile(tmppath);
+	}
+
+	free(tmppath);
+	free(path);
+}
+
+
+static struct sync_game *
+find_sync_game(struct minimod_ctx *ctx, uint64_t in_game_id)
+{
+	for (struct sync_game *g = ctx->sync_games; g; g = g->next)
+	{
+		if (g->game_id == in_game_id)
+		{
+			return g;
+		}
+	}
+	return NULL;
+}
+
+
+static void
+free_sync_game(struct sync_game *g)
 {
-	char *path;
+	free(g->events);
+	free(g);
+}
+
+
+static void
+free_sync_games(struct minimod_ctx *ctx)
+{
+	while (ctx->sync_games)
+	{
+		struct sync_game *next = ctx->sync_games->next;
+		free_sync_game(ctx->sync_games);
+		ctx->sync_games = next;
+	}
+}
+
+
+static int
+compare_sync_events(void const *in_a, void const *in_b)
+{
+	struct sync_event const *a = in_a;
+	struct sync_event const *b = in_b;
+	// user and mod events are numbered independently
+	if (a->date_added != b->date_added)
+	{
+		return a->date_added < b->date_added ? -1 : 1;
+	}
+	return (a->id > b->id) - (a->id < b->id);
+}
+
+
+// fold the events into one step per mod
+static struct sync_step *
+plan_sync(struct sync_event *io_events, size_t in_nevents, size_t *out_nsteps)
+{
+	qsort(io_events, in_nevents, sizeof *io_events, compare_sync_events);
+
+	struct sync_step *steps = calloc(in_nevents + 1, sizeof *steps);
+	size_t nsteps = 0;
+	for (size_t i = 0; i < in_nevents; ++i)
+	{
+		struct sync_event const *e = &io_events[i];
+		struct sync_step *step = NULL;
+		for (size_t k = 0; k < nsteps && !step; ++k)
+		{
+			step = steps[k].mod_id == e->mod_id ? &steps[k] : NULL;
+		}
+		if (!step)
+		{
+			step = &steps[nsteps++];
+			step->mod_id = e->mod_id;
+		}
+
+		switch (e->type)
+		{
+		case MINIMOD_EVENTTYPE_SUBSCRIBE:
+			step->is_wanted = true;
+			step->is_wanted_known = true;
+			break;
+		case MINIMOD_EVENTTYPE_UNSUBSCRIBE:
+		case MINIMOD_EVENTTYPE_MOD_DELETED:
+			step->is_wanted = false;
+			step->is_wanted_known = true;
+			break;
+		case MINIMOD_EVENTTYPE_MODFILE_CHANGED:
+			step->is_changed = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	*out_nsteps = nsteps;
+	return steps;
+}
+
+
+static void
+on_sync_installed(
+  void *in_userdata,
+  bool in_success,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	struct sync_install *si = in_userdata;
+	if (si->callback)
+	{
+		si->callback(
+		  si->userdata,
+		  in_game_id,
+		  in_mod_id,
+		  si->action,
+		  in_success);
+	}
+	free(si);
+}
+
+
+static void
+run_sync_plan(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  struct sync_step const *in_steps,
+  size_t in_nsteps,
+  minimod_sync_callback in_callback,
+  void *in_userdata)
+{
+	for (size_t i = 0; i < in_nsteps; ++i)
+	{
+		struct sync_step const *step = &in_steps[i];
+		bool const is_installed =
+		  minimod_ctx_is_installed(ctx, in_game_id, step->mod_id);
+		bool const is_wanted = step->is_wanted_known ? step->is_wanted
+		                                             : is_installed;
+
+		if (is_installed && !is_wanted)
+		{
+			LOG("sync: uninstalling %" PRIu64, step->mod_id);
+			bool const ok =
+			  minimod_ctx_uninstall(ctx, in_game_id, step->mod_id);
+			if (in_callback)
+			{
+				in_callback(
+				  in_userdata,
+				  in_game_id,
+				  step->mod_id,
+				  MINIMOD_SYNC_UNINSTALL,
+				  ok);
+			}
+		}
+		else if (is_wanted && (!is_installed || step->is_changed))
+		{
+			LOG("sync: installing %" PRIu64, step->mod_id);
+			struct sync_install *si = calloc(1, sizeof *si);
+			si->callback = in_callback;
+			si->userdata = in_userdata;
+			si->action =
+			  is_installed ? MINIMOD_SYNC_UPDATE : MINIMOD_SYNC_INSTALL;
+			minimod_ctx_enqueue_install(
+			  ctx,
+			  in_game_id,
+			  step->mod_id,
+			  0,
+			  MINIMOD_INSTALL_PRIORITY_BACKGROUND,
+			  on_sync_installed,
+			  si);
+		}
+	}
+}
+
+
+// Called once all requests of a poll are answered.
+static void
+finish_sync_poll(struct sync_game *g)
+{
+	struct minimod_ctx *ctx = g->ctx;
+	mtx_lock(&ctx->sync_mtx);
+	struct sync_event *events = g->events;
+	size_t const nevents = g->nevents;
+	g->events = NULL;
+	g->nevents = 0;
+	bool const is_applied = !g->is_failed && !g->is_stopped;
+	minimod_sync_callback callback = g->callback;
+	void *userdata = g->userdata;
+	mtx_unlock(&ctx->sync_mtx);
+
+	if (is_applied)
+	{
+		size_t nsteps = 0;
+		struct sync_step *steps = plan_sync(events, nevents, &nsteps);
+		run_sync_plan(ctx, g->game_id, steps, nsteps, callback, userdata);
+		free(steps);
+	}
+
+	mtx_lock(&ctx->sync_mtx);
+	if (is_applied)
+	{
+		for (size_t i = 0; i < nevents; ++i)
+		{
+			struct sync_event const *e = &events[i];
+			bool const is_user_event = e->type == MINIMOD_EVENTTYPE_SUBSCRIBE
+			  || e->type == MINIMOD_EVENTTYPE_UNSUBSCRIBE;
+			uint64_t *cursor =
+			  is_user_event ? &g->user_event_id : &g->mod_event_id;
+			*cursor = e->id > *cursor ? e->id : *cursor;
+		}
+		write_sync_state(g);
+	}
+
+	// back off while nothing happens or requests fail
+	bool const is_busy = is_applied && nevents > 0;
+	uint32_t const interval_ms = g->interval_ms * 2;
+	g->interval_ms = is_busy ? ctx->sync_min_interval_ms : interval_ms;
+	if (g->interval_ms > ctx->sync_max_interval_ms)
+	{
+		g->interval_ms = ctx->sync_max_interval_ms;
+	}
+	bool const is_due = is_applied && g->has_more;
+	g->next_poll =
+	  sys_microseconds() + (is_due ? 0 : g->interval_ms * UINT64_C(1000));
+	g->is_polling = false;
+	bool const is_stopped = g->is_stopped;
+	mtx_unlock(&ctx->sync_mtx);
+
+	free(events);
+	if (is_stopped)
+	{
+		free_sync_game(g);
+	}
+}
+
+
+static void
+add_sync_events(
+  struct sync_game *g,
+  size_t in_nevents,
+  struct minimod_event const *in_events,
+  struct minimod_pagination const *in_pagi)
+{
+	struct minimod_ctx *ctx = g->ctx;
+	mtx_lock(&ctx->sync_mtx);
+	if (!in_pagi)
+	{
+		g->is_failed = true;
+	}
+	g->events =
+	  realloc(g->events, (g->nevents + in_nevents + 1) * sizeof *g->events);
+	for (size_t i = 0; i < in_nevents; ++i)
+	{
+		g->events[g->nevents++] = (struct sync_event){
+			.id = in_events[i].id,
+			.date_added = in_events[i].date_added,
+			.mod_id = in_events[i].mod_id,
+			.type = in_events[i].type,
+		};
+	}
+	g->has_more = g->has_more || in_nevents >= SYNC_PAGE_SIZE;
+	bool const is_finished = --g->npending == 0;
+	mtx_unlock(&ctx->sync_mtx);
+
+	if (is_finished)
+	{
+		finish_sync_poll(g);
+	}
+}
+
+
+static void
+on_sync_events(
+  void *in_userdata,
+  size_t in_nevents,
+  struct minimod_event const *in_events,
+  struct minimod_pagination const *in_pagi)
+{
+	add_sync_events(in_userdata, in_nevents, in_events, in_pagi);
+}
+
+
+struct sync_mod_filter
+{
+	char *ids;
+	size_t nids;
+};
+
+
+static void
+add_sync_mod_filter(
+  void *in_userdata,
+  uint64_t UNUSED(in_game_id),
+  uint64_t in_mod_id,
+  char const *UNUSED(in_path))
+{
+	struct sync_mod_filter *filter = in_userdata;
+	if (filter->nids++ < SYNC_MAX_FILTERED_MODS)
+	{
+		char *ids;
+		asprintf(
+		  &ids,
+		  "%s%s%" PRIu64,
+		  filter->ids ? filter->ids : "",
+		  filter->ids ? "," : "",
+		  in_mod_id);
+		free(filter->ids);
+		filter->ids = ids;
+	}
+}
+
+
+static char *
+sync_cursor_filter(uint64_t in_event_id)
+{
+	char *filter;
 	asprintf(
-	  &path,
-	  "%s/games?api_key=%s&%s",
-	  endpoints[l_mmi.env],
-	  l_mmi.api_key,
-	  in_filter ? in_filter : "");
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		NULL
-		// clang-format on
+	  &filter,
+	  "_sort=id&_limit=%i&id-gt=%" PRIu64,
+	  SYNC_PAGE_SIZE,
+	  in_event_id);
+	return filter;
+}
+
+
+static void
+start_sync_poll(struct sync_game *g)
+{
+	struct minimod_ctx *ctx = g->ctx;
+	struct sync_mod_filter mods = { 0 };
+	minimod_ctx_enum_installed_mods(
+	  ctx,
+	  g->game_id,
+	  add_sync_mod_filter,
+	  &mods);
+
+	bool const has_user = minimod_ctx_is_authenticated(ctx);
+	bool const has_mods = mods.nids > 0;
+
+	mtx_lock(&ctx->sync_mtx);
+	g->is_failed = false;
+	g->has_more = false;
+	// + 1 for this function, so no response finishes the poll early
+	g->npending = 1 + (has_user ? 1 : 0) + (has_mods ? 1 : 0);
+	uint64_t const user_event_id = g->user_event_id;
+	uint64_t const mod_event_id = g->mod_event_id;
+	uint64_t const date_baseline = g->date_baseline;
+	mtx_unlock(&ctx->sync_mtx);
+
+	if (has_user)
+	{
+		char *cursor = sync_cursor_filter(user_event_id);
+		char *filter;
+		asprintf(
+		  &filter,
+		  "event_type-in=USER_SUBSCRIBE,USER_UNSUBSCRIBE&%s",
+		  cursor);
+		bool const is_sent = minimod_ctx_get_user_events(
+		  ctx,
+		  filter,
+		  g->game_id,
+		  user_event_id ? 0 : date_baseline,
+		  on_sync_events,
+		  g);
+		if (!is_sent)
+		{
+			// deauthenticated in the meantime
+			add_sync_events(g, 0, NULL, NULL);
+		}
+		free(filter);
+		free(cursor);
+	}
+
+	if (has_mods)
+	{
+		char *cursor = sync_cursor_filter(mod_event_id);
+		char *filter;
+		asprintf(
+		  &filter,
+		  "event_type-in=MODFILE_CHANGED,MOD_DELETED&%s%s%s",
+		  cursor,
+		  mods.nids <= SYNC_MAX_FILTERED_MODS ? "&mod_id-in=" : "",
+		  mods.nids <= SYNC_MAX_FILTERED_MODS ? mods.ids : "");
+		minimod_handle const handle = minimod_ctx_get_mod_events(
+		  ctx,
+		  filter,
+		  g->game_id,
+		  0,
+		  mod_event_id ? 0 : date_baseline,
+		  on_sync_events,
+		  g);
+		if (!handle)
+		{
+			// no callback follows, which would end the poll
+			add_sync_events(g, 0, NULL, NULL);
+		}
+		free(filter);
+		free(cursor);
+	}
+	free(mods.ids);
+
+	add_sync_events(g, 0, NULL, &(struct minimod_pagination){ 0 });
+}
+
+
+void
+minimod_ctx_start_sync(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  minimod_sync_callback in_callback,
+  void *in_userdata)
+{
+	ASSERT(in_game_id > 0);
+
+	mtx_lock(&ctx->sync_mtx);
+	struct sync_game *g = find_sync_game(ctx, in_game_id);
+	if (!g)
+	{
+		g = calloc(1, sizeof *g);
+		g->ctx = ctx;
+		g->game_id = in_game_id;
+		g->interval_ms = ctx->sync_min_interval_ms;
+		read_sync_state(g);
+		g->next = ctx->sync_games;
+		ctx->sync_games = g;
+	}
+	g->callback = in_callback;
+	g->userdata = in_userdata;
+	mtx_unlock(&ctx->sync_mtx);
+}
+
+
+void
+minimod_ctx_stop_sync(struct minimod_ctx *ctx, uint64_t in_game_id)
+{
+	mtx_lock(&ctx->sync_mtx);
+	struct sync_game **link = &ctx->sync_games;
+	while (*link && (*link)->game_id != in_game_id)
+	{
+		link = &(*link)->next;
+	}
+	struct sync_game *g = *link;
+	bool is_idle = false;
+	if (g)
+	{
+		*link = g->next;
+		// a running poll frees it, once it is finished
+		g->is_stopped = true;
+		is_idle = !g->is_polling;
+	}
+	mtx_unlock(&ctx->sync_mtx);
+
+	if (is_idle)
+	{
+		free_sync_game(g);
+	}
+}
+
+
+uint32_t
+minimod_ctx_sync_tick(struct minimod_ctx *ctx)
+{
+	uint64_t const now = sys_microseconds();
+	// do not spend the rate limit on polls
+	int64_t const ratelimited_s = minimod_ctx_is_ratelimited(ctx);
+	uint64_t const not_before = ratelimited_s > 0
+	  ? now + (uint64_t)ratelimited_s * UINT64_C(1000000)
+	  : now;
+
+	struct sync_game **due = NULL;
+	size_t ndue = 0;
+	uint64_t next_poll = now + ctx->sync_max_interval_ms * UINT64_C(1000);
+
+	mtx_lock(&ctx->sync_mtx);
+	for (struct sync_game *g = ctx->sync_games; g; g = g->next)
+	{
+		if (g->is_polling)
+		{
+			continue;
+		}
+		if (g->next_poll <= now && not_before <= now)
+		{
+			g->is_polling = true;
+			due = realloc(due, (ndue + 1) * sizeof *due);
+			due[ndue++] = g;
+			continue;
+		}
+		uint64_t const poll = g->next_poll > not_before ? g->next_poll
+		                                                : not_before;
+		next_poll = poll < next_poll ? poll : next_poll;
+	}
+	mtx_unlock(&ctx->sync_mtx);
+
+	for (size_t i = 0; i < ndue; ++i)
+	{
+		LOG("sync: polling game %" PRIu64, due[i]->game_id);
+		start_sync_poll(due[i]);
+	}
+	free(due);
+
+	return (uint32_t)((next_poll - now + 999) / 1000);
+}
+
+
+void
+minimod_ctx_set_sync_interval(
+  struct minimod_ctx *ctx,
+  uint32_t in_min_ms,
+  uint32_t in_max_ms)
+{
+	ASSERT(in_min_ms <= in_max_ms);
+
+	mtx_lock(&ctx->sync_mtx);
+	ctx->sync_min_interval_ms = in_min_ms;
+	ctx->sync_max_interval_ms = in_max_ms;
+	for (struct sync_game *g = ctx->sync_games; g; g = g->next)
+	{
+		uint32_t const ms = g->interval_ms;
+		g->interval_ms = ms < in_min_ms ? in_min_ms : ms;
+		g->interval_ms = ms > in_max_ms ? in_max_ms : g->interval_ms;
+	}
+	mtx_unlock(&ctx->sync_mtx);
+}
+
+
+// RECONCILE
+// ---------
+struct reconcile_sub
+{
+	uint64_t mod_id;
+	uint64_t modfile_id;
+	uint64_t filesize;
+	bool is_installed;
+	char _padding[7];
+};
+
+
+struct reconcile
+{
+	struct minimod_ctx *ctx;
+	uint64_t game_id;
+	minimod_reconcile_callback callback;
+	void *userdata;
+	// subscriptions as they arrive, turned into a hash set once complete
+	struct reconcile_sub *subs;
+	size_t nsubs;
+	size_t nslots;
+	struct minimod_reconcile_step *steps;
+	size_t nsteps;
+	bool is_execute;
+	char _padding[7];
+};
+
+
+// open addressing, mod_id 0 marks an empty slot
+static struct reconcile_sub *
+find_reconcile_sub(struct reconcile *r, uint64_t in_mod_id)
+{
+	size_t i = (size_t)(in_mod_id * 0x9E3779B97F4A7C15ull) & (r->nslots - 1);
+	while (r->subs[i].mod_id != 0 && r->subs[i].mod_id != in_mod_id)
+	{
+		i = (i + 1) & (r->nslots - 1);
+	}
+	return &r->subs[i];
+}
+
+
+static void
+hash_reconcile_subs(struct reconcile *r)
+{
+	r->nslots = 16;
+	while (r->nslots < r->nsubs * 2)
+	{
+		r->nslots *= 2;
+	}
+
+	struct reconcile_sub *list = r->subs;
+	r->subs = calloc(r->nslots, sizeof *r->subs);
+	for (size_t i = 0; i < r->nsubs; ++i)
+	{
+		*find_reconcile_sub(r, list[i].mod_id) = list[i];
+	}
+	free(list);
+}
+
+
+static void
+add_reconcile_step(
+  struct reconcile *r,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  uint64_t in_filesize,
+  enum minimod_reconcile_action in_action)
+{
+	r->steps = realloc(r->steps, (r->nsteps + 1) * sizeof *r->steps);
+	r->steps[r->nsteps++] = (struct minimod_reconcile_step){
+		.mod_id = in_mod_id,
+		.modfile_id = in_modfile_id,
+		.filesize = in_filesize,
+		.action = in_action,
+	};
+}
+
+
+// Probe every installed mod of the game against the subscriptions.
+static void
+on_reconcile_installed(
+  void *in_userdata,
+  struct modindex_entry const *in_entry)
+{
+	struct reconcile *r = in_userdata;
+	struct reconcile_sub *sub = find_reconcile_sub(r, in_entry->mod_id);
+	if (sub->mod_id == 0)
+	{
+		add_reconcile_step(
+		  r,
+		  in_entry->mod_id,
+		  0,
+		  0,
+		  MINIMOD_RECONCILE_REMOVE);
+		return;
+	}
+
+	sub->is_installed = true;
+	if (sub->modfile_id != 0 && sub->modfile_id != in_entry->modfile_id)
+	{
+		add_reconcile_step(
+		  r,
+		  sub->mod_id,
+		  sub->modfile_id,
+		  sub->filesize,
+		  MINIMOD_RECONCILE_UPDATE);
+	}
+}
+
+
+static int
+cmp_reconcile_steps(void const *in_a, void const *in_b)
+{
+	struct minimod_reconcile_step const *a = in_a;
+	struct minimod_reconcile_step const *b = in_b;
+	if (a->action != b->action)
+	{
+		return a->action < b->action ? -1 : 1;
+	}
+	return a->mod_id < b->mod_id ? -1 : (a->mod_id > b->mod_id);
+}
+
+
+static void
+finish_reconcile(struct reconcile *r)
+{
+	struct minimod_ctx *ctx = r->ctx;
+	hash_reconcile_subs(r);
+	modindex_enum(ctx->installed, r->game_id, on_reconcile_installed, r);
+
+	for (size_t i = 0; i < r->nslots; ++i)
+	{
+		struct reconcile_sub const *sub = &r->subs[i];
+		// mods without a modfile cannot be installed anyway
+		if (sub->mod_id != 0 && !sub->is_installed && sub->modfile_id != 0)
+		{
+			add_reconcile_step(
+			  r,
+			  sub->mod_id,
+			  sub->modfile_id,
+			  sub->filesize,
+			  MINIMOD_RECONCILE_INSTALL);
+		}
+	}
+
+	if (r->nsteps > 0)
+	{
+		qsort(r->steps, r->nsteps, sizeof *r->steps, cmp_reconcile_steps);
+	}
+
+	struct minimod_reconcile_plan plan = {
+		.game_id = r->game_id,
+		.steps = r->steps,
+		.nsteps = r->nsteps,
 	};
+	for (size_t i = 0; i < r->nsteps; ++i)
+	{
+		switch (r->steps[i].action)
+		{
+		case MINIMOD_RECONCILE_INSTALL:
+			plan.ninstalls += 1;
+			break;
+		case MINIMOD_RECONCILE_UPDATE:
+			plan.nupdates += 1;
+			break;
+		case MINIMOD_RECONCILE_REMOVE:
+			plan.nremovals += 1;
+			break;
+		}
+		plan.nbytes_download += r->steps[i].filesize;
+	}
+	LOG("reconcile: %zu installs, %zu updates, %zu removals, %" PRIu64
+	    " bytes",
+	  plan.ninstalls,
+	  plan.nupdates,
+	  plan.nremovals,
+	  plan.nbytes_download);
+
+	if (r->callback)
+	{
+		r->callback(r->userdata, &plan);
+	}
 
-	struct task *task = alloc_task();
-	task->callback.fptr.get_games = in_callback;
-	task->callback.userdata = in_udata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_games,
-	      task))
+	if (r->is_execute)
 	{
-		free_task(task);
+		for (size_t i = 0; i < r->nsteps; ++i)
+		{
+			struct minimod_reconcile_step const *step = &r->steps[i];
+			if (step->action == MINIMOD_RECONCILE_REMOVE)
+			{
+				minimod_ctx_uninstall(ctx, r->game_id, step->mod_id);
+			}
+			else
+			{
+				minimod_ctx_enqueue_install(
+				  ctx,
+				  r->game_id,
+				  step->mod_id,
+				  step->modfile_id,
+				  MINIMOD_INSTALL_PRIORITY_BACKGROUND,
+				  NULL,
+				  NULL);
+			}
+		}
 	}
+}
 
-	free(path);
+
+static void
+free_reconcile(struct reconcile *r)
+{
+	free(r->subs);
+	free(r->steps);
+	free(r);
 }
 
 
-void
-minimod_get_mods(
-  char const *in_filter,
+// Pages are delivered one at a time and in order, so no locking is needed.
+static void
+on_reconcile_page(
+  void *in_userdata,
+  size_t in_nmods,
+  struct minimod_mod const *in_mods,
+  struct minimod_pagination const *in_pagination)
+{
+	struct reconcile *r = in_userdata;
+
+	if (!in_pagination)
+	{
+		LOGE("reconcile: retrieving subscriptions failed");
+		if (r->callback)
+		{
+			r->callback(r->userdata, NULL);
+		}
+		free_reconcile(r);
+		return;
+	}
+
+	r->subs = realloc(r->subs, (r->nsubs + in_nmods) * sizeof *r->subs);
+	for (size_t i = 0; i < in_nmods; ++i)
+	{
+		QAJ4C_Value const *modfile =
+		  QAJ4C_object_get(in_mods[i].more, "modfile");
+		r->subs[r->nsubs++] = (struct reconcile_sub){
+			.mod_id = in_mods[i].id,
+			.modfile_id = in_mods[i].modfile_id,
+			.filesize =
+			  QAJ4C_get_uint64(QAJ4C_object_get(modfile, "filesize")),
+		};
+	}
+
+	// the paging ends with this flag or with a failure, even if the total
+	// changes meanwhile
+	if (in_pagination->is_last)
+	{
+		finish_reconcile(r);
+		free_reconcile(r);
+	}
+}
+
+
+bool
+minimod_ctx_reconcile(
+  struct minimod_ctx *ctx,
   uint64_t in_game_id,
-  uint64_t in_mod_id,
-  minimod_get_mods_callback in_callback,
+  unsigned int in_max_inflight,
+  bool in_execute,
+  minimod_reconcile_callback in_callback,
   void *in_userdata)
 {
 	ASSERT(in_game_id > 0);
-	char *path;
-	if (in_mod_id)
+	struct auth *auth = pin_auth(ctx);
+	if (!auth)
 	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "?api_key=%s&%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  in_mod_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "");
+		return false;
 	}
-	else
+
+	struct reconcile *r = calloc(1, sizeof *r);
+	r->ctx = ctx;
+	r->game_id = in_game_id;
+	r->callback = in_callback;
+	r->userdata = in_userdata;
+	r->is_execute = in_execute;
+
+	char *filter = NULL;
+	asprintf(&filter, "game_id=%" PRIu64, in_game_id);
+
+	struct callback callback = { .userdata = r };
+	callback.fptr.get_mods = on_reconcile_page;
+	// it is never cancelled
+	release_paging(start_paging(ctx,
+	  path_subscriptions(ctx, filter),
+	  auth,
+	  in_max_inflight,
+	  deliver_mods,
+	  callback));
+
+	free(filter);
+	return true;
+}
+
+
+// DEPENDENCIES
+// ------------
+#define DEPENDENCY_DEFAULT_INFLIGHT 4
+#define DEPENDENCY_MAX_INFLIGHT 16
+
+struct dep_node
+{
+	uint64_t mod_id;
+	uint64_t *deps;
+	size_t ndeps;
+	// while ordering: 0 = unvisited, 1 = on the stack, 2 = done
+	int mark;
+	char _padding[4];
+};
+
+
+struct dep_resolve
+{
+	struct minimod_ctx *ctx;
+	mtx_t mtx;
+	uint64_t game_id;
+	minimod_resolve_dependencies_callback callback;
+	void *userdata;
+	// in order of discovery, so nodes[nrequested..nnodes) is the queue
+	// of the breadth-first expansion
+	struct dep_node *nodes;
+	size_t nnodes;
+	size_t nrequested;
+	// open addressing, index + 1 into nodes, 0 marks an empty slot
+	size_t *slots;
+	size_t nslots;
+	size_t ninflight;
+	size_t max_inflight;
+	bool is_failed;
+	bool has_cycle;
+	char _padding[6];
+};
+
+
+struct dep_request
+{
+	struct dep_resolve *resolve;
+	size_t index;
+};
+
+
+static size_t *
+find_dep_slot(struct dep_resolve *r, uint64_t in_mod_id)
+{
+	size_t i = (size_t)(in_mod_id * 0x9E3779B97F4A7C15ull) & (r->nslots - 1);
+	while (r->slots[i] != 0 && r->nodes[r->slots[i] - 1].mod_id != in_mod_id)
 	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods?api_key=%s&%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "");
+		i = (i + 1) & (r->nslots - 1);
 	}
+	return &r->slots[i];
+}
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		NULL
-		// clang-format on
-	};
 
-	struct task *task = alloc_task();
-	task->callback.fptr.get_mods = in_callback;
-	task->callback.userdata = in_userdata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_mods,
-	      task))
+static void
+add_dep_node(struct dep_resolve *r, uint64_t in_mod_id)
+{
+	if (r->nslots > 0 && *find_dep_slot(r, in_mod_id) != 0)
 	{
-		free_task(task);
+		return;
 	}
 
-	free(path);
+	if ((r->nnodes + 1) * 2 > r->nslots)
+	{
+		free(r->slots);
+		r->nslots = r->nslots > 0 ? r->nslots * 2 : 16;
+		r->slots = calloc(r->nslots, sizeof *r->slots);
+		for (size_t i = 0; i < r->nnodes; ++i)
+		{
+			*find_dep_slot(r, r->nodes[i].mod_id) = i + 1;
+		}
+	}
+
+	r->nodes = realloc(r->nodes, (r->nnodes + 1) * sizeof *r->nodes);
+	r->nodes[r->nnodes] = (struct dep_node){ .mod_id = in_mod_id };
+	r->nnodes += 1;
+	*find_dep_slot(r, in_mod_id) = r->nnodes;
 }
 
 
-void
-minimod_email_request(
-  char const *in_email,
-  minimod_email_request_callback in_callback,
-  void *in_udata)
+static void
+free_dep_resolve(struct dep_resolve *r)
 {
-	char *path;
-	asprintf(&path, "%s/oauth/emailrequest", endpoints[l_mmi.env]);
+	for (size_t i = 0; i < r->nnodes; ++i)
+	{
+		free(r->nodes[i].deps);
+	}
+	free(r->nodes);
+	free(r->slots);
+	mtx_destroy(&r->mtx);
+	free(r);
+}
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Content-Type", "application/x-www-form-urlencoded",
-		NULL
-		// clang-format on
+
+// Depth-first post-order, so every mod comes after its dependencies.
+static void
+order_dependencies(
+  struct dep_resolve *r,
+  size_t in_index,
+  uint64_t *io_mod_ids,
+  size_t *io_nmod_ids)
+{
+	struct minimod_ctx *ctx = r->ctx;
+	struct dep_node *node = &r->nodes[in_index];
+	if (node->mark == 2)
+	{
+		return;
+	}
+	if (node->mark == 1)
+	{
+		r->has_cycle = true;
+		return;
+	}
+
+	node->mark = 1;
+	for (size_t i = 0; i < node->ndeps; ++i)
+	{
+		size_t const dep = *find_dep_slot(r, node->deps[i]) - 1;
+		order_dependencies(r, dep, io_mod_ids, io_nmod_ids);
+	}
+	node->mark = 2;
+
+	if (!minimod_ctx_is_installed(ctx, r->game_id, node->mod_id))
+	{
+		io_mod_ids[(*io_nmod_ids)++] = node->mod_id;
+	}
+}
+
+
+// Called once no request is in flight anymore.
+static void
+finish_dependencies(struct dep_resolve *r)
+{
+	if (r->is_failed)
+	{
+		LOGE("dependencies: resolving %" PRIu64 " failed", r->nodes[0].mod_id);
+		r->callback(r->userdata, NULL);
+		free_dep_resolve(r);
+		return;
+	}
+
+	uint64_t *mod_ids = malloc(r->nnodes * sizeof *mod_ids);
+	size_t nmod_ids = 0;
+	order_dependencies(r, 0, mod_ids, &nmod_ids);
+
+	struct minimod_dependency_order order = {
+		.game_id = r->game_id,
+		.mod_id = r->nodes[0].mod_id,
+		.mod_ids = mod_ids,
+		.nmod_ids = nmod_ids,
+		.nresolved = r->nnodes,
+		.has_cycle = r->has_cycle,
 	};
+	LOG("dependencies: %zu mods, %zu to install%s",
+	  r->nnodes,
+	  nmod_ids,
+	  r->has_cycle ? ", cyclic" : "");
+	r->callback(r->userdata, &order);
+
+	free(mod_ids);
+	free_dep_resolve(r);
+}
 
-	char *payload;
-	char *email = netw_percent_encode(in_email, strlen(in_email), NULL);
-	int nbytes =
-	  asprintf(&payload, "api_key=%s&email=%s", l_mmi.api_key, email);
-	free(email);
-	LOG("payload: %s (%i)", payload, nbytes);
 
-	struct task *task = alloc_task();
-	task->callback.fptr.email_request = in_callback;
-	task->callback.userdata = in_udata;
-	if (!netw_request(
-	      NETW_VERB_POST,
-	      path,
-	      headers,
-	      payload,
-	      (size_t)nbytes,
-	      handle_email_request,
-	      task))
+static void
+on_dependencies(
+  void *in_userdata,
+  size_t in_ndeps,
+  uint64_t const *in_deps,
+  struct minimod_pagination const *in_pagination);
+
+
+// Requests queued nodes while there is room. Expects r->mtx to be locked,
+// which is unlocked before any request is submitted.
+static void
+pump_dependencies(struct dep_resolve *r)
+{
+	struct minimod_ctx *ctx = r->ctx;
+	uint64_t mod_ids[DEPENDENCY_MAX_INFLIGHT];
+	size_t indices[DEPENDENCY_MAX_INFLIGHT];
+	size_t n = 0;
+	while (!r->is_failed && r->ninflight < r->max_inflight
+	  && r->nrequested < r->nnodes)
 	{
-		free_task(task);
+		indices[n] = r->nrequested;
+		mod_ids[n] = r->nodes[r->nrequested].mod_id;
+		r->nrequested += 1;
+		r->ninflight += 1;
+		n += 1;
 	}
+	bool const is_finished = r->ninflight == 0;
+	uint64_t const game_id = r->game_id;
+	mtx_unlock(&r->mtx);
 
-	free(payload);
-	free(path);
+	if (is_finished)
+	{
+		finish_dependencies(r);
+		return;
+	}
+
+	// requests which could not be submitted keep counting as in flight
+	// until all are submitted, so *r* cannot be finished in between.
+	size_t nfailed = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		struct dep_request *req = malloc(sizeof *req);
+		req->resolve = r;
+		req->index = indices[i];
+		if (!get_dependencies(ctx, game_id, mod_ids[i], on_dependencies, req))
+		{
+			free(req);
+			nfailed += 1;
+		}
+	}
+
+	if (nfailed > 0)
+	{
+		mtx_lock(&r->mtx);
+		r->ninflight -= nfailed;
+		r->is_failed = true;
+		pump_dependencies(r);
+	}
+}
+
+
+static void
+on_dependencies(
+  void *in_userdata,
+  size_t in_ndeps,
+  uint64_t const *in_deps,
+  struct minimod_pagination const *in_pagination)
+{
+	struct dep_request *req = in_userdata;
+	struct dep_resolve *r = req->resolve;
+	size_t const index = req->index;
+	free(req);
+
+	mtx_lock(&r->mtx);
+	r->ninflight -= 1;
+	if (!in_pagination)
+	{
+		r->is_failed = true;
+	}
+	else if (!r->is_failed)
+	{
+		uint64_t *deps = malloc(in_ndeps * sizeof *deps);
+		size_t ndeps = 0;
+		for (size_t i = 0; i < in_ndeps; ++i)
+		{
+			if (in_deps[i] != 0)
+			{
+				deps[ndeps++] = in_deps[i];
+				add_dep_node(r, in_deps[i]);
+			}
+		}
+		r->nodes[index].deps = deps;
+		r->nodes[index].ndeps = ndeps;
+	}
+	pump_dependencies(r);
 }
 
 
 void
-minimod_email_exchange(
-  char const *in_code,
-  minimod_access_token_callback in_callback,
-  void *in_udata)
+minimod_ctx_resolve_dependencies(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_resolve_dependencies_callback in_callback,
+  void *in_userdata)
 {
-	char *path;
-	asprintf(&path, "%s/oauth/emailexchange", endpoints[l_mmi.env]);
+	ASSERT(in_game_id > 0);
+	ASSERT(in_mod_id > 0);
+	ASSERT(in_callback);
+
+	struct dep_resolve *r = calloc(1, sizeof *r);
+	mtx_init(&r->mtx, mtx_plain);
+	r->ctx = ctx;
+	r->game_id = in_game_id;
+	r->callback = in_callback;
+	r->userdata = in_userdata;
+	r->max_inflight =
+	  in_max_inflight > 0 ? in_max_inflight : DEPENDENCY_DEFAULT_INFLIGHT;
+	if (r->max_inflight > DEPENDENCY_MAX_INFLIGHT)
+	{
+		r->max_inflight = DEPENDENCY_MAX_INFLIGHT;
+	}
+	add_dep_node(r, in_mod_id);
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Content-Type", "application/x-www-form-urlencoded",
-		NULL
-		// clang-format on
-	};
+	mtx_lock(&r->mtx);
+	pump_dependencies(r);
+}
 
-	char *payload;
-	int nbytes = asprintf(
-	  &payload,
-	  "api_key=%s&security_code=%s",
-	  l_mmi.api_key,
-	  in_code);
-	LOG("payload: %s (%i)", payload, nbytes);
 
-	struct task *task = alloc_task();
-	task->callback.fptr.access_token = in_callback;
-	task->callback.userdata = in_udata;
-	if (!netw_request(
-	      NETW_VERB_POST,
-	      path,
-	      headers,
-	      payload,
-	      (size_t)nbytes,
-	      handle_token_exchange,
-	      task))
+// BATCHING
+// --------
+struct batched_lookup
+{
+	uint64_t mod_id;
+	minimod_get_mods_callback callback;
+	void *userdata;
+	struct request_control control;
+};
+
+
+// lookups of mods of the same game, collected during the batching window
+struct mod_batch
+{
+	struct minimod_ctx *ctx;
+	struct mod_batch *next;
+	uint64_t game_id;
+	uint64_t deadline;
+	struct batched_lookup *lookups;
+	size_t nlookups;
+	size_t max_lookups;
+};
+
+
+// Fans out a response of a batch to the individual lookups, as if each
+// mod was requested on its own.
+static void
+on_batched_mods(
+  void *in_userdata,
+  size_t in_nmods,
+  struct minimod_mod const *in_mods,
+  struct minimod_pagination const *UNUSED(in_pagination))
+{
+	struct mod_batch *b = in_userdata;
+	struct minimod_ctx *ctx = b->ctx;
+	for (size_t i = 0; i < b->nlookups; ++i)
 	{
-		free_task(task);
-	}
+		struct batched_lookup *lookup = &b->lookups[i];
+		if (unregister_control(ctx, &lookup->control))
+		{
+			continue;
+		}
+		struct minimod_mod const *mod = NULL;
+		for (size_t k = 0; k < in_nmods && !mod; ++k)
+		{
+			mod = in_mods[k].id == lookup->mod_id ? &in_mods[k] : NULL;
+		}
 
-	free(payload);
-	free(path);
+		if (mod)
+		{
+			lookup->callback(lookup->userdata, 1, mod, NULL);
+		}
+		else
+		{
+			lookup->callback(lookup->userdata, 0, NULL, NULL);
+		}
+		finish_handle(ctx, lookup->control.handle);
+	}
+	free(b->lookups);
+	free(b);
 }
 
 
-void
-minimod_steam_auth(
-  void const *in_ticket,
-  size_t in_ticketbytes,
-  minimod_access_token_callback in_callback,
-  void *in_udata)
+static void
+submit_batch(struct mod_batch *b)
 {
-	char *path;
-	asprintf(&path, "%s/external/steamauth", endpoints[l_mmi.env]);
+	struct minimod_ctx *ctx = b->ctx;
+	char *ids = NULL;
+	// as urgent as the most urgent lookup
+	enum minimod_priority priority = MINIMOD_PRIORITY_BACKGROUND;
+	for (size_t i = 0; i < b->nlookups; ++i)
+	{
+		enum minimod_priority const p =
+		  get_control_priority(&b->lookups[i].control);
+		priority = p < priority ? p : priority;
+
+		// the same mod may be looked up more than once
+		bool is_duplicate = false;
+		for (size_t k = 0; k < i && !is_duplicate; ++k)
+		{
+			is_duplicate = b->lookups[k].mod_id == b->lookups[i].mod_id;
+		}
+		if (!is_duplicate)
+		{
+			char *more;
+			asprintf(
+			  &more,
+			  "%s%s%" PRIu64,
+			  ids ? ids : "",
+			  ids ? "," : "",
+			  b->lookups[i].mod_id);
+			free(ids);
+			ids = more;
+		}
+	}
+
+	char *filter;
+	asprintf(&filter, "_limit=%i&id-in=%s", PAGING_LIMIT, ids);
+	char *path = path_mods(ctx, filter, b->game_id, 0);
+	LOG("batch: %zu lookups: %s", b->nlookups, path);
 
 	char const *const headers[] = {
 		// clang-format off
 		"Accept", "application/json",
-		"Content-Type", "application/x-www-form-urlencoded",
 		NULL
 		// clang-format on
 	};
 
-	char b64[256];
-	size_t b64_len = enc_base64(in_ticket, in_ticketbytes, b64, sizeof b64);
-	ASSERT(b64_len <= sizeof b64);
-	char *ticket = netw_percent_encode(b64, b64_len, NULL);
-	char *payload;
-	int nbytes =
-	  asprintf(&payload, "api_key=%s&appdata=%s", l_mmi.api_key, ticket);
-	LOG("payload: %s (%i)", payload, nbytes);
-	free(ticket);
-
-	struct task *task = alloc_task();
-	task->callback.fptr.access_token = in_callback;
-	task->callback.userdata = in_udata;
-	if (!netw_request(
-	      NETW_VERB_POST,
-	      path,
-	      headers,
-	      payload,
-	      (size_t)nbytes,
-	      handle_token_exchange,
-	      task))
+	struct task *task = alloc_task(ctx);
+	task->callback.fptr.get_mods = on_batched_mods;
+	task->callback.userdata = b;
+	task->control.priority = priority;
+	if (!submit_get(path, headers, deliver_mods, task))
 	{
-		free_task(task);
+		on_batched_mods(b, 0, NULL, NULL);
 	}
 
-	free(payload);
 	free(path);
+	free(filter);
+	free(ids);
 }
 
 
-bool
-minimod_get_me(minimod_get_users_callback in_callback, void *in_udata)
+// Returns:
+//	The handle of the lookup, 0 if batching is disabled.
+static minimod_handle
+enqueue_batched_lookup(
+  struct minimod_ctx *ctx,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  enum minimod_priority in_priority,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
 {
-	if (!minimod_is_authenticated())
+	mtx_lock(&ctx->batch_mtx);
+	if (ctx->batch_window_ms == 0)
 	{
-		return false;
+		mtx_unlock(&ctx->batch_mtx);
+		return 0;
 	}
 
-	char *path;
-	asprintf(&path, "%s/me", endpoints[l_mmi.env]);
+	struct mod_batch **it = &ctx->batches;
+	while (*it && (*it)->game_id != in_game_id)
+	{
+		it = &(*it)->next;
+	}
+	if (!*it)
+	{
+		struct mod_batch *b = calloc(1, sizeof *b);
+		b->ctx = ctx;
+		b->game_id = in_game_id;
+		b->deadline = sys_microseconds() + ctx->batch_window_ms * 1000ull;
+		b->max_lookups = ctx->max_batch_size;
+		b->lookups = calloc(b->max_lookups, sizeof *b->lookups);
+		b->next = ctx->batches;
+		ctx->batches = b;
+		it = &ctx->batches;
+		cnd_signal(&ctx->batch_cnd);
+	}
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		NULL
-		// clang-format on
+	struct mod_batch *b = *it;
+	struct batched_lookup *lookup = &b->lookups[b->nlookups++];
+	*lookup = (struct batched_lookup){
+		.mod_id = in_mod_id,
+		.callback = in_callback,
+		.userdata = in_userdata,
+		.control.priority = in_priority,
 	};
-
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.fptr.get_users = in_callback;
-	task->callback.userdata = in_udata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_users,
-	      task))
+	minimod_handle const handle = register_control(ctx, &lookup->control);
+	// a full batch does not wait for its window to pass
+	bool const is_full = b->nlookups == b->max_lookups;
+	if (is_full)
 	{
-		free_task(task);
+		*it = b->next;
 	}
+	mtx_unlock(&ctx->batch_mtx);
 
-	free(path);
-
-	return true;
+	if (is_full)
+	{
+		submit_batch(b);
+	}
+	return handle;
 }
 
 
-bool
-minimod_get_user_events(
-  char const *in_filter,
-  uint64_t in_game_id,
-  uint64_t in_date_cutoff,
-  minimod_get_events_callback in_callback,
-  void *in_userdata)
+// Sleeps until the earliest window of an open batch passed, or until a
+// batch is opened while there is none.
+static int
+batch_main(void *in_arg)
 {
-	if (!minimod_is_authenticated())
+	struct minimod_ctx *ctx = in_arg;
+	mtx_lock(&ctx->batch_mtx);
+	while (!__atomic_load_n(&ctx->is_batch_quitting, __ATOMIC_ACQUIRE))
 	{
-		return false;
+		uint64_t const now = sys_microseconds();
+		uint64_t deadline = UINT64_MAX;
+		struct mod_batch *due = NULL;
+		struct mod_batch **it = &ctx->batches;
+		while (*it)
+		{
+			struct mod_batch *b = *it;
+			if (b->deadline <= now)
+			{
+				*it = b->next;
+				b->next = due;
+				due = b;
+			}
+			else
+			{
+				deadline = b->deadline < deadline ? b->deadline : deadline;
+				it = &b->next;
+			}
+		}
+
+		if (due)
+		{
+			mtx_unlock(&ctx->batch_mtx);
+			while (due)
+			{
+				struct mod_batch *next = due->next;
+				submit_batch(due);
+				due = next;
+			}
+			mtx_lock(&ctx->batch_mtx);
+		}
+		else if (deadline == UINT64_MAX)
+		{
+			cnd_wait(&ctx->batch_cnd, &ctx->batch_mtx);
+		}
+		else
+		{
+			// rounded up, to not wake up just before it is due
+			uint64_t const ms = (deadline - now + 999) / 1000;
+			sys_cnd_timedwait(
+			  &ctx->batch_cnd,
+			  &ctx->batch_mtx,
+			  ms < UINT32_MAX ? (uint32_t)ms : UINT32_MAX);
+		}
 	}
+	mtx_unlock(&ctx->batch_mtx);
+	return 0;
+}
 
-	char *game_filter = NULL;
-	if (in_game_id)
+
+static void
+stop_batching(struct minimod_ctx *ctx)
+{
+	if (ctx->has_batch_thread)
 	{
-		asprintf(&game_filter, "&game_id=%" PRIu64, in_game_id);
+		mtx_lock(&ctx->batch_mtx);
+		__atomic_store_n(&ctx->is_batch_quitting, true, __ATOMIC_RELEASE);
+		cnd_signal(&ctx->batch_cnd);
+		mtx_unlock(&ctx->batch_mtx);
+		thrd_join(ctx->batch_thread, NULL);
 	}
-	char *cutoff_filter = NULL;
-	if (in_date_cutoff)
+
+	struct mod_batch *b = ctx->batches;
+	ctx->batches = NULL;
+	while (b)
 	{
-		asprintf(&cutoff_filter, "&date_added-gt=%" PRIu64, in_date_cutoff);
+		struct mod_batch *next = b->next;
+		on_batched_mods(b, 0, NULL, NULL);
+		b = next;
 	}
-	char *path;
-	asprintf(
-	  &path,
-	  "%s/me/events?%s%s%s",
-	  endpoints[l_mmi.env],
-	  in_filter ? in_filter : "",
-	  game_filter ? game_filter : "",
-	  cutoff_filter ? cutoff_filter : "");
+	mtx_destroy(&ctx->batch_mtx);
+	cnd_destroy(&ctx->batch_cnd);
+}
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		NULL
-		// clang-format on
-	};
-	LOG("request: %s", path);
 
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.fptr.get_events = in_callback;
-	task->callback.userdata = in_userdata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_events,
-	      task))
+void
+minimod_ctx_set_batching(
+  struct minimod_ctx *ctx,
+  uint32_t in_window_ms,
+  unsigned int in_max_batch_size)
+{
+	mtx_lock(&ctx->batch_mtx);
+	ctx->batch_window_ms = in_window_ms;
+	ctx->max_batch_size =
+	  in_max_batch_size > 0 ? in_max_batch_size : DEFAULT_BATCH_SIZE;
+	// a batch is a single page of mods
+	if (ctx->max_batch_size > PAGING_LIMIT)
 	{
-		free_task(task);
+		ctx->max_batch_size = PAGING_LIMIT;
+	}
+	// started on demand, but kept running until minimod_deinit()
+	if (in_window_ms > 0 && !ctx->has_batch_thread)
+	{
+		ctx->has_batch_thread =
+		  (thrd_success == thrd_create(&ctx->batch_thread, batch_main, ctx));
 	}
+	mtx_unlock(&ctx->batch_mtx);
+}
 
-	free(path);
 
-	return true;
+char const *
+minimod_get_more_string(void const *more, char const *name)
+{
+	ASSERT(QAJ4C_is_object(more));
+	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
+	return QAJ4C_is_string(obj) ? QAJ4C_get_string(obj) : NULL;
+}
+
+
+int64_t
+minimod_get_more_int(void const *more, char const *name)
+{
+	ASSERT(QAJ4C_is_object(more));
+	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
+	return QAJ4C_is_int64(obj) ? QAJ4C_get_int64(obj) : 0;
+}
+
+
+double
+minimod_get_more_float(void const *more, char const *name)
+{
+	ASSERT(QAJ4C_is_object(more));
+	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
+	return QAJ4C_is_double(obj) ? QAJ4C_get_double(obj) : 0;
+}
+
+
+bool
+minimod_get_more_bool(void const *more, char const *name)
+{
+	ASSERT(QAJ4C_is_object(more));
+	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
+	return QAJ4C_is_bool(obj) ? QAJ4C_get_bool(obj) : 0;
+}
+
+
+// GLOBAL CONTEXT
+// --------------
+// The functions without a context use the one of minimod_init().
+size_t
+minimod_poll(size_t in_max_items, uint64_t in_budget_us)
+{
+	return minimod_ctx_poll(l_ctx, in_max_items, in_budget_us);
+}
+
+
+intptr_t
+minimod_get_completion_fd(void)
+{
+	return minimod_ctx_get_completion_fd(l_ctx);
+}
+
+
+int64_t
+minimod_is_ratelimited(void)
+{
+	return minimod_ctx_is_ratelimited(l_ctx);
 }
 
 
 void
-minimod_get_dependencies(
-  uint64_t in_game_id,
-  uint64_t in_mod_id,
-  minimod_get_dependencies_callback in_callback,
-  void *in_userdata)
+minimod_set_request_rate(
+  uint32_t in_requests_per_minute,
+  unsigned int in_burst)
 {
-	ASSERT(in_game_id > 0);
-	ASSERT(in_mod_id > 0);
+	minimod_ctx_set_request_rate(l_ctx, in_requests_per_minute, in_burst);
+}
 
-	char *path;
-	asprintf(
-	  &path,
-	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/dependencies?api_key=%s",
-	  endpoints[l_mmi.env],
-	  in_game_id,
-	  in_mod_id,
-	  l_mmi.api_key);
 
-	struct task *task = alloc_task();
-	task->callback.fptr.get_dependencies = in_callback;
-	task->callback.userdata = in_userdata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      NULL,
-	      NULL,
-	      0,
-	      handle_get_dependencies,
-	      task))
-	{
-		free_task(task);
-	}
+size_t
+minimod_get_scheduled_requests(void)
+{
+	return minimod_ctx_get_scheduled_requests(l_ctx);
+}
+
+
+void
+minimod_set_max_connections(unsigned int in_max_connections)
+{
+	minimod_ctx_set_max_connections(l_ctx, in_max_connections);
+}
+
+
+bool
+minimod_cancel(minimod_handle in_handle)
+{
+	return minimod_ctx_cancel(l_ctx, in_handle);
+}
+
+
+bool
+minimod_set_priority(
+  minimod_handle in_handle,
+  enum minimod_priority in_priority)
+{
+	return minimod_ctx_set_priority(l_ctx, in_handle, in_priority);
+}
+
+
+bool
+minimod_wait(minimod_handle in_handle, uint32_t in_timeout_ms)
+{
+	return minimod_ctx_wait(l_ctx, in_handle, in_timeout_ms);
+}
+
+
+bool
+minimod_wait_all(
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms)
+{
+	return minimod_ctx_wait_all(l_ctx, in_handles, in_nhandles, in_timeout_ms);
+}
+
+
+size_t
+minimod_wait_any(
+  minimod_handle const *in_handles,
+  size_t in_nhandles,
+  uint32_t in_timeout_ms)
+{
+	return minimod_ctx_wait_any(l_ctx, in_handles, in_nhandles, in_timeout_ms);
+}
+
 
-	free(path);
+void
+minimod_set_retry_policy(
+  char const *in_endpoint,
+  struct minimod_retry_policy const *in_policy)
+{
+	minimod_ctx_set_retry_policy(l_ctx, in_endpoint, in_policy);
 }
 
 
-bool
-minimod_is_authenticated(void)
+void
+minimod_set_request_stats_callback(
+  minimod_request_stats_callback in_callback,
+  void *in_userdata)
 {
-	return l_mmi.token && l_mmi.token_bearer;
+	minimod_ctx_set_request_stats_callback(l_ctx, in_callback, in_userdata);
 }
 
 
 void
-minimod_deauthenticate(void)
+minimod_set_cache(size_t in_max_bytes, size_t in_max_entries)
 {
-	fsu_rmfile(get_tokenpath());
+	minimod_ctx_set_cache(l_ctx, in_max_bytes, in_max_entries);
+}
 
-	free(l_mmi.token);
-	free(l_mmi.token_bearer);
 
-	l_mmi.token = NULL;
-	l_mmi.token_bearer = NULL;
+void
+minimod_set_batching(uint32_t in_window_ms, unsigned int in_max_batch_size)
+{
+	minimod_ctx_set_batching(l_ctx, in_window_ms, in_max_batch_size);
 }
 
 
 void
+minimod_get_cache_stats(struct minimod_cache_stats *out_stats)
+{
+	minimod_ctx_get_cache_stats(l_ctx, out_stats);
+}
+
+
+minimod_handle
+minimod_get_games(
+  char const *in_filter,
+  minimod_get_games_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_get_games(l_ctx, in_filter, in_callback, in_userdata);
+}
+
+
+minimod_handle
+minimod_get_mods(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_get_mods(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
+}
+
+
+minimod_handle
 minimod_get_modfiles(
   char const *in_filter,
   uint64_t in_game_id,
@@ -1464,62 +8893,18 @@ minimod_get_modfiles(
   minimod_get_modfiles_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-	ASSERT(in_mod_id > 0);
-	char *path;
-	if (in_modfile_id)
-	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/files/%" PRIu64
-		  "?api_key=%s&%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  in_mod_id,
-		  in_modfile_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "");
-	}
-	else
-	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/files?api_key=%s&%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  in_mod_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "");
-	}
-	LOG("request: %s", path);
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		NULL
-		// clang-format on
-	};
-
-	struct task *task = alloc_task();
-	task->callback.fptr.get_modfiles = in_callback;
-	task->callback.userdata = in_userdata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_modfiles,
-	      task))
-	{
-		free_task(task);
-	}
-
-	free(path);
+	return minimod_ctx_get_modfiles(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_modfile_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
-void
+minimod_handle
 minimod_get_mod_events(
   char const *in_filter,
   uint64_t in_game_id,
@@ -1528,391 +8913,244 @@ minimod_get_mod_events(
   minimod_get_events_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-
-	char *cutoff = NULL;
-	if (in_date_cutoff)
-	{
-		asprintf(&cutoff, "&date_added-gt=%" PRIu64, in_date_cutoff);
-	}
-	char *path;
-	if (in_mod_id)
-	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/events/"
-		  "?api_key=%s&%s%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  in_mod_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "",
-		  cutoff ? cutoff : "");
-	}
-	else
-	{
-		asprintf(
-		  &path,
-		  "%s/games/%" PRIu64 "/mods/events?api_key=%s&%s%s",
-		  endpoints[l_mmi.env],
-		  in_game_id,
-		  l_mmi.api_key,
-		  in_filter ? in_filter : "",
-		  cutoff ? cutoff : "");
-	}
-	free(cutoff);
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		NULL
-		// clang-format on
-	};
-	LOG("request: %s", path);
+	return minimod_ctx_get_mod_events(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_date_cutoff,
+	  in_callback,
+	  in_userdata);
+}
 
-	struct task *task = alloc_task();
-	task->callback.fptr.get_events = in_callback;
-	task->callback.userdata = in_userdata;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_events,
-	      task))
-	{
-		free_task(task);
-	}
 
-	free(path);
+minimod_handle
+minimod_get_dependencies(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  minimod_get_dependencies_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_get_dependencies(
+	  l_ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
-static void
-on_install_download(
-  void *in_udata,
-  FILE *in_file,
-  int error,
-  struct netw_header const *UNUSED(in_header))
+void
+minimod_resolve_dependencies(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_resolve_dependencies_callback in_callback,
+  void *in_userdata)
 {
-	struct install_request *req = in_udata;
-	// Downloads are not authenticated, thusly there is no need to handle
-	// rate-limiting or authorization errors.
-	if (error != 200)
-	{
-		LOGE("mod NOT downloaded %i", error);
-		req->callback(req->userdata, false, req->game_id, req->mod_id);
-		free_install_request(req);
-		return;
-	}
+	minimod_ctx_resolve_dependencies(
+	  l_ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
+}
 
-	LOG("mod downloaded");
 
-	// extract zip?
-	if (l_mmi.unzip)
-	{
-		long s = ftell(in_file);
-		ASSERT(s >= 0);
-		int seek_err = fseek(in_file, 0, SEEK_SET);
-		if (seek_err != 0)
-		{
-			LOGE("Seek failed %i", errno);
-		}
-		// unzip it
-		mz_zip_archive zip = { 0 };
-		if (!mz_zip_reader_init_cfile(&zip, in_file, (mz_uint64)s, 0))
-		{
-			LOGE("zip error: %i", zip.m_last_error);
-		}
-		mz_uint nfiles = mz_zip_reader_get_num_files(&zip);
-		LOG("#files in zip: %u", nfiles);
-		for (mz_uint i = 0; i < nfiles; ++i)
-		{
-			mz_zip_archive_file_stat stat;
-			mz_zip_reader_file_stat(&zip, i, &stat);
-			if (!stat.m_is_directory)
-			{
-				char *path;
-				asprintf(
-				  &path,
-				  "%s/mods/%" PRIu64 "/%" PRIu64 "/%s",
-				  l_mmi.root_path,
-				  req->game_id,
-				  req->mod_id,
-				  stat.m_filename);
-				LOG("  + extracting %s", path);
-				FILE *f = fsu_fopen(path, "wb");
-				mz_zip_reader_extract_to_cfile(&zip, i, f, 0);
-				free(path);
-
-				fclose(f);
-			}
-		}
-		mz_zip_reader_end(&zip);
-		fsu_rmfile(req->zip_path);
-	}
+bool
+minimod_is_authenticated(void)
+{
+	return minimod_ctx_is_authenticated(l_ctx);
+}
 
-	// callback
-	req->callback(req->userdata, true, req->game_id, req->mod_id);
 
-	fclose(in_file);
-	free_install_request(req);
+void
+minimod_deauthenticate(void)
+{
+	minimod_ctx_deauthenticate(l_ctx);
 }
 
 
-static bool
-json_print_callback(void *ptr, const char *buffer, size_t size)
+void
+minimod_email_request(
+  char const *in_email,
+  minimod_email_request_callback in_callback,
+  void *in_userdata)
 {
-	fwrite(buffer, size, 1, ptr);
-	return true;
+	minimod_ctx_email_request(l_ctx, in_email, in_callback, in_userdata);
 }
 
 
-static void
-on_install_get_mod(
-  void *in_userdata,
-  size_t in_nmods,
-  struct minimod_mod const *in_mods,
-  struct minimod_pagination const *UNUSED(pagi))
+void
+minimod_email_exchange(
+  char const *in_code,
+  minimod_access_token_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(in_nmods <= 1);
-	struct install_request *req = in_userdata;
+	minimod_ctx_email_exchange(l_ctx, in_code, in_callback, in_userdata);
+}
 
-	if (in_nmods > 0)
-	{
-		// write json file
-		char *jpath;
-		asprintf(
-		  &jpath,
-		  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
-		  l_mmi.root_path,
-		  req->game_id,
-		  req->mod_id);
 
-		FILE *jout = fsu_fopen(jpath, "wb");
-		QAJ4C_print_buffer_callback(
-		  in_mods[0].more,
-		  json_print_callback,
-		  jout);
-		fclose(jout);
+void
+minimod_steam_auth(
+  void const *in_ticket,
+  size_t in_ticketbytes,
+  minimod_access_token_callback in_callback,
+  void *in_userdata)
+{
+	minimod_ctx_steam_auth(
+	  l_ctx,
+	  in_ticket,
+	  in_ticketbytes,
+	  in_callback,
+	  in_userdata);
+}
 
-		free(jpath);
-	}
 
-	req->waiting = 0;
+minimod_handle
+minimod_get_me(minimod_get_users_callback in_callback, void *in_userdata)
+{
+	return minimod_ctx_get_me(l_ctx, in_callback, in_userdata);
 }
 
 
-static void
-on_install_get_modfile(
-  void *in_userdata,
-  size_t nmodfiles,
-  struct minimod_modfile const *modfiles,
-  struct minimod_pagination const *UNUSED(pagi))
+minimod_handle
+minimod_get_user_events(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(nmodfiles == 1);
-	struct install_request *req = in_userdata;
-
-	// write actual file
-	asprintf(
-	  &req->zip_path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip",
-	  l_mmi.root_path,
-	  req->game_id,
-	  req->mod_id);
-	FILE *fout = fsu_fopen(req->zip_path, "w+b");
-	ASSERT(fout);
+	return minimod_ctx_get_user_events(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_date_cutoff,
+	  in_callback,
+	  in_userdata);
+}
 
-	req->file = fout;
 
-	netw_download_to(
-	  NETW_VERB_GET,
-	  modfiles[0].url,
-	  NULL,
-	  NULL,
-	  0,
-	  fout,
-	  on_install_download,
-	  req);
+minimod_handle
+minimod_install(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_modfile_id,
+  minimod_install_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_install(
+	  l_ctx,
+	  in_game_id,
+	  in_mod_id,
+	  in_modfile_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
-void
-minimod_install(
+minimod_handle
+minimod_enqueue_install(
   uint64_t in_game_id,
   uint64_t in_mod_id,
   uint64_t in_modfile_id,
+  enum minimod_install_priority in_priority,
   minimod_install_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-	ASSERT(in_mod_id > 0);
-
-	// fetch meta-data and proceed from there
-	struct install_request *req = alloc_install_request();
-	req->callback = in_callback;
-	req->userdata = in_userdata;
-	req->mod_id = in_mod_id;
-	req->game_id = in_game_id;
-	req->waiting = 1;
-
-	LOG("install: get_mods");
-	minimod_get_mods(NULL, in_game_id, in_mod_id, on_install_get_mod, req);
-	while (req->waiting)
-	{
-		sys_sleep(1);
-	}
-
-	LOG("install: get_modfiles");
-	minimod_get_modfiles(
-	  "_sort=-date_added&_limit=1",
+	return minimod_ctx_enqueue_install(
+	  l_ctx,
 	  in_game_id,
 	  in_mod_id,
 	  in_modfile_id,
-	  on_install_get_modfile,
-	  req);
+	  in_priority,
+	  in_callback,
+	  in_userdata);
 }
 
 
-bool
-minimod_uninstall(uint64_t in_game_id, uint64_t in_mod_id)
+void
+minimod_set_install_limits(
+  unsigned int in_max_downloads,
+  unsigned int in_max_extractions)
 {
-	// check if a json file exists. if it does not, then there is no mod either
-	char *path;
-	asprintf(
-	  &path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
-	  l_mmi.root_path,
-	  in_game_id,
-	  in_mod_id);
-	if (fsu_ptype(path) != FSU_PATHTYPE_FILE)
-	{
-		free(path);
-		return false;
-	}
-	fsu_rmfile(path);
-	free(path);
-
-	// check if the mod was stored as zip
-	asprintf(
-	  &path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64 ".zip",
-	  l_mmi.root_path,
-	  in_game_id,
-	  in_mod_id);
-	if (fsu_ptype(path) == FSU_PATHTYPE_FILE)
-	{
-		fsu_rmfile(path);
-	}
-	free(path);
+	minimod_ctx_set_install_limits(
+	  l_ctx,
+	  in_max_downloads,
+	  in_max_extractions);
+}
 
-	// finally and probably redundantly check for dir
-	asprintf(
-	  &path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64,
-	  l_mmi.root_path,
-	  in_game_id,
-	  in_mod_id);
-	if (fsu_ptype(path) == FSU_PATHTYPE_DIR)
-	{
-		fsu_rmdir_recursive(path);
-	}
-	free(path);
 
-	return true;
+void
+minimod_get_install_queue_stats(struct minimod_install_queue_stats *out_stats)
+{
+	minimod_ctx_get_install_queue_stats(l_ctx, out_stats);
 }
 
 
-struct enum_data
+void
+minimod_set_install_queue_callback(
+  minimod_install_queue_callback in_callback,
+  void *in_userdata)
 {
-	minimod_enum_installed_mods_callback callback;
-	void *userdata;
-	uint64_t game_id;
-};
+	minimod_ctx_set_install_queue_callback(l_ctx, in_callback, in_userdata);
+}
 
 
-static bool
-is_str_numeric(char const *str, size_t len)
+void
+minimod_set_install_stats_callback(
+  minimod_install_stats_callback in_callback,
+  void *in_userdata)
 {
-	for (size_t i = 0; i < len; ++i)
-	{
-		if (!isdigit(str[i]))
-		{
-			return false;
-		}
-	}
-	return true;
+	minimod_ctx_set_install_stats_callback(l_ctx, in_callback, in_userdata);
 }
 
 
-static bool
-str_ends_with_json(char const *str, size_t len)
+void
+minimod_set_install_error_callback(
+  minimod_install_error_callback in_callback,
+  void *in_userdata)
 {
-	return (len > 5) && (strcmp(str + len - 5, ".json") == 0);
+	minimod_ctx_set_install_error_callback(l_ctx, in_callback, in_userdata);
 }
 
 
-static void
-game_enumerator(
-  char const *root,
-  char const *name,
-  bool is_dir,
-  void *in_userdata)
+void
+minimod_set_install_progress_callback(
+  minimod_install_progress_callback in_callback,
+  void *in_userdata,
+  uint32_t in_interval_ms,
+  uint32_t in_stall_timeout_ms)
 {
-	struct enum_data *edata = in_userdata;
+	minimod_ctx_set_install_progress_callback(
+	  l_ctx,
+	  in_callback,
+	  in_userdata,
+	  in_interval_ms,
+	  in_stall_timeout_ms);
+}
 
-	if (is_dir)
-	{
-		return;
-	}
 
-	size_t l = strlen(name);
-	if (str_ends_with_json(name, l) && is_str_numeric(name, l - 5))
-	{
-		LOG("found mod: %s %s", root, name);
-		uint64_t mod_id = strtoul(name, NULL, 10);
-		LOG("mod_id: %" PRIu64, mod_id);
-		char *path = NULL;
-		asprintf(&path, "%s%" PRIu64 ".zip", root, mod_id);
-		if (fsu_ptype(path) == FSU_PATHTYPE_FILE)
-		{
-			edata->callback(edata->userdata, edata->game_id, mod_id, path);
-		}
-		else
-		{
-			free(path);
-			asprintf(&path, "%s%" PRIu64 "/", root, mod_id);
-			edata->callback(edata->userdata, edata->game_id, mod_id, path);
-		}
-		free(path);
-	}
+bool
+minimod_uninstall(uint64_t in_game_id, uint64_t in_mod_id)
+{
+	return minimod_ctx_uninstall(l_ctx, in_game_id, in_mod_id);
 }
 
 
-static void
-root_enumerator(
-  char const *root,
-  char const *name,
-  bool is_dir,
-  void *in_userdata)
+bool
+minimod_is_installed(uint64_t in_game_id, uint64_t in_mod_id)
 {
-	struct enum_data *edata = in_userdata;
+	return minimod_ctx_is_installed(l_ctx, in_game_id, in_mod_id);
+}
 
-	if (is_dir)
-	{
-		LOG("found dir: %s - %s", root, name);
-		size_t l = strlen(name);
-		bool is_game_id = is_str_numeric(name, l);
-		if (is_game_id)
-		{
-			edata->game_id = strtoull(name, NULL, 10);
-			char *path;
-			asprintf(&path, "%s%s/", root, name);
-			fsu_enum_dir(path, game_enumerator, edata);
-			free(path);
-		}
-	}
+
+bool
+minimod_is_downloading(uint64_t in_game_id, uint64_t in_mod_id)
+{
+	return minimod_ctx_is_downloading(l_ctx, in_game_id, in_mod_id);
 }
 
 
@@ -1922,46 +9160,14 @@ minimod_enum_installed_mods(
   minimod_enum_installed_mods_callback in_callback,
   void *in_userdata)
 {
-	struct enum_data edata;
-	edata.callback = in_callback;
-	edata.userdata = in_userdata;
-	edata.game_id = in_game_id;
-
-	char *path;
-	if (in_game_id)
-	{
-		asprintf(&path, "%s/mods/%" PRIu64 "/", l_mmi.root_path, in_game_id);
-		LOG("path-wid: %s", path);
-		fsu_enum_dir(path, game_enumerator, &edata);
-	}
-	else
-	{
-		asprintf(&path, "%s/mods/", l_mmi.root_path);
-		LOG("path-noid: %s", path);
-		fsu_enum_dir(path, root_enumerator, &edata);
-	}
-	free(path);
+	minimod_ctx_enum_installed_mods(
+	  l_ctx,
+	  in_game_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
-/* Should get_installed_mod() use a callback for unified interfaces?
- * But it is not asynchronous. Should asynchronicity be emulated?
- * Or use a different interface that just returns a minimod_mod struct?
- * If so, who owns the memory? Who frees the data of the mod?
- * What happens with the underlying QAJ4C object?
- * Inconvenient to handle; that's for sure.
- *
- * So a callback makes much more sense, also for consistency.
- * But if it is not asynchronous (to save minimod from spawning
- * threads itself) maybe 'get_installed_mod' is the wrong name.
- * It also has strong ties with minimod_enum_installed_mods().
- * So it should not be called 'get' or 'enum'; but what else?
- *
- * Combining those two would be nice, however loading the data during
- * enumeration are lots of allocations and memory, even if they
- * may not be required; and I'd prefer on the side of no-superflous
- * allocs and cycles.
- */
 bool
 minimod_get_installed_mod(
   uint64_t in_game_id,
@@ -1969,91 +9175,57 @@ minimod_get_installed_mod(
   minimod_get_mods_callback in_callback,
   void *in_userdata)
 {
-	char *path;
-	asprintf(
-	  &path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
-	  l_mmi.root_path,
+	return minimod_ctx_get_installed_mod(
+	  l_ctx,
 	  in_game_id,
-	  in_mod_id);
-
-	int64_t fsize_raw = fsu_fsize(path);
-	FILE *jfile = fsu_fopen(path, "rb");
-
-	free(path);
-
-	if (!jfile)
-	{
-		return false;
-	}
-
-	// load file data into memory
-	if (fsize_raw > 0)
-	{
-		size_t fsize = (size_t)fsize_raw;
-		char *filebuffer = malloc(fsize);
-		fread(filebuffer, fsize, 1, jfile);
-
-		// load data into QAJ4C
-		size_t nbuffer = QAJ4C_calculate_max_buffer_size_n(filebuffer, fsize);
-		void *buffer = malloc(nbuffer);
-		QAJ4C_Value const *document = NULL;
-		QAJ4C_parse_opt(filebuffer, fsize, 0, buffer, nbuffer, &document);
-		ASSERT(QAJ4C_is_object(document));
-
-		// call callback with data
-		struct minimod_mod mod = { 0 };
-		populate_mod(&mod, document);
-		in_callback(in_userdata, 1, &mod, NULL);
-
-		free(buffer);
-		free(filebuffer);
-	}
-	else
-	{
-		in_callback(in_userdata, 0, NULL, NULL);
-	}
-	fclose(jfile);
-
-
-	return true;
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
-bool
-minimod_is_installed(uint64_t in_game_id, uint64_t in_mod_id)
+struct minimod_archive *
+minimod_open_archive(
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  size_t in_cache_bytes)
 {
-	// check if a json file exists. if it does not, then there is no mod either
-	char *path;
-	asprintf(
-	  &path,
-	  "%s/mods/%" PRIu64 "/%" PRIu64 ".json",
-	  l_mmi.root_path,
+	return minimod_ctx_open_archive(
+	  l_ctx,
 	  in_game_id,
-	  in_mod_id);
-	bool is_installed = (fsu_ptype(path) == FSU_PATHTYPE_FILE);
-	free(path);
-	return is_installed;
+	  in_mod_id,
+	  in_cache_bytes);
 }
 
 
-bool
-minimod_is_downloading(uint64_t in_game_id, uint64_t in_mod_id)
+void
+minimod_start_sync(
+  uint64_t in_game_id,
+  minimod_sync_callback in_callback,
+  void *in_userdata)
 {
-	bool is_downloading = false;
-	mtx_lock(&l_mmi.install_requests_mtx);
-	struct install_request *r = l_mmi.install_requests;
-	while (r)
-	{
-		if (r->game_id == in_game_id && r->mod_id == in_mod_id)
-		{
-			is_downloading = true;
-			break;
-		}
-		r = r->next;
-	}
-	mtx_unlock(&l_mmi.install_requests_mtx);
-	return is_downloading;
+	minimod_ctx_start_sync(l_ctx, in_game_id, in_callback, in_userdata);
+}
+
+
+void
+minimod_stop_sync(uint64_t in_game_id)
+{
+	minimod_ctx_stop_sync(l_ctx, in_game_id);
+}
+
+
+uint32_t
+minimod_sync_tick(void)
+{
+	return minimod_ctx_sync_tick(l_ctx);
+}
+
+
+void
+minimod_set_sync_interval(uint32_t in_min_ms, uint32_t in_max_ms)
+{
+	minimod_ctx_set_sync_interval(l_ctx, in_min_ms, in_max_ms);
 }
 
 
@@ -2065,145 +9237,37 @@ minimod_rate(
   minimod_rate_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-	if (!minimod_is_authenticated())
-	{
-		return false;
-	}
-
-	char *path = NULL;
-	asprintf(
-	  &path,
-	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/ratings",
-	  endpoints[l_mmi.env],
+	return minimod_ctx_rate(
+	  l_ctx,
 	  in_game_id,
-	  in_mod_id);
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Content-Type", "application/x-www-form-urlencoded",
-		"Authorization", l_mmi.token_bearer,
-		NULL
-		// clang-format on
-	};
-
-	char const *data = in_rating > 0 ? "rating=1"
-	  : in_rating < 0                ? "rating=-1"
-	                                 : "rating=0";
-
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.userdata = in_userdata;
-	task->callback.fptr.rate = in_callback;
-	if (!netw_request(
-	      NETW_VERB_POST,
-	      path,
-	      headers,
-	      data,
-	      strlen(data),
-	      handle_rate,
-	      task))
-	{
-		free_task(task);
-	}
-
-	free(path);
-	return true;
+	  in_mod_id,
+	  in_rating,
+	  in_callback,
+	  in_userdata);
 }
 
 
-bool
+minimod_handle
 minimod_get_ratings(
   char const *in_filter,
   minimod_get_ratings_callback in_callback,
-  void *in_udata)
+  void *in_userdata)
 {
-	if (!minimod_is_authenticated())
-	{
-		return false;
-	}
-
-	char *path = NULL;
-	asprintf(
-	  &path,
-	  "%s/me/ratings?%s",
-	  endpoints[l_mmi.env],
-	  in_filter ? in_filter : "");
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		NULL
-		// clang-format on
-	};
-
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.userdata = in_udata;
-	task->callback.fptr.get_ratings = in_callback;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_ratings,
-	      task))
-	{
-		free_task(task);
-	}
-
-	free(path);
-	return true;
+	return minimod_ctx_get_ratings(l_ctx, in_filter, in_callback, in_userdata);
 }
 
 
-bool
+minimod_handle
 minimod_get_subscriptions(
   char const *in_filter,
   minimod_get_mods_callback in_callback,
-  void *in_udata)
+  void *in_userdata)
 {
-	if (!minimod_is_authenticated())
-	{
-		return false;
-	}
-
-	char *path = NULL;
-	asprintf(
-	  &path,
-	  "%s/me/subscribed?%s",
-	  endpoints[l_mmi.env],
-	  in_filter ? in_filter : "");
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		NULL
-		// clang-format on
-	};
-
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.userdata = in_udata;
-	task->callback.fptr.get_mods = in_callback;
-	if (!netw_request(
-	      NETW_VERB_GET,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_get_mods,
-	      task))
-	{
-		free_task(task);
-	}
-
-	free(path);
-	return true;
+	return minimod_ctx_get_subscriptions(
+	  l_ctx,
+	  in_filter,
+	  in_callback,
+	  in_userdata);
 }
 
 
@@ -2214,52 +9278,12 @@ minimod_subscribe(
   minimod_subscription_change_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-	ASSERT(in_mod_id > 0);
-	if (!minimod_is_authenticated())
-	{
-		return false;
-	}
-
-	char *path = NULL;
-	asprintf(
-	  &path,
-	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/subscribe",
-	  endpoints[l_mmi.env],
+	return minimod_ctx_subscribe(
+	  l_ctx,
 	  in_game_id,
-	  in_mod_id);
-
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		"Content-Type", "application/x-www-form-urlencoded",
-		NULL
-		// clang-format on
-	};
-
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.userdata = in_userdata;
-	task->callback.fptr.subscription_change = in_callback;
-	task->meta64 = in_mod_id;
-	task->meta32 = 1;
-
-	if (!netw_request(
-	      NETW_VERB_POST,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_subscription_change,
-	      task))
-	{
-		free_task(task);
-	}
-
-	free(path);
-
-	return true;
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
 }
 
 
@@ -2270,86 +9294,141 @@ minimod_unsubscribe(
   minimod_subscription_change_callback in_callback,
   void *in_userdata)
 {
-	ASSERT(in_game_id > 0);
-	ASSERT(in_mod_id > 0);
-	if (!minimod_is_authenticated())
-	{
-		return false;
-	}
-
-	char *path = NULL;
-	asprintf(
-	  &path,
-	  "%s/games/%" PRIu64 "/mods/%" PRIu64 "/subscribe",
-	  endpoints[l_mmi.env],
+	return minimod_ctx_unsubscribe(
+	  l_ctx,
 	  in_game_id,
-	  in_mod_id);
+	  in_mod_id,
+	  in_callback,
+	  in_userdata);
+}
 
-	char const *const headers[] = {
-		// clang-format off
-		"Accept", "application/json",
-		"Authorization", l_mmi.token_bearer,
-		"Content-Type", "application/x-www-form-urlencoded",
-		NULL
-		// clang-format on
-	};
 
-	struct task *task = alloc_task();
-	task->flags |= TASK_FLAG_AUTH_TOKEN;
-	task->callback.userdata = in_userdata;
-	task->callback.fptr.subscription_change = in_callback;
-	task->meta64 = in_mod_id;
-	task->meta32 = -1;
+bool
+minimod_reconcile(
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  bool in_execute,
+  minimod_reconcile_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_reconcile(
+	  l_ctx,
+	  in_game_id,
+	  in_max_inflight,
+	  in_execute,
+	  in_callback,
+	  in_userdata);
+}
 
-	if (!netw_request(
-	      NETW_VERB_DELETE,
-	      path,
-	      headers,
-	      NULL,
-	      0,
-	      handle_subscription_change,
-	      task))
-	{
-		free_task(task);
-	}
 
-	free(path);
+struct minimod_paging *
+minimod_get_games_all(
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_games_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_get_games_all(
+	  l_ctx,
+	  in_filter,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
+}
 
-	return true;
+
+struct minimod_paging *
+minimod_get_mods_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  unsigned int in_max_inflight,
+  minimod_get_mods_callback in_callback,
+  void *in_userdata)
+{
+	return minimod_ctx_get_mods_all(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
 }
 
 
-char const *
-minimod_get_more_string(void const *more, char const *name)
+struct minimod_paging *
+minimod_get_modfiles_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  unsigned int in_max_inflight,
+  minimod_get_modfiles_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(QAJ4C_is_object(more));
-	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
-	return QAJ4C_is_string(obj) ? QAJ4C_get_string(obj) : NULL;
+	return minimod_ctx_get_modfiles_all(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
 }
 
 
-int64_t
-minimod_get_more_int(void const *more, char const *name)
+struct minimod_paging *
+minimod_get_mod_events_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(QAJ4C_is_object(more));
-	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
-	return QAJ4C_is_int64(obj) ? QAJ4C_get_int64(obj) : 0;
+	return minimod_ctx_get_mod_events_all(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_mod_id,
+	  in_date_cutoff,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
 }
 
 
-double
-minimod_get_more_float(void const *more, char const *name)
+struct minimod_paging *
+minimod_get_user_events_all(
+  char const *in_filter,
+  uint64_t in_game_id,
+  uint64_t in_date_cutoff,
+  unsigned int in_max_inflight,
+  minimod_get_events_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(QAJ4C_is_object(more));
-	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
-	return QAJ4C_is_double(obj) ? QAJ4C_get_double(obj) : 0;
+	return minimod_ctx_get_user_events_all(
+	  l_ctx,
+	  in_filter,
+	  in_game_id,
+	  in_date_cutoff,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
 }
 
 
-bool
-minimod_get_more_bool(void const *more, char const *name)
+struct minimod_paging *
+minimod_get_ratings_all(
+  char const *in_filter,
+  unsigned int in_max_inflight,
+  minimod_get_ratings_callback in_callback,
+  void *in_userdata)
 {
-	ASSERT(QAJ4C_is_object(more));
-	QAJ4C_Value const *obj = QAJ4C_object_get(more, name);
-	return QAJ4C_is_bool(obj) ? QAJ4C_get_bool(obj) : 0;
+	return minimod_ctx_get_ratings_all(
+	  l_ctx,
+	  in_filter,
+	  in_max_inflight,
+	  in_callback,
+	  in_userdata);
 }
+
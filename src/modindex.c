@@ -0,0 +1,461 @@
+#include "modindex.h"
+
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
+#endif
+#pragma GCC diagnostic ignored "-Wunused-macros"
+
+#ifdef MINIMOD_LOG_ENABLE
+#define LOG(FMT, ...) printf("[modindex] " FMT "\n", ##__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+#define LOGE(FMT, ...) fprintf(stderr, "[modindex] " FMT "\n", ##__VA_ARGS__)
+
+#define ASSERT(in_condition)                      \
+	do                                            \
+	{                                             \
+		if (__builtin_expect(!(in_condition), 0)) \
+		{                                         \
+			LOGE(                                 \
+			  "[assertion] %s:%i: '%s'",          \
+			  __FILE__,                           \
+			  __LINE__,                           \
+			  #in_condition);                     \
+			__asm__ volatile("int $0x03");        \
+			__builtin_unreachable();              \
+		}                                         \
+	} while (__LINE__ == -1)
+
+#pragma GCC diagnostic pop
+
+// first bytes of the index file, bump when changing the format
+#define INDEX_FILE_MAGIC "minimod-index 1\n"
+
+// game_id, mod_id, modfile_id, date_updated, nbytes, flags
+#define RECORD_FIELDS 6
+#define RECORD_BYTES (RECORD_FIELDS * 8)
+
+#define RECORD_FLAG_ZIP 1u
+
+#define MIN_CAPACITY 64
+
+
+struct modindex
+{
+	mtx_t mtx;
+	char *path;
+	// exists while the mods directory is being changed
+	char *dirty_path;
+	// open addressing, game_id 0 marks an empty slot
+	struct modindex_entry *slots;
+	size_t capacity;
+	size_t nentries;
+	unsigned int ntransactions;
+	bool is_modified;
+	char _padding[3];
+};
+
+
+static size_t
+slot_of(
+  struct modindex const *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	uint64_t const key[2] = { in_game_id, in_mod_id };
+	return (size_t)hash_fnv1a(key, sizeof key) & (in_index->capacity - 1);
+}
+
+
+// returns the slot of the entry or the empty slot it would go into
+static size_t
+find_slot(
+  struct modindex const *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	size_t i = slot_of(in_index, in_game_id, in_mod_id);
+	while (in_index->slots[i].game_id != 0)
+	{
+		struct modindex_entry const *e = &in_index->slots[i];
+		if (e->game_id == in_game_id && e->mod_id == in_mod_id)
+		{
+			break;
+		}
+		i = (i + 1) & (in_index->capacity - 1);
+	}
+	return i;
+}
+
+
+static void
+grow(struct modindex *io_index)
+{
+	struct modindex_entry *old = io_index->slots;
+	size_t const ncapacity = io_index->capacity;
+
+	io_index->capacity = ncapacity ? ncapacity * 2 : MIN_CAPACITY;
+	io_index->slots = calloc(io_index->capacity, sizeof *io_index->slots);
+	for (size_t i = 0; i < ncapacity; ++i)
+	{
+		if (old[i].game_id != 0)
+		{
+			size_t const slot =
+			  find_slot(io_index, old[i].game_id, old[i].mod_id);
+			io_index->slots[slot] = old[i];
+		}
+	}
+	free(old);
+}
+
+
+static void
+insert(struct modindex *io_index, struct modindex_entry const *in_entry)
+{
+	// keep the load factor below 1/2, so probe sequences stay short
+	if ((io_index->nentries + 1) * 2 > io_index->capacity)
+	{
+		grow(io_index);
+	}
+
+	size_t const slot =
+	  find_slot(io_index, in_entry->game_id, in_entry->mod_id);
+	if (io_index->slots[slot].game_id == 0)
+	{
+		io_index->nentries += 1;
+	}
+	io_index->slots[slot] = *in_entry;
+}
+
+
+static bool
+erase(struct modindex *io_index, uint64_t in_game_id, uint64_t in_mod_id)
+{
+	if (io_index->nentries == 0)
+	{
+		return false;
+	}
+
+	size_t const mask = io_index->capacity - 1;
+	size_t i = find_slot(io_index, in_game_id, in_mod_id);
+	if (io_index->slots[i].game_id == 0)
+	{
+		return false;
+	}
+
+	// shift following entries back instead of leaving tombstones
+	size_t j = i;
+	for (;;)
+	{
+		j = (j + 1) & mask;
+		struct modindex_entry const *e = &io_index->slots[j];
+		if (e->game_id == 0)
+		{
+			break;
+		}
+		size_t const home = slot_of(io_index, e->game_id, e->mod_id);
+		// move e into the hole, unless its home slot lies cyclically in (i, j]
+		bool const is_reachable =
+		  (i < j) ? (i < home && home <= j) : (i < home || home <= j);
+		if (!is_reachable)
+		{
+			io_index->slots[i] = *e;
+			i = j;
+		}
+	}
+	memset(&io_index->slots[i], 0, sizeof io_index->slots[i]);
+	io_index->nentries -= 1;
+	return true;
+}
+
+
+static void
+put_u64(unsigned char *out, uint64_t in_value)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		out[i] = (unsigned char)(in_value >> (i * 8));
+	}
+}
+
+
+static uint64_t
+get_u64(unsigned char const *in)
+{
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i)
+	{
+		value = (value << 8) | in[i];
+	}
+	return value;
+}
+
+
+// needs to be called with in_index->mtx locked
+static bool
+save(struct modindex const *in_index)
+{
+	size_t const nmagic = strlen(INDEX_FILE_MAGIC);
+	size_t const nbuffer = nmagic + in_index->nentries * RECORD_BYTES;
+	unsigned char *buffer = malloc(nbuffer);
+	memcpy(buffer, INDEX_FILE_MAGIC, nmagic);
+
+	unsigned char *ptr = buffer + nmagic;
+	for (size_t i = 0; i < in_index->capacity; ++i)
+	{
+		struct modindex_entry const *e = &in_index->slots[i];
+		if (e->game_id == 0)
+		{
+			continue;
+		}
+		put_u64(ptr + 0 * 8, e->game_id);
+		put_u64(ptr + 1 * 8, e->mod_id);
+		put_u64(ptr + 2 * 8, e->modfile_id);
+		put_u64(ptr + 3 * 8, e->date_updated);
+		put_u64(ptr + 4 * 8, e->nbytes);
+		put_u64(ptr + 5 * 8, e->is_zip ? RECORD_FLAG_ZIP : 0);
+		ptr += RECORD_BYTES;
+	}
+
+	char *tmppath;
+	asprintf(&tmppath, "%s.tmp", in_index->path);
+
+	bool is_saved = false;
+	FILE *f = fsu_fopen(tmppath, "wb");
+	if (f)
+	{
+		is_saved = fwrite(buffer, 1, nbuffer, f) == nbuffer;
+		is_saved = (0 == fclose(f)) && is_saved;
+		is_saved = is_saved && fsu_mvfile(tmppath, in_index->path, true);
+		if (!is_saved)
+		{
+			fsu_rmfile(tmppath);
+		}
+	}
+	if (!is_saved)
+	{
+		LOGE("failed to write %s", in_index->path);
+	}
+
+	free(tmppath);
+	free(buffer);
+	return is_saved;
+}
+
+
+static struct modindex *
+alloc_index(char const *in_path)
+{
+	struct modindex *idx = calloc(1, sizeof *idx);
+	idx->path = strdup(in_path);
+	asprintf(&idx->dirty_path, "%s.dirty", in_path);
+	mtx_init(&idx->mtx, mtx_plain);
+	grow(idx);
+	return idx;
+}
+
+
+struct modindex *
+modindex_load(char const *in_path)
+{
+	struct modindex *idx = alloc_index(in_path);
+
+	// an interrupted change may have left the index out of date
+	if (fsu_ptype(idx->dirty_path) != FSU_PATHTYPE_NONE)
+	{
+		LOG("%s is stale", in_path);
+		modindex_destroy(idx);
+		return NULL;
+	}
+
+	int64_t const fsize = fsu_fsize(in_path);
+	size_t const nmagic = strlen(INDEX_FILE_MAGIC);
+	FILE *f = fsize >= (int64_t)nmagic ? fsu_fopen(in_path, "rb") : NULL;
+	if (!f)
+	{
+		modindex_destroy(idx);
+		return NULL;
+	}
+
+	unsigned char *buffer = malloc((size_t)fsize);
+	size_t const nread = fread(buffer, 1, (size_t)fsize, f);
+	fclose(f);
+
+	// a truncated file does not end on a record boundary
+	size_t const nrecords = (size_t)(fsize - (int64_t)nmagic) / RECORD_BYTES;
+	bool const is_valid = nread == (size_t)fsize
+	  && 0 == memcmp(buffer, INDEX_FILE_MAGIC, nmagic)
+	  && nmagic + nrecords * RECORD_BYTES == nread;
+
+	for (size_t i = 0; is_valid && i < nrecords; ++i)
+	{
+		unsigned char const *ptr = buffer + nmagic + i * RECORD_BYTES;
+		struct modindex_entry e = {
+			.game_id = get_u64(ptr + 0 * 8),
+			.mod_id = get_u64(ptr + 1 * 8),
+			.modfile_id = get_u64(ptr + 2 * 8),
+			.date_updated = get_u64(ptr + 3 * 8),
+			.nbytes = get_u64(ptr + 4 * 8),
+			.is_zip = (get_u64(ptr + 5 * 8) & RECORD_FLAG_ZIP) != 0,
+		};
+		if (e.game_id != 0)
+		{
+			insert(idx, &e);
+		}
+	}
+	free(buffer);
+
+	if (!is_valid)
+	{
+		LOGE("%s is corrupt", in_path);
+		modindex_destroy(idx);
+		return NULL;
+	}
+
+	LOG("loaded %zu mods from %s", idx->nentries, in_path);
+	return idx;
+}
+
+
+struct modindex *
+modindex_create(char const *in_path)
+{
+	return alloc_index(in_path);
+}
+
+
+void
+modindex_destroy(struct modindex *in_index)
+{
+	mtx_destroy(&in_index->mtx);
+	free(in_index->slots);
+	free(in_index->dirty_path);
+	free(in_index->path);
+	free(in_index);
+}
+
+
+void
+modindex_begin(struct modindex *in_index)
+{
+	mtx_lock(&in_index->mtx);
+	if (in_index->ntransactions++ == 0)
+	{
+		FILE *f = fsu_fopen(in_index->dirty_path, "wb");
+		if (f)
+		{
+			fclose(f);
+		}
+		else
+		{
+			LOGE("failed to create %s", in_index->dirty_path);
+		}
+	}
+	mtx_unlock(&in_index->mtx);
+}
+
+
+bool
+modindex_end(struct modindex *in_index)
+{
+	mtx_lock(&in_index->mtx);
+	ASSERT(in_index->ntransactions > 0);
+	in_index->ntransactions -= 1;
+	if (in_index->is_modified && save(in_index))
+	{
+		in_index->is_modified = false;
+	}
+	// a failed save keeps the marker, so the index is rebuilt next time
+	bool const is_saved = !in_index->is_modified;
+	if (is_saved && in_index->ntransactions == 0)
+	{
+		fsu_rmfile(in_index->dirty_path);
+	}
+	mtx_unlock(&in_index->mtx);
+
+	return is_saved;
+}
+
+
+void
+modindex_put(struct modindex *in_index, struct modindex_entry const *in_entry)
+{
+	ASSERT(in_entry->game_id != 0);
+
+	mtx_lock(&in_index->mtx);
+	insert(in_index, in_entry);
+	in_index->is_modified = true;
+	mtx_unlock(&in_index->mtx);
+}
+
+
+bool
+modindex_remove(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id)
+{
+	mtx_lock(&in_index->mtx);
+	bool const is_removed = erase(in_index, in_game_id, in_mod_id);
+	in_index->is_modified = in_index->is_modified || is_removed;
+	mtx_unlock(&in_index->mtx);
+
+	return is_removed;
+}
+
+
+bool
+modindex_get(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  struct modindex_entry *out_entry)
+{
+	mtx_lock(&in_index->mtx);
+	size_t const slot = find_slot(in_index, in_game_id, in_mod_id);
+	struct modindex_entry const *e = &in_index->slots[slot];
+	bool const is_found = in_game_id != 0 && e->game_id != 0;
+	if (is_found && out_entry)
+	{
+		*out_entry = *e;
+	}
+	mtx_unlock(&in_index->mtx);
+
+	return is_found;
+}
+
+
+void
+modindex_enum(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  modindex_callback in_callback,
+  void *in_userdata)
+{
+	mtx_lock(&in_index->mtx);
+	struct modindex_entry *entries =
+	  malloc((in_index->nentries + 1) * sizeof *entries);
+	size_t nentries = 0;
+	for (size_t i = 0; i < in_index->capacity; ++i)
+	{
+		struct modindex_entry const *e = &in_index->slots[i];
+		if (e->game_id != 0 && (in_game_id == 0 || e->game_id == in_game_id))
+		{
+			entries[nentries++] = *e;
+		}
+	}
+	mtx_unlock(&in_index->mtx);
+
+	for (size_t i = 0; i < nentries; ++i)
+	{
+		in_callback(in_userdata, &entries[i]);
+	}
+	free(entries);
+}
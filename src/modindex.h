@@ -0,0 +1,153 @@
+// vi: filetype=c
+#pragma once
+#ifndef MINIMOD_MODINDEX_H_INCLUDED
+#define MINIMOD_MODINDEX_H_INCLUDED
+
+/* Title: modindex
+ *
+ * Topic: Introduction
+ *
+ * Index of installed mods used by minimod, so enumerating installed mods
+ * or checking whether a mod is installed does not touch the file system.
+ *
+ * The index is kept in memory as a hash set and mirrored to a single
+ * file, which is replaced atomically on every change. While the mods
+ * directory is being changed, a marker file flags the index on disk as
+ * stale, so an interrupted change leads to a rebuild instead of an index
+ * out of sync with the directory.
+ * All functions are thread-safe.
+ */
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Section: API */
+
+struct modindex;
+
+/* Struct: modindex_entry
+ *
+ * modfile_id - Installed modfile
+ * date_updated - date_updated of the mod when it was installed
+ * nbytes - Size of the ZIP file or of all extracted files, 0 if unknown
+ * is_zip - true if the mod is installed as ZIP file, false if extracted
+ */
+struct modindex_entry
+{
+	uint64_t game_id;
+	uint64_t mod_id;
+	uint64_t modfile_id;
+	uint64_t date_updated;
+	uint64_t nbytes;
+	bool is_zip;
+	char _padding[7];
+};
+
+/* Callback: modindex_callback()
+ */
+typedef void (*modindex_callback)(
+  void *in_userdata,
+  struct modindex_entry const *in_entry);
+
+/* Function: modindex_load()
+ *
+ * Load the index mirrored to *in_path*.
+ *
+ * Returns:
+ *	NULL if there is no index, it is unreadable or stale. It needs to be
+ *	rebuilt by the caller then, see <modindex_create()>.
+ */
+struct modindex *
+modindex_load(char const *in_path);
+
+/* Function: modindex_create()
+ *
+ * Create an empty index, which is mirrored to *in_path* once it is
+ * changed.
+ */
+struct modindex *
+modindex_create(char const *in_path);
+
+/* Function: modindex_destroy()
+ */
+void
+modindex_destroy(struct modindex *in_index);
+
+/* Function: modindex_begin()
+ *
+ * Call before changing the mods directory. Until the matching
+ * <modindex_end()> the index on disk is considered stale.
+ * Transactions of multiple threads may overlap.
+ */
+void
+modindex_begin(struct modindex *in_index);
+
+/* Function: modindex_end()
+ *
+ * End a transaction started with <modindex_begin()>. Writes the index,
+ * if <modindex_put()> or <modindex_remove()> changed it.
+ *
+ * Returns:
+ *	false if the index could not be written. It stays stale on disk then.
+ */
+bool
+modindex_end(struct modindex *in_index);
+
+/* Function: modindex_put()
+ *
+ * Add an entry, replacing the one of the same mod.
+ */
+void
+modindex_put(struct modindex *in_index, struct modindex_entry const *in_entry);
+
+/* Function: modindex_remove()
+ *
+ * Returns:
+ *	false if there was no entry for the mod.
+ */
+bool
+modindex_remove(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id);
+
+/* Function: modindex_get()
+ *
+ * Parameters:
+ *	out_entry - Receives the entry, if any. May be NULL.
+ *
+ * Returns:
+ *	false if the mod is not in the index.
+ */
+bool
+modindex_get(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  uint64_t in_mod_id,
+  struct modindex_entry *out_entry);
+
+/* Function: modindex_enum()
+ *
+ * Call *in_callback* for every entry of game *in_game_id*, or of all games
+ * if it is 0. Works on a copy of the entries, so the callback may change
+ * the index.
+ */
+void
+modindex_enum(
+  struct modindex *in_index,
+  uint64_t in_game_id,
+  modindex_callback in_callback,
+  void *in_userdata);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -2,10 +2,22 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+// copy_file_range() was added to glibc 2.27
+#if defined(__linux__) && defined(__GLIBC__) \
+  && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define UTIL_HAS_COPY_FILE_RANGE
+#endif
 
 #pragma GCC diagnostic push
 #ifdef __clang__
@@ -88,6 +100,107 @@ fsu_fopen(char const *in_path, char const *in_mode)
 }
 
 
+FILE *
+fsu_fopen_nomkdir(char const *in_path, char const *in_mode)
+{
+	return fopen(in_path, in_mode);
+}
+
+
+size_t
+fsu_pread(FILE *in_file, void *out_buffer, size_t in_bytes, uint64_t in_offset)
+{
+	int const fd = fileno(in_file);
+	size_t total = 0;
+	while (total < in_bytes)
+	{
+		ssize_t const n = pread(
+		  fd,
+		  (char *)out_buffer + total,
+		  in_bytes - total,
+		  (off_t)(in_offset + total));
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			break;
+		}
+		total += (size_t)n;
+	}
+	return total;
+}
+
+
+bool
+fsu_copy_range(
+  FILE *in_src,
+  uint64_t in_offset,
+  uint64_t in_bytes,
+  FILE *in_dst)
+{
+	// the copy bypasses the stdio buffer of in_dst
+	if (fflush(in_dst) != 0)
+	{
+		return false;
+	}
+
+	int const dst = fileno(in_dst);
+
+#ifdef UTIL_HAS_COPY_FILE_RANGE
+	int const src = fileno(in_src);
+	loff_t offset = (loff_t)in_offset;
+	while (in_bytes > 0)
+	{
+		ssize_t const n =
+		  copy_file_range(src, &offset, dst, NULL, (size_t)in_bytes, 0);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			// i.e. not supported by the file system, so copy manually
+			break;
+		}
+		in_bytes -= (uint64_t)n;
+	}
+	in_offset = (uint64_t)offset;
+#endif
+
+	char buffer[64 * 1024];
+	while (in_bytes > 0)
+	{
+		size_t const nwant =
+		  in_bytes < sizeof buffer ? (size_t)in_bytes : sizeof buffer;
+		size_t const nread = fsu_pread(in_src, buffer, nwant, in_offset);
+		if (nread != nwant)
+		{
+			return false;
+		}
+		size_t nwritten = 0;
+		while (nwritten < nread)
+		{
+			ssize_t const n = write(dst, buffer + nwritten, nread - nwritten);
+			if (n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (n <= 0)
+			{
+				return false;
+			}
+			nwritten += (size_t)n;
+		}
+		in_offset += nread;
+		in_bytes -= nread;
+	}
+
+	return true;
+}
+
+
 bool
 fsu_mkdir(char const *in_dir)
 {
@@ -199,6 +312,118 @@ fsu_cpfile(char const *in_srcpath, char const *in_dstpath, bool in_replace)
 }
 
 
+struct tee
+{
+	FILE *file;
+	fsu_tee_callback callback;
+	void *userdata;
+};
+
+
+static size_t
+tee_write(void *in_tee, char const *in_data, size_t in_bytes)
+{
+	struct tee *t = in_tee;
+	size_t const n = fwrite(in_data, 1, in_bytes, t->file);
+	// the callback fails the write, i.e. to abort a download
+	return t->callback(t->userdata, in_data, n) ? n : 0;
+}
+
+
+static int
+tee_close(void *in_tee)
+{
+	struct tee *t = in_tee;
+	int const rv = fclose(t->file);
+	free(t);
+	return rv;
+}
+
+
+#if defined(__linux__)
+static ssize_t
+tee_write_cookie(void *in_tee, char const *in_data, size_t in_bytes)
+{
+	return (ssize_t)tee_write(in_tee, in_data, in_bytes);
+}
+#else
+static int
+tee_write_funopen(void *in_tee, char const *in_data, int in_bytes)
+{
+	size_t const n = tee_write(in_tee, in_data, (size_t)in_bytes);
+	return n > 0 ? (int)n : -1;
+}
+#endif
+
+
+FILE *
+fsu_tee(FILE *in_file, fsu_tee_callback in_callback, void *in_userdata)
+{
+	struct tee *t = malloc(sizeof *t);
+	t->file = in_file;
+	t->callback = in_callback;
+	t->userdata = in_userdata;
+
+#if defined(__linux__)
+	cookie_io_functions_t const functions = {
+		.read = NULL,
+		.write = tee_write_cookie,
+		.seek = NULL,
+		.close = tee_close,
+	};
+	FILE *f = fopencookie(t, "wb", functions);
+#else
+	FILE *f = funopen(t, NULL, tee_write_funopen, NULL, tee_close);
+#endif
+	if (!f)
+	{
+		free(t);
+	}
+	return f;
+}
+
+
+bool
+fsu_truncate(char const *in_path, uint64_t in_bytes)
+{
+	return 0 == truncate(in_path, (off_t)in_bytes);
+}
+
+
+void const *
+fsu_mmap(char const *in_path, size_t *out_bytes)
+{
+	int fd = open(in_path, O_RDONLY);
+	if (fd == -1)
+	{
+		return NULL;
+	}
+
+	struct stat st = { 0 };
+	void *data = NULL;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			data = NULL;
+		}
+	}
+	// the mapping keeps its own reference to the file
+	close(fd);
+
+	*out_bytes = data ? (size_t)st.st_size : 0;
+	return data;
+}
+
+
+void
+fsu_munmap(void const *in_data, size_t in_bytes)
+{
+	munmap((void *)(uintptr_t)in_data, in_bytes);
+}
+
+
 bool
 fsu_mvfile(char const *in_srcpath, char const *in_dstpath, bool in_replace)
 {
@@ -274,6 +499,39 @@ fsu_enum_dir(
 }
 
 
+static pthread_key_t l_arena_key;
+static pthread_once_t l_arena_once = PTHREAD_ONCE_INIT;
+
+
+static void
+arena_destructor(void *in_arena)
+{
+	arena_free(in_arena);
+	free(in_arena);
+}
+
+
+static void
+arena_key_init(void)
+{
+	pthread_key_create(&l_arena_key, arena_destructor);
+}
+
+
+struct arena *
+arena_thread(void)
+{
+	pthread_once(&l_arena_once, arena_key_init);
+	struct arena *arena = pthread_getspecific(l_arena_key);
+	if (!arena)
+	{
+		arena = calloc(1, sizeof *arena);
+		pthread_setspecific(l_arena_key, arena);
+	}
+	return arena;
+}
+
+
 void
 sys_sleep(uint32_t ms)
 {
@@ -288,6 +546,144 @@ sys_seconds(void)
 }
 
 
+uint64_t
+sys_microseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+
+bool
+sys_pipe(FILE **out_read, FILE **out_write)
+{
+	int fds[2];
+	if (0 != pipe(fds))
+	{
+		return false;
+	}
+	*out_read = fdopen(fds[0], "rb");
+	*out_write = fdopen(fds[1], "wb");
+	if (!*out_read || !*out_write)
+	{
+		if (*out_read)
+		{
+			fclose(*out_read);
+		}
+		else
+		{
+			close(fds[0]);
+		}
+		if (*out_write)
+		{
+			fclose(*out_write);
+		}
+		else
+		{
+			close(fds[1]);
+		}
+		return false;
+	}
+	return true;
+}
+
+
+unsigned int
+sys_ncpus(void)
+{
+	long const n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (unsigned int)n : 1;
+}
+
+
+#ifndef __linux__
+static bool
+set_nonblocking(int fd)
+{
+	int const flags = fcntl(fd, F_GETFL);
+	return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1
+	  && fcntl(fd, F_SETFD, FD_CLOEXEC) != -1;
+}
+#endif
+
+
+bool
+sys_event_init(struct sys_event *out_event)
+{
+#ifdef __linux__
+	int const fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd == -1)
+	{
+		LOGE("eventfd() failed: %s", strerror(errno));
+		return false;
+	}
+	out_event->read_fd = fd;
+	out_event->write_fd = fd;
+#else
+	int fds[2];
+	if (0 != pipe(fds))
+	{
+		LOGE("pipe() failed: %s", strerror(errno));
+		return false;
+	}
+	if (!set_nonblocking(fds[0]) || !set_nonblocking(fds[1]))
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	out_event->read_fd = fds[0];
+	out_event->write_fd = fds[1];
+#endif
+	return true;
+}
+
+
+void
+sys_event_destroy(struct sys_event *in_event)
+{
+	close(in_event->read_fd);
+	if (in_event->write_fd != in_event->read_fd)
+	{
+		close(in_event->write_fd);
+	}
+}
+
+
+void
+sys_event_set(struct sys_event *in_event)
+{
+	// a full pipe or counter is still signalled, so failing is fine
+#ifdef __linux__
+	uint64_t const one = 1;
+	ssize_t const n = write(in_event->write_fd, &one, sizeof one);
+#else
+	char const one = 1;
+	ssize_t const n = write(in_event->write_fd, &one, sizeof one);
+#endif
+	(void)n;
+}
+
+
+void
+sys_event_reset(struct sys_event *in_event)
+{
+	// eventfd is drained by a single read
+	char buf[64];
+	while (read(in_event->read_fd, buf, sizeof buf) > 0)
+	{
+	}
+}
+
+
+intptr_t
+sys_event_handle(struct sys_event const *in_event)
+{
+	return in_event->read_fd;
+}
+
+
 #ifndef UTIL_HAS_THREADS_H
 int
 mtx_init(mtx_t *mutex, int type)
@@ -327,4 +723,114 @@ mtx_unlock(mtx_t *mutex)
 #pragma GCC diagnostic pop
 #endif
 
+
+struct thrd_start
+{
+	thrd_start_t func;
+	void *arg;
+};
+
+
+static void *
+thrd_trampoline(void *in_start)
+{
+	struct thrd_start start = *(struct thrd_start *)in_start;
+	free(in_start);
+	return (void *)(intptr_t)start.func(start.arg);
+}
+
+
+int
+thrd_create(thrd_t *thr, thrd_start_t func, void *arg)
+{
+	struct thrd_start *start = malloc(sizeof *start);
+	start->func = func;
+	start->arg = arg;
+	if (0 != pthread_create(thr, NULL, thrd_trampoline, start))
+	{
+		free(start);
+		return thrd_error;
+	}
+	return thrd_success;
+}
+
+
+int
+thrd_join(thrd_t thr, int *res)
+{
+	void *result = NULL;
+	if (0 != pthread_join(thr, &result))
+	{
+		return thrd_error;
+	}
+	if (res)
+	{
+		*res = (int)(intptr_t)result;
+	}
+	return thrd_success;
+}
+
+
+int
+thrd_detach(thrd_t thr)
+{
+	return pthread_detach(thr) == 0 ? thrd_success : thrd_error;
+}
+
+
+int
+cnd_init(cnd_t *cond)
+{
+	return pthread_cond_init(cond, NULL) == 0 ? thrd_success : thrd_error;
+}
+
+
+int
+cnd_wait(cnd_t *cond, mtx_t *mutex)
+{
+	return pthread_cond_wait(cond, mutex) == 0 ? thrd_success : thrd_error;
+}
+
+
+int
+cnd_signal(cnd_t *cond)
+{
+	return pthread_cond_signal(cond) == 0 ? thrd_success : thrd_error;
+}
+
+
+int
+cnd_broadcast(cnd_t *cond)
+{
+	return pthread_cond_broadcast(cond) == 0 ? thrd_success : thrd_error;
+}
+
+
+void
+cnd_destroy(cnd_t *cond)
+{
+	pthread_cond_destroy(cond);
+}
+
+#endif
+
+
+bool
+sys_cnd_timedwait(cnd_t *cond, mtx_t *mutex, uint32_t in_ms)
+{
+	// both take an absolute time of the realtime clock
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += in_ms / 1000;
+	ts.tv_nsec += (long)(in_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000)
+	{
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000;
+	}
+#ifdef UTIL_HAS_THREADS_H
+	return cnd_timedwait(cond, mutex, &ts) != thrd_timedout;
+#else
+	return pthread_cond_timedwait(cond, mutex, &ts) != ETIMEDOUT;
 #endif
+}
@@ -1,6 +1,9 @@
 #include "util.h"
 
 #include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -398,8 +401,8 @@ fsu_enum_dir(
 }
 
 
-FILE *
-fsu_fopen(char const *in_path, char const *in_mode)
+static FILE *
+fsu_fopen_impl(char const *in_path, char const *in_mode, bool in_mkdir)
 {
 	ASSERT(in_mode);
 
@@ -422,7 +425,7 @@ fsu_fopen(char const *in_path, char const *in_mode)
 	}
 
 	// create directory if mode contains 'w'
-	if (has_write)
+	if (has_write && in_mkdir)
 	{
 		fsu_mkdir(in_path);
 	}
@@ -433,6 +436,72 @@ fsu_fopen(char const *in_path, char const *in_mode)
 }
 
 
+FILE *
+fsu_fopen(char const *in_path, char const *in_mode)
+{
+	return fsu_fopen_impl(in_path, in_mode, true);
+}
+
+
+FILE *
+fsu_fopen_nomkdir(char const *in_path, char const *in_mode)
+{
+	return fsu_fopen_impl(in_path, in_mode, false);
+}
+
+
+size_t
+fsu_pread(FILE *in_file, void *out_buffer, size_t in_bytes, uint64_t in_offset)
+{
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(in_file));
+	size_t total = 0;
+	while (total < in_bytes)
+	{
+		uint64_t const offset = in_offset + total;
+		// an explicit offset makes ReadFile() ignore the file position
+		OVERLAPPED ov = {
+			.Offset = (DWORD)offset,
+			.OffsetHigh = (DWORD)(offset >> 32),
+		};
+		size_t const remaining = in_bytes - total;
+		DWORD const nwant =
+		  remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+		DWORD nread = 0;
+		if (!ReadFile(file, (char *)out_buffer + total, nwant, &nread, &ov)
+		    || nread == 0)
+		{
+			break;
+		}
+		total += nread;
+	}
+	return total;
+}
+
+
+bool
+fsu_copy_range(
+  FILE *in_src,
+  uint64_t in_offset,
+  uint64_t in_bytes,
+  FILE *in_dst)
+{
+	char buffer[64 * 1024];
+	while (in_bytes > 0)
+	{
+		size_t const nwant =
+		  in_bytes < sizeof buffer ? (size_t)in_bytes : sizeof buffer;
+		size_t const nread = fsu_pread(in_src, buffer, nwant, in_offset);
+		if (nread != nwant || fwrite(buffer, 1, nread, in_dst) != nread)
+		{
+			return false;
+		}
+		in_offset += nread;
+		in_bytes -= nread;
+	}
+	return true;
+}
+
+
 bool
 fsu_mvfile(char const *in_srcpath, char const *in_dstpath, bool in_replace)
 {
@@ -478,6 +547,105 @@ fsu_mvfile(char const *in_srcpath, char const *in_dstpath, bool in_replace)
 	return (result == TRUE);
 }
 
+FILE *
+fsu_tee(FILE *in_file, fsu_tee_callback in_callback, void *in_userdata)
+{
+	// the CRT does not support custom streams
+	(void)in_file;
+	(void)in_callback;
+	(void)in_userdata;
+	return NULL;
+}
+
+
+bool
+fsu_truncate(char const *in_path, uint64_t in_bytes)
+{
+	// convert to utf16
+	size_t nchars = sys_wchar_from_utf8(in_path, NULL, 0);
+	ASSERT(nchars);
+	wchar_t *utf16 = malloc(nchars * sizeof *utf16);
+	sys_wchar_from_utf8(in_path, utf16, nchars);
+
+	HANDLE file = CreateFile(
+	  utf16,
+	  GENERIC_WRITE,
+	  FILE_SHARE_READ,
+	  NULL,
+	  OPEN_EXISTING,
+	  FILE_ATTRIBUTE_NORMAL,
+	  NULL);
+	free(utf16);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size = { .QuadPart = (LONGLONG)in_bytes };
+	BOOL ok = SetFilePointerEx(file, size, NULL, FILE_BEGIN)
+	  && SetEndOfFile(file);
+	CloseHandle(file);
+	return ok;
+}
+
+
+void const *
+fsu_mmap(char const *in_path, size_t *out_bytes)
+{
+	*out_bytes = 0;
+
+	// convert to utf16
+	size_t nchars = sys_wchar_from_utf8(in_path, NULL, 0);
+	ASSERT(nchars);
+	wchar_t *utf16 = malloc(nchars * sizeof *utf16);
+	sys_wchar_from_utf8(in_path, utf16, nchars);
+
+	HANDLE file = CreateFile(
+	  utf16,
+	  GENERIC_READ,
+	  FILE_SHARE_READ,
+	  NULL,
+	  OPEN_EXISTING,
+	  FILE_ATTRIBUTE_NORMAL,
+	  NULL);
+	free(utf16);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+
+	LARGE_INTEGER size = { .QuadPart = 0 };
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	CloseHandle(file);
+
+	if (!mapping)
+	{
+		return NULL;
+	}
+
+	// the view keeps its own reference to the mapping
+	void const *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	*out_bytes = data ? (size_t)size.QuadPart : 0;
+	return data;
+}
+
+
+void
+fsu_munmap(void const *in_data, size_t in_bytes)
+{
+	(void)in_bytes;
+	UnmapViewOfFile(in_data);
+}
+
+
 int64_t
 fsu_fsize(char const *in_path)
 {
@@ -510,6 +678,46 @@ fsu_fsize(char const *in_path)
 }
 
 
+static INIT_ONCE l_arena_once = INIT_ONCE_STATIC_INIT;
+static DWORD l_arena_fls = FLS_OUT_OF_INDEXES;
+
+
+static void NTAPI
+arena_destructor(void *in_arena)
+{
+	if (in_arena)
+	{
+		arena_free(in_arena);
+		free(in_arena);
+	}
+}
+
+
+static BOOL CALLBACK
+arena_fls_init(PINIT_ONCE once, void *param, void **context)
+{
+	(void)once;
+	(void)param;
+	(void)context;
+	l_arena_fls = FlsAlloc(arena_destructor);
+	return l_arena_fls != FLS_OUT_OF_INDEXES;
+}
+
+
+struct arena *
+arena_thread(void)
+{
+	InitOnceExecuteOnce(&l_arena_once, arena_fls_init, NULL, NULL);
+	struct arena *arena = FlsGetValue(l_arena_fls);
+	if (!arena)
+	{
+		arena = calloc(1, sizeof *arena);
+		FlsSetValue(l_arena_fls, arena);
+	}
+	return arena;
+}
+
+
 void
 sys_sleep(uint32_t ms)
 {
@@ -563,6 +771,107 @@ sys_seconds(void)
 }
 
 
+uint64_t
+sys_microseconds(void)
+{
+	static LARGE_INTEGER frequency;
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	uint64_t const ticks = (uint64_t)counter.QuadPart;
+	uint64_t const freq = (uint64_t)frequency.QuadPart;
+	// split to not overflow
+	return (ticks / freq) * 1000000 + (ticks % freq) * 1000000 / freq;
+}
+
+
+bool
+sys_pipe(FILE **out_read, FILE **out_write)
+{
+	int fds[2];
+	if (0 != _pipe(fds, 1024 * 1024, _O_BINARY))
+	{
+		return false;
+	}
+	*out_read = _fdopen(fds[0], "rb");
+	*out_write = _fdopen(fds[1], "wb");
+	if (!*out_read || !*out_write)
+	{
+		if (*out_read)
+		{
+			fclose(*out_read);
+		}
+		else
+		{
+			_close(fds[0]);
+		}
+		if (*out_write)
+		{
+			fclose(*out_write);
+		}
+		else
+		{
+			_close(fds[1]);
+		}
+		return false;
+	}
+	return true;
+}
+
+
+unsigned int
+sys_ncpus(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+
+bool
+sys_event_init(struct sys_event *out_event)
+{
+	out_event->handle = CreateEventW(NULL, TRUE, FALSE, NULL);
+	if (!out_event->handle)
+	{
+		LOGE("CreateEvent() failed: %lu", GetLastError());
+		return false;
+	}
+	return true;
+}
+
+
+void
+sys_event_destroy(struct sys_event *in_event)
+{
+	CloseHandle(in_event->handle);
+}
+
+
+void
+sys_event_set(struct sys_event *in_event)
+{
+	SetEvent(in_event->handle);
+}
+
+
+void
+sys_event_reset(struct sys_event *in_event)
+{
+	ResetEvent(in_event->handle);
+}
+
+
+intptr_t
+sys_event_handle(struct sys_event const *in_event)
+{
+	return (intptr_t)in_event->handle;
+}
+
+
 #ifndef UTIL_HAS_THREADS_H
 int
 mtx_init(mtx_t *mutex, int type)
@@ -594,4 +903,124 @@ mtx_unlock(mtx_t *mutex)
 	LeaveCriticalSection(mutex);
 	return 0;
 }
+
+
+struct thrd_start
+{
+	thrd_start_t func;
+	void *arg;
+};
+
+
+static unsigned __stdcall
+thrd_trampoline(void *in_start)
+{
+	struct thrd_start start = *(struct thrd_start *)in_start;
+	free(in_start);
+	return (unsigned)start.func(start.arg);
+}
+
+
+int
+thrd_create(thrd_t *thr, thrd_start_t func, void *arg)
+{
+	struct thrd_start *start = malloc(sizeof *start);
+	start->func = func;
+	start->arg = arg;
+	uintptr_t const handle =
+	  _beginthreadex(NULL, 0, thrd_trampoline, start, 0, NULL);
+	if (handle == 0)
+	{
+		free(start);
+		return thrd_error;
+	}
+	*thr = (HANDLE)handle;
+	return thrd_success;
+}
+
+
+int
+thrd_join(thrd_t thr, int *res)
+{
+	if (WaitForSingleObject(thr, INFINITE) != WAIT_OBJECT_0)
+	{
+		return thrd_error;
+	}
+	DWORD code = 0;
+	GetExitCodeThread(thr, &code);
+	CloseHandle(thr);
+	if (res)
+	{
+		*res = (int)code;
+	}
+	return thrd_success;
+}
+
+
+int
+thrd_detach(thrd_t thr)
+{
+	return CloseHandle(thr) ? thrd_success : thrd_error;
+}
+
+
+int
+cnd_init(cnd_t *cond)
+{
+	InitializeConditionVariable(cond);
+	return thrd_success;
+}
+
+
+int
+cnd_wait(cnd_t *cond, mtx_t *mutex)
+{
+	return SleepConditionVariableCS(cond, mutex, INFINITE) ? thrd_success
+	                                                       : thrd_error;
+}
+
+
+int
+cnd_signal(cnd_t *cond)
+{
+	WakeConditionVariable(cond);
+	return thrd_success;
+}
+
+
+int
+cnd_broadcast(cnd_t *cond)
+{
+	WakeAllConditionVariable(cond);
+	return thrd_success;
+}
+
+
+void
+cnd_destroy(cnd_t *cond)
+{
+	// condition variables do not need to be destroyed on windows
+	(void)cond;
+}
+#endif
+
+
+bool
+sys_cnd_timedwait(cnd_t *cond, mtx_t *mutex, uint32_t in_ms)
+{
+#ifdef UTIL_HAS_THREADS_H
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	ts.tv_sec += in_ms / 1000;
+	ts.tv_nsec += (long)(in_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000)
+	{
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000;
+	}
+	return cnd_timedwait(cond, mutex, &ts) != thrd_timedout;
+#else
+	return SleepConditionVariableCS(cond, mutex, in_ms)
+	  || GetLastError() != ERROR_TIMEOUT;
 #endif
+}
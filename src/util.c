@@ -1,5 +1,8 @@
 #include "util.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
@@ -116,3 +119,316 @@ enc_base64(
 
 	return req_bytes;
 }
+
+
+uint64_t
+hash_fnv1a(void const *in_data, size_t in_bytes)
+{
+	uint8_t const *data = in_data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < in_bytes; ++i)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+
+// MD5
+// ---
+// RFC 1321
+static uint32_t const kMD5K[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+	0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+	0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+	0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+	0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+	0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static unsigned char const kMD5Shift[16] = {
+	7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21,
+};
+
+
+static void
+md5_block(struct md5 *io_md5, unsigned char const *in_block)
+{
+	uint32_t m[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		m[i] = (uint32_t)in_block[i * 4] | (uint32_t)in_block[i * 4 + 1] << 8
+		  | (uint32_t)in_block[i * 4 + 2] << 16
+		  | (uint32_t)in_block[i * 4 + 3] << 24;
+	}
+
+	uint32_t a = io_md5->state[0];
+	uint32_t b = io_md5->state[1];
+	uint32_t c = io_md5->state[2];
+	uint32_t d = io_md5->state[3];
+	for (int i = 0; i < 64; ++i)
+	{
+		uint32_t f;
+		int g;
+		switch (i / 16)
+		{
+		case 0:
+			f = (b & c) | (~b & d);
+			g = i;
+			break;
+		case 1:
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+			break;
+		case 2:
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+			break;
+		default:
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+			break;
+		}
+		unsigned int const s = kMD5Shift[(i / 16) * 4 + i % 4];
+		uint32_t const x = a + f + kMD5K[i] + m[g];
+		a = d;
+		d = c;
+		c = b;
+		b = b + ((x << s) | (x >> (32 - s)));
+	}
+	io_md5->state[0] += a;
+	io_md5->state[1] += b;
+	io_md5->state[2] += c;
+	io_md5->state[3] += d;
+}
+
+
+void
+md5_init(struct md5 *out_md5)
+{
+	out_md5->state[0] = 0x67452301;
+	out_md5->state[1] = 0xefcdab89;
+	out_md5->state[2] = 0x98badcfe;
+	out_md5->state[3] = 0x10325476;
+	out_md5->nbytes = 0;
+}
+
+
+void
+md5_update(struct md5 *io_md5, void const *in_data, size_t in_bytes)
+{
+	unsigned char const *data = in_data;
+	size_t const nbuffered = (size_t)(io_md5->nbytes % 64);
+	io_md5->nbytes += in_bytes;
+
+	// complete the buffered block first
+	if (nbuffered > 0)
+	{
+		size_t const n = in_bytes < 64 - nbuffered ? in_bytes : 64 - nbuffered;
+		memcpy(io_md5->buffer + nbuffered, data, n);
+		data += n;
+		in_bytes -= n;
+		if (nbuffered + n < 64)
+		{
+			return;
+		}
+		md5_block(io_md5, io_md5->buffer);
+	}
+
+	for (; in_bytes >= 64; data += 64, in_bytes -= 64)
+	{
+		md5_block(io_md5, data);
+	}
+	memcpy(io_md5->buffer, data, in_bytes);
+}
+
+
+void
+md5_final(struct md5 *io_md5, char out_hex[33])
+{
+	uint64_t const nbits = io_md5->nbytes * 8;
+	unsigned char padding[72] = { 0x80 };
+	size_t const npadding = 64 - (size_t)((io_md5->nbytes + 8) % 64);
+	for (int i = 0; i < 8; ++i)
+	{
+		padding[npadding + (size_t)i] = (unsigned char)(nbits >> (8 * i));
+	}
+	md5_update(io_md5, padding, npadding + 8);
+
+	static char const digits[] = "0123456789abcdef";
+	for (int i = 0; i < 16; ++i)
+	{
+		uint32_t const byte = io_md5->state[i / 4] >> (8 * (i % 4));
+		out_hex[i * 2] = digits[(byte >> 4) & 0xf];
+		out_hex[i * 2 + 1] = digits[byte & 0xf];
+	}
+	out_hex[32] = '\0';
+}
+
+
+// ARENA
+// -----
+// minimum size of a block, including its header
+#define ARENA_MIN_BLOCK (64 * 1024)
+// check whether to shrink the arena every N complete releases
+#define ARENA_SHRINK_PERIOD 64
+
+struct arena_block
+{
+	struct arena_block *prev;
+	size_t size;
+	size_t used;
+	char _padding[8];
+	// data follows, 16 byte aligned
+};
+
+
+static size_t
+align16(size_t in_bytes)
+{
+	return (in_bytes + 15) & ~(size_t)15;
+}
+
+
+static struct arena_block *
+arena_new_block(struct arena_block *in_prev, size_t in_bytes)
+{
+	size_t size = align16(in_bytes) + sizeof(struct arena_block);
+	size = size < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK : size;
+	struct arena_block *block = malloc(size);
+	ASSERT(block);
+	block->prev = in_prev;
+	block->size = size - sizeof(struct arena_block);
+	block->used = 0;
+	return block;
+}
+
+
+void *
+arena_alloc(struct arena *a, size_t in_bytes)
+{
+	size_t const bytes = align16(in_bytes);
+	struct arena_block *top = a->top;
+	if (!top || top->size - top->used < bytes)
+	{
+		// grow geometrically, to keep the number of blocks low
+		size_t const next = top ? 2 * top->size : 0;
+		top = arena_new_block(top, bytes > next ? bytes : next);
+		a->top = top;
+	}
+
+	void *ptr = (char *)(top + 1) + top->used;
+	top->used += bytes;
+	a->total += bytes;
+	if (a->total > a->peak)
+	{
+		a->peak = a->total;
+	}
+	return ptr;
+}
+
+
+void *
+arena_calloc(struct arena *a, size_t in_count, size_t in_size)
+{
+	void *ptr = arena_alloc(a, in_count * in_size);
+	memset(ptr, 0, in_count * in_size);
+	return ptr;
+}
+
+
+struct arena_mark
+arena_mark(struct arena *a)
+{
+	if (!a->top)
+	{
+		a->top = arena_new_block(NULL, 0);
+	}
+	struct arena_block *top = a->top;
+	a->nmarks += 1;
+	return (struct arena_mark){
+		.block = top,
+		.used = top->used,
+		.total = a->total,
+	};
+}
+
+
+void
+arena_release(struct arena *a, struct arena_mark in_mark)
+{
+	ASSERT(a->nmarks > 0);
+	a->nmarks -= 1;
+	struct arena_block *top = a->top;
+	// the block of the mark has to be there, as long as marks are nested
+	while (top && top != in_mark.block)
+	{
+		struct arena_block *prev = top->prev;
+		free(top);
+		top = prev;
+	}
+	ASSERT(top);
+	top->used = in_mark.used;
+	a->top = top;
+	a->total = in_mark.total;
+
+	// only reorganize blocks if the arena is not in use at all. Outer marks
+	// still point to the current block, even if they were taken at total 0.
+	if (a->total > 0 || a->nmarks > 0)
+	{
+		return;
+	}
+
+	// the peak did not fit into the remaining block, so there were more.
+	// Those may have been freed by inner releases already.
+	bool const had_overflow = a->peak > top->size;
+	if (a->peak > a->window_peak)
+	{
+		a->window_peak = a->peak;
+	}
+	a->peak = 0;
+	a->nresets += 1;
+
+	size_t target = 0;
+	if (had_overflow)
+	{
+		// coalesce: replace all blocks with one big enough for the peak
+		target = a->window_peak;
+	}
+	else if (a->nresets >= ARENA_SHRINK_PERIOD)
+	{
+		// shrink, if the block was mostly unused for a while
+		if (top->size > 2 * a->window_peak && top->size > ARENA_MIN_BLOCK)
+		{
+			target = a->window_peak;
+		}
+		a->nresets = 0;
+		a->window_peak = 0;
+	}
+
+	if (target > 0)
+	{
+		free(top);
+		a->top = arena_new_block(NULL, target);
+	}
+}
+
+
+void
+arena_free(struct arena *a)
+{
+	struct arena_block *top = a->top;
+	while (top)
+	{
+		struct arena_block *prev = top->prev;
+		free(top);
+		top = prev;
+	}
+	*a = (struct arena){ 0 };
+}
@@ -48,6 +48,46 @@ enc_base64(
   void *out_dst,
   size_t in_dstbytes);
 
+/* Function: hash_fnv1a()
+ *
+ * 64bit FNV-1a hash of *in_bytes* bytes at *in_data*.
+ * Not cryptographically secure, but fast and good enough for hash-tables
+ * and file names.
+ */
+uint64_t
+hash_fnv1a(void const *in_data, size_t in_bytes);
+
+/* Struct: md5
+ *
+ * State of an incremental MD5 digest. See <md5_init()>.
+ */
+struct md5
+{
+	uint32_t state[4];
+	uint64_t nbytes;
+	unsigned char buffer[64];
+};
+
+/* Function: md5_init()
+ */
+void
+md5_init(struct md5 *out_md5);
+
+/* Function: md5_update()
+ *
+ * Add *in_bytes* bytes at *in_data* to the digest.
+ */
+void
+md5_update(struct md5 *io_md5, void const *in_data, size_t in_bytes);
+
+/* Function: md5_final()
+ *
+ * Finish the digest and write it as NUL-terminated lowercase hex string
+ * to *out_hex*.
+ */
+void
+md5_final(struct md5 *io_md5, char out_hex[33]);
+
 /* Enum: fsu_pathtype
  *
  * Types of directory entries.
@@ -133,9 +173,97 @@ fsu_rmdir(char const *path);
 bool
 fsu_rmdir_recursive(char const *path);
 
+/* Function: fsu_fopen_nomkdir()
+ *
+ *	Like <fsu_fopen()>, but never creates any directories.
+ *	For callers which already created all directories up front.
+ */
+FILE *
+fsu_fopen_nomkdir(char const *path, char const *mode);
+
+/* Function: fsu_pread()
+ *
+ *	Read up to *in_bytes* bytes at *in_offset* of *in_file*, independent of
+ *	the file position. So it is safe to be used by multiple threads on the
+ *	same file concurrently, as long as nobody relies on the file position.
+ *
+ *	Returns:
+ *		Number of bytes read.
+ */
+size_t
+fsu_pread(FILE *in_file, void *out_buffer, size_t in_bytes, uint64_t in_offset);
+
+/* Function: fsu_copy_range()
+ *
+ *	Append *in_bytes* bytes at *in_offset* of *in_src* to *in_dst*.
+ *	Uses copy_file_range() where available, so the data does not need to be
+ *	copied to userspace. *in_src* is read as with <fsu_pread()>.
+ *
+ *	Returns:
+ *		false if not all bytes could be copied.
+ */
+bool
+fsu_copy_range(
+  FILE *in_src,
+  uint64_t in_offset,
+  uint64_t in_bytes,
+  FILE *in_dst);
+
+/* Callback: fsu_tee_callback()
+ *
+ * Called by streams of <fsu_tee()> with every chunk written.
+ *
+ * Returns:
+ *	false to fail the write.
+ */
+typedef bool (*fsu_tee_callback)(
+  void *in_userdata,
+  void const *in_data,
+  size_t in_bytes);
+
+/* Function: fsu_tee()
+ *
+ *	Wrap *in_file* in a write-only stream, which writes everything to
+ *	*in_file* and passes it to *in_callback* as well, i.e. to hash data
+ *	while it is written. Closing the stream closes *in_file*.
+ *
+ *	Returns:
+ *		NULL if the platform has no custom streams (Windows).
+ */
+FILE *
+fsu_tee(FILE *in_file, fsu_tee_callback in_callback, void *in_userdata);
+
+/* Function: fsu_truncate()
+ *
+ *	Shrink (or extend with zeroes) a file to *in_bytes* bytes.
+ */
+bool
+fsu_truncate(char const *path, uint64_t in_bytes);
+
+/* Function: fsu_mmap()
+ *
+ *	Map a whole file read-only into memory. The mapping stays valid after
+ *	the file was replaced or removed, except on Windows where it prevents
+ *	both.
+ *
+ *	Returns:
+ *		NULL on error or if the file is empty.
+ */
+void const *
+fsu_mmap(char const *path, size_t *out_bytes);
+
+/* Function: fsu_munmap()
+ *
+ *	Unmap a file mapped by <fsu_mmap()>.
+ */
+void
+fsu_munmap(void const *in_data, size_t in_bytes);
+
 /* Function: fsu_mvfile()
  *
  *	Move file. Creates required directories automatically.
+ *	Also moves directories, as long as source and destination are on the
+ *	same volume.
  */
 bool
 fsu_mvfile(char const *from, char const *to, bool in_replace);
@@ -164,6 +292,85 @@ fsu_enum_dir(
   fsu_enum_dir_callback in_callback,
   void *in_userdata);
 
+/* Struct: arena_mark
+ *
+ * Position in an <arena>, as returned by <arena_mark()>.
+ */
+struct arena_mark
+{
+	void *block;
+	size_t used;
+	size_t total;
+};
+
+/* Struct: arena
+ *
+ * Growable bump allocator. Memory is freed all at once by
+ * <arena_release()>, either up to a mark or completely.
+ *
+ * Whenever the outermost mark is released and the arena is empty, all its
+ * blocks are coalesced into a single block the size of the highest usage
+ * (high water mark).
+ * If the block turns out to be much larger than what was used for
+ * a while, it is shrunk again.
+ * So after warming up, allocations do not touch the heap anymore.
+ */
+struct arena
+{
+	void *top;
+	size_t total;
+	size_t peak;
+	size_t window_peak;
+	uint32_t nresets;
+	// number of marks which are not released
+	uint32_t nmarks;
+};
+
+/* Function: arena_thread()
+ *
+ * Get the arena of the calling thread. It is freed automatically when the
+ * thread exits.
+ */
+struct arena *
+arena_thread(void);
+
+/* Function: arena_alloc()
+ *
+ * Allocate *in_bytes* bytes, aligned to 16 bytes.
+ */
+void *
+arena_alloc(struct arena *in_arena, size_t in_bytes);
+
+/* Function: arena_calloc()
+ *
+ * Like <arena_alloc()>, but zeroes the memory. Parameters as calloc().
+ */
+void *
+arena_calloc(struct arena *in_arena, size_t in_count, size_t in_size);
+
+/* Function: arena_mark()
+ *
+ * Remember the current position of the arena, to release everything
+ * allocated afterwards with <arena_release()>. Marks can be nested, but
+ * need to be released in reverse order.
+ */
+struct arena_mark
+arena_mark(struct arena *in_arena);
+
+/* Function: arena_release()
+ *
+ * Release all allocations made after *in_mark* was taken.
+ */
+void
+arena_release(struct arena *in_arena, struct arena_mark in_mark);
+
+/* Function: arena_free()
+ *
+ * Free all memory of an arena.
+ */
+void
+arena_free(struct arena *in_arena);
+
 /* Function: sys_sleep()
  *
  * Sleep thread for certain amount of milliseconds.
@@ -181,20 +388,131 @@ sys_sleep(uint32_t ms);
 time_t
 sys_seconds(void);
 
+/* Function: sys_microseconds()
+ *
+ * Gets the number of microseconds elapsed from some arbitrary point in time,
+ * from a monotonic clock. Meant to measure durations.
+ */
+uint64_t
+sys_microseconds(void);
+
+/* Function: sys_pipe()
+ *
+ * Create an anonymous pipe, opened as binary streams.
+ * Data written to *out_write* can be read from *out_read*. Once
+ * *out_write* is closed, reading *out_read* reports EOF.
+ */
+bool
+sys_pipe(FILE **out_read, FILE **out_write);
+
+/* Function: sys_ncpus()
+ *
+ * Number of logical CPUs available, at least 1.
+ */
+unsigned int
+sys_ncpus(void);
+
+/* Struct: sys_event
+ *
+ * Something an event loop can wait on, which is signalled across threads:
+ * an eventfd on Linux, a non-blocking pipe on other POSIX systems and a
+ * manual-reset event on Windows.
+ */
+struct sys_event
+{
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	int read_fd;
+	int write_fd;
+#endif
+};
+
+/* Function: sys_event_init()
+ *
+ * Create an event, which is not signalled.
+ */
+bool
+sys_event_init(struct sys_event *out_event);
+
+/* Function: sys_event_destroy()
+ */
+void
+sys_event_destroy(struct sys_event *in_event);
+
+/* Function: sys_event_set()
+ *
+ * Signal the event, so <sys_event_handle()> becomes readable.
+ * Setting it while it is signalled already is fine.
+ */
+void
+sys_event_set(struct sys_event *in_event);
+
+/* Function: sys_event_reset()
+ *
+ * Reset the event, so it is not signalled anymore.
+ */
+void
+sys_event_reset(struct sys_event *in_event);
+
+/* Function: sys_event_handle()
+ *
+ * The file descriptor (HANDLE on Windows) to wait on.
+ */
+intptr_t
+sys_event_handle(struct sys_event const *in_event);
+
 #ifndef UTIL_HAS_THREADS_H
 // if there is no system/compiler provided implementation of C11's threads.h
-// use this barebones mtx-functions to provide the required functionality.
+// use this barebones mtx/cnd/thrd-functions to provide the required
+// functionality.
 #ifdef _WIN32
 typedef CRITICAL_SECTION mtx_t;
+typedef CONDITION_VARIABLE cnd_t;
+typedef HANDLE thrd_t;
 #else
 typedef pthread_mutex_t mtx_t;
+typedef pthread_cond_t cnd_t;
+typedef pthread_t thrd_t;
 #endif
 
+typedef int (*thrd_start_t)(void *);
+
 enum mtx_types
 {
 	mtx_plain = 0,
 };
 
+enum thrd_results
+{
+	thrd_success = 0,
+	thrd_error = 1,
+};
+
+int
+thrd_create(thrd_t *thr, thrd_start_t func, void *arg);
+
+int
+thrd_join(thrd_t thr, int *res);
+
+int
+thrd_detach(thrd_t thr);
+
+int
+cnd_init(cnd_t *cond);
+
+int
+cnd_wait(cnd_t *cond, mtx_t *mutex);
+
+int
+cnd_signal(cnd_t *cond);
+
+int
+cnd_broadcast(cnd_t *cond);
+
+void
+cnd_destroy(cnd_t *cond);
+
 int
 mtx_init(mtx_t *mutex, int type);
 
@@ -209,6 +527,17 @@ mtx_destroy(mtx_t *mutex);
 
 #endif
 
+/* Function: sys_cnd_timedwait()
+ *
+ * Like cnd_wait(), but gives up after *in_ms* milliseconds. May return
+ * early, like cnd_wait() itself.
+ *
+ * Returns:
+ *	false if the time is up.
+ */
+bool
+sys_cnd_timedwait(cnd_t *cond, mtx_t *mutex, uint32_t in_ms);
+
 #ifdef _WIN32
 
 /* Function: sys_wchar_from_utf8()
@@ -86,12 +86,11 @@ test_get_all_games(void)
 	minimod_init(API_KEY_LIVE, NULL, 0, MINIMOD_CURRENT_ABI);
 
 	int nrequests_completed = 0;
-	minimod_get_games(NULL, get_all_games_callback, &nrequests_completed);
+	minimod_handle const request =
+	  minimod_get_games(NULL, get_all_games_callback, &nrequests_completed);
 
-	while (nrequests_completed == 0)
-	{
-		sys_sleep(10);
-	}
+	// block instead of spinning on nrequests_completed
+	minimod_wait(request, MINIMOD_WAIT_FOREVER);
 
 	minimod_deinit();
 }
@@ -692,6 +691,99 @@ test_dependencies(void)
 }
 
 
+// ===================================================================
+// RESPONSE CACHE
+// -------------------------------------------------------------------
+static void
+on_cached_games(
+  void *udata,
+  size_t ngames,
+  struct minimod_game const *UNUSED(games),
+  struct minimod_pagination const *UNUSED(pagi))
+{
+	printf("got %zu games\n", ngames);
+	*((int *)udata) = 0;
+}
+
+
+static void
+test_cache(void)
+{
+	printf("\n= Response cache:\n");
+	minimod_init(API_KEY_LIVE, NULL, 0, MINIMOD_CURRENT_ABI);
+	minimod_set_cache(8 * 1024 * 1024, 64);
+
+	// the second request is revalidated and served from the cache
+	for (int i = 0; i < 2; ++i)
+	{
+		int wait = 1;
+		minimod_get_games(NULL, on_cached_games, &wait);
+		while (wait)
+		{
+			sys_sleep(10);
+		}
+	}
+
+	struct minimod_cache_stats stats;
+	minimod_get_cache_stats(&stats);
+	printf(
+	  "hits: %" PRIu64 " misses: %" PRIu64 " bytes saved: %" PRIu64 "\n",
+	  stats.nhits,
+	  stats.nmisses,
+	  stats.nbytes_saved);
+
+	minimod_deinit();
+}
+
+
+// ===================================================================
+// PAGING
+// -------------------------------------------------------------------
+static void
+on_all_games(
+  void *udata,
+  size_t ngames,
+  struct minimod_game const *UNUSED(games),
+  struct minimod_pagination const *pagi)
+{
+	if (!pagi)
+	{
+		printf("request failed\n");
+		*((int *)udata) = 0;
+		return;
+	}
+
+	printf(
+	  "page at %" PRIu64 ": %zu of %" PRIu64 " games\n",
+	  pagi->offset,
+	  ngames,
+	  pagi->total);
+	if (pagi->is_last)
+	{
+		*((int *)udata) = 0;
+	}
+}
+
+
+static void
+test_paging(void)
+{
+	printf("\n= All pages of all games:\n");
+	minimod_init(API_KEY_LIVE, NULL, 0, MINIMOD_CURRENT_ABI);
+
+	int wait = 1;
+	struct minimod_paging *paging =
+	  minimod_get_games_all(NULL, 4, on_all_games, &wait);
+	while (wait)
+	{
+		sys_sleep(10);
+	}
+	minimod_release_paging(paging);
+
+	minimod_deinit();
+}
+
+
 int
 main(void)
 {
@@ -709,6 +801,8 @@ main(void)
 	test_mod_events();
 	test_user_events();
 	test_dependencies();
+	test_cache();
+	test_paging();
 
 	printf("[test] Done\n");
 